@@ -0,0 +1,149 @@
+// stream.c
+//
+// Output side of the headless frontends: writes frame messages to stdout or
+// to a unix domain socket, and paces the emulation to real time.
+
+#define _POSIX_C_SOURCE 200809L
+#include "stream.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define STREAM_FRAME_TIME_US (16667)
+
+static struct {
+    int fd;
+    bool fast;
+    struct timespec start;
+    struct timespec next_frame;
+} state;
+
+stream_args_t stream_parse_args(int argc, char* argv[]) {
+    stream_args_t args = {0};
+    for (int i = 1; i < argc; i++) {
+        if ((strcmp(argv[i], "-o") == 0) && (i + 1 < argc)) {
+            args.output = argv[++i];
+        } else if ((strcmp(argv[i], "-n") == 0) && (i + 1 < argc)) {
+            args.num_frames = (uint32_t)strtoul(argv[++i], 0, 10);
+        } else if (strcmp(argv[i], "-f") == 0) {
+            args.fast = true;
+        } else if ((strcmp(argv[i], "-r") == 0) && (i + 1 < argc)) {
+            args.record = argv[++i];
+        } else if ((strcmp(argv[i], "-p") == 0) && (i + 1 < argc)) {
+            args.replay = argv[++i];
+        } else {
+            fprintf(stderr, "usage: %s [-o socket_path] [-n frames] [-f] [-r recording_file] [-p input_log]\n",
+                    argv[0]);
+            exit(1);
+        }
+    }
+    return args;
+}
+
+bool stream_init(const stream_args_t* args) {
+    // A disconnecting receiver must not kill the emulator
+    signal(SIGPIPE, SIG_IGN);
+    state.fast = args->fast;
+    clock_gettime(CLOCK_MONOTONIC, &state.start);
+    state.next_frame = state.start;
+    if (args->output == 0) {
+        // Keep the real stdout for the stream and send diagnostic prints from the emulation to stderr
+        fflush(stdout);
+        state.fd = dup(STDOUT_FILENO);
+        if ((state.fd < 0) || (dup2(STDERR_FILENO, STDOUT_FILENO) < 0)) {
+            perror("dup");
+            return false;
+        }
+        return true;
+    }
+    struct sockaddr_un addr = {.sun_family = AF_UNIX};
+    if (strlen(args->output) >= sizeof(addr.sun_path)) {
+        fprintf(stderr, "socket path too long: %s\n", args->output);
+        return false;
+    }
+    strcpy(addr.sun_path, args->output);
+    state.fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (state.fd < 0) {
+        perror("socket");
+        return false;
+    }
+    if (connect(state.fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        close(state.fd);
+        return false;
+    }
+    return true;
+}
+
+void stream_shutdown(void) { close(state.fd); }
+
+bool stream_write(const uint8_t* data, size_t size) {
+    while (size > 0) {
+        const ssize_t n = write(state.fd, data, size);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        size -= (size_t)n;
+    }
+    return true;
+}
+
+void stream_record_write(const void* data, size_t size, void* user_data) {
+    fwrite(data, size, 1, (FILE*)user_data);
+}
+
+uint32_t stream_frame_time(void) {
+    if (!state.fast) {
+        state.next_frame.tv_nsec += STREAM_FRAME_TIME_US * 1000L;
+        if (state.next_frame.tv_nsec >= 1000000000L) {
+            state.next_frame.tv_nsec -= 1000000000L;
+            state.next_frame.tv_sec++;
+        }
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &state.next_frame, 0) == EINTR) {
+        }
+    }
+    return STREAM_FRAME_TIME_US;
+}
+
+uint8_t* stream_load_file(const char* path, size_t* size) {
+    FILE* fp = fopen(path, "rb");
+    if (fp == 0) {
+        perror(path);
+        return 0;
+    }
+    uint8_t* data = 0;
+    if ((fseek(fp, 0, SEEK_END) == 0) && (ftell(fp) > 0)) {
+        *size = (size_t)ftell(fp);
+        data = malloc(*size);
+        rewind(fp);
+        if (data && (fread(data, *size, 1, fp) != 1)) {
+            free(data);
+            data = 0;
+        }
+    }
+    fclose(fp);
+    if (data == 0) {
+        fprintf(stderr, "%s: read error\n", path);
+    }
+    return data;
+}
+
+bool stream_replay_report(const input_log_player_t* player) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const double ms = (now.tv_sec - state.start.tv_sec) * 1000.0 + (now.tv_nsec - state.start.tv_nsec) / 1000000.0;
+    fprintf(stderr, "replay: %u frames, %llu ticks in %.1f ms, %u checkpoints, %u tick errors, %u hash errors%s\n",
+            player->num_frames, (unsigned long long)player->replay_ticks, ms, player->num_checks,
+            player->num_tick_errors, player->num_check_errors, player->truncated ? ", log truncated" : "");
+    return (player->num_tick_errors == 0) && (player->num_check_errors == 0) && !player->truncated;
+}
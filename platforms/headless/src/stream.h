@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "chips/chips_common.h"
+#include "util/input_log.h"
+
+typedef struct {
+    const char* output;  // unix socket path, or 0 for stdout
+    uint32_t num_frames; // number of frames to run, 0 for no limit
+    bool fast;           // don't pace frames to real time
+    const char* record;  // file to record the session to (see util/recorder.h), or 0
+    const char* replay;  // input log to replay (see util/input_log.h), or 0
+} stream_args_t;
+
+// Parse '-o <socket path>', '-n <frames>', '-f' (fast), '-r <recording file>' and '-p <input log>' from the
+// command line
+stream_args_t stream_parse_args(int argc, char* argv[]);
+// Open the output, returns false on error
+bool stream_init(const stream_args_t* args);
+void stream_shutdown(void);
+// Write a complete frame message, returns false if the receiver went away
+bool stream_write(const uint8_t* data, size_t size);
+// Recorder write callback, 'user_data' is the FILE* of the recording
+void stream_record_write(const void* data, size_t size, void* user_data);
+// Wait until the next 60 Hz frame is due (returns immediately in fast mode), returns the frame time in microseconds
+uint32_t stream_frame_time(void);
+// Read a whole file into memory, returns 0 on error (release with free())
+uint8_t* stream_load_file(const char* path, size_t* size);
+// Print the replay results of an input log, returns false if the replay diverged from the log
+bool stream_replay_report(const input_log_player_t* player);
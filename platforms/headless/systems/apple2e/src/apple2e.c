@@ -0,0 +1,222 @@
+// apple2e.c
+//
+// Headless Apple //e streamer: runs the emulation without a window and writes
+// the rows changed each frame as fbstream messages (see util/fbstream.h).
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#define CHIPS_IMPL
+#define MEM_PAGE_SHIFT (9U)
+#define MEM_FLAT_PAGE_TABLE
+#define MEM_NUM_LAYERS (1U)
+#define MEM_TRACK_WRITES
+
+#define __in_flash()
+#define __not_in_flash()
+
+#define RGBA8(b, g, r) (0xFF000000 | (r << 16) | (g << 8) | (b))
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "roms/apple2e_roms.h"
+#include "images/apple2_images.h"
+
+#include "chips/chips_common.h"
+#include "chips/mos6502cpu.h"
+#include "chips/beeper.h"
+#include "chips/kbd.h"
+#include "chips/mem.h"
+#include "chips/clk.h"
+#include "devices/disk2_fdd.h"
+#include "devices/disk2_fdc.h"
+#include "devices/apple2_fdc_rom.h"
+#include "devices/prodos_hdd.h"
+#include "devices/prodos_hdc.h"
+#include "devices/prodos_hdc_rom.h"
+#include "systems/apple2e.h"
+
+#include "stream.h"
+#include "util/fbstream.h"
+#include "util/recorder.h"
+#include "util/input_log.h"
+
+#define FRAME_BYTES_PER_ROW (APPLE2E_SCREEN_WIDTH / 2)
+
+static struct {
+    apple2e_t apple2e;
+    fbstream_t stream;
+    uint8_t msg[FBSTREAM_MAX_FRAME_SIZE(FRAME_BYTES_PER_ROW, APPLE2E_SCREEN_HEIGHT)];
+    FILE* record_file;
+    recorder_t recorder;
+    uint8_t* replay_data;
+    input_log_player_t player;
+} state;
+
+static int16_t audio_buffer[1024];
+
+// Audio is only kept in recordings
+static void audio_callback(const void* samples, int num_samples, void* user_data) {
+    (void)user_data;
+    if (state.record_file) {
+        recorder_audio(&state.recorder, samples, num_samples, CHIPS_AUDIO_FORMAT_S16);
+    }
+}
+
+// Get apple2e_desc_t struct
+apple2e_desc_t apple2e_desc(void) {
+    return (apple2e_desc_t){
+        .fdc_enabled = false,
+        .hdc_enabled = true,
+        .hdc_internal_flash = false,
+        .audio =
+            {
+                .block_callback = {.func = audio_callback},
+                .format = CHIPS_AUDIO_FORMAT_S16,
+                .buffer = {.ptr = audio_buffer, .size = sizeof(audio_buffer)},
+                .sample_rate = 44100,
+            },
+        .roms =
+            {
+                .rom = {.ptr = apple2e_rom, .size = sizeof(apple2e_rom)},
+                .character_rom = {.ptr = apple2e_character_rom, .size = sizeof(apple2e_character_rom)},
+                .keyboard_rom = {.ptr = apple2e_keyboard_rom, .size = sizeof(apple2e_keyboard_rom)},
+                .fdc_rom = {.ptr = apple2_fdc_rom, .size = sizeof(apple2_fdc_rom)},
+                .hdc_rom = {.ptr = prodos_hdc_rom, .size = sizeof(prodos_hdc_rom)},
+            },
+    };
+}
+
+// Replay driver callbacks, the inputs are applied as in the PC frontend which recorded the log
+static uint32_t replay_exec(uint32_t micro_seconds, void* user_data) {
+    return apple2e_exec((apple2e_t*)user_data, micro_seconds);
+}
+
+static void replay_input(const input_log_event_t* ev, void* user_data) {
+    apple2e_t* sys = (apple2e_t*)user_data;
+    switch (ev->type) {
+        case INPUT_LOG_KEY_DOWN:
+            sys->kbd_last_key = (uint8_t)ev->code | 0x80;
+            break;
+        case INPUT_LOG_BUTTON:
+            if (ev->code == 0) {
+                sys->kbd_open_apple_pressed = ev->value != 0;
+            } else {
+                sys->kbd_solid_apple_pressed = ev->value != 0;
+            }
+            break;
+        case INPUT_LOG_PADDLE:
+            switch (ev->code) {
+                case 0: sys->paddl0 = (uint8_t)ev->value; break;
+                case 1: sys->paddl1 = (uint8_t)ev->value; break;
+                case 2: sys->paddl2 = (uint8_t)ev->value; break;
+                case 3: sys->paddl3 = (uint8_t)ev->value; break;
+            }
+            break;
+        case INPUT_LOG_RESET:
+            apple2e_reset(sys);
+            break;
+        case INPUT_LOG_INSERT:
+            if (sys->fdc.valid && (ev->code < CHIPS_ARRAY_SIZE(apple2_nib_images))) {
+                disk2_fdd_insert_disk(&sys->fdc.fdd[0], apple2_nib_images[ev->code]);
+            }
+            break;
+    }
+}
+
+static uint32_t replay_hash(void* user_data) {
+    apple2e_t* sys = (apple2e_t*)user_data;
+    uint32_t hash = input_log_hash(INPUT_LOG_HASH_INIT, sys->ram, sizeof(sys->ram));
+    return input_log_hash(hash, sys->aux_ram, sizeof(sys->aux_ram));
+}
+
+int main(int argc, char* argv[]) {
+    const stream_args_t args = stream_parse_args(argc, argv);
+    if (!stream_init(&args)) {
+        return 1;
+    }
+    if (args.replay) {
+        size_t size = 0;
+        state.replay_data = stream_load_file(args.replay, &size);
+        if ((state.replay_data == 0) ||
+            !input_log_player_init(&state.player, state.replay_data, size, APPLE2E_STATE_ID)) {
+            fprintf(stderr, "%s: not an Apple //e input log\n", args.replay);
+            return 1;
+        }
+    }
+    apple2e_desc_t desc = apple2e_desc();
+    apple2e_init(&state.apple2e, &desc);
+    fbstream_init(&state.stream, FRAME_BYTES_PER_ROW, APPLE2E_SCREEN_HEIGHT);
+    if (args.record) {
+        state.record_file = fopen(args.record, "wb");
+        if (state.record_file == 0) {
+            perror(args.record);
+            return 1;
+        }
+        recorder_init(&state.recorder, &(recorder_desc_t){
+                                           .width = APPLE2E_SCREEN_WIDTH,
+                                           .height = APPLE2E_SCREEN_HEIGHT,
+                                           .palette = apple2e_palette,
+                                           .sample_rate = 44100,
+                                           .write = {.func = stream_record_write, .user_data = state.record_file},
+                                       });
+    }
+
+    const input_log_replay_t replay = {
+        .exec = replay_exec,
+        .input = replay_input,
+        .hash = replay_hash,
+        .user_data = &state.apple2e,
+    };
+
+    // The first frame carries the whole screen
+    for (int row = 0; row < APPLE2E_SCREEN_HEIGHT; row++) {
+        chips_dirty_rows_set(&state.apple2e.dirty_rows, row);
+    }
+    for (uint32_t frame = 0; (args.num_frames == 0) || (frame < args.num_frames); frame++) {
+        if (args.replay) {
+            stream_frame_time();
+            if (!input_log_replay_frame(&state.player, &replay)) {
+                break;
+            }
+        } else {
+            apple2e_exec(&state.apple2e, stream_frame_time());
+        }
+        const size_t size =
+            fbstream_encode(&state.stream, state.apple2e.fb, &state.apple2e.dirty_rows, state.msg, sizeof(state.msg));
+        if (state.record_file) {
+            recorder_frame(&state.recorder, state.apple2e.fb, &state.apple2e.dirty_rows);
+        }
+        chips_dirty_rows_clear(&state.apple2e.dirty_rows);
+        if (!stream_write(state.msg, size)) {
+            break;
+        }
+    }
+    apple2e_discard(&state.apple2e);
+    bool replay_ok = true;
+    if (args.replay) {
+        replay_ok = stream_replay_report(&state.player);
+        free(state.replay_data);
+    }
+    if (state.record_file) {
+        fclose(state.record_file);
+    }
+    stream_shutdown();
+    return replay_ok ? 0 : 1;
+}
@@ -0,0 +1,212 @@
+// oric.c
+//
+// Headless Oric streamer: runs the emulation without a window and writes
+// the rows changed each frame as fbstream messages (see util/fbstream.h).
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#define CHIPS_IMPL
+#define MEM_TRACK_WRITES
+
+#define __in_flash()
+#define __not_in_flash()
+
+#define RGBA8(b, g, r) (0xFF000000 | (r << 16) | (g << 8) | (b))
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "roms/oric_roms.h"
+#include "images/oric_images.h"
+
+#include "chips/chips_common.h"
+#include "chips/mos6502cpu.h"
+#include "chips/mos6522via.h"
+#include "chips/ay38910psg.h"
+#include "chips/beeper.h"
+#include "chips/kbd.h"
+#include "chips/mem.h"
+#include "chips/clk.h"
+#include "devices/oric_td.h"
+#include "devices/disk2_fdd.h"
+#include "devices/disk2_fdc.h"
+#include "devices/oric_fdc_rom.h"
+#include "systems/oric.h"
+
+#include "stream.h"
+#include "util/fbstream.h"
+#include "util/recorder.h"
+#include "util/input_log.h"
+
+#define FRAME_BYTES_PER_ROW (ORIC_SCREEN_WIDTH / 2)
+
+static struct {
+    oric_t oric;
+    fbstream_t stream;
+    uint8_t msg[FBSTREAM_MAX_FRAME_SIZE(FRAME_BYTES_PER_ROW, ORIC_SCREEN_HEIGHT)];
+    FILE* record_file;
+    recorder_t recorder;
+    uint8_t* replay_data;
+    input_log_player_t player;
+} state;
+
+static int16_t audio_buffer[1024];
+
+// Audio is only kept in recordings
+static void audio_callback(const void* samples, int num_samples, void* user_data) {
+    (void)user_data;
+    if (state.record_file) {
+        recorder_audio(&state.recorder, samples, num_samples, CHIPS_AUDIO_FORMAT_S16);
+    }
+}
+
+// Get oric_desc_t struct
+oric_desc_t oric_desc(void) {
+    return (oric_desc_t){
+        .td_enabled = true,  // Enable tape drive
+        .fdc_enabled = true, // Enable floppy disk controller
+        .audio =
+            {
+                .block_callback = {.func = audio_callback},
+                .format = CHIPS_AUDIO_FORMAT_S16,
+                .buffer = {.ptr = audio_buffer, .size = sizeof(audio_buffer)},
+                .sample_rate = 44100,
+            },
+        .roms =
+            {
+                .rom = {.ptr = oric_rom, .size = sizeof(oric_rom)},
+                .boot_rom = {.ptr = oric_fdc_rom, .size = sizeof(oric_fdc_rom)},
+            },
+    };
+}
+
+// Replay driver callbacks, the inputs are applied as in the PC frontend which recorded the log
+static uint32_t replay_exec(uint32_t micro_seconds, void* user_data) {
+    return oric_exec((oric_t*)user_data, micro_seconds);
+}
+
+static void replay_input(const input_log_event_t* ev, void* user_data) {
+    oric_t* sys = (oric_t*)user_data;
+    switch (ev->type) {
+        case INPUT_LOG_KEY_DOWN:
+            kbd_key_down(&sys->kbd, ev->code);
+            break;
+        case INPUT_LOG_KEY_UP:
+            kbd_key_up(&sys->kbd, ev->code);
+            break;
+        case INPUT_LOG_RESET:
+            oric_reset(sys);
+            break;
+        case INPUT_LOG_NMI:
+            oric_nmi(sys);
+            break;
+        case INPUT_LOG_INSERT:
+            if (ev->code < CHIPS_ARRAY_SIZE(oric_nib_images)) {
+                if (sys->fdc.valid) {
+                    disk2_fdd_insert_disk(&sys->fdc.fdd[0], oric_nib_images[ev->code]);
+                }
+            } else if (ev->code - CHIPS_ARRAY_SIZE(oric_nib_images) < CHIPS_ARRAY_SIZE(oric_wave_images)) {
+                if (sys->td.valid) {
+                    oric_td_insert_tape(&sys->td, oric_wave_images[ev->code - CHIPS_ARRAY_SIZE(oric_nib_images)]);
+                }
+            }
+            break;
+    }
+}
+
+static uint32_t replay_hash(void* user_data) {
+    oric_t* sys = (oric_t*)user_data;
+    uint32_t hash = input_log_hash(INPUT_LOG_HASH_INIT, sys->ram, sizeof(sys->ram));
+    return input_log_hash(hash, sys->overlay_ram, sizeof(sys->overlay_ram));
+}
+
+int main(int argc, char* argv[]) {
+    const stream_args_t args = stream_parse_args(argc, argv);
+    if (!stream_init(&args)) {
+        return 1;
+    }
+    if (args.replay) {
+        size_t size = 0;
+        state.replay_data = stream_load_file(args.replay, &size);
+        if ((state.replay_data == 0) ||
+            !input_log_player_init(&state.player, state.replay_data, size, ORIC_STATE_ID)) {
+            fprintf(stderr, "%s: not an Oric input log\n", args.replay);
+            return 1;
+        }
+    }
+    oric_desc_t desc = oric_desc();
+    oric_init(&state.oric, &desc);
+    fbstream_init(&state.stream, FRAME_BYTES_PER_ROW, ORIC_SCREEN_HEIGHT);
+    if (args.record) {
+        state.record_file = fopen(args.record, "wb");
+        if (state.record_file == 0) {
+            perror(args.record);
+            return 1;
+        }
+        recorder_init(&state.recorder, &(recorder_desc_t){
+                                           .width = ORIC_SCREEN_WIDTH,
+                                           .height = ORIC_SCREEN_HEIGHT,
+                                           .palette = oric_palette,
+                                           .sample_rate = 44100,
+                                           .write = {.func = stream_record_write, .user_data = state.record_file},
+                                       });
+    }
+
+    const input_log_replay_t replay = {
+        .exec = replay_exec,
+        .input = replay_input,
+        .hash = replay_hash,
+        .user_data = &state.oric,
+    };
+
+    // The first frame carries the whole screen
+    for (int row = 0; row < ORIC_SCREEN_HEIGHT; row++) {
+        chips_dirty_rows_set(&state.oric.dirty_rows, row);
+    }
+    for (uint32_t frame = 0; (args.num_frames == 0) || (frame < args.num_frames); frame++) {
+        if (args.replay) {
+            stream_frame_time();
+            if (!input_log_replay_frame(&state.player, &replay)) {
+                break;
+            }
+        } else {
+            oric_exec(&state.oric, stream_frame_time());
+        }
+        const size_t size =
+            fbstream_encode(&state.stream, state.oric.fb, &state.oric.dirty_rows, state.msg, sizeof(state.msg));
+        if (state.record_file) {
+            recorder_frame(&state.recorder, state.oric.fb, &state.oric.dirty_rows);
+        }
+        chips_dirty_rows_clear(&state.oric.dirty_rows);
+        if (!stream_write(state.msg, size)) {
+            break;
+        }
+    }
+    oric_discard(&state.oric);
+    bool replay_ok = true;
+    if (args.replay) {
+        replay_ok = stream_replay_report(&state.player);
+        free(state.replay_data);
+    }
+    if (state.record_file) {
+        fclose(state.record_file);
+    }
+    stream_shutdown();
+    return replay_ok ? 0 : 1;
+}
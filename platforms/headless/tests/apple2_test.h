@@ -0,0 +1,82 @@
+#pragma once
+// apple2_test.h
+//
+// Shared setup of the Apple ][ system tests: includes the implementation and
+// boots a system straight into a test program in RAM. The tests don't depend
+// on the content of the Apple ][ ROMs, the system gets a zero filled ROM copy
+// whose reset vector points to the program.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#define CHIPS_IMPL
+
+#define __in_flash()
+#define __not_in_flash()
+
+#define RGBA8(b, g, r) (0xFF000000 | (r << 16) | (g << 8) | (b))
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "images/apple2_images.h"
+
+#include "chips/chips_common.h"
+#include "chips/mos6502cpu.h"
+#include "chips/beeper.h"
+#include "chips/kbd.h"
+#include "chips/mem.h"
+#include "chips/clk.h"
+#include "devices/apple2_lc.h"
+#include "devices/disk2_fdd.h"
+#include "devices/disk2_fdc.h"
+#include "devices/apple2_fdc_rom.h"
+#include "devices/prodos_hdd.h"
+#include "devices/prodos_hdc.h"
+#include "devices/prodos_hdc_rom.h"
+#include "systems/apple2.h"
+
+#define TEST_PROGRAM_ADDR (0x0300)
+
+static uint8_t test_rom[0x3000];
+static uint8_t test_character_rom[0x800];
+
+// Initialize 'sys' and reset it into 'program', which is copied to TEST_PROGRAM_ADDR
+static inline void test_apple2_init(apple2_t* sys, const uint8_t* program, size_t size) {
+    (void)apple2_palette;  // Only used by the frontends
+    test_rom[0x2FFC] = TEST_PROGRAM_ADDR & 0xFF;
+    test_rom[0x2FFD] = TEST_PROGRAM_ADDR >> 8;
+    apple2_init(sys, &(apple2_desc_t){
+                         .roms = {
+                             .rom = {test_rom, sizeof(test_rom)},
+                             .character_rom = {test_character_rom, sizeof(test_character_rom)},
+                             .fdc_rom = {apple2_fdc_rom, sizeof(apple2_fdc_rom)},
+                             .hdc_rom = {prodos_hdc_rom, sizeof(prodos_hdc_rom)},
+                         },
+                     });
+    memcpy(&sys->ram[TEST_PROGRAM_ADDR], program, size);
+    apple2_reset(sys);
+}
+
+// Tick 'sys' until its tick counter reaches 'system_ticks'
+static inline void test_apple2_tick_to(apple2_t* sys, uint32_t system_ticks) {
+    while (sys->system_ticks != system_ticks) {
+        apple2_tick(sys);
+    }
+}
@@ -0,0 +1,80 @@
+#pragma once
+// apple2e_test.h
+//
+// Shared setup of the Apple //e system tests: includes the implementation
+// with the memory configuration of the //e frontends and boots a system
+// straight into a test program in main RAM. The tests don't depend on the
+// content of the Apple //e ROMs, the system gets a zero filled ROM copy whose
+// reset vector points to the program.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#define CHIPS_IMPL
+#define MEM_PAGE_SHIFT (9U)
+#define MEM_FLAT_PAGE_TABLE
+#define MEM_NUM_LAYERS (1U)
+
+#define __in_flash()
+#define __not_in_flash()
+
+#define RGBA8(b, g, r) (0xFF000000 | (r << 16) | (g << 8) | (b))
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "images/apple2_images.h"
+
+#include "chips/chips_common.h"
+#include "chips/mos6502cpu.h"
+#include "chips/beeper.h"
+#include "chips/kbd.h"
+#include "chips/mem.h"
+#include "chips/clk.h"
+#include "devices/disk2_fdd.h"
+#include "devices/disk2_fdc.h"
+#include "devices/apple2_fdc_rom.h"
+#include "devices/prodos_hdd.h"
+#include "devices/prodos_hdc.h"
+#include "devices/prodos_hdc_rom.h"
+#include "systems/apple2e.h"
+
+#define TEST_PROGRAM_ADDR (0x0300)
+
+static uint8_t test_rom[0x4000];
+static uint8_t test_character_rom[0x1000];
+static uint8_t test_keyboard_rom[0x800];
+
+// Initialize 'sys' and reset it into 'program', which is copied to TEST_PROGRAM_ADDR
+static inline void test_apple2e_init(apple2e_t* sys, const uint8_t* program, size_t size) {
+    (void)apple2e_palette;  // Only used by the frontends
+    test_rom[0x3FFC] = TEST_PROGRAM_ADDR & 0xFF;
+    test_rom[0x3FFD] = TEST_PROGRAM_ADDR >> 8;
+    apple2e_init(sys, &(apple2e_desc_t){
+                          .roms = {
+                              .rom = {test_rom, sizeof(test_rom)},
+                              .character_rom = {test_character_rom, sizeof(test_character_rom)},
+                              .keyboard_rom = {test_keyboard_rom, sizeof(test_keyboard_rom)},
+                              .fdc_rom = {apple2_fdc_rom, sizeof(apple2_fdc_rom)},
+                              .hdc_rom = {prodos_hdc_rom, sizeof(prodos_hdc_rom)},
+                          },
+                      });
+    memcpy(&sys->ram[TEST_PROGRAM_ADDR], program, size);
+    apple2e_reset(sys);
+}
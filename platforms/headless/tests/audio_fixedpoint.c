@@ -0,0 +1,219 @@
+// audio_fixedpoint.c
+//
+// Checks the CHIPS_AUDIO_FIXEDPOINT build of the AY-3-8910 and the beeper
+// against the float build. Both builds play the same scripted register writes
+// and beeper edges. The float build writes its samples to a reference file,
+// the fixed-point build reads it back and fails if any 16-bit sample or its
+// 8-bit conversion differs by more than 1 LSB.
+//
+//     audio_float <reference file>
+//     audio_fixedpoint <reference file>
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#define CHIPS_IMPL
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "chips/chips_common.h"
+#include "chips/ay38910psg.h"
+#include "chips/beeper.h"
+
+// Same clocks as the Oric and the Apple II
+#define PSG_SAMPLE_TICKS (46)
+#define PSG_TICKS        (1000000 * 4)
+#define BEEPER_TICK_HZ   (1021800)
+#define BEEPER_TICKS     (BEEPER_TICK_HZ * 4)
+#define BEEPER_FLUSH     (1000)
+
+#define MAX_SAMPLES (200000)
+
+typedef struct {
+    int num;
+    int16_t s16[MAX_SAMPLES];
+    uint8_t u8[MAX_SAMPLES];
+} samples_t;
+
+static samples_t psg_samples, beeper_samples;
+
+// Deterministic pseudo random numbers, identical in both builds
+static uint32_t rnd_state = 1;
+static uint32_t rnd(uint32_t range) {
+    rnd_state = rnd_state * 1103515245U + 12345U;
+    return (rnd_state >> 8) % range;
+}
+
+static void psg_write(ay38910psg_t* psg, uint32_t tick, uint8_t reg, uint8_t data) {
+    ay38910psg_update(psg, tick);
+    ay38910psg_latch_address(psg, reg);
+    ay38910psg_write(psg, data);
+}
+
+static void psg_flush(ay38910psg_t* psg, uint32_t tick) {
+    int16_t out[AY38910PSG_MAX_SAMPLES];
+    const int num = ay38910psg_flush(psg, tick, out, AY38910PSG_MAX_SAMPLES);
+    for (int i = 0; (i < num) && (psg_samples.num < MAX_SAMPLES); i++) {
+        psg_samples.s16[psg_samples.num] = out[i];
+        psg_samples.u8[psg_samples.num] = (uint8_t)((out[i] < 0) ? 0 : (out[i] >> 7));
+        psg_samples.num++;
+    }
+}
+
+// Tones, noise, fixed volumes and all envelope shapes, changed at random ticks
+static void run_psg(void) {
+    ay38910psg_t psg;
+    ay38910psg_init(&psg, &(ay38910psg_desc_t){.type = AY38910PSG_TYPE_8912,
+                                                 .magnitude = 1.0f,
+                                                 .sample_ticks = PSG_SAMPLE_TICKS});
+    uint32_t tick = 0;
+    while (tick < PSG_TICKS) {
+        const uint32_t next = tick + 20 + rnd(3000);
+        for (; tick + 1000 < next; tick += 1000) {
+            psg_flush(&psg, tick + 1000);
+        }
+        tick = next;
+        switch (rnd(6)) {
+            case 0:
+                psg_write(&psg, tick, (uint8_t)(AY38910PSG_REG_PERIOD_A_FINE + rnd(6)), (uint8_t)rnd(256));
+                break;
+            case 1:
+                psg_write(&psg, tick, AY38910PSG_REG_PERIOD_NOISE, (uint8_t)rnd(32));
+                break;
+            case 2:
+                psg_write(&psg, tick, AY38910PSG_REG_ENABLE, (uint8_t)rnd(64));
+                break;
+            case 3:
+                psg_write(&psg, tick, (uint8_t)(AY38910PSG_REG_AMP_A + rnd(3)), (uint8_t)rnd(32));
+                break;
+            case 4:
+                psg_write(&psg, tick, AY38910PSG_REG_ENV_PERIOD_FINE, (uint8_t)rnd(256));
+                psg_write(&psg, tick, AY38910PSG_REG_ENV_PERIOD_COARSE, (uint8_t)rnd(4));
+                break;
+            default:
+                psg_write(&psg, tick, AY38910PSG_REG_ENV_SHAPE_CYCLE, (uint8_t)rnd(16));
+                break;
+        }
+        psg_flush(&psg, tick);
+    }
+    psg_flush(&psg, tick);
+}
+
+static void beeper_flush_samples(beeper_t* beeper, uint32_t tick) {
+    beeper_sample_t out[BEEPER_ACCUM_LEN];
+    const int num = beeper_flush(beeper, tick, out, BEEPER_ACCUM_LEN);
+    for (int i = 0; (i < num) && (beeper_samples.num < MAX_SAMPLES); i++) {
+        beeper_samples.s16[beeper_samples.num] = beeper_sample_s16(out[i]);
+        beeper_samples.u8[beeper_samples.num] = beeper_sample_u8(out[i]);
+        beeper_samples.num++;
+    }
+}
+
+// Square waves from clicks to ultrasonic, at changing volumes
+static void run_beeper(void) {
+    beeper_t beeper;
+    beeper_init(&beeper, &(beeper_desc_t){.tick_hz = BEEPER_TICK_HZ, .sound_hz = 44100, .base_volume = 0.8f});
+    uint32_t tick = 0;
+    uint32_t flush_tick = BEEPER_FLUSH;
+    uint32_t half_period = 500;
+    while (tick < BEEPER_TICKS) {
+        if (rnd(400) == 0) {
+            half_period = 5 + rnd(5000);
+            beeper_set_volume(&beeper, (float)(1 + rnd(100)) / 100.0f);
+        }
+        tick += half_period / 2 + rnd(half_period);
+        for (; flush_tick < tick; flush_tick += BEEPER_FLUSH) {
+            beeper_flush_samples(&beeper, flush_tick);
+        }
+        beeper_toggle(&beeper, tick);
+    }
+    beeper_flush_samples(&beeper, flush_tick);
+}
+
+#ifndef CHIPS_AUDIO_FIXEDPOINT
+static bool write_samples(FILE* file, const samples_t* s) {
+    return (fwrite(&s->num, sizeof(s->num), 1, file) == 1) &&
+           (fwrite(s->s16, sizeof(int16_t), (size_t)s->num, file) == (size_t)s->num) &&
+           (fwrite(s->u8, sizeof(uint8_t), (size_t)s->num, file) == (size_t)s->num);
+}
+#else
+static samples_t ref;
+
+static bool read_samples(FILE* file, samples_t* s) {
+    return (fread(&s->num, sizeof(s->num), 1, file) == 1) && (s->num >= 0) && (s->num <= MAX_SAMPLES) &&
+           (fread(s->s16, sizeof(int16_t), (size_t)s->num, file) == (size_t)s->num) &&
+           (fread(s->u8, sizeof(uint8_t), (size_t)s->num, file) == (size_t)s->num);
+}
+
+// Compare against the float reference, returns false if a sample is off by more than 1 LSB
+static bool compare_samples(FILE* file, const char* name, const samples_t* s) {
+    if (!read_samples(file, &ref)) {
+        fprintf(stderr, "%s: error reading the reference samples\n", name);
+        return false;
+    }
+    if (ref.num != s->num) {
+        fprintf(stderr, "%s: %d samples, reference has %d\n", name, s->num, ref.num);
+        return false;
+    }
+    int max_s16 = 0, max_u8 = 0, num_exact = 0;
+    for (int i = 0; i < s->num; i++) {
+        const int d16 = abs(s->s16[i] - ref.s16[i]);
+        const int d8 = abs(s->u8[i] - ref.u8[i]);
+        if ((d16 > 1) || (d8 > 1)) {
+            fprintf(stderr, "%s: sample %d is %d/%d, reference %d/%d\n", name, i, s->s16[i], s->u8[i], ref.s16[i],
+                    ref.u8[i]);
+            return false;
+        }
+        max_s16 = (d16 > max_s16) ? d16 : max_s16;
+        max_u8 = (d8 > max_u8) ? d8 : max_u8;
+        num_exact += (d16 == 0) ? 1 : 0;
+    }
+    printf("%s: %d samples, max difference %d (16-bit) %d (8-bit), %d exact\n", name, s->num, max_s16, max_u8,
+           num_exact);
+    return true;
+}
+#endif
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <reference file>\n", argv[0]);
+        return 2;
+    }
+    run_psg();
+    run_beeper();
+#ifndef CHIPS_AUDIO_FIXEDPOINT
+    FILE* file = fopen(argv[1], "wb");
+    if (!file || !write_samples(file, &psg_samples) || !write_samples(file, &beeper_samples)) {
+        fprintf(stderr, "error writing %s\n", argv[1]);
+        return 1;
+    }
+    fclose(file);
+    printf("wrote %d PSG and %d beeper samples\n", psg_samples.num, beeper_samples.num);
+    return 0;
+#else
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        fprintf(stderr, "error reading %s\n", argv[1]);
+        return 1;
+    }
+    const bool ok = compare_samples(file, "ay38910psg", &psg_samples) && compare_samples(file, "beeper", &beeper_samples);
+    fclose(file);
+    return ok ? 0 : 1;
+#endif
+}
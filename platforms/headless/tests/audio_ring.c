@@ -0,0 +1,157 @@
+// audio_ring.c
+//
+// Stress test for the rp2040 audio sample ring (platforms/rp2040/src/audio_ring.h)
+// on the host. A producer thread writes a numbered sample stream in blocks of
+// random size, a consumer thread takes chunks like the audio DMA interrupt and
+// checks every sample against the stream: nothing may be lost, duplicated or
+// reordered across the wraparound, and a handed-out chunk must stay intact
+// until the next audio_ring_read_chunk() call.
+//
+// The sample value is a hash of its sequence number, so stale data from an
+// earlier lap of the ring never matches by accident.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "audio_ring.h"
+
+#define NUM_SAMPLES (8 * 1024 * 1024)  // about 4000 laps of the ring
+#define MAX_BLOCK   (3 * AUDIO_RING_CHUNK_SIZE + 5)
+
+static audio_ring_t ring;
+static atomic_bool producer_done;
+static atomic_bool consumer_done;
+
+static uint8_t sample_value(uint32_t seq) {
+    seq ^= seq >> 16;
+    seq *= 0x45D9F3BU;
+    seq ^= seq >> 16;
+    return (uint8_t)seq;
+}
+
+static void* producer(void* arg) {
+    (void)arg;
+    uint32_t rnd = 1;
+    uint32_t seq = 0;
+    uint8_t block[MAX_BLOCK];
+    while (seq < NUM_SAMPLES) {
+        rnd = rnd * 1103515245U + 12345U;
+        int num = 1 + (int)((rnd >> 8) % MAX_BLOCK);
+        if (num > (int)(NUM_SAMPLES - seq)) {
+            num = (int)(NUM_SAMPLES - seq);
+        }
+        for (int i = 0; i < num; i++) {
+            block[i] = sample_value(seq + (uint32_t)i);
+        }
+        // The emulator drops what does not fit, the test retries so that the stream stays complete
+        int written = 0;
+        while ((written < num) && !atomic_load(&consumer_done)) {
+            const int n = audio_ring_write(&ring, block + written, num - written);
+            written += n;
+            if (n == 0) {
+                sched_yield();
+            }
+        }
+        if (written < num) {
+            // The consumer stopped on an error
+            break;
+        }
+        seq += (uint32_t)num;
+    }
+    atomic_store(&producer_done, true);
+    return NULL;
+}
+
+typedef struct {
+    uint32_t received;
+    uint32_t underruns;
+    int errors;
+} consumer_result_t;
+
+static void consume(consumer_result_t* res) {
+    uint8_t copy[AUDIO_RING_CHUNK_SIZE];
+    while (res->received < NUM_SAMPLES) {
+        const bool done = atomic_load(&producer_done);
+        const uint8_t* chunk = audio_ring_read_chunk(&ring);
+        if (chunk == ring.empty_samples) {
+            res->underruns++;
+            if (done && (atomic_load(&ring.head) - atomic_load(&ring.tail)) < AUDIO_RING_CHUNK_SIZE) {
+                // The stream ends with less than a chunk
+                break;
+            }
+            sched_yield();
+            continue;
+        }
+        for (int i = 0; i < AUDIO_RING_CHUNK_SIZE; i++) {
+            if (chunk[i] != sample_value(res->received + (uint32_t)i)) {
+                fprintf(stderr, "sample %u is %02X, expected %02X\n", res->received + (uint32_t)i, chunk[i],
+                        sample_value(res->received + (uint32_t)i));
+                res->errors++;
+                return;
+            }
+        }
+        // Let the producer run while the chunk is "playing", it must not overwrite it
+        memcpy(copy, chunk, sizeof(copy));
+        for (int i = 0; i < 4; i++) {
+            sched_yield();
+        }
+        if (memcmp(copy, chunk, sizeof(copy)) != 0) {
+            fprintf(stderr, "chunk at sample %u overwritten while handed out\n", res->received);
+            res->errors++;
+            return;
+        }
+        res->received += AUDIO_RING_CHUNK_SIZE;
+    }
+}
+
+static void* consumer(void* arg) {
+    consume((consumer_result_t*)arg);
+    atomic_store(&consumer_done, true);
+    return NULL;
+}
+
+int main(void) {
+    audio_ring_init(&ring);
+    atomic_init(&producer_done, false);
+    atomic_init(&consumer_done, false);
+    consumer_result_t res = {0};
+    pthread_t prod, cons;
+    if ((pthread_create(&cons, NULL, consumer, &res) != 0) || (pthread_create(&prod, NULL, producer, NULL) != 0)) {
+        fprintf(stderr, "error creating threads\n");
+        return 1;
+    }
+    pthread_join(prod, NULL);
+    pthread_join(cons, NULL);
+    if (res.errors > 0) {
+        return 1;
+    }
+    // Whole chunks only, the tail of the stream may stay in the ring
+    const uint32_t expected = NUM_SAMPLES - (NUM_SAMPLES % AUDIO_RING_CHUNK_SIZE);
+    if (res.received != expected) {
+        fprintf(stderr, "received %u samples, expected %u\n", res.received, expected);
+        return 1;
+    }
+    printf("audio_ring: %u samples in %u laps, %u underruns\n", res.received, res.received / AUDIO_RING_SIZE,
+           res.underruns);
+    return 0;
+}
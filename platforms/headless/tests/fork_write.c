@@ -0,0 +1,124 @@
+// fork_write.c
+//
+// Copy-on-write forks of an Apple //e (see apple2e_fork()) running a program
+// which keeps writing all over main RAM. A fork must see the same memory and
+// end in the same CPU state as a system which ran the whole way by itself,
+// writes of one fork must not show up in the parent or in another fork, and
+// writing one byte behind the CPU-visible mapping with mem_layer_wr() must
+// only copy the shared piece it lands in.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#define MEM_COPY_ON_WRITE
+
+#include "apple2e_test.h"
+
+// Increments every byte of $2000-$5FFF in turn, forever
+static const uint8_t program[] = {
+    0xE8,              // $0300 INX
+    0xFE, 0x00, 0x20,  // $0301 INC $2000,X
+    0xD0, 0xFA,        // $0304 BNE $0300
+    0xEE, 0x03, 0x03,  // $0306 INC $0303
+    0xAD, 0x03, 0x03,  // $0309 LDA $0303
+    0xC9, 0x60,        // $030C CMP #$60
+    0xD0, 0x05,        // $030E BNE $0315
+    0xA9, 0x20,        // $0310 LDA #$20
+    0x8D, 0x03, 0x03,  // $0312 STA $0303
+    0x4C, 0x00, 0x03,  // $0315 JMP $0300
+};
+
+#define FRAME_US (16667)
+
+static apple2e_t parent;
+static apple2e_t ref;
+static apple2e_t forks[2];
+static uint8_t parent_ram[0x10000];
+static uint8_t parent_aux_ram[0x10000];
+
+// Count the shared pieces of a fork which have not been copied yet
+static int num_pending(const mem_t* mem) {
+    int num = 0;
+    for (int i = 0; i < mem->num_shared; i++) {
+        for (uint32_t piece = 0; piece < (mem->shared[i].size >> MEM_LAYER_PAGE_SHIFT); piece++) {
+            num += (mem->shared[i].pending[piece >> 5] >> (piece & 31)) & 1;
+        }
+    }
+    return num;
+}
+
+// Check that a fork reads the same RAM as the reference system
+static bool same_ram(apple2e_t* fork, const apple2e_t* sys) {
+    for (size_t addr = 0; addr < sizeof(fork->ram); addr++) {
+        if ((*mem_shared_ptr(&fork->mem, &fork->ram[addr]) != sys->ram[addr]) ||
+            (*mem_shared_ptr(&fork->mem, &fork->aux_ram[addr]) != sys->aux_ram[addr])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main() {
+    int num_failed = 0;
+    test_apple2e_init(&parent, program, sizeof(program));
+    test_apple2e_init(&ref, program, sizeof(program));
+    for (int i = 0; i < 2; i++) {
+        apple2e_exec(&parent, FRAME_US);
+        apple2e_exec(&ref, FRAME_US);
+    }
+    memcpy(parent_ram, parent.ram, sizeof(parent_ram));
+    memcpy(parent_aux_ram, parent.aux_ram, sizeof(parent_aux_ram));
+
+    // The second fork runs a different program (DEC instead of INC), the first one runs on like the reference
+    apple2e_fork(&parent, &forks[0]);
+    apple2e_fork(&parent, &forks[1]);
+    mem_wr(&forks[1].mem, 0x0301, 0xDE);
+    for (int i = 0; i < 3; i++) {
+        apple2e_exec(&forks[1], FRAME_US);
+        apple2e_exec(&forks[0], FRAME_US);
+        apple2e_exec(&ref, FRAME_US);
+    }
+    if (!same_ram(&forks[0], &ref) || memcmp(&forks[0].cpu, &ref.cpu, sizeof(ref.cpu))) {
+        printf("fork: differs from the system which ran by itself, pc=%04X expected pc=%04X\n", forks[0].cpu.PC,
+               ref.cpu.PC);
+        num_failed++;
+    }
+    if (mem_rd(&forks[1].mem, 0x0301) != 0xDE) {
+        printf("fork: write to the program of the second fork is lost\n");
+        num_failed++;
+    }
+    if (memcmp(parent.ram, parent_ram, sizeof(parent_ram)) ||
+        memcmp(parent.aux_ram, parent_aux_ram, sizeof(parent_aux_ram))) {
+        printf("fork: writes of the forks changed the parent RAM\n");
+        num_failed++;
+    }
+
+    // A write to a layer only copies the shared piece it lands in
+    apple2e_fork(&parent, &forks[0]);
+    const int pending = num_pending(&forks[0].mem);
+    const uint8_t data = (uint8_t)~parent.ram[0x6000];
+    mem_layer_wr(&forks[0].mem, 0, 0x6000, data);
+    if ((num_pending(&forks[0].mem) != pending - 1) || (mem_rd(&forks[0].mem, 0x6000) != data) ||
+        (parent.ram[0x6000] != parent_ram[0x6000])) {
+        printf("fork: layer write copied %d pieces\n", pending - num_pending(&forks[0].mem));
+        num_failed++;
+    }
+
+    printf("%d of 4 fork checks failed\n", num_failed);
+    return num_failed ? 1 : 0;
+}
@@ -0,0 +1,97 @@
+// hdc_text.c
+//
+// The decoded text page of an Apple ][ (see apple2_text_screen()) after video
+// memory was written without the CPU. A program reads a ProDOS block into the
+// first text page through the hard disk controller, the text screen must show
+// the block and not the text cached before. The same goes for a block written
+// with mem_write_range() followed by apple2_video_mem_dirty().
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include "apple2_test.h"
+
+// Reads block 1 of the hard disk to $0400, then loops
+static const uint8_t program[] = {
+    0xA9, 0x01,        // $0300 LDA #$01      PRODOS_CMD_READ
+    0x85, 0x42,        // $0302 STA $42       PRODOS_DRV_COMMAND
+    0xA9, 0x70,        // $0304 LDA #$70
+    0x85, 0x43,        // $0306 STA $43       PRODOS_DRV_UNIT
+    0xA9, 0x00,        // $0308 LDA #$00
+    0x85, 0x44,        // $030A STA $44       PRODOS_DRV_BUFFER
+    0x85, 0x47,        // $030C STA $47       PRODOS_DRV_BLOCK + 1
+    0xA9, 0x04,        // $030E LDA #$04
+    0x85, 0x45,        // $0310 STA $45       PRODOS_DRV_BUFFER + 1
+    0xA9, 0x01,        // $0312 LDA #$01
+    0x85, 0x46,        // $0314 STA $46       PRODOS_DRV_BLOCK
+    0xA9, 0x65,        // $0316 LDA #$65      PRODOS_HDC_MAGIC
+    0x8D, 0xF7, 0xC0,  // $0318 STA $C0F7     PRODOS_HDC_PARA
+    0x4C, 0x1B, 0x03,  // $031B JMP $031B
+};
+
+static apple2_t sys;
+static uint8_t image[2 * PRODOS_HDD_BYTES_PER_BLOCK];
+static uint8_t block[PRODOS_HDD_BYTES_PER_BLOCK];
+
+// Fill a block with spaces, with 'text' at the start of the first text line
+static void fill_block(uint8_t* data, const char* text) {
+    memset(data, 0xA0, PRODOS_HDD_BYTES_PER_BLOCK);
+    for (size_t i = 0; text[i]; i++) {
+        data[i] = (uint8_t)text[i] | 0x80;
+    }
+}
+
+// Decode the text page and check its first line
+static bool first_line_is(const char* text) {
+    char out[24][81];
+    apple2_text_screen(&sys, out);
+    if (strncmp(out[0], text, strlen(text))) {
+        printf("text: first line is '%.40s', expected '%s'\n", out[0], text);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    int num_failed = 0;
+    test_apple2_init(&sys, program, sizeof(program));
+    // The test system has no hard disk controller, attach one with a two block image
+    prodos_hdc_init(&sys.hdc);
+    fill_block(&image[PRODOS_HDD_BYTES_PER_BLOCK], "HDC BLOCK");
+    prodos_hdd_insert_disk_internal(&sys.hdc.hdd[0], image, sizeof(image));
+    fill_block(&sys.ram[0x0400], "OLD TEXT");
+    sys.text = true;
+
+    // The block read replaces the cached text page
+    num_failed += !first_line_is("OLD TEXT");
+    apple2_exec(&sys, 16667);
+    if (sys.hdc.return_code[PRODOS_HDC_RC_A] != PRODOS_HDD_ERR_OK) {
+        printf("text: block read failed with %02X\n", sys.hdc.return_code[PRODOS_HDC_RC_A]);
+        num_failed++;
+    }
+    num_failed += !first_line_is("HDC BLOCK");
+
+    // So does a bulk write, once it is reported
+    fill_block(block, "BULK WRITE");
+    mem_write_range(&sys.mem, 0x0400, block, sizeof(block));
+    apple2_video_mem_dirty(&sys);
+    num_failed += !first_line_is("BULK WRITE");
+
+    printf("%d of 4 text checks failed\n", num_failed);
+    return num_failed ? 1 : 0;
+}
@@ -0,0 +1,89 @@
+// idle_loops.c
+//
+// Guest loops which count in the zero page, run once through apple2_exec(),
+// which fast-forwards idle loops (see chips_idle_t), and once tick by tick.
+// Each loop leaves on a flag of its counter and then spins on a JMP to
+// itself. Both runs must leave the loop with the same counter value and end
+// with the same CPU state after the same number of ticks.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include "apple2_test.h"
+
+typedef struct {
+    const char* name;
+    uint8_t program[16];
+    uint8_t start;     // Initial counter value
+    uint8_t exit;      // Counter value which leaves the loop
+    uint16_t exit_pc;  // Address of the JMP after the loop
+} idle_loop_t;
+
+static const idle_loop_t loops[] = {
+    // INC $10 / BPL: leaves when the counter reaches $80
+    {"INC/BPL", {0xE6, 0x10, 0x10, 0xFC, 0x4C, 0x04, 0x03}, 0x00, 0x80, 0x0304},
+    // INC $10 / BMI: leaves when the counter wraps to zero
+    {"INC/BMI", {0xE6, 0x10, 0x30, 0xFC, 0x4C, 0x04, 0x03}, 0x80, 0x00, 0x0304},
+    // DEC $10 / BNE: leaves when the counter reaches zero, crossing the sign boundary
+    {"DEC/BNE", {0xC6, 0x10, 0xD0, 0xFC, 0x4C, 0x04, 0x03}, 0x00, 0x00, 0x0304},
+    // DEC $10 / BPL: leaves when the counter wraps to $FF
+    {"DEC/BPL", {0xC6, 0x10, 0x10, 0xFC, 0x4C, 0x04, 0x03}, 0x70, 0xFF, 0x0304},
+    // INC $10 / BNE: leaves when the counter wraps to zero
+    {"INC/BNE", {0xE6, 0x10, 0xD0, 0xFC, 0x4C, 0x04, 0x03}, 0x00, 0x00, 0x0304},
+    // INC $10 / BIT $10 / BVC: leaves when bit 6 of the counter is set
+    {"INC/BIT/BVC", {0xE6, 0x10, 0x24, 0x10, 0x50, 0xFA, 0x4C, 0x06, 0x03}, 0x00, 0x40, 0x0306},
+};
+
+static apple2_t fast;
+static apple2_t slow;
+
+static bool run_loop(const idle_loop_t* loop) {
+    test_apple2_init(&fast, loop->program, sizeof(loop->program));
+    test_apple2_init(&slow, loop->program, sizeof(loop->program));
+    fast.ram[0x10] = slow.ram[0x10] = loop->start;
+
+    // About 4 frames, much longer than each loop runs
+    for (int i = 0; i < 4; i++) {
+        apple2_exec(&fast, 16667);
+    }
+    test_apple2_tick_to(&slow, fast.system_ticks);
+
+    bool ok = true;
+    if (fast.ram[0x10] != slow.ram[0x10] || memcmp(&fast.cpu, &slow.cpu, sizeof(fast.cpu))) {
+        printf("%s: exec counter=%02X pc=%04X, ticks counter=%02X pc=%04X\n", loop->name, fast.ram[0x10],
+               fast.cpu.PC, slow.ram[0x10], slow.cpu.PC);
+        ok = false;
+    }
+    if ((slow.ram[0x10] != loop->exit) || (slow.cpu.PC < loop->exit_pc) || (slow.cpu.PC > loop->exit_pc + 3)) {
+        printf("%s: loop left with counter=%02X pc=%04X, expected counter=%02X pc=%04X\n", loop->name,
+               slow.ram[0x10], slow.cpu.PC, loop->exit, loop->exit_pc);
+        ok = false;
+    }
+    return ok;
+}
+
+int main() {
+    int num_failed = 0;
+    for (size_t i = 0; i < CHIPS_ARRAY_SIZE(loops); i++) {
+        if (!run_loop(&loops[i])) {
+            num_failed++;
+        }
+    }
+    printf("%d of %d idle loops failed\n", num_failed, (int)CHIPS_ARRAY_SIZE(loops));
+    return num_failed ? 1 : 0;
+}
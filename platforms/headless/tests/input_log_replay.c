@@ -0,0 +1,163 @@
+// input_log_replay.c
+//
+// Input logs (see util/input_log.h) of an Apple ][ running a program which
+// keeps storing the keyboard and button state into RAM, so the RAM depends
+// on the exact tick each input was applied at. The inputs are recorded the
+// way the PC frontend records them, with frames of varying length. Replaying
+// the log on a new system must pass all checkpoints and end with the same
+// RAM hash, and a log with one changed key must fail a checkpoint.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include "apple2_test.h"
+#include "util/input_log.h"
+
+// Stores the keyboard and button 0 state into $2000-$21FF, forever
+static const uint8_t program[] = {
+    0xE8,              // $0300 INX
+    0xAD, 0x00, 0xC0,  // $0301 LDA $C000
+    0x9D, 0x00, 0x20,  // $0304 STA $2000,X
+    0xAD, 0x61, 0xC0,  // $0307 LDA $C061
+    0x9D, 0x00, 0x21,  // $030A STA $2100,X
+    0x4C, 0x00, 0x03,  // $030D JMP $0300
+};
+
+#define NUM_FRAMES        (300)
+#define CHECK_FRAMES      (10)
+#define FIRST_KEY_FRAME   (7)
+
+typedef struct {
+    uint8_t data[64 * 1024];
+    size_t size;
+} log_file_t;
+
+static apple2_t recorded;
+static apple2_t replayed;
+static log_file_t file;
+
+static bool write_log(const void* data, size_t size, void* user_data) {
+    log_file_t* f = (log_file_t*)user_data;
+    if (f->size + size > sizeof(f->data)) {
+        return false;
+    }
+    memcpy(&f->data[f->size], data, size);
+    f->size += size;
+    return true;
+}
+
+static void apply_input(const input_log_event_t* ev, void* user_data) {
+    apple2_t* sys = (apple2_t*)user_data;
+    switch (ev->type) {
+        case INPUT_LOG_KEY_DOWN:
+            sys->kbd_last_key = (uint8_t)ev->code | 0x80;
+            break;
+        case INPUT_LOG_BUTTON:
+            sys->butn0 = ev->value != 0;
+            break;
+    }
+}
+
+static uint32_t replay_exec(uint32_t micro_seconds, void* user_data) {
+    return apple2_exec((apple2_t*)user_data, micro_seconds);
+}
+
+static uint32_t ram_hash(void* user_data) {
+    apple2_t* sys = (apple2_t*)user_data;
+    uint32_t hash = input_log_hash(INPUT_LOG_HASH_INIT, sys->ram, sizeof(sys->ram));
+    return input_log_hash(hash, sys->lc.ram, sizeof(sys->lc.ram));
+}
+
+// Record an input and apply it to the recorded system
+static void record_input(input_log_t* log, uint8_t type, uint16_t code, uint32_t value) {
+    input_log_input(log, type, code, value);
+    const input_log_event_t ev = {.type = type, .code = code, .value = value};
+    apply_input(&ev, &recorded);
+}
+
+static void record(void) {
+    static input_log_t log;
+    test_apple2_init(&recorded, program, sizeof(program));
+    file.size = 0;
+    input_log_init(&log, APPLE2_STATE_ID, write_log, &file);
+    input_log_check(&log, ram_hash(&recorded));
+    srand(5);
+    for (uint32_t frame = 0; frame < NUM_FRAMES; frame++) {
+        if ((frame >= FIRST_KEY_FRAME) && ((rand() % 4) == 0)) {
+            record_input(&log, INPUT_LOG_KEY_DOWN, (uint16_t)('A' + (rand() % 26)), 0);
+        }
+        if ((rand() % 8) == 0) {
+            record_input(&log, INPUT_LOG_BUTTON, 0, rand() & 1);
+        }
+        const uint32_t micro_seconds = 16000 + (uint32_t)(rand() % 1500);
+        input_log_frame(&log, micro_seconds, apple2_exec(&recorded, micro_seconds));
+        if (((frame + 1) % CHECK_FRAMES) == 0) {
+            input_log_check(&log, ram_hash(&recorded));
+        }
+    }
+}
+
+// Replay the log on a new system, returns false if it diverged
+static bool replay(input_log_player_t* player) {
+    test_apple2_init(&replayed, program, sizeof(program));
+    if (!input_log_player_init(player, file.data, file.size, APPLE2_STATE_ID)) {
+        return false;
+    }
+    const input_log_replay_t desc = {
+        .exec = replay_exec,
+        .input = apply_input,
+        .hash = ram_hash,
+        .user_data = &replayed,
+    };
+    while (input_log_replay_frame(player, &desc)) {
+    }
+    return !player->truncated && (player->num_tick_errors == 0) && (player->num_check_errors == 0);
+}
+
+int main() {
+    int num_failed = 0;
+    record();
+
+    input_log_player_t player;
+    if (!replay(&player) || (player.num_frames != NUM_FRAMES) ||
+        (player.num_checks != 1 + NUM_FRAMES / CHECK_FRAMES) || (ram_hash(&replayed) != ram_hash(&recorded)) ||
+        (replayed.system_ticks != recorded.system_ticks)) {
+        printf("replay: frames=%u checks=%u tick errors=%u check errors=%u hash=%08X expected %08X\n",
+               player.num_frames, player.num_checks, player.num_tick_errors, player.num_check_errors,
+               ram_hash(&replayed), ram_hash(&recorded));
+        num_failed++;
+    }
+
+    // Change the first key in the log, a later checkpoint must catch it
+    bool changed = false;
+    input_log_player_init(&player, file.data, file.size, APPLE2_STATE_ID);
+    while (!changed && (input_log_player_next(&player) == INPUT_LOG_PLAYER_EVENT)) {
+        if (player.event.type == INPUT_LOG_KEY_DOWN) {
+            // The code follows the ticks and the type of the record just read
+            file.data[player.pos - INPUT_LOG_RECORD_SIZE + 5] ^= 0x01;
+            changed = true;
+        }
+    }
+    if (!changed || replay(&player) || (player.num_check_errors == 0)) {
+        printf("replay: changed key not detected\n");
+        num_failed++;
+    }
+
+    printf("%d of 2 replays failed, log %zu bytes\n", num_failed, file.size);
+    return num_failed ? 1 : 0;
+}
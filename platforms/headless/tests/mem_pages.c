@@ -0,0 +1,213 @@
+// mem_pages.c
+//
+// The two-level page table of mem.h (layer pages of MEM_LAYER_PAGE_SIZE
+// bytes, split into MEM_PAGE_SIZE pages only where needed) against a plain
+// model which keeps one read and write offset per layer and MEM_PAGE_SIZE
+// page. Random whole and partial layer page mappings, copied page items,
+// enabled and disabled layers, unmapped layers and copy-on-write sharing are
+// mixed with random reads and writes. Every read must return what the model
+// expects and the host memory must end up with the model's content. Built
+// with and without MEM_FLAT_PAGE_TABLE.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#define CHIPS_IMPL
+#define MEM_PAGE_SHIFT (9U)
+#define MEM_MAX_SPLIT  (16)  // All layers may split the first SPLIT_LAYER_PAGES layer pages
+#define MEM_COPY_ON_WRITE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chips/mem.h"
+
+#define HOST_SIZE         (0x20000)
+#define SPLIT_LAYER_PAGES (4)  // Partial mappings stay in the first layer pages
+#define NUM_STEPS         (200000)
+#define UNMAPPED          (-1)
+#define JUNK              (-2)
+
+// Signed page counts of mem.h
+#define NUM_LAYERS      ((int)MEM_NUM_LAYERS)
+#define NUM_PAGES       ((int)MEM_NUM_PAGES)
+#define NUM_LAYER_PAGES ((int)MEM_NUM_LAYER_PAGES)
+#define NUM_SPLIT_PAGES ((int)MEM_NUM_SPLIT_PAGES)
+
+static uint8_t host[HOST_SIZE];
+static uint8_t shared_src[HOST_SIZE];
+static uint8_t expected[HOST_SIZE];
+static mem_t mem;
+static mem_page_t copied_pages[NUM_PAGES];
+
+// The model: host offsets each layer maps at each page (UNMAPPED, or JUNK for writes to ROM)
+static long model_read[NUM_LAYERS][NUM_PAGES];
+static long model_write[NUM_LAYERS][NUM_PAGES];
+static uint32_t model_layer_mask = (1U << NUM_LAYERS) - 1;
+static bool model_shared;
+
+static int rnd(int n) { return rand() % n; }
+
+// Host offset the CPU reads or writes a page at
+static long model_visible(int page, bool write) {
+    for (int layer = 0; layer < NUM_LAYERS; layer++) {
+        if ((model_layer_mask & (1U << layer)) && (model_read[layer][page] != UNMAPPED)) {
+            return write ? model_write[layer][page] : model_read[layer][page];
+        }
+    }
+    return UNMAPPED;
+}
+
+// Map RAM, ROM or separate read and write memory, either whole layer pages or a few pages
+static void map_random(void) {
+    const int layer = rnd(NUM_LAYERS);
+    const bool whole = rnd(2);
+    int first;
+    int num;
+    if (whole) {
+        first = rnd(NUM_LAYER_PAGES) * NUM_SPLIT_PAGES;
+        num = (1 + rnd(4)) * NUM_SPLIT_PAGES;
+    } else {
+        first = rnd(SPLIT_LAYER_PAGES * NUM_SPLIT_PAGES - 6);
+        num = 1 + rnd(6);
+    }
+    if (first + num > NUM_PAGES) {
+        num = NUM_PAGES - first;
+    }
+    // Host memory keeps the offset of the address in its layer page
+    const long in_page = whole ? 0 : (first % NUM_SPLIT_PAGES) * MEM_PAGE_SIZE;
+    const long read_offset = (long)rnd(HOST_SIZE / MEM_LAYER_PAGE_SIZE - 8) * MEM_LAYER_PAGE_SIZE + in_page;
+    const long write_offset = (long)rnd(HOST_SIZE / MEM_LAYER_PAGE_SIZE - 8) * MEM_LAYER_PAGE_SIZE + in_page;
+    const int kind = rnd(3);
+    const uint16_t addr = (uint16_t)(first * MEM_PAGE_SIZE);
+    const uint32_t size = (uint32_t)num * MEM_PAGE_SIZE;
+    if (kind == 0) {
+        mem_map_ram(&mem, layer, addr, size, host + read_offset);
+    } else if (kind == 1) {
+        mem_map_rom(&mem, layer, addr, size, host + read_offset);
+    } else {
+        mem_map_rw(&mem, layer, addr, size, host + read_offset, host + write_offset);
+    }
+    for (int i = 0; i < num; i++) {
+        model_read[layer][first + i] = read_offset + i * MEM_PAGE_SIZE;
+        if (kind == 1) {
+            model_write[layer][first + i] = JUNK;
+        } else {
+            model_write[layer][first + i] = ((kind == 0) ? read_offset : write_offset) + i * MEM_PAGE_SIZE;
+        }
+    }
+}
+
+// Copy the page items of a mapped range and map them on another layer
+static void copy_random(void) {
+    const int from = rnd(NUM_LAYERS);
+    const int to = rnd(NUM_LAYERS);
+    int first = rnd(NUM_PAGES);
+    int num = 1 + rnd(20);
+    if (rnd(2)) {
+        first = rnd(NUM_LAYER_PAGES - 2) * NUM_SPLIT_PAGES;
+        num = 2 * NUM_SPLIT_PAGES;
+    }
+    if (first + num > NUM_PAGES) {
+        num = NUM_PAGES - first;
+    }
+    if ((from == to) || (first + num > SPLIT_LAYER_PAGES * NUM_SPLIT_PAGES)) {
+        return;
+    }
+    for (int i = 0; i < num; i++) {
+        if (model_read[from][first + i] == UNMAPPED) {
+            return;
+        }
+    }
+    const uint16_t addr = (uint16_t)(first * MEM_PAGE_SIZE);
+    mem_copy_pages(&mem, from, addr, (uint32_t)num * MEM_PAGE_SIZE, copied_pages);
+    mem_map_pages(&mem, to, addr, (uint32_t)num * MEM_PAGE_SIZE, copied_pages);
+    for (int i = 0; i < num; i++) {
+        model_read[to][first + i] = model_read[from][first + i];
+        model_write[to][first + i] = model_write[from][first + i];
+    }
+}
+
+int main() {
+    srand(1);
+    for (int i = 0; i < HOST_SIZE; i++) {
+        host[i] = expected[i] = (uint8_t)rand();
+        shared_src[i] = (uint8_t)rand();
+    }
+    mem_init(&mem);
+    for (int layer = 0; layer < NUM_LAYERS; layer++) {
+        for (int page = 0; page < NUM_PAGES; page++) {
+            model_read[layer][page] = model_write[layer][page] = UNMAPPED;
+        }
+    }
+
+    long num_errors = 0;
+    for (int step = 0; step < NUM_STEPS; step++) {
+        const int op = rnd(100);
+        if (op < 12) {
+            map_random();
+        } else if (op < 15) {
+            copy_random();
+        } else if (op < 18) {
+            const int layer = rnd(NUM_LAYERS);
+            const bool enabled = rnd(2);
+            mem_enable_layer(&mem, layer, enabled);
+            model_layer_mask = enabled ? (model_layer_mask | (1U << layer)) : (model_layer_mask & ~(1U << layer));
+        } else if (op < 19) {
+            const int layer = rnd(NUM_LAYERS);
+            mem_unmap_layer(&mem, layer);
+            for (int page = 0; page < NUM_PAGES; page++) {
+                model_read[layer][page] = model_write[layer][page] = UNMAPPED;
+            }
+        } else if (op < 20) {
+            // Share the second half of the host memory, it reads as the source until written
+            if (!model_shared) {
+                mem_share(&mem, host + HOST_SIZE / 2, shared_src + HOST_SIZE / 2, HOST_SIZE / 2);
+                memcpy(expected + HOST_SIZE / 2, shared_src + HOST_SIZE / 2, HOST_SIZE / 2);
+            } else {
+                mem_unshare(&mem);
+            }
+            model_shared = !model_shared;
+        } else if (op < 60) {
+            const uint16_t addr = (uint16_t)rand();
+            const long offset = model_visible(addr >> MEM_PAGE_SHIFT, false);
+            const uint8_t value = (offset == UNMAPPED) ? 0xFF : expected[offset + (addr & MEM_PAGE_MASK)];
+            const uint8_t data = mem_rd(&mem, addr);
+            if ((data != value) && (num_errors++ < 5)) {
+                printf("step %d: read %02X at %04X, expected %02X\n", step, data, addr, value);
+            }
+        } else {
+            const uint16_t addr = (uint16_t)rand();
+            const uint8_t data = (uint8_t)rand();
+            const long offset = model_visible(addr >> MEM_PAGE_SHIFT, true);
+            mem_wr(&mem, addr, data);
+            if (offset >= 0) {
+                expected[offset + (addr & MEM_PAGE_MASK)] = data;
+            }
+        }
+    }
+    mem_unshare(&mem);
+    for (int i = 0; i < HOST_SIZE; i++) {
+        if ((host[i] != expected[i]) && (num_errors++ < 10)) {
+            printf("host memory at %05X is %02X, expected %02X\n", i, host[i], expected[i]);
+        }
+    }
+    printf("%ld errors in %d page table steps\n", num_errors, NUM_STEPS);
+    return num_errors ? 1 : 0;
+}
@@ -0,0 +1,137 @@
+// rewind_step.c
+//
+// Rewind history (see util/rewind.h) of an Apple ][ running a program which
+// keeps writing all over its RAM, with the written pages reported by mem.h.
+// Every pushed snapshot is also kept as a full copy. Stepping back must
+// return exactly the copy taken at that frame, and the system loaded from it
+// must have the same RAM and CPU state, also after running on from a rewound
+// state.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#define MEM_TRACK_WRITES
+
+#include "apple2_test.h"
+#include "util/rewind.h"
+
+// Increments every byte of $2000-$5FFF in turn, forever
+static const uint8_t program[] = {
+    0xE8,              // $0300 INX
+    0xFE, 0x00, 0x20,  // $0301 INC $2000,X
+    0xD0, 0xFA,        // $0304 BNE $0300
+    0xEE, 0x03, 0x03,  // $0306 INC $0303
+    0xAD, 0x03, 0x03,  // $0309 LDA $0303
+    0xC9, 0x60,        // $030C CMP #$60
+    0xD0, 0x05,        // $030E BNE $0315
+    0xA9, 0x20,        // $0310 LDA #$20
+    0x8D, 0x03, 0x03,  // $0312 STA $0303
+    0x4C, 0x00, 0x03,  // $0315 JMP $0300
+};
+
+#define NUM_REFS        (64)
+#define SNAPSHOT_FRAMES (2)
+
+static apple2_t sys;
+static apple2_t snapshot;
+static apple2_t refs[NUM_REFS];
+static uint32_t ref_frames[NUM_REFS];
+static int num_refs;
+static rewind_t rw;
+static uint8_t rw_buffer[4 * 1024 * 1024];
+
+// Run one frame, the host also writes a few bytes through the memory map
+static void run_frame(uint32_t frame) {
+    apple2_exec(&sys, 16667);
+    for (uint32_t i = 0; i < 4; i++) {
+        mem_wr(&sys.mem, 0x0800 + ((frame * 97 + i * 1031) % 0x1800), (uint8_t)(frame + i));
+    }
+    rewind_mark_mem_written(&rw, &sys.mem, &sys);
+    if (rewind_frame(&rw)) {
+        apple2_save_snapshot(&sys, &snapshot);
+        rewind_push(&rw, &snapshot);
+        memcpy(&refs[num_refs % NUM_REFS], &snapshot, sizeof(snapshot));
+        ref_frames[num_refs % NUM_REFS] = rw.frame;
+        num_refs++;
+    }
+}
+
+// Step back 'num_frames' frames and check the image and the restored system against the copy of that frame
+static bool step_back(uint32_t num_frames) {
+    const apple2_t* im = rewind_step_back(&rw, num_frames);
+    if (!im) {
+        printf("step back %u: history is empty\n", num_frames);
+        return false;
+    }
+    const apple2_t* ref = 0;
+    for (int i = num_refs - 1; (i >= 0) && (i >= num_refs - NUM_REFS); i--) {
+        if (ref_frames[i % NUM_REFS] == rw.frame) {
+            ref = &refs[i % NUM_REFS];
+            break;
+        }
+    }
+    if (!ref) {
+        printf("step back %u: no snapshot copy of frame %u\n", num_frames, rw.frame);
+        return false;
+    }
+    if (memcmp(im, ref, sizeof(apple2_t))) {
+        printf("step back %u: image of frame %u differs from its copy\n", num_frames, rw.frame);
+        return false;
+    }
+    apple2_load_snapshot(&sys, APPLE2_SNAPSHOT_VERSION, (apple2_t*)im);
+    mem_clear_written(&sys.mem);
+    if (memcmp(sys.ram, ref->ram, sizeof(sys.ram)) || memcmp(sys.lc.ram, ref->lc.ram, sizeof(sys.lc.ram)) ||
+        memcmp(&sys.cpu, &ref->cpu, sizeof(sys.cpu))) {
+        printf("step back %u: system loaded from frame %u differs from its copy\n", num_frames, rw.frame);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    test_apple2_init(&sys, program, sizeof(program));
+    rewind_init(&rw, &(rewind_desc_t){
+                         .image_size = sizeof(apple2_t),
+                         .snapshot_frames = SNAPSHOT_FRAMES,
+                         .buffer = {rw_buffer, sizeof(rw_buffer)},
+                     });
+    rewind_track(&rw, offsetof(apple2_t, ram), sizeof(sys.ram));
+    rewind_track(&rw, offsetof(apple2_t, lc.ram), sizeof(sys.lc.ram));
+
+    int num_failed = 0;
+    uint32_t frame = 0;
+    for (; frame < 100; frame++) {
+        run_frame(frame);
+    }
+    const uint32_t steps[] = {1, 5, 12, 30};
+    for (size_t i = 0; i < CHIPS_ARRAY_SIZE(steps); i++) {
+        if (!step_back(steps[i])) {
+            num_failed++;
+        }
+    }
+    // Run on from the rewound state, then go back into the new history
+    for (; frame < 140; frame++) {
+        run_frame(frame);
+    }
+    if (!step_back(9)) {
+        num_failed++;
+    }
+    printf("%d of %d rewind steps failed, %d snapshots in %zu bytes of history\n", num_failed,
+           (int)CHIPS_ARRAY_SIZE(steps) + 1, rw.num_entries, rewind_history_size(&rw));
+    return num_failed ? 1 : 0;
+}
@@ -0,0 +1,96 @@
+// run_until.c
+//
+// apple2_run_until() through guest loops which are fast-forwarded as idle
+// loops (see chips_idle_t), against plain ticking. A memory condition on the
+// loop counter must stop partway through the loop, on the first instruction
+// boundary where it is met, and a PC condition after the loop must stop when
+// the loop is left. Both runs must stop after the same number of ticks with
+// the same CPU state.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include "apple2_test.h"
+
+typedef struct {
+    const char* name;
+    uint8_t program[16];
+    uint8_t start;  // Initial counter value at $10
+    chips_until_t cond;
+} until_case_t;
+
+// INC $10 / BNE, DEC $10 / BNE and INC $10 / BPL, each followed by a JMP to itself at $0304
+#define INC_BNE {0xE6, 0x10, 0xD0, 0xFC, 0x4C, 0x04, 0x03}
+#define DEC_BNE {0xC6, 0x10, 0xD0, 0xFC, 0x4C, 0x04, 0x03}
+#define INC_BPL {0xE6, 0x10, 0x10, 0xFC, 0x4C, 0x04, 0x03}
+
+static const until_case_t cases[] = {
+    {"INC/BNE until $10=$A0", INC_BNE, 0x00, {.type = CHIPS_UNTIL_MEM, .addr = 0x10, .value = 0xA0, .mask = 0xFF}},
+    {"INC/BNE until $10=$x5", INC_BNE, 0x30, {.type = CHIPS_UNTIL_MEM, .addr = 0x10, .value = 0x05, .mask = 0x0F}},
+    {"DEC/BNE until $10=$21", DEC_BNE, 0x00, {.type = CHIPS_UNTIL_MEM, .addr = 0x10, .value = 0x21, .mask = 0xFF}},
+    {"INC/BPL until $10 bit 6", INC_BPL, 0x00, {.type = CHIPS_UNTIL_MEM, .addr = 0x10, .value = 0x40, .mask = 0x40}},
+    {"INC/BNE until PC=$0304", INC_BNE, 0x00, {.type = CHIPS_UNTIL_PC, .addr = 0x0304}},
+    {"INC/BPL until PC=$0304", INC_BPL, 0x00, {.type = CHIPS_UNTIL_PC, .addr = 0x0304}},
+};
+
+static apple2_t fast;
+static apple2_t slow;
+
+// The run-until conditions, tested after each tick as apple2_run_until() does
+static bool cond_met(apple2_t* sys, const chips_until_t* cond) {
+    if (!MOS6502CPU_GET_SYNC(&sys->cpu)) {
+        return false;
+    }
+    if (cond->type == CHIPS_UNTIL_PC) {
+        return sys->cpu.addr == cond->addr;
+    }
+    return (sys->ram[cond->addr] & cond->mask) == cond->value;
+}
+
+static bool run_case(const until_case_t* c) {
+    test_apple2_init(&fast, c->program, sizeof(c->program));
+    test_apple2_init(&slow, c->program, sizeof(c->program));
+    fast.ram[0x10] = slow.ram[0x10] = c->start;
+
+    const bool fast_met = apple2_run_until(&fast, &c->cond, 100000);
+    bool slow_met = false;
+    while (!slow_met && (slow.system_ticks < 100000)) {
+        apple2_tick(&slow);
+        slow_met = cond_met(&slow, &c->cond);
+    }
+
+    if (!fast_met || !slow_met || (fast.system_ticks != slow.system_ticks) || (fast.ram[0x10] != slow.ram[0x10]) ||
+        memcmp(&fast.cpu, &slow.cpu, sizeof(fast.cpu))) {
+        printf("%s: run_until met=%d ticks=%u counter=%02X pc=%04X, ticks met=%d ticks=%u counter=%02X pc=%04X\n",
+               c->name, fast_met, fast.system_ticks, fast.ram[0x10], fast.cpu.PC, slow_met, slow.system_ticks,
+               slow.ram[0x10], slow.cpu.PC);
+        return false;
+    }
+    return true;
+}
+
+int main() {
+    int num_failed = 0;
+    for (size_t i = 0; i < CHIPS_ARRAY_SIZE(cases); i++) {
+        if (!run_case(&cases[i])) {
+            num_failed++;
+        }
+    }
+    printf("%d of %d run-until cases failed\n", num_failed, (int)CHIPS_ARRAY_SIZE(cases));
+    return num_failed ? 1 : 0;
+}
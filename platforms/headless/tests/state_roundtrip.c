@@ -0,0 +1,124 @@
+// state_roundtrip.c
+//
+// Portable state files (see chips_state_writer_t) of an Apple ][ running a
+// program which keeps writing all over RAM, with random data in main and
+// language card RAM. A second system which loads the state must run on in
+// lockstep with the first one, writing the state again must give the same
+// file, and a truncated file must be rejected without changing the system.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include "apple2_test.h"
+
+// Increments every byte of $2000-$5FFF in turn, forever
+static const uint8_t program[] = {
+    0xE8,              // $0300 INX
+    0xFE, 0x00, 0x20,  // $0301 INC $2000,X
+    0xD0, 0xFA,        // $0304 BNE $0300
+    0xEE, 0x03, 0x03,  // $0306 INC $0303
+    0xAD, 0x03, 0x03,  // $0309 LDA $0303
+    0xC9, 0x60,        // $030C CMP #$60
+    0xD0, 0x05,        // $030E BNE $0315
+    0xA9, 0x20,        // $0310 LDA #$20
+    0x8D, 0x03, 0x03,  // $0312 STA $0303
+    0x4C, 0x00, 0x03,  // $0315 JMP $0300
+};
+
+typedef struct {
+    uint8_t data[256 * 1024];
+    size_t size;
+} state_file_t;
+
+static apple2_t saved;
+static apple2_t loaded;
+static state_file_t file;
+static state_file_t file2;
+
+static bool write_file(const void* data, size_t size, void* user_data) {
+    state_file_t* f = (state_file_t*)user_data;
+    if (f->size + size > sizeof(f->data)) {
+        return false;
+    }
+    memcpy(&f->data[f->size], data, size);
+    f->size += size;
+    return true;
+}
+
+static bool save(apple2_t* sys, state_file_t* f) {
+    // The chunk buffer is owned by the caller
+    uint8_t chunk[CHIPS_STATE_MAX_CHUNK_SIZE];
+    f->size = 0;
+    return apple2_save_state(sys, (chips_range_t){chunk, sizeof(chunk)}, write_file, f);
+}
+
+static bool same_state(const apple2_t* a, const apple2_t* b) {
+    return !memcmp(a->ram, b->ram, sizeof(a->ram)) && !memcmp(a->lc.ram, b->lc.ram, sizeof(a->lc.ram)) &&
+           !memcmp(&a->cpu, &b->cpu, sizeof(a->cpu)) && (a->system_ticks == b->system_ticks);
+}
+
+int main() {
+    int num_failed = 0;
+    test_apple2_init(&saved, program, sizeof(program));
+    srand(1);
+    for (size_t i = 0x0800; i < 0x2000; i += 3) {
+        saved.ram[i] = (uint8_t)rand();
+    }
+    for (size_t i = 0; i < sizeof(saved.lc.ram); i += 7) {
+        saved.lc.ram[i] = (uint8_t)rand();
+    }
+    for (int i = 0; i < 10; i++) {
+        apple2_exec(&saved, 16667);
+    }
+    if (!save(&saved, &file)) {
+        printf("state: save failed\n");
+        return 1;
+    }
+
+    test_apple2_init(&loaded, program, sizeof(program));
+    apple2_exec(&loaded, 16667);
+    if (!apple2_load_state(&loaded, file.data, file.size)) {
+        printf("state: load failed\n");
+        return 1;
+    }
+    if (!same_state(&saved, &loaded)) {
+        printf("state: loaded system differs from the saved one\n");
+        num_failed++;
+    }
+    if (!save(&loaded, &file2) || (file.size != file2.size) || memcmp(file.data, file2.data, file.size)) {
+        printf("state: saving the loaded system gives a different file\n");
+        num_failed++;
+    }
+    for (int i = 0; i < 30; i++) {
+        apple2_exec(&saved, 16667);
+        apple2_exec(&loaded, 16667);
+    }
+    if (!same_state(&saved, &loaded)) {
+        printf("state: loaded system runs differently, pc=%04X expected pc=%04X\n", loaded.cpu.PC, saved.cpu.PC);
+        num_failed++;
+    }
+
+    const uint16_t pc = loaded.cpu.PC;
+    if (apple2_load_state(&loaded, file.data, file.size - 3) || (loaded.cpu.PC != pc)) {
+        printf("state: truncated file was loaded\n");
+        num_failed++;
+    }
+
+    printf("%d of 4 state checks failed, state file %zu bytes\n", num_failed, file.size);
+    return num_failed ? 1 : 0;
+}
@@ -25,6 +25,7 @@ typedef struct {
         sg_sampler smp;
         chips_dim_t dim;
         bool paletted;
+        bool needs_upload;  // texture content is undefined (new texture)
     } fb;
     struct {
         chips_rect_t view;
@@ -224,6 +225,7 @@ static void gfx_init_images_and_pass(void) {
         .pixel_format = state.fb.paletted ? SG_PIXELFORMAT_R8 : SG_PIXELFORMAT_RGBA8,
         .usage = SG_USAGE_STREAM,
     });
+    state.fb.needs_upload = true;
 
     // a sampler for sampling the emulators raw pixel data
     state.fb.smp = sg_make_sampler(&(sg_sampler_desc){
@@ -451,13 +453,17 @@ void gfx_draw(chips_display_info_t display_info) {
         sgl_end();
     }
 
-    // copy emulator pixel data into emulator framebuffer texture
-    sg_update_image(state.fb.img, &(sg_image_data){
-        .subimage[0][0] = {
-            .ptr = display_info.frame.buffer.ptr,
-            .size = display_info.frame.buffer.size,
-        }
-    });
+    // copy emulator pixel data into emulator framebuffer texture (the texture keeps its
+    // content when the upload is skipped)
+    if (!display_info.frame.unchanged || state.fb.needs_upload) {
+        sg_update_image(state.fb.img, &(sg_image_data){
+            .subimage[0][0] = {
+                .ptr = display_info.frame.buffer.ptr,
+                .size = display_info.frame.buffer.size,
+            }
+        });
+        state.fb.needs_upload = false;
+    }
 
     // upscale the original framebuffer 2x with nearest filtering
     sg_begin_pass(&(sg_pass){
@@ -19,12 +19,16 @@
 //     distribution.
 
 #define CHIPS_IMPL
+#define APPLE2_NTSC
+#define MEM_TRACK_WRITES
 
 #define __in_flash()
 #define __not_in_flash()
 
 #define RGBA8(b, g, r) (0xFF000000 | (r << 16) | (g << 8) | (b))
 
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "roms/apple2_roms.h"
@@ -44,7 +48,12 @@
 #include "devices/prodos_hdd.h"
 #include "devices/prodos_hdc.h"
 #include "devices/prodos_hdc_rom.h"
+#include "devices/apple2_ntsc.h"
 #include "systems/apple2.h"
+#include "util/fbstream.h"
+#include "util/recorder.h"
+#include "util/rewind.h"
+#include "util/input_log.h"
 
 typedef struct {
     uint32_t version;
@@ -56,6 +65,19 @@ typedef struct {
     uint32_t frame_time_us;
     uint32_t ticks;
     double emu_time_ms;
+    bool ntsc;  // NTSC composite rendering (ntsc command line option)
+    FILE *record_file;
+    recorder_t recorder;
+    rewind_t *rewind;  // Rewind history (rewind command line option), F10 held rewinds
+    apple2_t *rewind_snapshot;
+    uint8_t *rewind_buffer;
+    bool rewinding;
+    FILE *input_log_file;  // Input log (inputlog command line option), replayed by the headless streamer
+    input_log_t input_log;
+    uint32_t input_log_frames;
+#ifdef MOS6502CPU_PROFILE
+    mos6502cpu_profile_t *profile;
+#endif
 } state_t;
 
 static state_t state;
@@ -66,27 +88,151 @@ static state_t state;
 #define BORDER_BOTTOM (16)
 
 // Audio streaming callback
-static void audio_callback(const uint8_t sample, void *user_data) {
+static float audio_buffer[1024];
+
+static void audio_callback(const void *samples, int num_samples, void *user_data) {
     (void)user_data;
+    saudio_push((const float *)samples, num_samples);
+    if (state.record_file) {
+        recorder_audio(&state.recorder, samples, num_samples, CHIPS_AUDIO_FORMAT_FLOAT);
+    }
+}
+
+// Session recording output
+static void record_write(const void *data, size_t size, void *user_data) {
+    fwrite(data, size, 1, (FILE *)user_data);
+}
+
+// Start recording the session if requested with record=<file>
+static void record_init(void) {
+    if (!sargs_exists("record")) {
+        return;
+    }
+    state.record_file = fopen(sargs_value("record"), "wb");
+    if (state.record_file == 0) {
+        return;
+    }
+    recorder_init(&state.recorder, &(recorder_desc_t){
+        .width = APPLE2_SCREEN_WIDTH,
+        .height = APPLE2_SCREEN_HEIGHT,
+        .palette = apple2_palette,
+        .sample_rate = 44100,
+        .write = {.func = record_write, .user_data = state.record_file},
+    });
+}
+
+#define INPUT_LOG_CHECK_FRAMES (60)
+
+// Input log output
+static bool input_log_write(const void *data, size_t size, void *user_data) {
+    return fwrite(data, size, 1, (FILE *)user_data) == 1;
+}
+
+// Hash of the RAM for the input log checkpoints
+static uint32_t ram_hash(apple2_t *sys) {
+    uint32_t hash = input_log_hash(INPUT_LOG_HASH_INIT, sys->ram, sizeof(sys->ram));
+    return input_log_hash(hash, sys->lc.ram, sizeof(sys->lc.ram));
+}
+
+// Start logging the inputs if requested with inputlog=<file>
+static void input_recording_init(void) {
+    if (!sargs_exists("inputlog")) {
+        return;
+    }
+    state.input_log_file = fopen(sargs_value("inputlog"), "wb");
+    if (state.input_log_file == 0) {
+        return;
+    }
+    input_log_init(&state.input_log, APPLE2_STATE_ID, input_log_write, state.input_log_file);
+    input_log_check(&state.input_log, ram_hash(&state.apple2));
+}
 
-    static float samples[1024];
-    static int sample_index = 0;
-    samples[sample_index++] = (float)sample / 255.0f;
-    if (sample_index == 1024) {
-        saudio_push(samples, 1024);
-        sample_index = 0;
+// Log the last exec() call, and a checkpoint every INPUT_LOG_CHECK_FRAMES frames
+static void input_recording_frame(void) {
+    input_log_frame(&state.input_log, state.frame_time_us, state.ticks);
+    if ((++state.input_log_frames % INPUT_LOG_CHECK_FRAMES) == 0) {
+        input_log_check(&state.input_log, ram_hash(&state.apple2));
     }
 }
 
+// Apply an input to the system and log it
+static void input_apply(uint8_t type, uint16_t code, uint32_t value) {
+    apple2_t *sys = &state.apple2;
+    if (state.input_log_file) {
+        input_log_input(&state.input_log, type, code, value);
+    }
+    switch (type) {
+        case INPUT_LOG_KEY_DOWN:
+            sys->kbd_last_key = (uint8_t)code | 0x80;
+            break;
+        case INPUT_LOG_RESET:
+            apple2_reset(sys);
+            break;
+        case INPUT_LOG_INSERT:
+            if (sys->fdc.valid && (code < CHIPS_ARRAY_SIZE(apple2_nib_images))) {
+                disk2_fdd_insert_disk(&sys->fdc.fdd[0], apple2_nib_images[code]);
+            }
+            break;
+    }
+}
+
+#define REWIND_BUFFER_SIZE (8 * 1024 * 1024)
+
+// Keep a rewind history if requested with rewind, not while recording (the recording could not be replayed)
+static void rewind_history_init(void) {
+    if (!sargs_exists("rewind") || state.record_file || state.input_log_file) {
+        return;
+    }
+    state.rewind = calloc(1, sizeof(rewind_t));
+    state.rewind_snapshot = calloc(1, sizeof(apple2_t));
+    state.rewind_buffer = malloc(REWIND_BUFFER_SIZE);
+    rewind_init(state.rewind, &(rewind_desc_t){
+        .image_size = sizeof(apple2_t),
+        .buffer = {.ptr = state.rewind_buffer, .size = REWIND_BUFFER_SIZE},
+    });
+    rewind_track(state.rewind, offsetof(apple2_t, ram), sizeof(state.apple2.ram));
+    rewind_track(state.rewind, offsetof(apple2_t, lc.ram), sizeof(state.apple2.lc.ram));
+}
+
+// Push a snapshot every few frames, or go one snapshot back while F10 is held, returns false if rewinding
+static bool rewind_history_frame(void) {
+    apple2_t *sys = &state.apple2;
+    if (!state.rewinding) {
+        rewind_mark_mem_written(state.rewind, &sys->mem, sys);
+        if (rewind_frame(state.rewind)) {
+            apple2_save_snapshot(sys, state.rewind_snapshot);
+            rewind_push(state.rewind, state.rewind_snapshot);
+        }
+        return true;
+    }
+    const apple2_t *im = rewind_step_back(state.rewind, 1);
+    if (im) {
+        apple2_load_snapshot(sys, APPLE2_SNAPSHOT_VERSION, (apple2_t *)im);
+        mem_clear_written(&sys->mem);
+        if (state.ntsc) {
+            // The NTSC output is not part of the snapshot, render it again
+            apple2_screen_update(sys);
+        }
+    }
+    return false;
+}
+
+// NTSC mode: RGBA output of the system, and its height doubled copy for display
+static uint32_t apple2_ntsc_fb[APPLE2_SCREEN_WIDTH * APPLE2_SCREEN_HEIGHT];
+static uint32_t apple2_ntsc_frame_buffer[APPLE2_SCREEN_WIDTH * APPLE2_SCREEN_HEIGHT * 2];
+
 // Get apple2_desc_t struct based on joystick type
 apple2_desc_t apple2_desc(void) {
     return (apple2_desc_t){
         .fdc_enabled = false,
         .hdc_enabled = true,
         .hdc_internal_flash = false,
+        .ntsc_framebuffer = {.ptr = state.ntsc ? apple2_ntsc_fb : 0, .size = sizeof(apple2_ntsc_fb)},
         .audio =
             {
-                .callback = {.func = audio_callback},
+                .block_callback = {.func = audio_callback},
+                .format = CHIPS_AUDIO_FORMAT_FLOAT,
+                .buffer = {.ptr = audio_buffer, .size = sizeof(audio_buffer)},
                 .sample_rate = 44100,
             },
         .roms =
@@ -101,14 +247,44 @@ apple2_desc_t apple2_desc(void) {
 
 // original_size * 2 (byte per pixel) * 2 (height doubling) = original_size * 4
 static uint8_t apple2_frame_buffer[APPLE2_FRAMEBUFFER_SIZE * 4];
+// packed framebuffer content at the last update, to find the rows which need unpacking
+static uint8_t apple2_shadow_fb[APPLE2_FRAMEBUFFER_SIZE];
 
-static void apple2_update_frame_buffer(apple2_t* sys) {
+// Double the NTSC rows rendered since the last call, returns false if none were
+static bool apple2_update_ntsc_frame_buffer(apple2_t* sys) {
+    if (!chips_dirty_rows_any(&sys->dirty_rows)) {
+        return false;
+    }
+    for (int row = 0; row < APPLE2_SCREEN_HEIGHT; row++) {
+        if (chips_dirty_rows_test(&sys->dirty_rows, row)) {
+            const uint32_t* src_row = &apple2_ntsc_fb[row * APPLE2_SCREEN_WIDTH];
+            memcpy(&apple2_ntsc_frame_buffer[row * 2 * APPLE2_SCREEN_WIDTH], src_row, APPLE2_SCREEN_WIDTH * 4);
+            memcpy(&apple2_ntsc_frame_buffer[(row * 2 + 1) * APPLE2_SCREEN_WIDTH], src_row, APPLE2_SCREEN_WIDTH * 4);
+        }
+    }
+    chips_dirty_rows_clear(&sys->dirty_rows);
+    return true;
+}
+
+// Unpack and double the rows which changed since the last call, returns false if none did
+static bool apple2_update_frame_buffer(apple2_t* sys) {
+    if (state.ntsc) {
+        return apple2_update_ntsc_frame_buffer(sys);
+    }
     const int src_bytes_per_row = APPLE2_SCREEN_WIDTH / 2;
     const int dst_bytes_per_row = APPLE2_SCREEN_WIDTH;
     const int dst_double_row_bytes = dst_bytes_per_row * 2;
+    bool changed = false;
     
     for (int row = 0; row < APPLE2_SCREEN_HEIGHT; row++) {
         const uint8_t* src_row = &sys->fb[row * src_bytes_per_row];
+        uint8_t* shadow_row = &apple2_shadow_fb[row * src_bytes_per_row];
+        if (memcmp(src_row, shadow_row, src_bytes_per_row) == 0) {
+            continue;
+        }
+        memcpy(shadow_row, src_row, src_bytes_per_row);
+        changed = true;
+
         uint8_t* dst_row = &apple2_frame_buffer[row * dst_double_row_bytes];
         uint8_t* dst_row_dup = &apple2_frame_buffer[(row * 2 + 1) * dst_bytes_per_row];
         
@@ -120,19 +296,23 @@ static void apple2_update_frame_buffer(apple2_t* sys) {
         
         memcpy(dst_row_dup, dst_row, dst_bytes_per_row);
     }
+    // The recorder has seen this frame's rendered rows
+    chips_dirty_rows_clear(&sys->dirty_rows);
+    return changed;
 }
 
 chips_display_info_t apple2_display_info(apple2_t* sys) {
+    const bool ntsc = sys && state.ntsc;
     const chips_display_info_t res = {
         .frame = {
             .dim = {
                 .width = APPLE2_SCREEN_WIDTH,
                 .height = APPLE2_SCREEN_HEIGHT * 2,
             },
-            .bytes_per_pixel = 1,
+            .bytes_per_pixel = ntsc ? 4 : 1,
             .buffer = {
-                .ptr = sys ? apple2_frame_buffer : 0,
-                .size = APPLE2_FRAMEBUFFER_SIZE * 4,
+                .ptr = ntsc ? (void*)apple2_ntsc_frame_buffer : (sys ? apple2_frame_buffer : 0),
+                .size = ntsc ? sizeof(apple2_ntsc_frame_buffer) : APPLE2_FRAMEBUFFER_SIZE * 4,
             }
         },
         .screen = {
@@ -142,12 +322,12 @@ chips_display_info_t apple2_display_info(apple2_t* sys) {
             .height = APPLE2_SCREEN_HEIGHT * 2,
         },
         .palette = {
-            .ptr = sys ? apple2_palette : 0,
+            .ptr = (sys && !ntsc) ? apple2_palette : 0,
             .size = sizeof(apple2_palette),
         }
     };
     CHIPS_ASSERT(((sys == 0) && (res.frame.buffer.ptr == 0)) || ((sys != 0) && (res.frame.buffer.ptr != 0)));
-    CHIPS_ASSERT(((sys == 0) && (res.palette.ptr == 0)) || ((sys != 0) && (res.palette.ptr != 0)));
+    CHIPS_ASSERT(((sys == 0) && (res.palette.ptr == 0)) || ((sys != 0) && ((res.palette.ptr != 0) != ntsc)));
     return res;
 }
 
@@ -156,8 +336,16 @@ void app_init(void) {
         .logger.func = slog_func,
     });
 
+    state.ntsc = sargs_exists("ntsc");
     apple2_desc_t desc = apple2_desc();
     apple2_init(&state.apple2, &desc);
+#ifdef MOS6502CPU_PROFILE
+    state.profile = calloc(1, sizeof(mos6502cpu_profile_t));
+    apple2_profile_attach(&state.apple2, state.profile);
+#endif
+    record_init();
+    input_recording_init();
+    rewind_history_init();
     gfx_init(&(gfx_desc_t){
         .disable_speaker_icon = sargs_exists("disable-speaker-icon"),
         .border = {
@@ -179,11 +367,20 @@ static void draw_status_bar(void);
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
     const uint64_t emu_start_time = stm_now();
-    state.ticks = apple2_exec(&state.apple2, state.frame_time_us);
+    if (!state.rewind || rewind_history_frame()) {
+        state.ticks = apple2_exec(&state.apple2, state.frame_time_us);
+        if (state.input_log_file) {
+            input_recording_frame();
+        }
+    }
     state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    if (state.record_file) {
+        recorder_frame(&state.recorder, state.apple2.fb, &state.apple2.dirty_rows);
+    }
     draw_status_bar();
-    apple2_update_frame_buffer(&state.apple2);
-    gfx_draw(apple2_display_info(&state.apple2));
+    chips_display_info_t display_info = apple2_display_info(&state.apple2);
+    display_info.frame.unchanged = !apple2_update_frame_buffer(&state.apple2);
+    gfx_draw(display_info);
 }
 
 void app_input(const sapp_event* event) {
@@ -240,13 +437,37 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+#ifdef MOS6502CPU_PROFILE
+    mos6502cpu_profile_report(state.profile, apple2_profile_symbols, CHIPS_ARRAY_SIZE(apple2_profile_symbols), 32);
+    apple2_profile_attach(&state.apple2, 0);
+    free(state.profile);
+#endif
     apple2_discard(&state.apple2);
+    if (state.rewind) {
+        free(state.rewind_buffer);
+        free(state.rewind_snapshot);
+        free(state.rewind);
+    }
+    if (state.record_file) {
+        fclose(state.record_file);
+    }
+    if (state.input_log_file) {
+        fclose(state.input_log_file);
+    }
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
 static void kbd_raw_key_down(int code) {
+    if (state.record_file) {
+        recorder_input(&state.recorder, code, true);
+    }
+    if (code == 0x143) {
+        // F10
+        state.rewinding = state.rewind != 0;
+        return;
+    }
     if (isascii(code)) {
         code = toupper(code);
     }
@@ -259,8 +480,6 @@ static void kbd_raw_key_down(int code) {
         code = 0x08;
     }
 
-    apple2_t *sys = &state.apple2;
-
     switch (code) {
         case 0x13A:  // F1
         case 0x13B:  // F2
@@ -271,23 +490,16 @@ static void kbd_raw_key_down(int code) {
         case 0x140:  // F7
         case 0x141:  // F8
         case 0x142:  // F9
-        {
-            if (sys->fdc.valid) {
-                uint8_t index = code - 0x13A;
-                if (CHIPS_ARRAY_SIZE(apple2_nib_images) > index) {
-                    disk2_fdd_insert_disk(&sys->fdc.fdd[0], apple2_nib_images[index]);
-                }
-            }
+            input_apply(INPUT_LOG_INSERT, code - 0x13A, 0);
             break;
-        }
 
         case 0x145:  // F12
-            apple2_reset(sys);
+            input_apply(INPUT_LOG_RESET, 0, 0);
             break;
 
         default:
             if (code < 128) {
-                sys->kbd_last_key = code | 0x80;
+                input_apply(INPUT_LOG_KEY_DOWN, code, 0);
             }
             break;
     }
@@ -295,6 +507,14 @@ static void kbd_raw_key_down(int code) {
 }
 
 static void kbd_raw_key_up(int code) {
+    if (state.record_file) {
+        recorder_input(&state.recorder, code, false);
+    }
+    if (code == 0x143) {
+        // F10
+        state.rewinding = false;
+        return;
+    }
     if (isascii(code)) {
         code = toupper(code);
     }
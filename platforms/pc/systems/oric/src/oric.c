@@ -19,12 +19,15 @@
 //     distribution.
 
 #define CHIPS_IMPL
+#define MEM_TRACK_WRITES
 
 #define __in_flash()
 #define __not_in_flash()
 
 #define RGBA8(b, g, r) (0xFF000000 | (r << 16) | (g << 8) | (b))
 
+#include <stddef.h>
+#include <stdio.h>
 #include <stdlib.h>
 
 #include "roms/oric_roms.h"
@@ -44,6 +47,10 @@
 #include "devices/disk2_fdc.h"
 #include "devices/oric_fdc_rom.h"
 #include "systems/oric.h"
+#include "util/fbstream.h"
+#include "util/recorder.h"
+#include "util/rewind.h"
+#include "util/input_log.h"
 
 typedef struct {
     uint32_t version;
@@ -55,6 +62,18 @@ typedef struct {
     uint32_t frame_time_us;
     uint32_t ticks;
     double emu_time_ms;
+    FILE *record_file;
+    recorder_t recorder;
+    rewind_t *rewind;  // Rewind history (rewind command line option), F10 held rewinds
+    oric_t *rewind_snapshot;
+    uint8_t *rewind_buffer;
+    bool rewinding;
+    FILE *input_log_file;  // Input log (inputlog command line option), replayed by the headless streamer
+    input_log_t input_log;
+    uint32_t input_log_frames;
+#ifdef MOS6502CPU_PROFILE
+    mos6502cpu_profile_t *profile;
+#endif
 } state_t;
 
 static state_t state;
@@ -65,16 +84,141 @@ static state_t state;
 #define BORDER_BOTTOM (16)
 
 // Audio streaming callback
-static void audio_callback(const uint8_t sample, void *user_data) {
+static float audio_buffer[1024];
+
+static void audio_callback(const void *samples, int num_samples, void *user_data) {
     (void)user_data;
+    saudio_push((const float *)samples, num_samples);
+    if (state.record_file) {
+        recorder_audio(&state.recorder, samples, num_samples, CHIPS_AUDIO_FORMAT_FLOAT);
+    }
+}
+
+// Session recording output
+static void record_write(const void *data, size_t size, void *user_data) {
+    fwrite(data, size, 1, (FILE *)user_data);
+}
+
+// Start recording the session if requested with record=<file>
+static void record_init(void) {
+    if (!sargs_exists("record")) {
+        return;
+    }
+    state.record_file = fopen(sargs_value("record"), "wb");
+    if (state.record_file == 0) {
+        return;
+    }
+    recorder_init(&state.recorder, &(recorder_desc_t){
+        .width = ORIC_SCREEN_WIDTH,
+        .height = ORIC_SCREEN_HEIGHT,
+        .palette = oric_palette,
+        .sample_rate = 44100,
+        .write = {.func = record_write, .user_data = state.record_file},
+    });
+}
+
+#define INPUT_LOG_CHECK_FRAMES (60)
 
-    static float samples[1024];
-    static int sample_index = 0;
-    samples[sample_index++] = (float)sample / 255.0f;
-    if (sample_index == 1024) {
-        saudio_push(samples, 1024);
-        sample_index = 0;
+// Input log output
+static bool input_log_write(const void *data, size_t size, void *user_data) {
+    return fwrite(data, size, 1, (FILE *)user_data) == 1;
+}
+
+// Hash of the RAM for the input log checkpoints
+static uint32_t ram_hash(oric_t *sys) {
+    uint32_t hash = input_log_hash(INPUT_LOG_HASH_INIT, sys->ram, sizeof(sys->ram));
+    return input_log_hash(hash, sys->overlay_ram, sizeof(sys->overlay_ram));
+}
+
+// Start logging the inputs if requested with inputlog=<file>
+static void input_recording_init(void) {
+    if (!sargs_exists("inputlog")) {
+        return;
+    }
+    state.input_log_file = fopen(sargs_value("inputlog"), "wb");
+    if (state.input_log_file == 0) {
+        return;
     }
+    input_log_init(&state.input_log, ORIC_STATE_ID, input_log_write, state.input_log_file);
+    input_log_check(&state.input_log, ram_hash(&state.oric));
+}
+
+// Log the last exec() call, and a checkpoint every INPUT_LOG_CHECK_FRAMES frames
+static void input_recording_frame(void) {
+    input_log_frame(&state.input_log, state.frame_time_us, state.ticks);
+    if ((++state.input_log_frames % INPUT_LOG_CHECK_FRAMES) == 0) {
+        input_log_check(&state.input_log, ram_hash(&state.oric));
+    }
+}
+
+// Apply an input to the system and log it, images are numbered as the F1..F9 keys (disks first, then tapes)
+static void input_apply(uint8_t type, uint16_t code, uint32_t value) {
+    oric_t *sys = &state.oric;
+    if (state.input_log_file) {
+        input_log_input(&state.input_log, type, code, value);
+    }
+    switch (type) {
+        case INPUT_LOG_KEY_DOWN:
+            kbd_key_down(&sys->kbd, code);
+            break;
+        case INPUT_LOG_KEY_UP:
+            kbd_key_up(&sys->kbd, code);
+            break;
+        case INPUT_LOG_RESET:
+            oric_reset(sys);
+            break;
+        case INPUT_LOG_NMI:
+            oric_nmi(sys);
+            break;
+        case INPUT_LOG_INSERT:
+            if (code < CHIPS_ARRAY_SIZE(oric_nib_images)) {
+                if (sys->fdc.valid) {
+                    disk2_fdd_insert_disk(&sys->fdc.fdd[0], oric_nib_images[code]);
+                }
+            } else if (code - CHIPS_ARRAY_SIZE(oric_nib_images) < CHIPS_ARRAY_SIZE(oric_wave_images)) {
+                if (sys->td.valid) {
+                    oric_td_insert_tape(&sys->td, oric_wave_images[code - CHIPS_ARRAY_SIZE(oric_nib_images)]);
+                }
+            }
+            break;
+    }
+}
+
+#define REWIND_BUFFER_SIZE (8 * 1024 * 1024)
+
+// Keep a rewind history if requested with rewind, not while recording (the recording could not be replayed)
+static void rewind_history_init(void) {
+    if (!sargs_exists("rewind") || state.record_file || state.input_log_file) {
+        return;
+    }
+    state.rewind = calloc(1, sizeof(rewind_t));
+    state.rewind_snapshot = calloc(1, sizeof(oric_t));
+    state.rewind_buffer = malloc(REWIND_BUFFER_SIZE);
+    rewind_init(state.rewind, &(rewind_desc_t){
+        .image_size = sizeof(oric_t),
+        .buffer = {.ptr = state.rewind_buffer, .size = REWIND_BUFFER_SIZE},
+    });
+    rewind_track(state.rewind, offsetof(oric_t, ram), sizeof(state.oric.ram));
+    rewind_track(state.rewind, offsetof(oric_t, overlay_ram), sizeof(state.oric.overlay_ram));
+}
+
+// Push a snapshot every few frames, or go one snapshot back while F10 is held, returns false if rewinding
+static bool rewind_history_frame(void) {
+    oric_t *sys = &state.oric;
+    if (!state.rewinding) {
+        rewind_mark_mem_written(state.rewind, &sys->mem, sys);
+        if (rewind_frame(state.rewind)) {
+            oric_save_snapshot(sys, state.rewind_snapshot);
+            rewind_push(state.rewind, state.rewind_snapshot);
+        }
+        return true;
+    }
+    const oric_t *im = rewind_step_back(state.rewind, 1);
+    if (im) {
+        oric_load_snapshot(sys, ORIC_SNAPSHOT_VERSION, (oric_t *)im);
+        mem_clear_written(&sys->mem);
+    }
+    return false;
 }
 
 // Get oric_desc_t struct based on configuration
@@ -84,7 +228,9 @@ oric_desc_t oric_desc(void) {
         .fdc_enabled = true, // Enable floppy disk controller
         .audio =
             {
-                .callback = {.func = audio_callback},
+                .block_callback = {.func = audio_callback},
+                .format = CHIPS_AUDIO_FORMAT_FLOAT,
+                .buffer = {.ptr = audio_buffer, .size = sizeof(audio_buffer)},
                 .sample_rate = 44100,
             },
         .roms =
@@ -97,13 +243,24 @@ oric_desc_t oric_desc(void) {
 
 // original_size * 2 (byte per pixel) = original_size * 2
 static uint8_t oric_frame_buffer[ORIC_FRAMEBUFFER_SIZE * 2];
+// packed framebuffer content at the last update, to find the rows which need unpacking
+static uint8_t oric_shadow_fb[ORIC_FRAMEBUFFER_SIZE];
 
-static void oric_update_frame_buffer(oric_t* sys) {
+// Unpack the rows which changed since the last call, returns false if none did
+static bool oric_update_frame_buffer(oric_t* sys) {
     const int src_bytes_per_row = ORIC_SCREEN_WIDTH / 2;
     const int dst_bytes_per_row = ORIC_SCREEN_WIDTH;
+    bool changed = false;
     
     for (int row = 0; row < ORIC_SCREEN_HEIGHT; row++) {
         const uint8_t* src_row = &sys->fb[row * src_bytes_per_row];
+        uint8_t* shadow_row = &oric_shadow_fb[row * src_bytes_per_row];
+        if (memcmp(src_row, shadow_row, src_bytes_per_row) == 0) {
+            continue;
+        }
+        memcpy(shadow_row, src_row, src_bytes_per_row);
+        changed = true;
+
         uint8_t* dst_row = &oric_frame_buffer[row * dst_bytes_per_row];
         
         for (int col = 0; col < src_bytes_per_row; col++) {
@@ -112,6 +269,9 @@ static void oric_update_frame_buffer(oric_t* sys) {
             dst_row[col * 2 + 1] = pixel & 0x0F;
         }
     }
+    // The recorder has seen this frame's rendered rows
+    chips_dirty_rows_clear(&sys->dirty_rows);
+    return changed;
 }
 
 chips_display_info_t oric_display_info(oric_t* sys) {
@@ -150,6 +310,13 @@ void app_init(void) {
 
     oric_desc_t desc = oric_desc();
     oric_init(&state.oric, &desc);
+#ifdef MOS6502CPU_PROFILE
+    state.profile = calloc(1, sizeof(mos6502cpu_profile_t));
+    oric_profile_attach(&state.oric, state.profile);
+#endif
+    record_init();
+    input_recording_init();
+    rewind_history_init();
     gfx_init(&(gfx_desc_t){
         .disable_speaker_icon = sargs_exists("disable-speaker-icon"),
         .border = {
@@ -171,11 +338,20 @@ static void draw_status_bar(void);
 void app_frame(void) {
     state.frame_time_us = clock_frame_time();
     const uint64_t emu_start_time = stm_now();
-    state.ticks = oric_exec(&state.oric, state.frame_time_us);
+    if (!state.rewind || rewind_history_frame()) {
+        state.ticks = oric_exec(&state.oric, state.frame_time_us);
+        if (state.input_log_file) {
+            input_recording_frame();
+        }
+    }
     state.emu_time_ms = stm_ms(stm_since(emu_start_time));
+    if (state.record_file) {
+        recorder_frame(&state.recorder, state.oric.fb, &state.oric.dirty_rows);
+    }
     draw_status_bar();
-    oric_update_frame_buffer(&state.oric);
-    gfx_draw(oric_display_info(&state.oric));
+    chips_display_info_t display_info = oric_display_info(&state.oric);
+    display_info.frame.unchanged = !oric_update_frame_buffer(&state.oric);
+    gfx_draw(display_info);
 }
 
 void app_input(const sapp_event* event) {
@@ -235,13 +411,37 @@ void app_input(const sapp_event* event) {
 }
 
 void app_cleanup(void) {
+#ifdef MOS6502CPU_PROFILE
+    mos6502cpu_profile_report(state.profile, 0, 0, 32);
+    oric_profile_attach(&state.oric, 0);
+    free(state.profile);
+#endif
     oric_discard(&state.oric);
+    if (state.rewind) {
+        free(state.rewind_buffer);
+        free(state.rewind_snapshot);
+        free(state.rewind);
+    }
+    if (state.record_file) {
+        fclose(state.record_file);
+    }
+    if (state.input_log_file) {
+        fclose(state.input_log_file);
+    }
     saudio_shutdown();
     gfx_shutdown();
     sargs_shutdown();
 }
 
 static void kbd_raw_key_down(int code) {
+    if (state.record_file) {
+        recorder_input(&state.recorder, code, true);
+    }
+    if (code == 0x143) {
+        // F10
+        state.rewinding = state.rewind != 0;
+        return;
+    }
     if (isascii(code)) {
         if (isupper(code)) {
             code = tolower(code);
@@ -250,8 +450,6 @@ static void kbd_raw_key_down(int code) {
         }
     }
 
-    oric_t *sys = &state.oric;
-
     switch (code) {
         case 0x13A:  // F1
         case 0x13B:  // F2
@@ -262,39 +460,32 @@ static void kbd_raw_key_down(int code) {
         case 0x140:  // F7
         case 0x141:  // F8
         case 0x142:  // F9
-        {
-            uint8_t index = code - 0x13A;
-            int num_nib_images = CHIPS_ARRAY_SIZE(oric_nib_images);
-            if (index < num_nib_images) {
-                if (sys->fdc.valid) {
-                    disk2_fdd_insert_disk(&sys->fdc.fdd[0], oric_nib_images[index]);
-                }
-            } else {
-                index -= num_nib_images;
-                if (index < CHIPS_ARRAY_SIZE(oric_wave_images)) {
-                    if (sys->td.valid) {
-                        oric_td_insert_tape(&sys->td, oric_wave_images[index]);
-                    }
-                }
-            }
+            input_apply(INPUT_LOG_INSERT, code - 0x13A, 0);
             break;
-        }
 
         case 0x144:  // F11
-            oric_nmi(sys);
+            input_apply(INPUT_LOG_NMI, 0, 0);
             break;
 
         case 0x145:  // F12
-            oric_reset(sys);
+            input_apply(INPUT_LOG_RESET, 0, 0);
             break;
 
         default:
-            kbd_key_down(&sys->kbd, code);
+            input_apply(INPUT_LOG_KEY_DOWN, code, 0);
             break;
     }
 }
 
 static void kbd_raw_key_up(int code) {
+    if (state.record_file) {
+        recorder_input(&state.recorder, code, false);
+    }
+    if (code == 0x143) {
+        // F10
+        state.rewinding = false;
+        return;
+    }
     if (isascii(code)) {
         if (isupper(code)) {
             code = tolower(code);
@@ -303,7 +494,7 @@ static void kbd_raw_key_up(int code) {
         }
     }
 
-    kbd_key_up(&state.oric.kbd, code);
+    input_apply(INPUT_LOG_KEY_UP, code, 0);
 }
 
 static void draw_status_bar(void) {
@@ -6,71 +6,20 @@
 #include "hardware/irq.h"
 #include "hardware/pwm.h"
 #include "hardware/clocks.h"
-#include "pico/critical_section.h"
 
 #include "audio.h"
+#include "audio_ring.h"
 
-#define SAMPLES_BUFFER_SIZE    2048
-#define SAMPLES_CHUNK_SIZE     32
 #define SAMPLE_REPETITION_RATE 4
 
-typedef struct {
-    critical_section_t cs;
-    uint8_t samples[SAMPLES_BUFFER_SIZE];
-    uint8_t empty_samples[SAMPLES_CHUNK_SIZE];
-    uint16_t head;
-    uint16_t tail;
-    uint16_t size;
-} audio_buffer_t;
-
-static audio_buffer_t __not_in_flash() audio_buffer;
+static audio_ring_t __not_in_flash() audio_ring;
 
 static uint32_t single_sample = 0;
 static uint32_t *single_sample_ptr = &single_sample;
 static int pwm_dma_channel, trigger_dma_channel, sample_dma_channel;
 
-static inline void __not_in_flash_func(audio_buffer_init)(audio_buffer_t *audio_buffer) {
-    critical_section_init(&audio_buffer->cs);
-    memset(audio_buffer->samples, 0, SAMPLES_BUFFER_SIZE);
-    memset(audio_buffer->empty_samples, 0, SAMPLES_CHUNK_SIZE);
-    audio_buffer->head = 0;
-    audio_buffer->tail = 0;
-    audio_buffer->size = 0;
-}
-
-static inline void __not_in_flash_func(audio_buffer_enqueue)(audio_buffer_t *audio_buffer, uint8_t sample) {
-    if (audio_buffer->size < SAMPLES_BUFFER_SIZE) {
-        audio_buffer->samples[audio_buffer->head++] = sample;
-        if (audio_buffer->head >= SAMPLES_BUFFER_SIZE) {
-            audio_buffer->head = 0;
-        }
-        critical_section_enter_blocking(&audio_buffer->cs);
-        audio_buffer->size++;
-        critical_section_exit(&audio_buffer->cs);
-    }
-}
-
-static inline uint8_t *__not_in_flash_func(audio_buffer_dequeue)(audio_buffer_t *audio_buffer) {
-    if (audio_buffer->size >= SAMPLES_CHUNK_SIZE) {
-        uint8_t *samples = &audio_buffer->samples[audio_buffer->tail];
-        audio_buffer->tail += SAMPLES_CHUNK_SIZE;
-        if (audio_buffer->tail >= SAMPLES_BUFFER_SIZE) {
-            audio_buffer->tail = 0;
-        }
-        critical_section_enter_blocking(&audio_buffer->cs);
-        audio_buffer->size -= SAMPLES_CHUNK_SIZE;
-        critical_section_exit(&audio_buffer->cs);
-        return samples;
-    } else {
-        int p = audio_buffer->tail == 0 ? SAMPLES_BUFFER_SIZE : audio_buffer->tail;
-        int c = audio_buffer->samples[p - 1];
-        memset(audio_buffer->empty_samples, c, SAMPLES_CHUNK_SIZE);
-        return audio_buffer->empty_samples;    
-    }
-}
-
 static void __not_in_flash_func(audio_dma_irq_handler)() {
-    dma_channel_set_read_addr(sample_dma_channel, audio_buffer_dequeue(&audio_buffer), false);
+    dma_channel_set_read_addr(sample_dma_channel, audio_ring_read_chunk(&audio_ring), false);
     dma_channel_set_read_addr(trigger_dma_channel, &single_sample_ptr, true);
     dma_channel_acknowledge_irq1(trigger_dma_channel);
 }
@@ -132,7 +81,7 @@ void audio_init(uint8_t audio_pin, uint16_t sample_freq) {
                           &single_sample_ptr,
                           // Need to trigger once for each audio sample but as the PWM DREQ is
                           // used need to multiply by sample repetition rate
-                          SAMPLE_REPETITION_RATE * SAMPLES_CHUNK_SIZE,
+                          SAMPLE_REPETITION_RATE * AUDIO_RING_CHUNK_SIZE,
                           // Don't start yet
                           false);
 
@@ -154,16 +103,18 @@ void audio_init(uint8_t audio_pin, uint16_t sample_freq) {
                           // Write to single_sample
                           (char *)&single_sample + 2 * audio_pin_channel,
                           // Read from audio buffer
-                          audio_buffer.samples,
+                          audio_ring.samples,
                           // Only do one transfer (once per PWM DMA completion due to chaining)
                           1,
                           // Don't start yet
                           false);
 
-    audio_buffer_init(&audio_buffer);
+    audio_ring_init(&audio_ring);
 
     // Kick things off with the trigger DMA channel
     dma_channel_start(trigger_dma_channel);
 }
 
-void audio_push_sample(const uint8_t sample) { audio_buffer_enqueue(&audio_buffer, sample); }
+void audio_push_sample(const uint8_t sample) { audio_ring_write(&audio_ring, &sample, 1); }
+
+void audio_push_samples(const uint8_t *samples, int num_samples) { audio_ring_write(&audio_ring, samples, num_samples); }
@@ -15,6 +15,7 @@ extern "C" {
 
 void audio_init(uint8_t audio_pin, uint16_t sample_freq);
 void audio_push_sample(const uint8_t sample);
+void audio_push_samples(const uint8_t *samples, int num_samples);
 
 #ifdef __cplusplus
 }
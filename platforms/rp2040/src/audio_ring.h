@@ -0,0 +1,87 @@
+#ifndef AUDIO_RING_H_FILE
+#define AUDIO_RING_H_FILE
+
+// Single-producer/single-consumer sample ring buffer.
+//
+// The emulation loop is the only producer and writes 'head', the audio
+// DMA interrupt is the only consumer and writes 'tail'. Both indices run
+// freely and are masked on access, so no lock is needed: each side reads
+// the other side's index with acquire semantics and publishes its own with
+// release semantics.
+//
+// The consumer takes whole chunks and keeps the last chunk it handed out
+// reserved until the next audio_ring_read_chunk() call, so the producer
+// cannot overwrite samples while the DMA is still reading them.
+//
+// No platform dependencies, the same code can run on a host.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define AUDIO_RING_SIZE       (2048)  // must be 2^N
+#define AUDIO_RING_CHUNK_SIZE (32)    // must divide AUDIO_RING_SIZE
+
+typedef struct {
+    _Atomic uint32_t head;  // written by producer
+    _Atomic uint32_t tail;  // written by consumer
+    uint32_t reserved;      // consumer only: number of samples handed out but not yet released
+    uint8_t samples[AUDIO_RING_SIZE];
+    uint8_t empty_samples[AUDIO_RING_CHUNK_SIZE];
+} audio_ring_t;
+
+static inline void audio_ring_init(audio_ring_t *ring) {
+    atomic_init(&ring->head, 0);
+    atomic_init(&ring->tail, 0);
+    ring->reserved = 0;
+    for (int i = 0; i < AUDIO_RING_SIZE; i++) {
+        ring->samples[i] = 0;
+    }
+    for (int i = 0; i < AUDIO_RING_CHUNK_SIZE; i++) {
+        ring->empty_samples[i] = 0;
+    }
+}
+
+// Producer: append up to 'num_samples' samples, return number of samples written (rest is dropped)
+static inline int audio_ring_write(audio_ring_t *ring, const uint8_t *samples, int num_samples) {
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    const uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    const uint32_t free = AUDIO_RING_SIZE - (head - tail);
+    if ((uint32_t)num_samples > free) {
+        num_samples = (int)free;
+    }
+    for (int i = 0; i < num_samples; i++) {
+        ring->samples[(head + i) & (AUDIO_RING_SIZE - 1)] = samples[i];
+    }
+    atomic_store_explicit(&ring->head, head + num_samples, memory_order_release);
+    return num_samples;
+}
+
+// Consumer: release the previously returned chunk and return the next one,
+// or a chunk repeating the last sample if not enough samples are available
+static inline const uint8_t *audio_ring_read_chunk(audio_ring_t *ring) {
+    uint32_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed) + ring->reserved;
+    atomic_store_explicit(&ring->tail, tail, memory_order_release);
+    const uint32_t head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    if ((head - tail) >= AUDIO_RING_CHUNK_SIZE) {
+        ring->reserved = AUDIO_RING_CHUNK_SIZE;
+        return &ring->samples[tail & (AUDIO_RING_SIZE - 1)];
+    } else {
+        const uint8_t last = ring->samples[(tail - 1) & (AUDIO_RING_SIZE - 1)];
+        for (int i = 0; i < AUDIO_RING_CHUNK_SIZE; i++) {
+            ring->empty_samples[i] = last;
+        }
+        ring->reserved = 0;
+        return ring->empty_samples;
+    }
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // AUDIO_RING_H_FILE
@@ -41,8 +41,13 @@ typedef struct {
 #define MOS6502CPU_TICK(c)           wdc65C02cpu_tick(c)
 #define MOS6502CPU_GET_ADDR(c)       wdc65C02cpu_get_addr()
 #define MOS6502CPU_GET_DATA(c)       wdc65C02cpu_get_data()
+#define MOS6502CPU_GET_SYNC(c)       (false)  // SYNC pin is not connected
 #define MOS6502CPU_SET_DATA(c, data) wdc65C02cpu_set_data(data)
 #define MOS6502CPU_SET_IRQ(c, state) wdc65C02cpu_set_irq(state)
+// The registers live in the external CPU, state files are saved without a CPU chunk and can't restore one
+#define MOS6502CPU_SAVE_STATE(c, w)  ((void)0)
+#define MOS6502CPU_LOAD_STATE(c, r)  (false)
+#define MOS6502CPU_STATE_ID          CHIPS_STATE_ID('C', 'P', 'U', ' ')
 
 // Initialize cpu
 void wdc65C02cpu_init();
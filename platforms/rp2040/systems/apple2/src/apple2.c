@@ -88,9 +88,11 @@ typedef struct {
 static state_t __not_in_flash() state;
 
 // Audio streaming callback
-static void audio_callback(const uint8_t sample, void *user_data) {
+static uint8_t __not_in_flash() audio_buffer[64];
+
+static void audio_callback(const void *samples, int num_samples, void *user_data) {
     (void)user_data;
-    audio_push_sample(sample);
+    audio_push_samples((const uint8_t *)samples, num_samples);
 }
 
 // Get apple2_desc_t struct based on joystick type
@@ -101,7 +103,9 @@ apple2_desc_t apple2_desc(void) {
         .hdc_internal_flash = false,
         .audio =
             {
-                .callback = {.func = audio_callback},
+                .block_callback = {.func = audio_callback},
+                .format = CHIPS_AUDIO_FORMAT_U8,
+                .buffer = {.ptr = audio_buffer, .size = sizeof(audio_buffer)},
                 .sample_rate = 44100,
             },
         .roms =
@@ -414,10 +418,8 @@ int main() {
     while (1) {
         uint32_t start_time_in_micros = time_us_32();
 
-        uint32_t num_ticks = 17030;
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-            apple2_tick(&state.apple2);
-        }
+        // Idle loops are fast-forwarded, the time saved is slept below
+        apple2_run_ticks(&state.apple2, 17030);
 
         apple2_screen_update(&state.apple2);
         tuh_task();
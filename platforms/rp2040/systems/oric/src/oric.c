@@ -84,9 +84,11 @@ typedef struct {
 state_t __not_in_flash() state;
 
 // Audio streaming callback
-static void audio_callback(const uint8_t sample, void *user_data) {
+static uint8_t __not_in_flash() audio_buffer[64];
+
+static void audio_callback(const void *samples, int num_samples, void *user_data) {
     (void)user_data;
-    audio_push_sample(sample);
+    audio_push_samples((const uint8_t *)samples, num_samples);
 }
 
 // Get oric_desc_t struct based on joystick type
@@ -96,7 +98,9 @@ oric_desc_t oric_desc(void) {
         .fdc_enabled = true,
         .audio =
             {
-                .callback = {.func = audio_callback},
+                .block_callback = {.func = audio_callback},
+                .format = CHIPS_AUDIO_FORMAT_U8,
+                .buffer = {.ptr = audio_buffer, .size = sizeof(audio_buffer)},
                 .sample_rate = 22050,
             },
         .roms =
@@ -300,10 +304,8 @@ int main() {
     while (1) {
         uint32_t start_time_in_micros = time_us_32();
 
-        uint32_t num_ticks = 19968;
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-            oric_tick(&state.oric);
-        }
+        // Idle loops are fast-forwarded, the time saved is slept below
+        oric_run_ticks(&state.oric, 19968);
 
         oric_screen_update(&state.oric);
         kbd_update(&state.oric.kbd, 19968);
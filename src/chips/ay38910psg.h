@@ -4,6 +4,30 @@
 //
 // AY-3-8910/2/3 sound chip emulator
 //
+// Define CHIPS_AUDIO_FIXEDPOINT before including this header to build
+// an integer-only sample generator (Q15 volume table and DC adjust) for
+// targets without an FPU. Use ay38910psg_sample_u8() / ay38910psg_sample_s16()
+// to read the current sample in either build.
+//
+// ## Lazy Update
+//
+// Instead of calling the tick functions from the system tick, a system can
+// let the chip catch up on demand: call ay38910psg_update() with the current
+// system tick before each register write, and ay38910psg_flush() whenever
+// samples are needed (e.g. once per audio block). Tone, noise and envelope
+// counters are advanced arithmetically between sample points, so a static
+// or silent PSG costs nothing per system tick. The timing matches the tick
+// functions being called every AY38910PSG_CHANNEL_STEP_TICKS and
+// AY38910PSG_ENV_STEP_TICKS system ticks (relative to system tick 0), with
+// one sample every 'sample_ticks' system ticks.
+//
+// ## State Files
+//
+// ay38910psg_save_state() / ay38910psg_load_state() write and read the
+// registers and generator counters as a chunk of a portable state file
+// (include chips/chips_common.h before this header). The sample output
+// filter is not stored.
+//
 // ## zlib/libpng license
 //
 // Copyright (c) 2023 Veselin Sladkov
@@ -62,6 +86,8 @@ extern "C" {
 #define AY38910PSG_REG_IO_PORT_B         (15)  // Not on AY-3-8912/3
 // Number of registers
 #define AY38910PSG_NUM_REGISTERS (16)
+// State file chunk id
+#define AY38910PSG_STATE_ID CHIPS_STATE_ID('P', 'S', 'G', ' ')
 // Error-accumulation precision boost
 #define AY38910PSG_FIXEDPOINT_SCALE (16)
 // Number of channels
@@ -69,6 +95,12 @@ extern "C" {
 // DC adjustment buffer length
 #define AY38910PSG_DCADJ_BUFLEN (512)
 
+// System ticks between tone/noise counter steps and between envelope counter steps (lazy update)
+#define AY38910PSG_CHANNEL_STEP_TICKS (64)
+#define AY38910PSG_ENV_STEP_TICKS     (128)
+// Max number of samples buffered between two ay38910psg_flush() calls
+#define AY38910PSG_MAX_SAMPLES (64)
+
 // IO port names
 #define AY38910PSG_PORT_A (0)
 #define AY38910PSG_PORT_B (1)
@@ -94,6 +126,7 @@ typedef struct {
     ay38910psg_in_t in_cb;    // I/O port input callback
     ay38910psg_out_t out_cb;  // I/O port output callback
     void* user_data;          // Optional user-data for callbacks
+    int sample_ticks;         // System ticks per output sample (lazy update only)
 } ay38910psg_desc_t;
 
 // Tone channel
@@ -156,11 +189,26 @@ typedef struct {
     ay38910psg_env_t env;                             // Envelope generator
 
     // Sample generation
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    int32_t volumes[16];  // Volume table scaled by the magnitude, Q15 with 4 extra fraction bits
+    int32_t sample;       // Q15
+    int32_t dcadj_sum;
+    uint32_t dcadj_pos;
+    int32_t dcadj_buf[AY38910PSG_DCADJ_BUFLEN];
+#else
     float mag;
     float sample;
     float dcadj_sum;
     uint32_t dcadj_pos;
     float dcadj_buf[AY38910PSG_DCADJ_BUFLEN];
+#endif
+
+    // Lazy update
+    uint32_t tick;         // First system tick not yet processed
+    uint32_t next_sample;  // System tick of the next sample
+    uint32_t sample_ticks;
+    int num_samples;
+    int16_t samples[AY38910PSG_MAX_SAMPLES];
 } ay38910psg_t;
 
 // Initialize AY-3-8910 instance
@@ -179,11 +227,37 @@ uint8_t ay38910psg_read(ay38910psg_t* c);
 void ay38910psg_write(ay38910psg_t* c, uint8_t data);
 
 void ay38910psg_latch_address(ay38910psg_t* c, uint8_t data);
-
+// Lazy update: process all system ticks before 'tick', call before writing a register
+void ay38910psg_update(ay38910psg_t* c, uint32_t tick);
+// Lazy update: process all system ticks before 'tick' and copy the generated samples to 'out'
+int ay38910psg_flush(ay38910psg_t* c, uint32_t tick, int16_t* out, int max_samples);
+
+// Get the current sample as unsigned 8-bit value (clamped)
+static inline uint8_t ay38910psg_sample_u8(const ay38910psg_t* c) {
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    const int32_t s = (c->sample * 255) >> 15;
+#else
+    const int32_t s = (int32_t)(c->sample * 255.0f);
+#endif
+    return (uint8_t)((s < 0) ? 0 : ((s > 255) ? 255 : s));
+}
+// Get the current sample as signed 16-bit value (clamped)
+static inline int16_t ay38910psg_sample_s16(const ay38910psg_t* c) {
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    const int32_t s = c->sample;
+#else
+    const int32_t s = (int32_t)(c->sample * 32767.0f);
+#endif
+    return (int16_t)((s < -32768) ? -32768 : ((s > 32767) ? 32767 : s));
+}
 // Prepare ay38910psg_t snapshot for saving
 void ay38910psg_snapshot_onsave(ay38910psg_t* snapshot);
 // Fixup ay38910psg_t snapshot after loading
 void ay38910psg_snapshot_onload(ay38910psg_t* snapshot, ay38910psg_t* sys);
+// Write the PSG state chunk to a state file
+void ay38910psg_save_state(const ay38910psg_t* c, chips_state_writer_t* w);
+// Read the current state file chunk (AY38910PSG_STATE_ID), returns false if it's invalid
+bool ay38910psg_load_state(ay38910psg_t* c, chips_state_reader_t* r);
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -218,6 +292,11 @@ static const uint8_t _ay38910psg_reg_mask[AY38910PSG_NUM_REGISTERS] = {
 };
 
 // Volume table from: https://github.com/true-grue/ayumi/blob/master/ayumi.c
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+// Same table in Q15 with 4 extra fraction bits, so that the rounding errors of three channels stay well below 1 LSB
+static const int32_t _ay38910psg_volumes[16] = {0,     5240,   7576,   11040,  16096,  23880,  33815,  56287,
+                                                66367, 107470, 153198, 195469, 258220, 333083, 422346, 524272};
+#else
 static const float _ay38910psg_volumes[16] = {0.0f,
                                               0.00999465934234f,
                                               0.0144502937362f,
@@ -234,6 +313,7 @@ static const float _ay38910psg_volumes[16] = {0.0f,
                                               0.635324635691f,
                                               0.805584802014f,
                                               1.0f};
+#endif
 
 // Canned envelope generator shapes
 static const uint8_t _ay38910psg_shapes[16][32] = {
@@ -268,19 +348,6 @@ static const uint8_t _ay38910psg_shapes[16][32] = {
     {15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0},
 };
 
-// DC adjustment filter from StSound, this moves an "offcenter"
-// signal back to the zero-line (e.g. the volume-level output
-// from the chip simulation which is >0.0 gets converted to
-// a +/- sample value)
-
-static float _ay38910psg_dcadjust(ay38910psg_t* c, float s) {
-    c->dcadj_sum -= c->dcadj_buf[c->dcadj_pos];
-    c->dcadj_sum += s;
-    c->dcadj_buf[c->dcadj_pos] = s;
-    c->dcadj_pos = (c->dcadj_pos + 1) & (AY38910PSG_DCADJ_BUFLEN - 1);
-    return s - (c->dcadj_sum / AY38910PSG_DCADJ_BUFLEN);
-}
-
 // Update computed values after registers have been reprogrammed
 static void _ay38910psg_update_values(ay38910psg_t* c) {
     for (int i = 0; i < AY38910PSG_NUM_CHANNELS; i++) {
@@ -329,7 +396,17 @@ void ay38910psg_init(ay38910psg_t* c, const ay38910psg_desc_t* desc) {
     c->user_data = desc->user_data;
     c->type = desc->type;
     c->noise.rng = 1;
+    c->sample_ticks = (uint32_t)desc->sample_ticks;
+    c->next_sample = c->sample_ticks - 1;
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    // Fold the magnitude into the volume table, 1.0 is exactly 32768 so the default magnitude is lossless
+    const int64_t mag = (int64_t)(desc->magnitude * 32768.0f);
+    for (int i = 0; i < 16; i++) {
+        c->volumes[i] = (int32_t)((_ay38910psg_volumes[i] * mag) >> 15);
+    }
+#else
     c->mag = desc->magnitude;
+#endif
     _ay38910psg_update_values(c);
     _ay38910psg_restart_env_shape(c);
 }
@@ -388,24 +465,125 @@ void ay38910psg_tick_envelope_generator(ay38910psg_t* c) {
 }
 
 void ay38910psg_tick_sample_generator(ay38910psg_t* c) {
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    int32_t sm = 0;
+#else
     float sm = 0.0f;
+#endif
     for (int i = 0; i < AY38910PSG_NUM_CHANNELS; i++) {
         const ay38910psg_tone_t* chn = &c->tone[i];
         int vol_enable = (chn->bit | chn->tone_disable) & ((c->noise.rng & 1) | (chn->noise_disable));
         if (vol_enable) {
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+            int32_t vol;
+#else
             float vol;
+#endif
             if (0 == (c->reg[AY38910PSG_REG_AMP_A + i] & (1 << 4))) {
                 // Fixed amplitude
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+                vol = c->volumes[c->reg[AY38910PSG_REG_AMP_A + i] & 0x0F];
+#else
                 vol = _ay38910psg_volumes[c->reg[AY38910PSG_REG_AMP_A + i] & 0x0F];
+#endif
             } else {
                 // Envelope control
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+                vol = c->volumes[c->env.shape_state];
+#else
                 vol = _ay38910psg_volumes[c->env.shape_state];
+#endif
             }
             sm += vol;
         }
     }
-    // c->sample = _ay38910psg_dcadjust(c, sm) * c->mag;
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    c->sample = sm >> 4;
+#else
     c->sample = sm * c->mag;
+#endif
+}
+
+// Number of multiples of 'step' (2^N) in the tick range [from, to)
+static uint32_t _ay38910psg_num_steps(uint32_t from, uint32_t to, uint32_t step) {
+    const uint32_t span = to - from;
+    const uint32_t offset = ((from + step - 1) & ~(step - 1)) - from;
+    return (span > offset) ? (((span - offset - 1) / step) + 1) : 0;
+}
+
+// Advance a period counter by 'n' steps, return number of times the period elapsed
+static uint32_t _ay38910psg_advance_counter(uint16_t* counter, uint16_t period, uint32_t n) {
+    // same as n times: counter += 8; if (counter >= period) { counter = 0; elapsed++; }
+    const uint32_t first = (*counter >= period) ? 1 : (((uint32_t)(period - *counter) + 7) / 8);
+    if (n < first) {
+        *counter += (uint16_t)(8 * n);
+        return 0;
+    }
+    n -= first;
+    const uint32_t steps_per_period = ((uint32_t)period + 7) / 8;
+    *counter = (uint16_t)(8 * (n % steps_per_period));
+    return 1 + (n / steps_per_period);
+}
+
+// Advance tone, noise and envelope generators over the tick range [c->tick, tick)
+static void _ay38910psg_advance(ay38910psg_t* c, uint32_t tick) {
+    const uint32_t n = _ay38910psg_num_steps(c->tick, tick, AY38910PSG_CHANNEL_STEP_TICKS);
+    if (n > 0) {
+        for (int i = 0; i < AY38910PSG_NUM_CHANNELS; i++) {
+            ay38910psg_tone_t* chn = &c->tone[i];
+            chn->bit ^= _ay38910psg_advance_counter(&chn->counter, chn->period, n) & 1;
+        }
+        const uint32_t toggles = _ay38910psg_advance_counter(&c->noise.counter, c->noise.period, n);
+        // the random number generator is stepped on each 0 => 1 transition
+        for (uint32_t rising = (toggles + (c->noise.bit ? 0 : 1)) / 2; rising > 0; rising--) {
+            c->noise.rng ^= (((c->noise.rng & 1) ^ ((c->noise.rng >> 3) & 1)) << 17);
+            c->noise.rng >>= 1;
+        }
+        c->noise.bit ^= toggles & 1;
+    }
+    const uint32_t m = _ay38910psg_num_steps(c->tick, tick, AY38910PSG_ENV_STEP_TICKS);
+    if (m > 0) {
+        const uint32_t elapsed = _ay38910psg_advance_counter(&c->env.counter, c->env.period, m);
+        if (elapsed > 0) {
+            if (!c->env.shape_holding) {
+                uint32_t shape_counter = c->env.shape_counter + elapsed;
+                if (c->env.shape_hold) {
+                    const uint32_t to_end = (c->env.shape_counter == 0x1F) ? 0x20 : (0x1F - c->env.shape_counter);
+                    if (elapsed >= to_end) {
+                        shape_counter = 0x1F;
+                        c->env.shape_holding = true;
+                    }
+                }
+                c->env.shape_counter = (uint8_t)(shape_counter & 0x1F);
+            }
+            c->env.shape_state = _ay38910psg_shapes[c->env_shape_cycle][c->env.shape_counter];
+        }
+    }
+    c->tick = tick;
+}
+
+void ay38910psg_update(ay38910psg_t* c, uint32_t tick) {
+    CHIPS_ASSERT(c && (c->sample_ticks > 0));
+    // generate a sample at each sample point in [c->tick, tick)
+    while ((uint32_t)(c->next_sample - c->tick) < (uint32_t)(tick - c->tick)) {
+        _ay38910psg_advance(c, c->next_sample + 1);
+        ay38910psg_tick_sample_generator(c);
+        CHIPS_ASSERT(c->num_samples < AY38910PSG_MAX_SAMPLES);
+        c->samples[c->num_samples++] = ay38910psg_sample_s16(c);
+        c->next_sample += c->sample_ticks;
+    }
+    _ay38910psg_advance(c, tick);
+}
+
+int ay38910psg_flush(ay38910psg_t* c, uint32_t tick, int16_t* out, int max_samples) {
+    CHIPS_ASSERT(c && out);
+    ay38910psg_update(c, tick);
+    CHIPS_ASSERT(c->num_samples <= max_samples);
+    (void)max_samples;
+    const int num_samples = c->num_samples;
+    memcpy(out, c->samples, (size_t)num_samples * sizeof(int16_t));
+    c->num_samples = 0;
+    return num_samples;
 }
 
 uint8_t ay38910psg_read(ay38910psg_t* c) {
@@ -505,4 +683,51 @@ void ay38910psg_snapshot_onload(ay38910psg_t* snapshot, ay38910psg_t* sys) {
     snapshot->out_cb = sys->out_cb;
     snapshot->user_data = sys->user_data;
 }
+
+void ay38910psg_save_state(const ay38910psg_t* c, chips_state_writer_t* w) {
+    CHIPS_ASSERT(c && w);
+    chips_state_begin_chunk(w, AY38910PSG_STATE_ID, 1);
+    chips_state_put8(w, c->addr);
+    chips_state_put_bytes(w, c->reg, AY38910PSG_NUM_REGISTERS);
+    for (int i = 0; i < AY38910PSG_NUM_CHANNELS; i++) {
+        chips_state_put16(w, c->tone[i].counter);
+        chips_state_put8(w, (uint8_t)c->tone[i].bit);
+    }
+    chips_state_put16(w, c->noise.counter);
+    chips_state_put32(w, c->noise.rng);
+    chips_state_put8(w, (uint8_t)c->noise.bit);
+    chips_state_put16(w, c->env.counter);
+    chips_state_put_bool(w, c->env.shape_holding);
+    chips_state_put_bool(w, c->env.shape_hold);
+    chips_state_put8(w, c->env.shape_counter);
+    chips_state_put8(w, c->env.shape_state);
+    chips_state_put32(w, c->tick);
+    chips_state_put32(w, c->next_sample);
+    chips_state_end_chunk(w);
+}
+
+bool ay38910psg_load_state(ay38910psg_t* c, chips_state_reader_t* r) {
+    CHIPS_ASSERT(c && r && (r->chunk_id == AY38910PSG_STATE_ID));
+    c->addr = chips_state_get8(r);
+    chips_state_get_bytes(r, c->reg, AY38910PSG_NUM_REGISTERS);
+    // Derive periods and enable bits from the registers
+    _ay38910psg_update_values(c);
+    for (int i = 0; i < AY38910PSG_NUM_CHANNELS; i++) {
+        c->tone[i].counter = chips_state_get16(r);
+        c->tone[i].bit = chips_state_get8(r) & 1;
+    }
+    c->noise.counter = chips_state_get16(r);
+    c->noise.rng = chips_state_get32(r);
+    c->noise.bit = chips_state_get8(r) & 1;
+    c->env.counter = chips_state_get16(r);
+    c->env.shape_holding = chips_state_get_bool(r);
+    c->env.shape_hold = chips_state_get_bool(r);
+    c->env.shape_counter = chips_state_get8(r) & 0x1F;
+    c->env.shape_state = chips_state_get8(r);
+    c->tick = chips_state_get32(r);
+    c->next_sample = chips_state_get32(r);
+    // Samples generated before loading belong to the old timeline
+    c->num_samples = 0;
+    return r->ok;
+}
 #endif  // CHIPS_IMPL
@@ -2,7 +2,27 @@
 
 // beeper.h
 //
-// Simple square-wave beeper
+// Square-wave beeper with band-limited (BLEP) synthesis
+//
+// Instead of ticking the beeper every CPU cycle, state changes are recorded
+// with a timestamp in system ticks via beeper_set() / beeper_toggle(). The
+// recorded edges are turned into band-limited steps (windowed-sinc table) and
+// integrated into output samples when beeper_flush() is called, typically once
+// per block of a few hundred system ticks. Between edges the beeper costs
+// nothing, and the output has no aliasing from quantizing edges to samples.
+//
+// NOTE: beeper_flush() must be called at least every
+// (BEEPER_ACCUM_LEN - BEEPER_BLEP_WIDTH - 2) output samples.
+//
+// Define CHIPS_AUDIO_FIXEDPOINT before including this header to run the
+// synthesis with integer math on targets without an FPU. Samples are
+// then int16_t in the range 0..32767 instead of float 0.0..1.0, use
+// beeper_sample_u8() / beeper_sample_s16() to convert in either build.
+//
+// beeper_save_state() / beeper_load_state() write and read a chunk of a
+// portable state file (include chips/chips_common.h before this header).
+// Only the beeper state and sample clock are stored, the band-limiting
+// filter starts from a settled level after loading.
 //
 // ## zlib/libpng license
 //
@@ -29,10 +49,26 @@
 extern "C" {
 #endif
 
-// Error-accumulation precision boost
-#define BEEPER_FIXEDPOINT_SCALE (16)
+// Number of sub-sample phases in the band-limited step table
+#define BEEPER_BLEP_PHASES (32)
+// Filter width in output samples (must be even)
+#define BEEPER_BLEP_WIDTH (16)
+// Max number of edges recorded between two flushes
+#define BEEPER_MAX_EDGES (64)
+// Accumulation ring buffer size in output samples (must be 2^N)
+#define BEEPER_ACCUM_LEN (128)
 // DC adjust buffer size
 #define BEEPER_DCADJ_BUFLEN (512)
+// State file chunk id
+#define BEEPER_STATE_ID CHIPS_STATE_ID('B', 'E', 'E', 'P')
+
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+typedef int32_t beeper_level_t;   // 1/16 of a sample LSB, 1.0 is 32767 << 4
+typedef int16_t beeper_sample_t;  // Q15, 0 to 32767
+#else
+typedef float beeper_level_t;
+typedef float beeper_sample_t;  // 0.0 to 1.0
+#endif
 
 // Initialization parameters
 typedef struct {
@@ -41,31 +77,91 @@ typedef struct {
     float base_volume;
 } beeper_desc_t;
 
+// A recorded state change
+typedef struct {
+    uint32_t tick;
+    int state;
+} beeper_edge_t;
+
 // Beeper state
 typedef struct {
     int state;
-    int period;
-    int counter;
-    float base_volume;
-    float volume;
-    float sample;
-    float dcadj_sum;
+    int tick_hz;
+    int sound_hz;
+    beeper_level_t base_volume;
+    beeper_level_t volume;
+    beeper_sample_t sample;
+    // system tick of the last flush
+    uint32_t last_tick;
+    // distance from last_tick to the next output sample in 1/(tick_hz*sound_hz) units
+    uint32_t phase;
+    // level of the last processed edge (before band-limiting)
+    beeper_level_t step_level;
+    // current integrated output level
+    beeper_level_t level;
+    int num_edges;
+    beeper_edge_t edges[BEEPER_MAX_EDGES];
+    uint32_t accum_pos;
+    beeper_level_t accum[BEEPER_ACCUM_LEN];
+    beeper_level_t dcadj_sum;
     uint32_t dcadj_pos;
-    float dcadj_buf[BEEPER_DCADJ_BUFLEN];
+    beeper_level_t dcadj_buf[BEEPER_DCADJ_BUFLEN];
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    // band-limited step table scaled to the height 'blep_delta', rebuilt when the volume changes
+    int32_t blep_delta;
+    int32_t blep[BEEPER_BLEP_PHASES][BEEPER_BLEP_WIDTH];
+#endif
 } beeper_t;
 
 // Initialize beeper instance
 void beeper_init(beeper_t* beeper, const beeper_desc_t* desc);
 // Reset the beeper instance
 void beeper_reset(beeper_t* beeper);
-// Set current on/off state
-static inline void beeper_set(beeper_t* beeper, bool state) { beeper->state = state ? 1 : 0; }
-// Toggle current state (on->off or off->on)
-static inline void beeper_toggle(beeper_t* beeper) { beeper->state = !beeper->state; }
+// Record an edge (internal, called by beeper_set/beeper_toggle)
+void beeper_record_edge(beeper_t* beeper, uint32_t tick);
+// Set current on/off state at system tick 'tick'
+static inline void beeper_set(beeper_t* beeper, bool state, uint32_t tick) {
+    if (beeper->state != (state ? 1 : 0)) {
+        beeper->state = state ? 1 : 0;
+        beeper_record_edge(beeper, tick);
+    }
+}
+// Toggle current state (on->off or off->on) at system tick 'tick'
+static inline void beeper_toggle(beeper_t* beeper, uint32_t tick) {
+    beeper->state = !beeper->state;
+    beeper_record_edge(beeper, tick);
+}
 // Set current volume 0.0 to 1.0
-static inline void beeper_set_volume(beeper_t* beeper, float vol) { beeper->volume = vol; }
-// Tick the beeper, return true if a new sample is ready
-bool beeper_tick(beeper_t* beeper);
+static inline void beeper_set_volume(beeper_t* beeper, float vol) {
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    // the fixed-point volume is the step height, including the base volume
+    beeper->volume = (int32_t)(vol * (float)beeper->base_volume + 0.5f);
+#else
+    beeper->volume = vol;
+#endif
+}
+// Generate all samples up to system tick 'tick', return number of samples written to 'out'
+int beeper_flush(beeper_t* beeper, uint32_t tick, beeper_sample_t* out, int max_samples);
+// Write the beeper state chunk to a state file
+void beeper_save_state(const beeper_t* beeper, chips_state_writer_t* w);
+// Read the current state file chunk (BEEPER_STATE_ID), returns false if it's invalid
+bool beeper_load_state(beeper_t* beeper, chips_state_reader_t* r);
+// Convert a sample to unsigned 8-bit
+static inline uint8_t beeper_sample_u8(beeper_sample_t s) {
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    return (uint8_t)((s * 255) >> 15);
+#else
+    return (uint8_t)(s * 255.0f);
+#endif
+}
+// Convert a sample to signed 16-bit
+static inline int16_t beeper_sample_s16(beeper_sample_t s) {
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    return s;
+#else
+    return (int16_t)(s * 32767.0f);
+#endif
+}
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -73,52 +169,221 @@ bool beeper_tick(beeper_t* beeper);
 /*-- IMPLEMENTATION ----------------------------------------------------------*/
 #ifdef CHIPS_IMPL
 #include <string.h>
+#include <math.h>
 #ifndef CHIPS_ASSERT
 #include <assert.h>
 #define CHIPS_ASSERT(c) assert(c)
 #endif
 
+#define _BEEPER_PI (3.14159265358979f)
+
+// Band-limited impulse table, one row per sub-sample phase, each row sums to 1 (Q30 in fixed-point builds)
+static beeper_level_t _beeper_blep[BEEPER_BLEP_PHASES][BEEPER_BLEP_WIDTH];
+static bool _beeper_blep_valid;
+
+// Blackman-windowed sinc, cutoff slightly below Nyquist
+static void _beeper_init_blep(void) {
+    const float cutoff = 0.9f;
+    const float half_width = (float)(BEEPER_BLEP_WIDTH / 2);
+    for (int ph = 0; ph < BEEPER_BLEP_PHASES; ph++) {
+        const float frac = (float)ph / BEEPER_BLEP_PHASES;
+        float taps[BEEPER_BLEP_WIDTH];
+        float sum = 0.0f;
+        for (int i = 0; i < BEEPER_BLEP_WIDTH; i++) {
+            // distance of this tap from the kernel center in samples
+            const float x = (1.0f - frac) + (float)i - half_width;
+            const float sx = _BEEPER_PI * cutoff * x;
+            const float sinc = (fabsf(sx) < 1.0e-6f) ? 1.0f : sinf(sx) / sx;
+            float window = 0.0f;
+            if (fabsf(x) < half_width) {
+                window = 0.42f + 0.5f * cosf(_BEEPER_PI * x / half_width) +
+                         0.08f * cosf(2.0f * _BEEPER_PI * x / half_width);
+            }
+            taps[i] = sinc * window;
+            sum += taps[i];
+        }
+        for (int i = 0; i < BEEPER_BLEP_WIDTH; i++) {
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+            _beeper_blep[ph][i] = (int32_t)(taps[i] / sum * 1073741824.0f + ((taps[i] < 0.0f) ? -0.5f : 0.5f));
+#else
+            _beeper_blep[ph][i] = taps[i] / sum;
+#endif
+        }
+    }
+    _beeper_blep_valid = true;
+}
+
 void beeper_init(beeper_t* b, const beeper_desc_t* desc) {
     CHIPS_ASSERT(b && desc);
-    CHIPS_ASSERT((desc->tick_hz > 0) && (desc->sound_hz > 0));
+    CHIPS_ASSERT((desc->tick_hz > 0) && (desc->sound_hz > 0) && (desc->sound_hz < desc->tick_hz));
+    if (!_beeper_blep_valid) {
+        _beeper_init_blep();
+    }
     *b = (beeper_t){
-        .period = (desc->tick_hz * BEEPER_FIXEDPOINT_SCALE) / desc->sound_hz,
-        .counter = b->period,
+        .tick_hz = desc->tick_hz,
+        .sound_hz = desc->sound_hz,
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+        .base_volume = (int32_t)(desc->base_volume * (float)(32767 << 4) + 0.5f),
+        .volume = (int32_t)(desc->base_volume * (float)(32767 << 4) + 0.5f),
+#else
         .base_volume = desc->base_volume,
         .volume = 1.0f,
+#endif
     };
 }
 
 void beeper_reset(beeper_t* b) {
     CHIPS_ASSERT(b);
     b->state = 0;
-    b->counter = b->period;
     b->sample = 0;
+    b->step_level = 0;
+    b->level = 0;
+    b->num_edges = 0;
+    memset(b->accum, 0, sizeof(b->accum));
+}
+
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+// Scale the impulse table to the step height 'delta' (> 0), rounding the running sums so that
+// the partial steps stay within half a level unit and each row adds up to exactly 'delta'
+static void _beeper_scale_blep(beeper_t* b, int32_t delta) {
+    for (int ph = 0; ph < BEEPER_BLEP_PHASES; ph++) {
+        int64_t sum = 0;
+        int32_t prev = 0;
+        for (int i = 0; i < (BEEPER_BLEP_WIDTH - 1); i++) {
+            sum += _beeper_blep[ph][i];
+            const int32_t level = (int32_t)((sum * delta + (1 << 29)) >> 30);
+            b->blep[ph][i] = level - prev;
+            prev = level;
+        }
+        b->blep[ph][BEEPER_BLEP_WIDTH - 1] = delta - prev;
+    }
+    b->blep_delta = delta;
+}
+#endif
+
+// Add the band-limited steps of all recorded edges to the accumulation buffer
+static void _beeper_process_edges(beeper_t* b) {
+    const int64_t tick_hz = b->tick_hz;
+    for (int e = 0; e < b->num_edges; e++) {
+        const beeper_edge_t* edge = &b->edges[e];
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+        const int32_t target = edge->state ? b->volume : 0;
+#else
+        const float target = (float)edge->state * b->volume * b->base_volume;
+#endif
+        const beeper_level_t delta = target - b->step_level;
+        b->step_level = target;
+        // position of the edge relative to the next output sample, in 1/tick_hz samples
+        const int64_t pos = (int64_t)(uint32_t)(edge->tick - b->last_tick) * b->sound_hz - b->phase;
+        int64_t index = pos / tick_hz;
+        int64_t rem = pos - index * tick_hz;
+        if (rem < 0) {
+            index--;
+            rem += tick_hz;
+        }
+        CHIPS_ASSERT((index + 1 + BEEPER_BLEP_WIDTH) < BEEPER_ACCUM_LEN);
+        const int phase = (int)((rem * BEEPER_BLEP_PHASES) / tick_hz);
+        uint32_t p = b->accum_pos + (uint32_t)(index + 1);
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+        // the volume rarely changes, so all steps share one pre-scaled table and cost only adds
+        if (delta == 0) {
+            continue;
+        }
+        const int32_t height = (delta < 0) ? -delta : delta;
+        if (height != b->blep_delta) {
+            _beeper_scale_blep(b, height);
+        }
+        const int32_t* kernel = b->blep[phase];
+        if (delta > 0) {
+            for (int i = 0; i < BEEPER_BLEP_WIDTH; i++, p++) {
+                b->accum[p & (BEEPER_ACCUM_LEN - 1)] += kernel[i];
+            }
+        } else {
+            for (int i = 0; i < BEEPER_BLEP_WIDTH; i++, p++) {
+                b->accum[p & (BEEPER_ACCUM_LEN - 1)] -= kernel[i];
+            }
+        }
+#else
+        const float* kernel = _beeper_blep[phase];
+        for (int i = 0; i < BEEPER_BLEP_WIDTH; i++, p++) {
+            b->accum[p & (BEEPER_ACCUM_LEN - 1)] += delta * kernel[i];
+        }
+#endif
+    }
+    b->num_edges = 0;
 }
 
-// DC adjustment filter from StSound, this moves an "offcenter"
-// signal back to the zero-line (e.g. the volume-level output
-// from the chip simulation which is >0.0 gets converted to
-// a +/- sample value)
-
-static float _beeper_dcadjust(beeper_t* bp, float s) {
-    bp->dcadj_sum -= bp->dcadj_buf[bp->dcadj_pos];
-    bp->dcadj_sum += s;
-    bp->dcadj_buf[bp->dcadj_pos] = s;
-    bp->dcadj_pos = (bp->dcadj_pos + 1) & (BEEPER_DCADJ_BUFLEN - 1);
-    return s - (bp->dcadj_sum / BEEPER_DCADJ_BUFLEN);
+void beeper_record_edge(beeper_t* b, uint32_t tick) {
+    if (b->num_edges == BEEPER_MAX_EDGES) {
+        _beeper_process_edges(b);
+    }
+    b->edges[b->num_edges++] = (beeper_edge_t){.tick = tick, .state = b->state};
 }
 
-bool beeper_tick(beeper_t* bp) {
-    // Generate a new sample?
-    bp->counter -= BEEPER_FIXEDPOINT_SCALE;
-    if (bp->counter <= 0) {
-        bp->counter += bp->period;
-        // bp->sample = _beeper_dcadjust(bp, (float)bp->state * bp->volume * bp->base_volume);
-        bp->sample = (float)bp->state * bp->volume * bp->base_volume;
-        return true;
+int beeper_flush(beeper_t* b, uint32_t tick, beeper_sample_t* out, int max_samples) {
+    CHIPS_ASSERT(b && out);
+    _beeper_process_edges(b);
+    // number of output samples which lie before 'tick'
+    const int64_t span = (int64_t)(uint32_t)(tick - b->last_tick) * b->sound_hz;
+    int num_samples = 0;
+    if (span > (int64_t)b->phase) {
+        num_samples = (int)((span - b->phase + b->tick_hz - 1) / b->tick_hz);
+    }
+    CHIPS_ASSERT(num_samples <= max_samples);
+    CHIPS_ASSERT(num_samples < (BEEPER_ACCUM_LEN - BEEPER_BLEP_WIDTH - 1));
+    (void)max_samples;
+    for (int i = 0; i < num_samples; i++) {
+        b->level += b->accum[b->accum_pos];
+        b->accum[b->accum_pos] = 0;
+        b->accum_pos = (b->accum_pos + 1) & (BEEPER_ACCUM_LEN - 1);
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+        const int32_t max_level = 32767 << 4;
+#else
+        const float max_level = 1.0f;
+#endif
+        beeper_level_t s = b->level;
+        if (s < 0) {
+            s = 0;
+        } else if (s > max_level) {
+            s = max_level;
+        }
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+        out[i] = (beeper_sample_t)(s >> 4);
+#else
+        out[i] = (beeper_sample_t)s;
+#endif
     }
-    return false;
+    if (num_samples > 0) {
+        b->sample = out[num_samples - 1];
+    }
+    b->phase = (uint32_t)(b->phase + (int64_t)num_samples * b->tick_hz - span);
+    b->last_tick = tick;
+    return num_samples;
+}
+
+void beeper_save_state(const beeper_t* b, chips_state_writer_t* w) {
+    CHIPS_ASSERT(b && w);
+    chips_state_begin_chunk(w, BEEPER_STATE_ID, 1);
+    chips_state_put8(w, (uint8_t)b->state);
+    chips_state_put32(w, b->last_tick);
+    chips_state_put32(w, b->phase);
+    chips_state_end_chunk(w);
+}
+
+bool beeper_load_state(beeper_t* b, chips_state_reader_t* r) {
+    CHIPS_ASSERT(b && r && (r->chunk_id == BEEPER_STATE_ID));
+    beeper_reset(b);
+    b->state = chips_state_get8(r) ? 1 : 0;
+    b->last_tick = chips_state_get32(r);
+    b->phase = chips_state_get32(r);
+    // Start at the settled level of the loaded state
+#ifdef CHIPS_AUDIO_FIXEDPOINT
+    b->step_level = b->state ? b->volume : 0;
+#else
+    b->step_level = (float)b->state * b->volume * b->base_volume;
+#endif
+    b->level = b->step_level;
+    return r->ok;
 }
 
 #endif  // CHIPS_IMPL
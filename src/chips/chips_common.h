@@ -52,17 +52,121 @@ typedef struct {
         chips_dim_t dim;  // Framebuffer dimensions in pixels
         chips_range_t buffer;
         size_t bytes_per_pixel;  // 1 or 4
+        bool unchanged;          // Buffer content is the same as in the previous frame (upload may be skipped)
     } frame;
     chips_rect_t screen;
     chips_range_t palette;
     bool portrait;
 } chips_display_info_t;
 
+#define CHIPS_MAX_DIRTY_ROWS (256)
+
+// Framebuffer rows rendered since the set was last cleared (one bit per row)
+typedef struct {
+    uint32_t bits[CHIPS_MAX_DIRTY_ROWS / 32];
+} chips_dirty_rows_t;
+
 typedef struct {
     void (*func)(const uint8_t sample, void* user_data);
     void* user_data;
 } chips_audio_callback_t;
 
+// Sample formats for block audio callbacks
+typedef enum {
+    CHIPS_AUDIO_FORMAT_U8 = 0,  // uint8_t, 0 to 255
+    CHIPS_AUDIO_FORMAT_S16,     // int16_t, -32768 to 32767
+    CHIPS_AUDIO_FORMAT_FLOAT,   // float, -1.0 to 1.0
+} chips_audio_format_t;
+
+// Block audio callback, receives 'num_samples' samples in the format selected in chips_audio_desc_t
+typedef struct {
+    void (*func)(const void* samples, int num_samples, void* user_data);
+    void* user_data;
+} chips_audio_block_callback_t;
+
+// Scanline callback, called after a scanline has been rendered into the framebuffer
+typedef struct {
+    void (*func)(int line, void* user_data);
+    void* user_data;
+} chips_scanline_callback_t;
+
+// Reasons why an exec function stopped early (chips_breakpoints_t.stop_reason)
+#define CHIPS_STOP_NONE        (0)
+#define CHIPS_STOP_BREAKPOINT  (1)  // Instruction at a PC breakpoint is about to execute
+#define CHIPS_STOP_WATCH_READ  (2)  // Watched memory location was read
+#define CHIPS_STOP_WATCH_WRITE (3)  // Watched memory location was written
+
+// Watchpoint flags
+#define CHIPS_WATCH_READ  (1 << 0)
+#define CHIPS_WATCH_WRITE (1 << 1)
+
+#define CHIPS_MAX_WATCHPOINTS (8)
+
+typedef struct {
+    uint16_t addr;
+    uint32_t size;
+    uint8_t flags;  // CHIPS_WATCH_READ and/or CHIPS_WATCH_WRITE
+} chips_watchpoint_t;
+
+// Native breakpoints and watchpoints evaluated inside the exec loop
+typedef struct {
+    uint32_t pc_bits[(1 << 16) / 32];  // Execution breakpoint bitmap, one bit per address
+    int num_watchpoints;
+    chips_watchpoint_t watchpoints[CHIPS_MAX_WATCHPOINTS];
+    int stop_reason;     // Why the last exec stopped (CHIPS_STOP_*)
+    uint16_t stop_addr;  // Breakpoint address or address of the watched memory access
+} chips_breakpoints_t;
+
+// Stop conditions of the xxx_run_until() functions (chips_until_t.type)
+#define CHIPS_UNTIL_PC   (1)  // Instruction at 'addr' is about to execute
+#define CHIPS_UNTIL_MEM  (2)  // (Byte at 'addr' & 'mask') == 'value', as seen by the CPU
+#define CHIPS_UNTIL_TEXT (3)  // A line of the text screen contains 'text'
+#define CHIPS_UNTIL_IDLE (4)  // Guest polls the keyboard and no key is pending
+
+// System ticks between two text screen checks of CHIPS_UNTIL_TEXT
+#define CHIPS_UNTIL_TEXT_TICKS (16384)
+
+typedef struct {
+    int type;  // CHIPS_UNTIL_*
+    uint16_t addr;
+    uint8_t value;
+    uint8_t mask;
+    const char* text;
+} chips_until_t;
+
+// Guest idle loops (see xxx_run_ticks()): a loop iteration which starts and ends with the same CPU
+// state, only reads input switches and writes the same values as the iteration before is a fixed
+// point of the system, it repeats unchanged until an input changes and can be fast-forwarded.
+// Zero page counters incremented or decremented by each iteration (like RNDL in the Apple II KEYIN
+// loop) are advanced by the number of skipped iterations. A counter is only read by its own INC or
+// DEC, so the loop can only see it through the N and Z flags: skipping stops before the counter
+// would change its sign or reach zero, and the iteration which does that runs normally.
+#define CHIPS_IDLE_MAX_TICKS  (256)  // Max ticks of an iteration
+#define CHIPS_IDLE_MAX_WRITES (8)    // Max memory writes of an iteration
+#define CHIPS_IDLE_MAX_READS  (8)    // Max zero page reads of an iteration
+#define CHIPS_IDLE_MAX_MISSES (16)   // Max clean iterations in a row which don't repeat
+
+// Idle loop detector, fed with the memory accesses of each tick
+typedef struct {
+    uint16_t head;        // Loop head: target of a backward jump
+    uint16_t pc;          // Address of the last opcode fetch
+    uint32_t head_tick;   // System tick of the last opcode fetch at the loop head
+    uint32_t period;      // Ticks of the last iteration
+    bool tracking;        // Current iteration only polled inputs so far
+    bool clean;           // Last iteration only polled inputs
+    uint8_t num_repeats;  // Consecutive clean iterations which did the same as the one before
+    uint8_t num_misses;   // Consecutive clean iterations which didn't
+    uint8_t num_writes;
+    uint8_t num_last_writes;
+    uint8_t num_reads;    // Zero page reads of the current iteration, CHIPS_IDLE_MAX_READS + 1 if too many
+    uint8_t counters;     // Bit mask of the last writes which increment or decrement a zero page counter
+    uint8_t down;         // Bit mask of the counters which are decremented
+    uint8_t max_skip;     // Iterations which can be skipped before a counter changes its N or Z flag
+    uint32_t writes[CHIPS_IDLE_MAX_WRITES];       // (addr << 8) | data of the current iteration
+    uint32_t last_writes[CHIPS_IDLE_MAX_WRITES];  // (addr << 8) | data of the last iteration
+    uint8_t reads[CHIPS_IDLE_MAX_READS];          // Zero page addresses read by the current iteration
+} chips_idle_t;
+
 typedef void (*chips_debug_func_t)(void* user_data, uint64_t pins);
 typedef struct {
     struct {
@@ -70,18 +174,287 @@ typedef struct {
         void* user_data;
     } callback;
     bool* stopped;
+    chips_breakpoints_t* breakpoints;  // Optional breakpoints, checked without calling the debug callback
 } chips_debug_t;
 
 typedef struct {
-    chips_audio_callback_t callback;
+    chips_audio_callback_t callback;              // Per-sample callback (used if block_callback.func is 0)
+    chips_audio_block_callback_t block_callback;  // Block callback, called when 'buffer' is full or at end of exec
+    chips_audio_format_t format;                  // Sample format for block_callback
+    chips_range_t buffer;                         // Caller-provided sample buffer for block_callback
     int sample_rate;
     float volume;
 } chips_audio_desc_t;
 
+// Audio output state of a system, collects samples for the block callback
+typedef struct {
+    chips_audio_callback_t callback;
+    chips_audio_block_callback_t block_callback;
+    chips_audio_format_t format;
+    void* buffer;
+    int num_samples;  // Buffer capacity in samples
+    int pos;          // Number of samples in buffer
+} chips_audio_t;
+
+// Worst case size of RLE-encoded data (see chips_rle_encode())
+#define CHIPS_RLE_MAX_SIZE(len) ((len) + ((len) + 127) / 128)
+
+// Portable state files
+//
+// A state file is a header followed by a list of chunks, all values are
+// little endian, so files can be exchanged between the PC and RP2040 builds:
+//
+//     uint32_t magic      CHIPS_STATE_MAGIC
+//     uint32_t system     system id (CHIPS_STATE_ID)
+//     uint16_t version    CHIPS_STATE_VERSION
+//     chunks:
+//         uint32_t id         chunk id (CHIPS_STATE_ID)
+//         uint16_t version    chunk version
+//         uint32_t size       payload size
+//         uint8_t data[size]  payload
+//     end chunk (CHIPS_STATE_CHUNK_END, empty)
+//
+// A chunk payload is a sequence of explicitly sized fields written with the
+// chips_state_put*() functions. Readers skip unknown chunks and read fields
+// past the end of a chunk as zero, so fields can be appended to a chunk and
+// new chunks can be added without breaking older files.
+#define CHIPS_STATE_ID(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+#define CHIPS_STATE_MAGIC          CHIPS_STATE_ID('R', 'R', 'S', 'S')
+#define CHIPS_STATE_VERSION        (1)
+#define CHIPS_STATE_HEADER_SIZE    (10)
+#define CHIPS_STATE_CHUNK_HEADER   (10)
+#define CHIPS_STATE_CHUNK_END      CHIPS_STATE_ID('E', 'N', 'D', ' ')
+#define CHIPS_STATE_MAX_CHUNK_SIZE (6144)  // Fits a RLE-encoded 6 KB disk track
+#define CHIPS_STATE_BLOCK_SIZE     (4096)  // Memory is stored in chunks of this many bytes
+
+// Stream output callback, returns false on write error
+typedef bool (*chips_state_write_t)(const void* data, size_t size, void* user_data);
+
+// State file writer, collects one chunk in a caller-owned buffer and passes it to the write callback when the chunk
+// is complete
+typedef struct {
+    chips_state_write_t write;
+    void* user_data;
+    bool ok;  // False after a write error or chunk overflow
+    uint32_t chunk_id;
+    uint16_t chunk_version;
+    uint8_t* buf;  // Payload of the current chunk (CHIPS_STATE_MAX_CHUNK_SIZE bytes)
+    size_t pos;    // Size of the current chunk payload
+} chips_state_writer_t;
+
+// State file reader, reads from a memory buffer
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    size_t pos;  // Offset of the next chunk header
+    bool ok;     // False after invalid chunk data was read
+    uint32_t chunk_id;
+    uint16_t chunk_version;
+    const uint8_t* chunk;  // Payload of the current chunk
+    size_t chunk_size;
+    size_t chunk_pos;  // Read position in the current chunk
+} chips_state_reader_t;
+
+// Initialize audio output from the system's audio desc
+void chips_audio_init(chips_audio_t* audio, const chips_audio_desc_t* desc);
+// Deliver the samples collected so far to the block callback
+void chips_audio_flush(chips_audio_t* audio);
+// Push a sample given as signed 16-bit value
+static inline void chips_audio_push(chips_audio_t* audio, int16_t sample) {
+    if (audio->block_callback.func) {
+        switch (audio->format) {
+            case CHIPS_AUDIO_FORMAT_U8:
+                ((uint8_t*)audio->buffer)[audio->pos] = (uint8_t)((sample < 0) ? 0 : (sample >> 7));
+                break;
+            case CHIPS_AUDIO_FORMAT_S16:
+                ((int16_t*)audio->buffer)[audio->pos] = sample;
+                break;
+            case CHIPS_AUDIO_FORMAT_FLOAT:
+                ((float*)audio->buffer)[audio->pos] = (float)sample * (1.0f / 32768.0f);
+                break;
+        }
+        if (++audio->pos == audio->num_samples) {
+            chips_audio_flush(audio);
+        }
+    } else if (audio->callback.func) {
+        audio->callback.func((uint8_t)((sample < 0) ? 0 : (sample >> 7)), audio->callback.user_data);
+    }
+}
+
+// Set an execution breakpoint
+static inline void chips_breakpoint_set(chips_breakpoints_t* bp, uint16_t pc) {
+    bp->pc_bits[pc >> 5] |= 1U << (pc & 31);
+}
+// Clear an execution breakpoint
+static inline void chips_breakpoint_clear(chips_breakpoints_t* bp, uint16_t pc) {
+    bp->pc_bits[pc >> 5] &= ~(1U << (pc & 31));
+}
+// Test for an execution breakpoint
+static inline bool chips_breakpoint_test(const chips_breakpoints_t* bp, uint16_t pc) {
+    return 0 != (bp->pc_bits[pc >> 5] & (1U << (pc & 31)));
+}
+// Mark a framebuffer row as dirty
+static inline void chips_dirty_rows_set(chips_dirty_rows_t* d, int row) {
+    d->bits[row >> 5] |= 1U << (row & 31);
+}
+// Test if a framebuffer row is dirty
+static inline bool chips_dirty_rows_test(const chips_dirty_rows_t* d, int row) {
+    return 0 != (d->bits[row >> 5] & (1U << (row & 31)));
+}
+// Test if any framebuffer row is dirty
+static inline bool chips_dirty_rows_any(const chips_dirty_rows_t* d) {
+    uint32_t any = 0;
+    for (size_t i = 0; i < CHIPS_ARRAY_SIZE(d->bits); i++) {
+        any |= d->bits[i];
+    }
+    return 0 != any;
+}
+// Mark all framebuffer rows as dirty
+static inline void chips_dirty_rows_set_all(chips_dirty_rows_t* d) {
+    for (size_t i = 0; i < CHIPS_ARRAY_SIZE(d->bits); i++) {
+        d->bits[i] = ~0U;
+    }
+}
+// Mark all framebuffer rows as clean
+static inline void chips_dirty_rows_clear(chips_dirty_rows_t* d) {
+    for (size_t i = 0; i < CHIPS_ARRAY_SIZE(d->bits); i++) {
+        d->bits[i] = 0;
+    }
+}
+// Forget the current loop iteration, inputs may have changed
+static inline void chips_idle_reset(chips_idle_t* idle) {
+    idle->tracking = false;
+    idle->clean = false;
+    idle->num_repeats = 0;
+    idle->num_misses = 0;
+}
+// Feed a memory access which isn't an opcode fetch (only needed while 'tracking' is true),
+// 'io' is true for I/O with side effects and for inputs which may change before the next event
+static inline void chips_idle_access(chips_idle_t* idle, uint16_t addr, bool rw, uint8_t data, bool io) {
+    if (io) {
+        idle->tracking = false;
+    } else if (!rw) {
+        if (idle->num_writes < CHIPS_IDLE_MAX_WRITES) {
+            idle->writes[idle->num_writes++] = ((uint32_t)addr << 8) | data;
+        } else {
+            idle->tracking = false;
+        }
+    } else if ((addr < 0x100) && (idle->num_reads <= CHIPS_IDLE_MAX_READS)) {
+        if (idle->num_reads < CHIPS_IDLE_MAX_READS) {
+            idle->reads[idle->num_reads] = (uint8_t)addr;
+        }
+        idle->num_reads++;
+    }
+}
+// Opcode fetch at the loop head or a new loop candidate (see chips_idle_fetch())
+bool chips_idle_head(chips_idle_t* idle, uint16_t pc, uint32_t tick);
+// Feed an opcode fetch, returns true at the loop head after an iteration which did the same as the one
+// before, the caller then saves the CPU state and compares it with the saved one if 'num_repeats' > 1
+static inline bool chips_idle_fetch(chips_idle_t* idle, uint16_t pc, uint32_t tick) {
+    const uint16_t last_pc = idle->pc;
+    idle->pc = pc;
+    if (pc == idle->head) {
+        if (idle->num_misses >= CHIPS_IDLE_MAX_MISSES) {
+            // Loop is not tracked any further
+            idle->head_tick = tick;
+            return false;
+        }
+    } else if ((pc >= last_pc) || ((tick - idle->head_tick) <= CHIPS_IDLE_MAX_TICKS)) {
+        return false;
+    }
+    return chips_idle_head(idle, pc, tick);
+}
+// Iterations of a fixed point loop which fit in 'max_ticks' ticks and keep the flags of the zero page counters
+static inline uint32_t chips_idle_iterations(const chips_idle_t* idle, uint32_t max_ticks) {
+    const uint32_t n = max_ticks / idle->period;
+    return (idle->counters && (n > idle->max_skip)) ? idle->max_skip : n;
+}
+// Value of the counter written by last write 'i' after skipping 'n' iterations
+static inline uint8_t chips_idle_counter(const chips_idle_t* idle, int i, uint32_t n) {
+    const uint32_t w = idle->last_writes[i];
+    return (uint8_t)((idle->down & (1U << i)) ? (w - n) : (w + n));
+}
+// Iterations out of 'n' which can be skipped before a zero page counter meets the run-until condition 'cond'
+static inline uint32_t chips_idle_until_iterations(const chips_idle_t* idle, const chips_until_t* cond, uint32_t n) {
+    if (cond->type != CHIPS_UNTIL_MEM) {
+        return n;
+    }
+    for (int i = 0; i < idle->num_last_writes; i++) {
+        if ((idle->counters & (1U << i)) && ((idle->last_writes[i] >> 8) == cond->addr)) {
+            for (uint32_t k = 1; k <= n; k++) {
+                if ((chips_idle_counter(idle, i, k) & cond->mask) == cond->value) {
+                    // The iteration which writes the value runs normally
+                    n = k - 1;
+                    break;
+                }
+            }
+        }
+    }
+    return n;
+}
+// Add a watchpoint, returns false if all watchpoint slots are used
+bool chips_watchpoint_add(chips_breakpoints_t* bp, uint16_t addr, uint32_t size, uint8_t flags);
+// Remove all watchpoints
+void chips_watchpoint_clear_all(chips_breakpoints_t* bp);
+// Test a memory access against the watchpoints, returns CHIPS_STOP_WATCH_* or CHIPS_STOP_NONE
+int chips_watchpoint_test(const chips_breakpoints_t* bp, uint16_t addr, bool rw);
+
+// RLE-encode 'len' bytes, 'dst' must have room for CHIPS_RLE_MAX_SIZE(len) bytes, returns encoded size
+int chips_rle_encode(const uint8_t* src, int len, uint8_t* dst);
+// RLE-decode into exactly 'len' bytes, returns false if the data is invalid
+bool chips_rle_decode(const uint8_t* src, int size, uint8_t* dst, int len);
+
+// Start a state file, writes the header, 'buffer' collects the chunks (at least CHIPS_STATE_MAX_CHUNK_SIZE bytes)
+void chips_state_writer_init(chips_state_writer_t* w, uint32_t system_id, chips_range_t buffer,
+                             chips_state_write_t write, void* user_data);
+// Start a new chunk
+void chips_state_begin_chunk(chips_state_writer_t* w, uint32_t id, uint16_t version);
+// Append fields to the current chunk
+void chips_state_put8(chips_state_writer_t* w, uint8_t v);
+void chips_state_put16(chips_state_writer_t* w, uint16_t v);
+void chips_state_put32(chips_state_writer_t* w, uint32_t v);
+void chips_state_put_bool(chips_state_writer_t* w, bool v);
+void chips_state_put_bytes(chips_state_writer_t* w, const void* src, size_t size);
+// Append 'len' bytes RLE-encoded, must be the last field of a chunk
+void chips_state_put_rle(chips_state_writer_t* w, const uint8_t* src, int len);
+// Complete the current chunk and pass it to the write callback
+void chips_state_end_chunk(chips_state_writer_t* w);
+// Write a memory range as one chunk per CHIPS_STATE_BLOCK_SIZE block, blocks holding the power-on fill pattern are
+// skipped ('fill' low byte at even, high byte at odd offsets)
+void chips_state_put_memory(chips_state_writer_t* w, uint32_t id, const uint8_t* mem, size_t size, uint16_t fill);
+// Complete the state file, returns false if anything could not be written
+bool chips_state_writer_finish(chips_state_writer_t* w);
+
+// Start reading a state file, returns false if the header or chunk list is invalid or the system id doesn't match
+bool chips_state_reader_init(chips_state_reader_t* r, const void* data, size_t size, uint32_t system_id);
+// Advance to the next chunk, returns false at the end of the file
+bool chips_state_next_chunk(chips_state_reader_t* r);
+// Read fields from the current chunk, fields past the end of the chunk read as zero
+uint8_t chips_state_get8(chips_state_reader_t* r);
+uint16_t chips_state_get16(chips_state_reader_t* r);
+uint32_t chips_state_get32(chips_state_reader_t* r);
+bool chips_state_get_bool(chips_state_reader_t* r);
+void chips_state_get_bytes(chips_state_reader_t* r, void* dst, size_t size);
+// Read a field written with chips_state_put_rle(), returns false if it's invalid
+bool chips_state_get_rle(chips_state_reader_t* r, uint8_t* dst, int len);
+// Read a chunk written with chips_state_put_memory(), returns false if it's invalid
+bool chips_state_get_memory(chips_state_reader_t* r, uint8_t* mem, size_t size, uint16_t fill);
+// Fill a memory range with the power-on fill pattern (missing blocks of chips_state_put_memory())
+void chips_state_fill_memory(uint8_t* mem, size_t size, uint16_t fill);
+
 // Prepare chips_audio_t snapshot for saving
 void chips_audio_callback_snapshot_onsave(chips_audio_callback_t* snapshot);
 // Fixup chips_audio_t snapshot after loading
 void chips_audio_callback_snapshot_onload(chips_audio_callback_t* snapshot, chips_audio_callback_t* sys);
+// Prepare chips_audio_t snapshot for saving
+void chips_audio_snapshot_onsave(chips_audio_t* snapshot);
+// Fixup chips_audio_t snapshot after loading
+void chips_audio_snapshot_onload(chips_audio_t* snapshot, chips_audio_t* sys);
+// Prepare chips_scanline_callback_t snapshot for saving
+void chips_scanline_callback_snapshot_onsave(chips_scanline_callback_t* snapshot);
+// Fixup chips_scanline_callback_t snapshot after loading
+void chips_scanline_callback_snapshot_onload(chips_scanline_callback_t* snapshot, chips_scanline_callback_t* sys);
 // Prepare chips_debut_t snapshot for saving
 void chips_debug_snapshot_onsave(chips_debug_t* snapshot);
 // Fixup chips_debug_t snapshot after loading
@@ -93,6 +466,432 @@ void chips_debug_snapshot_onload(chips_debug_t* snapshot, chips_debug_t* sys);
 
 /*--- IMPLEMENTATION ---------------------------------------------------------*/
 #ifdef CHIPS_IMPL
+#include <string.h>  // memcpy, memset
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+bool chips_watchpoint_add(chips_breakpoints_t* bp, uint16_t addr, uint32_t size, uint8_t flags) {
+    if (bp->num_watchpoints >= CHIPS_MAX_WATCHPOINTS) {
+        return false;
+    }
+    bp->watchpoints[bp->num_watchpoints++] = (chips_watchpoint_t){.addr = addr, .size = size, .flags = flags};
+    return true;
+}
+
+void chips_watchpoint_clear_all(chips_breakpoints_t* bp) { bp->num_watchpoints = 0; }
+
+int chips_watchpoint_test(const chips_breakpoints_t* bp, uint16_t addr, bool rw) {
+    const uint8_t mask = rw ? CHIPS_WATCH_READ : CHIPS_WATCH_WRITE;
+    for (int i = 0; i < bp->num_watchpoints; i++) {
+        const chips_watchpoint_t* wp = &bp->watchpoints[i];
+        if ((wp->flags & mask) && ((uint16_t)(addr - wp->addr) < wp->size)) {
+            return rw ? CHIPS_STOP_WATCH_READ : CHIPS_STOP_WATCH_WRITE;
+        }
+    }
+    return CHIPS_STOP_NONE;
+}
+
+// True if the current iteration read the zero page byte at 'addr' exactly once (the read of its INC or DEC)
+static bool _chips_idle_read_once(const chips_idle_t* idle, uint8_t addr) {
+    if (idle->num_reads > CHIPS_IDLE_MAX_READS) {
+        return false;
+    }
+    int num = 0;
+    for (int i = 0; i < idle->num_reads; i++) {
+        num += (idle->reads[i] == addr) ? 1 : 0;
+    }
+    return num == 1;
+}
+
+bool chips_idle_head(chips_idle_t* idle, uint16_t pc, uint32_t tick) {
+    if (pc == idle->head) {
+        const uint32_t period = tick - idle->head_tick;
+        const bool clean = idle->tracking && (period <= CHIPS_IDLE_MAX_TICKS);
+        bool repeat = clean && idle->clean && (period == idle->period) && (idle->num_writes == idle->num_last_writes);
+        idle->counters = 0;
+        idle->down = 0;
+        idle->max_skip = 255;
+        for (int i = 0; i < idle->num_writes; i++) {
+            const uint32_t w = idle->writes[i];
+            const uint32_t last_w = idle->last_writes[i];
+            const uint8_t step = (uint8_t)(w - last_w);
+            if ((w < 0x10000) && ((w >> 8) == (last_w >> 8)) && ((step == 0x01) || (step == 0xFF)) &&
+                _chips_idle_read_once(idle, (uint8_t)(w >> 8))) {
+                // Zero page counter, the skipped values must have the same N and Z flags as this one
+                const uint8_t value = (uint8_t)w;
+                uint8_t skip;
+                if (step == 0x01) {
+                    skip = (value == 0) ? 0 : (value < 0x80) ? (uint8_t)(0x7F - value) : (uint8_t)(0xFF - value);
+                } else {
+                    skip = (value == 0) ? 0 : (value < 0x80) ? (uint8_t)(value - 1) : (uint8_t)(value - 0x80);
+                    idle->down |= (uint8_t)(1U << i);
+                }
+                idle->counters |= (uint8_t)(1U << i);
+                idle->max_skip = (skip < idle->max_skip) ? skip : idle->max_skip;
+            } else {
+                repeat = repeat && (w == last_w);
+            }
+            idle->last_writes[i] = w;
+        }
+        if (repeat) {
+            idle->num_repeats = (idle->num_repeats < 255) ? (idle->num_repeats + 1) : 255;
+            idle->num_misses = 0;
+        } else {
+            idle->num_repeats = 0;
+            if (clean) {
+                idle->num_misses++;
+            }
+        }
+        idle->clean = clean;
+        idle->period = period;
+        idle->num_last_writes = idle->num_writes;
+    } else {
+        // Backward jump after the loop at 'head' was left, a new loop candidate (jumps within
+        // a loop, like returns from a subroutine called by the loop, don't replace the head)
+        idle->head = pc;
+        idle->clean = false;
+        idle->num_repeats = 0;
+        idle->num_misses = 0;
+    }
+    // Start the next iteration, loops which keep changing memory (like counters) are not tracked
+    // any further after CHIPS_IDLE_MAX_MISSES iterations, until they are left or chips_idle_reset() is called
+    idle->head_tick = tick;
+    idle->tracking = idle->num_misses < CHIPS_IDLE_MAX_MISSES;
+    idle->num_writes = 0;
+    idle->num_reads = 0;
+    return idle->num_repeats > 0;
+}
+
+// Byte 'i' of 'src' XORed with a 16-bit pattern (low byte at even, high byte at odd offsets)
+#define _CHIPS_RLE_BYTE(src, i, pattern) ((uint8_t)((src)[i] ^ (((i) & 1) ? ((pattern) >> 8) : (pattern))))
+
+// RLE-encode 'len' bytes XORed with 'pattern'
+static int _chips_rle_encode(const uint8_t* src, int len, uint16_t pattern, uint8_t* dst) {
+    int pos = 0;
+    int out = 0;
+    while (pos < len) {
+        // Length of the run starting at pos
+        const uint8_t c = _CHIPS_RLE_BYTE(src, pos, pattern);
+        int run = 1;
+        while ((pos + run < len) && (run < 129) && (_CHIPS_RLE_BYTE(src, pos + run, pattern) == c)) {
+            run++;
+        }
+        if (run >= 3) {
+            dst[out++] = (uint8_t)(run + 125);
+            dst[out++] = c;
+            pos += run;
+        } else {
+            // Collect literals up to the next run of 3 or more
+            int start = pos;
+            while ((pos < len) && (pos - start < 128)) {
+                if ((pos + 2 < len) && (_CHIPS_RLE_BYTE(src, pos, pattern) == _CHIPS_RLE_BYTE(src, pos + 1, pattern)) &&
+                    (_CHIPS_RLE_BYTE(src, pos, pattern) == _CHIPS_RLE_BYTE(src, pos + 2, pattern))) {
+                    break;
+                }
+                pos++;
+            }
+            dst[out++] = (uint8_t)(pos - start - 1);
+            for (int i = start; i < pos; i++) {
+                dst[out++] = _CHIPS_RLE_BYTE(src, i, pattern);
+            }
+        }
+    }
+    return out;
+}
+
+int chips_rle_encode(const uint8_t* src, int len, uint8_t* dst) { return _chips_rle_encode(src, len, 0, dst); }
+
+bool chips_rle_decode(const uint8_t* src, int size, uint8_t* dst, int len) {
+    int in = 0;
+    int out = 0;
+    while (in < size) {
+        const uint8_t c = src[in++];
+        if (c < 128) {
+            const int n = c + 1;
+            if ((in + n > size) || (out + n > len)) {
+                return false;
+            }
+            memcpy(&dst[out], &src[in], n);
+            in += n;
+            out += n;
+        } else {
+            const int n = c - 125;
+            if ((in >= size) || (out + n > len)) {
+                return false;
+            }
+            memset(&dst[out], src[in++], n);
+            out += n;
+        }
+    }
+    return out == len;
+}
+
+static void _chips_state_put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void _chips_state_put32(uint8_t* p, uint32_t v) {
+    _chips_state_put16(p, (uint16_t)v);
+    _chips_state_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t _chips_state_get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t _chips_state_get32(const uint8_t* p) {
+    return _chips_state_get16(p) | ((uint32_t)_chips_state_get16(p + 2) << 16);
+}
+
+static void _chips_state_write(chips_state_writer_t* w, const void* data, size_t size) {
+    if (w->ok && !w->write(data, size, w->user_data)) {
+        w->ok = false;
+    }
+}
+
+static void _chips_state_write_chunk_header(chips_state_writer_t* w, uint32_t id, uint16_t version, uint32_t size) {
+    uint8_t header[CHIPS_STATE_CHUNK_HEADER];
+    _chips_state_put32(&header[0], id);
+    _chips_state_put16(&header[4], version);
+    _chips_state_put32(&header[6], size);
+    _chips_state_write(w, header, sizeof(header));
+}
+
+void chips_state_writer_init(chips_state_writer_t* w, uint32_t system_id, chips_range_t buffer,
+                             chips_state_write_t write, void* user_data) {
+    CHIPS_ASSERT(w && buffer.ptr && (buffer.size >= CHIPS_STATE_MAX_CHUNK_SIZE) && write);
+    w->write = write;
+    w->user_data = user_data;
+    w->ok = true;
+    w->chunk_id = 0;
+    w->buf = (uint8_t*)buffer.ptr;
+    w->pos = 0;
+    uint8_t header[CHIPS_STATE_HEADER_SIZE];
+    _chips_state_put32(&header[0], CHIPS_STATE_MAGIC);
+    _chips_state_put32(&header[4], system_id);
+    _chips_state_put16(&header[8], CHIPS_STATE_VERSION);
+    _chips_state_write(w, header, sizeof(header));
+}
+
+void chips_state_begin_chunk(chips_state_writer_t* w, uint32_t id, uint16_t version) {
+    CHIPS_ASSERT(w && (w->chunk_id == 0) && (id != 0));
+    w->chunk_id = id;
+    w->chunk_version = version;
+    w->pos = 0;
+}
+
+void chips_state_put_bytes(chips_state_writer_t* w, const void* src, size_t size) {
+    CHIPS_ASSERT(w && w->chunk_id);
+    if (w->pos + size > CHIPS_STATE_MAX_CHUNK_SIZE) {
+        w->ok = false;
+        return;
+    }
+    memcpy(&w->buf[w->pos], src, size);
+    w->pos += size;
+}
+
+void chips_state_put8(chips_state_writer_t* w, uint8_t v) { chips_state_put_bytes(w, &v, 1); }
+
+void chips_state_put16(chips_state_writer_t* w, uint16_t v) {
+    uint8_t p[2];
+    _chips_state_put16(p, v);
+    chips_state_put_bytes(w, p, sizeof(p));
+}
+
+void chips_state_put32(chips_state_writer_t* w, uint32_t v) {
+    uint8_t p[4];
+    _chips_state_put32(p, v);
+    chips_state_put_bytes(w, p, sizeof(p));
+}
+
+void chips_state_put_bool(chips_state_writer_t* w, bool v) { chips_state_put8(w, v ? 1 : 0); }
+
+// Append 'len' bytes XORed with 'pattern' RLE-encoded
+static void _chips_state_put_rle(chips_state_writer_t* w, const uint8_t* src, int len, uint16_t pattern) {
+    CHIPS_ASSERT(w && w->chunk_id && src);
+    if (w->pos + CHIPS_RLE_MAX_SIZE(len) > CHIPS_STATE_MAX_CHUNK_SIZE) {
+        w->ok = false;
+        return;
+    }
+    w->pos += _chips_rle_encode(src, len, pattern, &w->buf[w->pos]);
+}
+
+void chips_state_put_rle(chips_state_writer_t* w, const uint8_t* src, int len) { _chips_state_put_rle(w, src, len, 0); }
+
+void chips_state_end_chunk(chips_state_writer_t* w) {
+    CHIPS_ASSERT(w && w->chunk_id);
+    _chips_state_write_chunk_header(w, w->chunk_id, w->chunk_version, (uint32_t)w->pos);
+    if (w->pos > 0) {
+        _chips_state_write(w, w->buf, w->pos);
+    }
+    w->chunk_id = 0;
+    w->pos = 0;
+}
+
+static uint8_t _chips_state_fill_byte(size_t offset, uint16_t fill) {
+    return (offset & 1) ? (uint8_t)(fill >> 8) : (uint8_t)fill;
+}
+
+void chips_state_put_memory(chips_state_writer_t* w, uint32_t id, const uint8_t* mem, size_t size, uint16_t fill) {
+    CHIPS_ASSERT(w && mem);
+    // Blocks are stored as XOR against the fill pattern, so untouched memory compresses into runs of zeros
+    for (size_t offset = 0; offset < size; offset += CHIPS_STATE_BLOCK_SIZE) {
+        const size_t len = ((size - offset) < CHIPS_STATE_BLOCK_SIZE) ? (size - offset) : CHIPS_STATE_BLOCK_SIZE;
+        uint8_t any = 0;
+        for (size_t i = 0; i < len; i++) {
+            any |= mem[offset + i] ^ _chips_state_fill_byte(i, fill);
+        }
+        if (any == 0) {
+            continue;
+        }
+        chips_state_begin_chunk(w, id, 1);
+        chips_state_put32(w, (uint32_t)offset);
+        _chips_state_put_rle(w, &mem[offset], (int)len, fill);
+        chips_state_end_chunk(w);
+    }
+}
+
+bool chips_state_writer_finish(chips_state_writer_t* w) {
+    CHIPS_ASSERT(w && (w->chunk_id == 0));
+    _chips_state_write_chunk_header(w, CHIPS_STATE_CHUNK_END, 1, 0);
+    return w->ok;
+}
+
+bool chips_state_reader_init(chips_state_reader_t* r, const void* data, size_t size, uint32_t system_id) {
+    CHIPS_ASSERT(r && data);
+    memset(r, 0, sizeof(*r));
+    const uint8_t* p = (const uint8_t*)data;
+    if ((size < CHIPS_STATE_HEADER_SIZE) || (_chips_state_get32(&p[0]) != CHIPS_STATE_MAGIC) ||
+        (_chips_state_get32(&p[4]) != system_id) || (_chips_state_get16(&p[8]) != CHIPS_STATE_VERSION)) {
+        return false;
+    }
+    // Validate the chunk list up front, so a truncated file is rejected before any state is changed
+    size_t pos = CHIPS_STATE_HEADER_SIZE;
+    for (;;) {
+        if ((size - pos) < CHIPS_STATE_CHUNK_HEADER) {
+            return false;
+        }
+        const uint32_t id = _chips_state_get32(&p[pos]);
+        const uint32_t chunk_size = _chips_state_get32(&p[pos + 6]);
+        pos += CHIPS_STATE_CHUNK_HEADER;
+        if ((size - pos) < chunk_size) {
+            return false;
+        }
+        if (id == CHIPS_STATE_CHUNK_END) {
+            break;
+        }
+        pos += chunk_size;
+    }
+    r->data = p;
+    r->size = size;
+    r->pos = CHIPS_STATE_HEADER_SIZE;
+    r->ok = true;
+    return true;
+}
+
+bool chips_state_next_chunk(chips_state_reader_t* r) {
+    CHIPS_ASSERT(r && r->data);
+    const uint8_t* p = &r->data[r->pos];
+    r->chunk_id = _chips_state_get32(&p[0]);
+    r->chunk_version = _chips_state_get16(&p[4]);
+    r->chunk_size = _chips_state_get32(&p[6]);
+    r->chunk = &p[CHIPS_STATE_CHUNK_HEADER];
+    r->chunk_pos = 0;
+    if (r->chunk_id == CHIPS_STATE_CHUNK_END) {
+        return false;
+    }
+    r->pos += CHIPS_STATE_CHUNK_HEADER + r->chunk_size;
+    return true;
+}
+
+void chips_state_get_bytes(chips_state_reader_t* r, void* dst, size_t size) {
+    CHIPS_ASSERT(r && dst);
+    size_t avail = r->chunk_size - r->chunk_pos;
+    if (avail > size) {
+        avail = size;
+    }
+    memcpy(dst, &r->chunk[r->chunk_pos], avail);
+    memset((uint8_t*)dst + avail, 0, size - avail);
+    r->chunk_pos += avail;
+}
+
+uint8_t chips_state_get8(chips_state_reader_t* r) {
+    uint8_t v;
+    chips_state_get_bytes(r, &v, 1);
+    return v;
+}
+
+uint16_t chips_state_get16(chips_state_reader_t* r) {
+    uint8_t p[2];
+    chips_state_get_bytes(r, p, sizeof(p));
+    return _chips_state_get16(p);
+}
+
+uint32_t chips_state_get32(chips_state_reader_t* r) {
+    uint8_t p[4];
+    chips_state_get_bytes(r, p, sizeof(p));
+    return _chips_state_get32(p);
+}
+
+bool chips_state_get_bool(chips_state_reader_t* r) { return chips_state_get8(r) != 0; }
+
+bool chips_state_get_rle(chips_state_reader_t* r, uint8_t* dst, int len) {
+    CHIPS_ASSERT(r && dst);
+    const int size = (int)(r->chunk_size - r->chunk_pos);
+    const bool valid = chips_rle_decode(&r->chunk[r->chunk_pos], size, dst, len);
+    r->chunk_pos = r->chunk_size;
+    if (!valid) {
+        r->ok = false;
+    }
+    return valid;
+}
+
+void chips_state_fill_memory(uint8_t* mem, size_t size, uint16_t fill) {
+    CHIPS_ASSERT(mem);
+    for (size_t i = 0; i < size; i++) {
+        mem[i] = _chips_state_fill_byte(i, fill);
+    }
+}
+
+bool chips_state_get_memory(chips_state_reader_t* r, uint8_t* mem, size_t size, uint16_t fill) {
+    CHIPS_ASSERT(r && mem);
+    const uint32_t offset = chips_state_get32(r);
+    if (((offset % CHIPS_STATE_BLOCK_SIZE) != 0) || (offset >= size)) {
+        r->ok = false;
+        return false;
+    }
+    const size_t len = ((size - offset) < CHIPS_STATE_BLOCK_SIZE) ? (size - offset) : CHIPS_STATE_BLOCK_SIZE;
+    if (!chips_state_get_rle(r, &mem[offset], (int)len)) {
+        return false;
+    }
+    for (size_t i = 0; i < len; i++) {
+        mem[offset + i] ^= _chips_state_fill_byte(i, fill);
+    }
+    return true;
+}
+
+void chips_audio_init(chips_audio_t* audio, const chips_audio_desc_t* desc) {
+    static const size_t sample_size[] = {sizeof(uint8_t), sizeof(int16_t), sizeof(float)};
+    *audio = (chips_audio_t){
+        .callback = desc->callback,
+        .block_callback = desc->block_callback,
+        .format = desc->format,
+        .buffer = desc->buffer.ptr,
+        .num_samples = (int)(desc->buffer.size / sample_size[desc->format]),
+    };
+    if (audio->block_callback.func && ((audio->buffer == 0) || (audio->num_samples == 0))) {
+        // no buffer to collect samples in, fall back to the per-sample callback
+        audio->block_callback.func = 0;
+    }
+}
+
+void chips_audio_flush(chips_audio_t* audio) {
+    if (audio->block_callback.func && (audio->pos > 0)) {
+        audio->block_callback.func(audio->buffer, audio->pos, audio->block_callback.user_data);
+    }
+    audio->pos = 0;
+}
 
 void chips_audio_callback_snapshot_onsave(chips_audio_callback_t* snapshot) {
     snapshot->func = 0;
@@ -104,16 +903,40 @@ void chips_audio_callback_snapshot_onload(chips_audio_callback_t* snapshot, chip
     snapshot->user_data = sys->user_data;
 }
 
+void chips_audio_snapshot_onsave(chips_audio_t* snapshot) {
+    chips_audio_callback_snapshot_onsave(&snapshot->callback);
+    snapshot->block_callback.func = 0;
+    snapshot->block_callback.user_data = 0;
+    snapshot->buffer = 0;
+}
+
+void chips_audio_snapshot_onload(chips_audio_t* snapshot, chips_audio_t* sys) {
+    // keep the live buffer, samples collected before loading are still delivered
+    *snapshot = *sys;
+}
+
+void chips_scanline_callback_snapshot_onsave(chips_scanline_callback_t* snapshot) {
+    snapshot->func = 0;
+    snapshot->user_data = 0;
+}
+
+void chips_scanline_callback_snapshot_onload(chips_scanline_callback_t* snapshot, chips_scanline_callback_t* sys) {
+    snapshot->func = sys->func;
+    snapshot->user_data = sys->user_data;
+}
+
 void chips_debug_snapshot_onsave(chips_debug_t* snapshot) {
     snapshot->callback.func = 0;
     snapshot->callback.user_data = 0;
     snapshot->stopped = 0;
+    snapshot->breakpoints = 0;
 }
 
 void chips_debug_snapshot_onload(chips_debug_t* snapshot, chips_debug_t* sys) {
     snapshot->callback.func = sys->callback.func;
     snapshot->callback.user_data = sys->callback.user_data;
     snapshot->stopped = sys->stopped;
+    snapshot->breakpoints = sys->breakpoints;
 }
 
 #endif  // CHIPS_IMPL
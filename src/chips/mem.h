@@ -20,11 +20,17 @@
 //
 // ## Feature Overview
 //
-// - maps 16-bit addresses to host system addresses with 1 KByte page-size
-//     granularity
+// - maps 16-bit addresses to host system addresses with MEM_PAGE_SIZE
+//     granularity (4 KBytes by default)
 // - memory pages can be mapped as RAM, ROM or RAM-behind-ROM (where
 //     read accesses are mapped to a different memory page then write accesses)
-// - 4 independent page-table layers to simplify bank-switching implementations
+// - 4 independent page-table layers to simplify bank-switching implementations,
+//     layers can be enabled and disabled without remapping them
+// - per-page flags for the CPU-visible address space (e.g. debugger watchpoints)
+// - optional tracking of the host memory pages written by mem_wr() (e.g. for
+//     delta snapshots), compiled in when MEM_TRACK_WRITES is defined
+// - optional copy-on-write sharing of host memory with another instance (e.g.
+//     for forking a system), compiled in when MEM_COPY_ON_WRITE is defined
 //
 // ## Usage
 //
@@ -59,11 +65,30 @@
 // ****************************************************************************
 //
 //
-// Each layer is an array of 64 page items (one page item covers 1 KByte of memory).
+// Each layer is an array of 16 page items (one page item covers MEM_LAYER_PAGE_SIZE,
+// 4 KBytes of memory). When MEM_PAGE_SIZE is smaller and a layer page is mapped
+// in smaller pieces (e.g. the 512 byte regions of the Apple //e), only this layer
+// page is split into a table of MEM_PAGE_SIZE page items (up to MEM_MAX_SPLIT
+// layer pages over all layers). Remapping whole layer pages touches a single
+// layer page item.
+//
+// The CPU-visible page-table is built the same way: one page item per
+// MEM_LAYER_PAGE_SIZE, and a table of MEM_PAGE_SIZE page items only behind the
+// pages which the layers map in pieces. mem_rd() and mem_wr() use the coarse
+// page item unless its page is split. When the split pages take most of the
+// accesses (the zero page and stack of the Apple //e), define
+// MEM_FLAT_PAGE_TABLE to keep one CPU-visible page item per MEM_PAGE_SIZE
+// instead: mem_rd() and mem_wr() are then a single table lookup again, and
+// a remap writes MEM_NUM_SPLIT_PAGES items per layer page.
 //
 // The CPU sees the highest priority valid page items (where layer 0 is
 // highest priority and layer 3 is lowest priority).
 //
+// Disabled layers (see mem_enable_layer()) are skipped. The CPU-visible
+// page-table caches the composition of the enabled layers, mapping a layer
+// or enabling and disabling it only recomputes the pages the layer maps
+// (e.g. switching RAM over a ROM in and out).
+//
 // Each page item consists of two host system pointers, one for read access,
 // and one for write access.
 //
@@ -82,6 +107,19 @@
 // - **unmapped page**: the read-pointer points to the internal junk-read-page, and
 //     the write-pointer to the internal junk-write-page
 //
+// ## Copy-on-write sharing
+//
+// mem_share() makes a host memory range read from another instance's copy
+// (e.g. the RAM of the system a fork was made from). The CPU-visible pages
+// of the shared host pages get a null write-pointer, which makes mem_wr()
+// copy the host page with mem_copy_on_write() first. Code which reads host
+// memory directly (e.g. video rendering) has to go through mem_shared_ptr().
+// Shared host memory is copied in MEM_LAYER_PAGE_SIZE pieces. The other
+// instance must not change the shared memory while it is shared.
+//
+// Sharing needs MEM_COPY_ON_WRITE, without it mem_wr() has no null check,
+// mem_unshare() does nothing and mem_shared_ptr() returns its argument.
+//
 // ## zlib/libpng license
 //
 // Copyright (c) 2018 Andre Weissflog
@@ -120,8 +158,48 @@ extern "C" {
 #define MEM_PAGE_SIZE (1U << MEM_PAGE_SHIFT)
 #define MEM_PAGE_MASK (MEM_PAGE_SIZE - 1)
 
-#define MEM_NUM_PAGES  (MEM_ADDR_RANGE / MEM_PAGE_SIZE)
-#define MEM_NUM_LAYERS (1U)
+#ifndef MEM_LAYER_PAGE_SHIFT
+// Layer page size (4 KBytes)
+#define MEM_LAYER_PAGE_SHIFT (12U)
+#endif  // MEM_LAYER_PAGE_SHIFT
+
+#if MEM_PAGE_SHIFT > MEM_LAYER_PAGE_SHIFT
+#error "MEM_PAGE_SHIFT must not be larger than MEM_LAYER_PAGE_SHIFT"
+#endif
+
+#if (MEM_LAYER_PAGE_SHIFT - MEM_PAGE_SHIFT) > 5
+#error "a layer page must not have more than 32 pages"
+#endif
+
+#define MEM_LAYER_PAGE_SIZE (1U << MEM_LAYER_PAGE_SHIFT)
+#define MEM_LAYER_PAGE_MASK (MEM_LAYER_PAGE_SIZE - 1)
+
+#define MEM_NUM_PAGES       (MEM_ADDR_RANGE / MEM_PAGE_SIZE)
+#define MEM_NUM_LAYER_PAGES (MEM_ADDR_RANGE / MEM_LAYER_PAGE_SIZE)
+#define MEM_NUM_SPLIT_PAGES (MEM_LAYER_PAGE_SIZE / MEM_PAGE_SIZE)  // Pages of a split layer page
+
+#ifndef MEM_NUM_LAYERS
+// Number of page-table layers (max 32)
+#define MEM_NUM_LAYERS (4U)
+#endif  // MEM_NUM_LAYERS
+
+#ifndef MEM_MAX_SPLIT
+// Max number of layer pages mapped in pieces smaller than MEM_LAYER_PAGE_SIZE
+#define MEM_MAX_SPLIT (4)
+#endif  // MEM_MAX_SPLIT
+
+// Page flags, checked by the system emulation, not by mem_rd()/mem_wr()
+#define MEM_PAGE_FLAG_WATCH_READ  (1 << 0)  // Page contains a read watchpoint
+#define MEM_PAGE_FLAG_WATCH_WRITE (1 << 1)  // Page contains a write watchpoint
+
+#ifdef MEM_TRACK_WRITES
+// Max number of written pages remembered across mapping changes between mem_collect_written() calls
+#define MEM_WRITTEN_LOG_SIZE (64)
+#endif
+#ifdef MEM_COPY_ON_WRITE
+// Max number of host memory ranges shared with other instances
+#define MEM_MAX_SHARED (2)
+#endif
 
 // Memory page item maps a chunk of emulator memory to host memory
 typedef struct {
@@ -129,14 +207,66 @@ typedef struct {
     uint8_t* write_ptr;
 } mem_page_t;
 
+#ifdef MEM_COPY_ON_WRITE
+// Host memory range which is read from another instance until written (see mem_share())
+typedef struct {
+    uint8_t* ptr;                                       // Host memory of this instance
+    const uint8_t* src;                                 // Host memory of the other instance
+    uint32_t size;
+    uint32_t pending[(MEM_NUM_LAYER_PAGES + 31) / 32];  // Pieces not copied yet (one bit per MEM_LAYER_PAGE_SIZE bytes)
+} mem_shared_t;
+#endif
+
 // Memory instance is a 2-dimensional table of memory pages
 typedef struct {
-    // Pages that are actually visible to the emulated CPU
+#ifdef MEM_FLAT_PAGE_TABLE
+    // Pages that are actually visible to the emulated CPU (one page item per MEM_PAGE_SIZE bytes)
     mem_page_t page_table[MEM_NUM_PAGES];
-    // <emory-mapped layers, layer 0 is highest priority
-    mem_page_t layers[MEM_NUM_LAYERS][MEM_NUM_PAGES];
+#else
+    // Pages that are actually visible to the emulated CPU (one page item per MEM_LAYER_PAGE_SIZE bytes)
+    mem_page_t page_table[MEM_NUM_LAYER_PAGES];
+    // Split CPU-visible pages, 1 + index into fine_pages (0: the page_table item maps the whole page)
+    uint8_t fine[MEM_NUM_LAYER_PAGES];
+    // Page items of the split CPU-visible pages (one per MEM_PAGE_SIZE bytes)
+    mem_page_t fine_pages[MEM_MAX_SPLIT][MEM_NUM_SPLIT_PAGES];
+    // Used fine_pages slots (bit n: slot n)
+    uint32_t fine_used;
+#endif
+    // Memory-mapped layers, layer 0 is highest priority (one page item per MEM_LAYER_PAGE_SIZE bytes)
+    mem_page_t layers[MEM_NUM_LAYERS][MEM_NUM_LAYER_PAGES];
+    // Split layer pages, 1 + index into split_pages (0: the layer page item maps the whole layer page)
+    uint8_t split[MEM_NUM_LAYERS][MEM_NUM_LAYER_PAGES];
+    // Page items of the split layer pages (one per MEM_PAGE_SIZE bytes)
+    mem_page_t split_pages[MEM_MAX_SPLIT][MEM_NUM_SPLIT_PAGES];
+    // Used split_pages slots (bit n: slot n)
+    uint32_t split_used;
+    // Enabled layers (bit n: layer n)
+    uint32_t layer_mask;
+    // Range of layer pages each layer has mapped since it was last unmapped
+    uint16_t mapped_begin[MEM_NUM_LAYERS];
+    uint16_t mapped_end[MEM_NUM_LAYERS];
+    // Flags of the CPU-visible pages (MEM_PAGE_FLAG_*), independent of the mapping
+    uint8_t page_flags[MEM_NUM_PAGES];
+#ifdef MEM_TRACK_WRITES
+    // CPU-visible pages written since the last mem_collect_written() call (one bit per page)
+    uint32_t written[(MEM_NUM_PAGES + 31) / 32];
+    // Host write pointers of written pages which have been mapped out since then
+    uint8_t* written_log[MEM_WRITTEN_LOG_SIZE];
+    int num_written_log;
+    bool written_lost;  // More pages were mapped out than fit into the log
+#endif
+#ifdef MEM_COPY_ON_WRITE
+    // Host memory shared with other instances
+    mem_shared_t shared[MEM_MAX_SHARED];
+    int num_shared;
+#endif
 } mem_t;
 
+#ifdef MEM_TRACK_WRITES
+// Callback for mem_collect_written(), receives the host address of a written page (MEM_PAGE_SIZE bytes)
+typedef void (*mem_written_func_t)(uint8_t* ptr, void* user_data);
+#endif
+
 // Initialize a new mem instance
 void mem_init(mem_t* mem);
 // Map a range of RAM
@@ -145,22 +275,91 @@ void mem_map_ram(mem_t* mem, size_t layer, uint16_t addr, uint32_t size, uint8_t
 void mem_map_rom(mem_t* mem, size_t layer, uint16_t addr, uint32_t size, const uint8_t* ptr);
 // Map a range of memory to different read/write pointers (e.g. for RAM behind ROM)
 void mem_map_rw(mem_t* mem, size_t layer, uint16_t addr, uint32_t size, const uint8_t* read_ptr, uint8_t* write_ptr);
+// Copy the page items of a layer range (one per MEM_PAGE_SIZE bytes, e.g. to cache a memory map for mem_map_pages())
+void mem_copy_pages(const mem_t* mem, size_t layer, uint16_t addr, uint32_t size, mem_page_t* dst);
+// Map a range from page items saved with mem_copy_pages(), contiguous items of a whole layer page are merged
+void mem_map_pages(mem_t* mem, size_t layer, uint16_t addr, uint32_t size, const mem_page_t* pages);
 // Unmap all memory pages in a layer, also updates the CPU-visible page-table
 void mem_unmap_layer(mem_t* mem, size_t layer);
+// Enable or disable a layer (all layers are enabled after mem_init()), only updates the pages mapped by the layer
+void mem_enable_layer(mem_t* mem, size_t layer, bool enabled);
 // Unmap all memory pages in all layers, also updates the CPU-visible page-table
 void mem_unmap_all(mem_t* mem);
 // Get the host-memory read-ptr of an emulator memory address
 uint8_t* mem_readptr(mem_t* mem, uint16_t addr);
+// Get the host-memory write-ptr of an emulator memory address (copies shared host memory first)
+uint8_t* mem_writeptr(mem_t* mem, uint16_t addr);
 // Copy a range of bytes into memory via mem_wr()
 void mem_write_range(mem_t* mem, uint16_t addr, const uint8_t* src, uint32_t num_bytes);
+#ifdef MEM_TRACK_WRITES
+// Report the host pages written since the last call and start over, returns false if written pages were lost
+// (the caller has to treat all memory as written)
+bool mem_collect_written(mem_t* mem, mem_written_func_t func, void* user_data);
+// Forget the written pages
+void mem_clear_written(mem_t* mem);
+#endif
+#ifdef MEM_COPY_ON_WRITE
+// Read a host memory range from 'src' until it is written (copy-on-write), 'size' must be a multiple of
+// MEM_LAYER_PAGE_SIZE
+void mem_share(mem_t* mem, uint8_t* ptr, const uint8_t* src, uint32_t size);
+// Copy the shared host memory mapped for writing at a 16-bit address, returns its host address (called by mem_wr())
+uint8_t* mem_copy_on_write(mem_t* mem, uint16_t addr);
+#endif
+// Copy all shared host pages which have not been written yet and stop sharing
+void mem_unshare(mem_t* mem);
+// Move all host pointers into [old_base, old_base + size) to new_base (helper for copying a system)
+void mem_relocate(mem_t* mem, const void* old_base, size_t size, void* new_base);
+// Set page flags on all pages overlapping an address range
+void mem_set_page_flags(mem_t* mem, uint16_t addr, uint32_t size, uint8_t flags);
+// Clear page flags on all pages
+void mem_clear_page_flags(mem_t* mem, uint8_t flags);
+
+// Get the flags of the page containing a 16-bit address
+static inline uint8_t mem_page_flags(const mem_t* mem, uint16_t addr) {
+    return mem->page_flags[addr >> MEM_PAGE_SHIFT];
+}
+
+// Get the CPU-visible page item of a 16-bit address and the offset of the address in it
+static inline const mem_page_t* mem_page_item(const mem_t* mem, uint16_t addr, uint32_t* offset) {
+#ifdef MEM_FLAT_PAGE_TABLE
+    *offset = addr & MEM_PAGE_MASK;
+    return &mem->page_table[addr >> MEM_PAGE_SHIFT];
+#else
+#if MEM_PAGE_SHIFT < MEM_LAYER_PAGE_SHIFT
+    const uint8_t fine = mem->fine[addr >> MEM_LAYER_PAGE_SHIFT];
+    if (fine) {
+        *offset = addr & MEM_PAGE_MASK;
+        return &mem->fine_pages[fine - 1][(addr >> MEM_PAGE_SHIFT) % MEM_NUM_SPLIT_PAGES];
+    }
+#endif
+    *offset = addr & MEM_LAYER_PAGE_MASK;
+    return &mem->page_table[addr >> MEM_LAYER_PAGE_SHIFT];
+#endif
+}
 
 // Read a byte at 16-bit address
 static inline uint8_t mem_rd(mem_t* mem, uint16_t addr) {
-    return mem->page_table[addr >> MEM_PAGE_SHIFT].read_ptr[addr & MEM_PAGE_MASK];
+    uint32_t offset;
+    return mem_page_item(mem, addr, &offset)->read_ptr[offset];
 }
 // Write a byte to 16-bit address
 static inline void mem_wr(mem_t* mem, uint16_t addr, uint8_t data) {
-    mem->page_table[addr >> MEM_PAGE_SHIFT].write_ptr[addr & MEM_PAGE_MASK] = data;
+    uint32_t offset;
+    uint8_t* write_ptr = mem_page_item(mem, addr, &offset)->write_ptr;
+#ifdef MEM_COPY_ON_WRITE
+    if (write_ptr) {
+        write_ptr[offset] = data;
+    } else {
+        // Shared host memory
+        *mem_copy_on_write(mem, addr) = data;
+    }
+#else
+    write_ptr[offset] = data;
+#endif
+#ifdef MEM_TRACK_WRITES
+    const uint32_t page = addr >> MEM_PAGE_SHIFT;
+    mem->written[page >> 5] |= 1U << (page & 31);
+#endif
 }
 // Helper method to write a 16-bit value, does 2 mem_wr()
 static inline void mem_wr16(mem_t* mem, uint16_t addr, uint16_t data) {
@@ -174,6 +373,23 @@ static inline uint16_t mem_rd16(mem_t* mem, uint16_t addr) {
     return (h << 8) | l;
 }
 
+// Get the address a host memory location is currently read from (its source while shared and not written yet)
+static inline const uint8_t* mem_shared_ptr(const mem_t* mem, const uint8_t* ptr) {
+#ifndef MEM_COPY_ON_WRITE
+    (void)mem;
+#else
+    for (int i = 0; i < mem->num_shared; i++) {
+        const mem_shared_t* shared = &mem->shared[i];
+        const uintptr_t offset = (uintptr_t)ptr - (uintptr_t)shared->ptr;
+        if ((offset < shared->size) &&
+            (shared->pending[offset >> (MEM_LAYER_PAGE_SHIFT + 5)] & (1U << ((offset >> MEM_LAYER_PAGE_SHIFT) & 31)))) {
+            return shared->src + offset;
+        }
+    }
+#endif
+    return ptr;
+}
+
 // Read a byte from a specific layer (slow!)
 uint8_t mem_layer_rd(mem_t* mem, size_t layer, uint16_t addr);
 // Write a byte to a specific layer (slow!)
@@ -196,68 +412,351 @@ void mem_snapshot_onload(mem_t* snapshot, void* base);
 #define CHIPS_ASSERT(c) assert(c)
 #endif
 
-// Dummy page for currently unmapped memory
-static uint8_t _mem_unmapped_page[MEM_PAGE_SIZE];
+// Dummy page for currently unmapped memory (a CPU-visible page item may cover a whole layer page)
+static uint8_t _mem_unmapped_page[MEM_LAYER_PAGE_SIZE];
 // Write-only 'junk table' for writes to ROM areas
-static uint8_t _mem_junk_page[MEM_PAGE_SIZE];
+static uint8_t _mem_junk_page[MEM_LAYER_PAGE_SIZE];
+
+// Written bits of the pages of a layer page
+#define _MEM_SPLIT_BITS ((uint32_t)((1ULL << MEM_NUM_SPLIT_PAGES) - 1))
+// Number of CPU-visible page items
+#ifdef MEM_FLAT_PAGE_TABLE
+#define _MEM_NUM_TABLE_PAGES MEM_NUM_PAGES
+#else
+#define _MEM_NUM_TABLE_PAGES MEM_NUM_LAYER_PAGES
+#endif
 
 void mem_init(mem_t* m) {
     CHIPS_ASSERT(m);
     *m = (mem_t){0};
+    m->layer_mask = (uint32_t)((1ULL << MEM_NUM_LAYERS) - 1);
     memset(_mem_unmapped_page, 0xFF, sizeof(_mem_unmapped_page));
     mem_unmap_all(m);
 }
 
-// This sets the CPU-visible mapping of a page in the page-table
-static void _mem_update_page_table(mem_t* m, size_t page_index) {
+#ifdef MEM_TRACK_WRITES
+// Remember the host page of a written page when it is mapped out
+static void _mem_log_written(mem_t* m, size_t page_index, uint8_t* write_ptr) {
+    const uint32_t bit = 1U << (page_index & 31);
+    if (m->written[page_index >> 5] & bit) {
+        m->written[page_index >> 5] &= ~bit;
+        if (m->num_written_log < MEM_WRITTEN_LOG_SIZE) {
+            m->written_log[m->num_written_log++] = write_ptr;
+        } else {
+            m->written_lost = true;
+        }
+    }
+}
+#endif
+
+#ifdef MEM_COPY_ON_WRITE
+// Find the shared range and piece of a host address, returns false if it is not shared
+static bool _mem_find_shared(mem_t* m, const uint8_t* ptr, mem_shared_t** shared, uint32_t* shared_page) {
+    for (int i = 0; i < m->num_shared; i++) {
+        const uintptr_t offset = (uintptr_t)ptr - (uintptr_t)m->shared[i].ptr;
+        if (offset < m->shared[i].size) {
+            *shared = &m->shared[i];
+            *shared_page = (uint32_t)(offset >> MEM_LAYER_PAGE_SHIFT);
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool _mem_shared_pending(const mem_shared_t* shared, uint32_t shared_page) {
+    return (shared->pending[shared_page >> 5] & (1U << (shared_page & 31))) != 0;
+}
+
+// Redirect a CPU-visible page item of 'size' bytes mapping host memory which hasn't been copied yet
+static void _mem_apply_shared(mem_t* m, mem_page_t* page, uint32_t size) {
+    (void)size;
+    mem_shared_t* shared;
+    uint32_t shared_page;
+    if (_mem_find_shared(m, page->read_ptr, &shared, &shared_page) && _mem_shared_pending(shared, shared_page)) {
+        page->read_ptr = (uint8_t*)shared->src + (page->read_ptr - shared->ptr);
+    }
+    if (_mem_find_shared(m, page->write_ptr, &shared, &shared_page)) {
+        // Host memory is mapped in whole pieces
+        CHIPS_ASSERT(((page->write_ptr - shared->ptr) & (size - 1)) == 0);
+        if (_mem_shared_pending(shared, shared_page)) {
+            page->write_ptr = 0;
+        }
+    }
+}
+#endif
+
+// Get the host pointers a layer maps at a CPU-visible page, returns false if the page is not mapped
+static bool _mem_layer_page(const mem_t* m, size_t layer, size_t page_index, uint8_t** read_ptr,
+                            uint8_t** write_ptr) {
+    const size_t layer_page = page_index / MEM_NUM_SPLIT_PAGES;
+    const uint8_t split = m->split[layer][layer_page];
+    if (split) {
+        const mem_page_t* page = &m->split_pages[split - 1][page_index % MEM_NUM_SPLIT_PAGES];
+        *read_ptr = page->read_ptr;
+        *write_ptr = page->write_ptr;
+    } else {
+        const mem_page_t* page = &m->layers[layer][layer_page];
+        if (page->read_ptr == 0) {
+            return false;
+        }
+        const size_t offset = (page_index % MEM_NUM_SPLIT_PAGES) * MEM_PAGE_SIZE;
+        *read_ptr = page->read_ptr + offset;
+        // All pages of a ROM share the junk page
+        *write_ptr = (page->write_ptr == _mem_junk_page) ? _mem_junk_page : page->write_ptr + offset;
+    }
+    return *read_ptr != 0;
+}
+
+static inline bool _mem_layer_page_mapped(const mem_t* m, size_t layer, size_t layer_page) {
+    return (m->split[layer][layer_page] != 0) || (m->layers[layer][layer_page].read_ptr != 0);
+}
+
+#ifdef MEM_TRACK_WRITES
+// Get the host pointers of a CPU-visible page
+static void _mem_visible_page(const mem_t* m, size_t page_index, uint8_t** read_ptr, uint8_t** write_ptr) {
+#ifdef MEM_FLAT_PAGE_TABLE
+    *read_ptr = m->page_table[page_index].read_ptr;
+    *write_ptr = m->page_table[page_index].write_ptr;
+#else
+    const size_t layer_page = page_index / MEM_NUM_SPLIT_PAGES;
+    const uint8_t fine = m->fine[layer_page];
+    if (fine) {
+        const mem_page_t* page = &m->fine_pages[fine - 1][page_index % MEM_NUM_SPLIT_PAGES];
+        *read_ptr = page->read_ptr;
+        *write_ptr = page->write_ptr;
+    } else {
+        const mem_page_t* page = &m->page_table[layer_page];
+        const size_t offset = (page_index % MEM_NUM_SPLIT_PAGES) * MEM_PAGE_SIZE;
+        *read_ptr = page->read_ptr + offset;
+        // Shared host memory not copied yet and ROM stay as they are
+        const bool keep = (page->write_ptr == 0) || (page->write_ptr == _mem_junk_page);
+        *write_ptr = keep ? page->write_ptr : page->write_ptr + offset;
+    }
+#endif
+}
+#endif
+
+// Split a layer page into MEM_PAGE_SIZE page items (if not split yet) and return them
+static mem_page_t* _mem_split(mem_t* m, size_t layer, size_t layer_page) {
+    if (m->split[layer][layer_page] == 0) {
+        size_t slot = 0;
+        while ((slot < MEM_MAX_SPLIT) && (m->split_used & (1U << slot))) {
+            slot++;
+        }
+        // Increase MEM_MAX_SPLIT when this fails
+        CHIPS_ASSERT(slot < MEM_MAX_SPLIT);
+        mem_page_t* pages = m->split_pages[slot];
+        for (size_t i = 0; i < MEM_NUM_SPLIT_PAGES; i++) {
+            if (!_mem_layer_page(m, layer, layer_page * MEM_NUM_SPLIT_PAGES + i, &pages[i].read_ptr,
+                                 &pages[i].write_ptr)) {
+                pages[i].read_ptr = 0;
+                pages[i].write_ptr = 0;
+            }
+        }
+        m->layers[layer][layer_page].read_ptr = 0;
+        m->layers[layer][layer_page].write_ptr = 0;
+        m->split[layer][layer_page] = (uint8_t)(slot + 1);
+        m->split_used |= 1U << slot;
+    }
+    return m->split_pages[m->split[layer][layer_page] - 1];
+}
+
+// Map a whole layer page with a single page item
+static void _mem_map_whole(mem_t* m, size_t layer, size_t layer_page, uint8_t* read_ptr, uint8_t* write_ptr) {
+    if (m->split[layer][layer_page]) {
+        m->split_used &= ~(1U << (m->split[layer][layer_page] - 1));
+        m->split[layer][layer_page] = 0;
+    }
+    m->layers[layer][layer_page].read_ptr = read_ptr;
+    m->layers[layer][layer_page].write_ptr = write_ptr;
+}
+
+// This sets the CPU-visible mapping of a layer page in the page-table
+static void _mem_update_page_table(mem_t* m, size_t layer_page) {
+    const size_t first = layer_page * MEM_NUM_SPLIT_PAGES;
+#ifdef MEM_TRACK_WRITES
+    // Host pages of written pages are logged when they are mapped out
+    const uint32_t written = (m->written[first >> 5] >> (first & 31)) & _MEM_SPLIT_BITS;
+    uint8_t* prev_write_ptrs[MEM_NUM_SPLIT_PAGES] = {0};
+    uint8_t* read_ptr;
+    for (size_t i = 0; written && (i < MEM_NUM_SPLIT_PAGES); i++) {
+        if (written & (1U << i)) {
+            _mem_visible_page(m, first + i, &read_ptr, &prev_write_ptrs[i]);
+        }
+    }
+#endif
     // Find highest priority layer which maps this memory page
     size_t layer_index;
     for (layer_index = 0; layer_index < MEM_NUM_LAYERS; layer_index++) {
-        if (m->layers[layer_index][page_index].read_ptr) {
-            // Found highest priority layer with valid mapping
+        if ((m->layer_mask & (1U << layer_index)) && _mem_layer_page_mapped(m, layer_index, layer_page)) {
+            // Found highest priority enabled layer with valid mapping
             break;
         }
     }
-    if (layer_index != MEM_NUM_LAYERS) {
-        // Found a valid mapping
-        //
-        // FIXME FIXME FIXME
-        //
-        // The following lines triggers a code generation problem in Xcode 14.2
-        // (also 14.0 and 14.1) resulting in a nullptr access because this line
-        // doesn't seem to be executed resulting in all read_ptr/write_ptr to be
-        // zero. Happens when called from within _kc85_update_memory_map() with
-        // at least -O2. After 2 days of investigation it's still unclear whether
-        // this is a bug in Clang or actual UB. A few facts from the investigation:
-        //
-        // - compiling with -fwrapv fixes the problem (yet no case of
-        //     signed integer overflow could be found going up the callstack,
-        //     UBSAN is also clean) - frwrapv seems to disable any loop unrolling
-        //     optimizations
-        // - replacing the struct assignment below with memcpy fixes the problem
-        // - __attribute__((noinline)) fixes the problem
-        // - compiling with UBSAN fixes the problem(!!!) (but neither UBSAN nor
-        //     ASAN trigger anything)
-        // - compiling with more recent clang versions (e.g. to WASM with Emscripten
-        //     or 'zig cc' also fixes the problem (but in the case of 'zig cc' it might
-        //     also be because zig uses different default compilation options?
-        //
-        // TODO: check again once Xcode 15 is released (assuming this finally updated
-        // clang)
-
-        // m->page_table[page_index] = m->layers[layer_index][page_index];
-
-        m->page_table[page_index].read_ptr = m->layers[layer_index][page_index].read_ptr;
-        m->page_table[page_index].write_ptr = m->layers[layer_index][page_index].write_ptr;
+    if ((layer_index == MEM_NUM_LAYERS) || (m->split[layer_index][layer_page] == 0)) {
+        // A single page item maps the whole page
+#ifdef MEM_FLAT_PAGE_TABLE
+        mem_page_t whole_page;
+        mem_page_t* page = &whole_page;
+#else
+        if (m->fine[layer_page]) {
+            m->fine_used &= ~(1U << (m->fine[layer_page] - 1));
+            m->fine[layer_page] = 0;
+        }
+        mem_page_t* page = &m->page_table[layer_page];
+#endif
+        if (layer_index != MEM_NUM_LAYERS) {
+            // Found a valid mapping
+            //
+            // FIXME FIXME FIXME
+            //
+            // The following lines triggers a code generation problem in Xcode 14.2
+            // (also 14.0 and 14.1) resulting in a nullptr access because this line
+            // doesn't seem to be executed resulting in all read_ptr/write_ptr to be
+            // zero. Happens when called from within _kc85_update_memory_map() with
+            // at least -O2. After 2 days of investigation it's still unclear whether
+            // this is a bug in Clang or actual UB. A few facts from the investigation:
+            //
+            // - compiling with -fwrapv fixes the problem (yet no case of
+            //     signed integer overflow could be found going up the callstack,
+            //     UBSAN is also clean) - frwrapv seems to disable any loop unrolling
+            //     optimizations
+            // - replacing the struct assignment below with memcpy fixes the problem
+            // - __attribute__((noinline)) fixes the problem
+            // - compiling with UBSAN fixes the problem(!!!) (but neither UBSAN nor
+            //     ASAN trigger anything)
+            // - compiling with more recent clang versions (e.g. to WASM with Emscripten
+            //     or 'zig cc' also fixes the problem (but in the case of 'zig cc' it might
+            //     also be because zig uses different default compilation options?
+            //
+            // TODO: check again once Xcode 15 is released (assuming this finally updated
+            // clang)
+
+            // m->page_table[layer_page] = m->layers[layer_index][layer_page];
+
+            page->read_ptr = m->layers[layer_index][layer_page].read_ptr;
+            page->write_ptr = m->layers[layer_index][layer_page].write_ptr;
+        } else {
+            // No mapping exists for this page, set to special 'unmapped page'
+            page->read_ptr = _mem_unmapped_page;
+            page->write_ptr = _mem_junk_page;
+        }
+#ifdef MEM_FLAT_PAGE_TABLE
+        for (size_t i = 0; i < MEM_NUM_SPLIT_PAGES; i++) {
+            const size_t offset = i * MEM_PAGE_SIZE;
+            mem_page_t* flat_page = &m->page_table[first + i];
+            flat_page->read_ptr = page->read_ptr + offset;
+            flat_page->write_ptr = (page->write_ptr == _mem_junk_page) ? _mem_junk_page : page->write_ptr + offset;
+#ifdef MEM_COPY_ON_WRITE
+            if (m->num_shared > 0) {
+                _mem_apply_shared(m, flat_page, MEM_PAGE_SIZE);
+            }
+#endif
+        }
+#elif defined(MEM_COPY_ON_WRITE)
+        if (m->num_shared > 0) {
+            _mem_apply_shared(m, page, MEM_LAYER_PAGE_SIZE);
+        }
+#endif
     } else {
-        // No mapping exists for this page, set to special 'unmapped page'
-        m->page_table[page_index].read_ptr = _mem_unmapped_page;
-        m->page_table[page_index].write_ptr = _mem_junk_page;
+        // The highest priority layer maps the page in pieces, compose it from MEM_PAGE_SIZE page items
+#ifdef MEM_FLAT_PAGE_TABLE
+        mem_page_t* pages = &m->page_table[first];
+#else
+        if (m->fine[layer_page] == 0) {
+            size_t slot = 0;
+            while (m->fine_used & (1U << slot)) {
+                slot++;
+            }
+            // There are never more split CPU-visible pages than split layer pages
+            CHIPS_ASSERT(slot < MEM_MAX_SPLIT);
+            m->fine[layer_page] = (uint8_t)(slot + 1);
+            m->fine_used |= 1U << slot;
+        }
+        mem_page_t* pages = m->fine_pages[m->fine[layer_page] - 1];
+#endif
+        const mem_page_t* split_pages = m->split_pages[m->split[layer_index][layer_page] - 1];
+        for (size_t i = 0; i < MEM_NUM_SPLIT_PAGES; i++) {
+            size_t layer = layer_index;
+            if (split_pages[i].read_ptr) {
+                pages[i] = split_pages[i];
+            } else {
+                // Fall back to the lower priority layers
+                for (layer = layer_index + 1; layer < MEM_NUM_LAYERS; layer++) {
+                    if ((m->layer_mask & (1U << layer)) &&
+                        _mem_layer_page(m, layer, first + i, &pages[i].read_ptr, &pages[i].write_ptr)) {
+                        break;
+                    }
+                }
+            }
+            if (layer == MEM_NUM_LAYERS) {
+                pages[i].read_ptr = _mem_unmapped_page;
+                pages[i].write_ptr = _mem_junk_page;
+            }
+#ifdef MEM_COPY_ON_WRITE
+            if (m->num_shared > 0) {
+                _mem_apply_shared(m, &pages[i], MEM_PAGE_SIZE);
+            }
+#endif
+        }
+    }
+#ifdef MEM_TRACK_WRITES
+    for (size_t i = 0; written && (i < MEM_NUM_SPLIT_PAGES); i++) {
+        uint8_t* write_ptr;
+        if (written & (1U << i)) {
+            _mem_visible_page(m, first + i, &read_ptr, &write_ptr);
+            if ((prev_write_ptrs[i] != write_ptr) && prev_write_ptrs[i]) {
+                _mem_log_written(m, first + i, prev_write_ptrs[i]);
+            }
+        }
+    }
+#endif
+}
+
+static void _mem_update_all(mem_t* m) {
+    for (size_t layer_page = 0; layer_page < MEM_NUM_LAYER_PAGES; layer_page++) {
+        _mem_update_page_table(m, layer_page);
     }
 }
 
+// Extend the range of layer pages a layer has mapped
+static void _mem_mark_mapped(mem_t* m, size_t layer, uint16_t addr, uint32_t size) {
+    if (size == 0) {
+        return;
+    }
+    size_t begin = addr >> MEM_LAYER_PAGE_SHIFT;
+    size_t end = ((addr + size - 1) >> MEM_LAYER_PAGE_SHIFT) + 1;
+    if (end > MEM_NUM_LAYER_PAGES) {
+        // Wraps around
+        begin = 0;
+        end = MEM_NUM_LAYER_PAGES;
+    }
+    if (m->mapped_begin[layer] != m->mapped_end[layer]) {
+        begin = (begin < m->mapped_begin[layer]) ? begin : m->mapped_begin[layer];
+        end = (end > m->mapped_end[layer]) ? end : m->mapped_end[layer];
+    }
+    m->mapped_begin[layer] = (uint16_t)begin;
+    m->mapped_end[layer] = (uint16_t)end;
+}
+
+// Check if page items map contiguous host memory, so a single layer page item can map them
+static bool _mem_contiguous(const mem_page_t* pages) {
+    if (pages[0].read_ptr == 0) {
+        return false;
+    }
+    const bool rom = pages[0].write_ptr == _mem_junk_page;
+    for (size_t i = 1; i < MEM_NUM_SPLIT_PAGES; i++) {
+        const size_t offset = i * MEM_PAGE_SIZE;
+        if ((pages[i].read_ptr != pages[0].read_ptr + offset) ||
+            (pages[i].write_ptr != (rom ? _mem_junk_page : pages[0].write_ptr + offset))) {
+            return false;
+        }
+    }
+    return true;
+}
+
 static void _mem_map(mem_t* m, size_t layer, uint16_t addr, uint32_t size, const uint8_t* read_ptr,
-                     uint8_t* write_ptr) {
+                     uint8_t* write_ptr, const mem_page_t* pages) {
     CHIPS_ASSERT(m);
     CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
     CHIPS_ASSERT((addr & MEM_PAGE_MASK) == 0);
@@ -265,69 +764,136 @@ static void _mem_map(mem_t* m, size_t layer, uint16_t addr, uint32_t size, const
     CHIPS_ASSERT(size <= MEM_ADDR_RANGE);
     const size_t num = size >> MEM_PAGE_SHIFT;
     CHIPS_ASSERT(num <= MEM_NUM_PAGES);
-    for (size_t i = 0; i < num; i++) {
-        const uint16_t offset = i * MEM_PAGE_SIZE;
+    const bool enabled = (m->layer_mask & (1U << layer)) != 0;
+    _mem_mark_mapped(m, layer, addr, size);
+    size_t i = 0;
+    while (i < num) {
+        const uint32_t offset = i * MEM_PAGE_SIZE;
         // The page_index will wrap-around
-        const uint16_t page_index = ((addr + offset) & MEM_ADDR_MASK) >> MEM_PAGE_SHIFT;
-        CHIPS_ASSERT(page_index <= MEM_NUM_PAGES);
-        mem_page_t* page = &m->layers[layer][page_index];
-        page->read_ptr = (uint8_t*)read_ptr + offset;
-        if (0 != write_ptr) {
-            page->write_ptr = write_ptr + offset;
+        const size_t page_index = ((addr + offset) & MEM_ADDR_MASK) >> MEM_PAGE_SHIFT;
+        CHIPS_ASSERT(page_index < MEM_NUM_PAGES);
+        const size_t layer_page = page_index / MEM_NUM_SPLIT_PAGES;
+        const bool whole = ((page_index % MEM_NUM_SPLIT_PAGES) == 0) && ((num - i) >= MEM_NUM_SPLIT_PAGES);
+        size_t num_mapped;
+        if (pages) {
+            // Page items from mem_copy_pages()
+            if (whole && _mem_contiguous(&pages[i])) {
+                _mem_map_whole(m, layer, layer_page, pages[i].read_ptr, pages[i].write_ptr);
+                num_mapped = MEM_NUM_SPLIT_PAGES;
+            } else {
+                _mem_split(m, layer, layer_page)[page_index % MEM_NUM_SPLIT_PAGES] = pages[i];
+                num_mapped = 1;
+            }
         } else {
-            page->write_ptr = _mem_junk_page;
+            uint8_t* page_read_ptr = (uint8_t*)read_ptr + offset;
+            uint8_t* page_write_ptr = (0 != write_ptr) ? (write_ptr + offset) : _mem_junk_page;
+            if (whole) {
+                // Whole layer page, a single page item
+                _mem_map_whole(m, layer, layer_page, page_read_ptr, page_write_ptr);
+                num_mapped = MEM_NUM_SPLIT_PAGES;
+            } else {
+                mem_page_t* page = &_mem_split(m, layer, layer_page)[page_index % MEM_NUM_SPLIT_PAGES];
+                page->read_ptr = page_read_ptr;
+                page->write_ptr = page_write_ptr;
+                num_mapped = 1;
+            }
+        }
+        i += num_mapped;
+        // Update the CPU-visible page once all pieces of this layer page are mapped
+        if (enabled && ((i == num) || (((page_index + num_mapped) % MEM_NUM_SPLIT_PAGES) == 0))) {
+            _mem_update_page_table(m, layer_page);
         }
-        _mem_update_page_table(m, page_index);
     }
 }
 
 void mem_map_ram(mem_t* m, size_t layer, uint16_t addr, uint32_t size, uint8_t* ptr) {
     CHIPS_ASSERT(ptr);
-    _mem_map(m, layer, addr, size, ptr, ptr);
+    _mem_map(m, layer, addr, size, ptr, ptr, 0);
 }
 
 void mem_map_rom(mem_t* m, size_t layer, uint16_t addr, uint32_t size, const uint8_t* ptr) {
     CHIPS_ASSERT(ptr);
-    _mem_map(m, layer, addr, size, ptr, 0);
+    _mem_map(m, layer, addr, size, ptr, 0, 0);
 }
 
 void mem_map_rw(mem_t* m, size_t layer, uint16_t addr, uint32_t size, const uint8_t* read_ptr, uint8_t* write_ptr) {
     CHIPS_ASSERT(read_ptr && write_ptr);
-    _mem_map(m, layer, addr, size, read_ptr, write_ptr);
+    _mem_map(m, layer, addr, size, read_ptr, write_ptr, 0);
+}
+
+void mem_copy_pages(const mem_t* m, size_t layer, uint16_t addr, uint32_t size, mem_page_t* dst) {
+    CHIPS_ASSERT(m && dst);
+    CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
+    CHIPS_ASSERT(((addr & MEM_PAGE_MASK) == 0) && ((size & MEM_PAGE_MASK) == 0) && ((addr + size) <= MEM_ADDR_RANGE));
+    for (size_t i = 0; i < (size >> MEM_PAGE_SHIFT); i++) {
+        if (!_mem_layer_page(m, layer, (addr >> MEM_PAGE_SHIFT) + i, &dst[i].read_ptr, &dst[i].write_ptr)) {
+            dst[i].read_ptr = 0;
+            dst[i].write_ptr = 0;
+        }
+    }
+}
+
+void mem_map_pages(mem_t* m, size_t layer, uint16_t addr, uint32_t size, const mem_page_t* pages) {
+    CHIPS_ASSERT(pages);
+    CHIPS_ASSERT((addr + size) <= MEM_ADDR_RANGE);
+    _mem_map(m, layer, addr, size, 0, 0, pages);
 }
 
 void mem_unmap_layer(mem_t* m, size_t layer) {
     CHIPS_ASSERT(m);
     CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
-    for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
-        mem_page_t* page = &m->layers[layer][page_index];
-        page->read_ptr = 0;
-        page->write_ptr = 0;
-        _mem_update_page_table(m, page_index);
+    memset(m->layers[layer], 0, sizeof(m->layers[layer]));
+    for (size_t layer_page = 0; layer_page < MEM_NUM_LAYER_PAGES; layer_page++) {
+        if (m->split[layer][layer_page]) {
+            m->split_used &= ~(1U << (m->split[layer][layer_page] - 1));
+        }
     }
+    memset(m->split[layer], 0, sizeof(m->split[layer]));
+    m->mapped_begin[layer] = m->mapped_end[layer] = 0;
+    _mem_update_all(m);
 }
 
-void mem_unmap_all(mem_t* m) {
-    for (size_t layer_index = 0; layer_index < MEM_NUM_LAYERS; layer_index++) {
-        for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
-            mem_page_t* page = &m->layers[layer_index][page_index];
-            page->read_ptr = 0;
-            page->write_ptr = 0;
-        }
+void mem_enable_layer(mem_t* m, size_t layer, bool enabled) {
+    CHIPS_ASSERT(m);
+    CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
+    const uint32_t bit = 1U << layer;
+    if (((m->layer_mask & bit) != 0) == enabled) {
+        return;
     }
-    for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
-        _mem_update_page_table(m, page_index);
+    m->layer_mask ^= bit;
+    // Only the pages the layer maps change
+    for (size_t layer_page = m->mapped_begin[layer]; layer_page < m->mapped_end[layer]; layer_page++) {
+        if (_mem_layer_page_mapped(m, layer, layer_page)) {
+            _mem_update_page_table(m, layer_page);
+        }
     }
 }
 
+void mem_unmap_all(mem_t* m) {
+    memset(m->layers, 0, sizeof(m->layers));
+    memset(m->split, 0, sizeof(m->split));
+    m->split_used = 0;
+    memset(m->mapped_begin, 0, sizeof(m->mapped_begin));
+    memset(m->mapped_end, 0, sizeof(m->mapped_end));
+    _mem_update_all(m);
+}
+
 uint8_t* mem_readptr(mem_t* m, uint16_t addr) {
     CHIPS_ASSERT(m);
-    return (uint8_t*)&(m->page_table[addr >> MEM_PAGE_SHIFT].read_ptr[addr & MEM_PAGE_MASK]);
+    uint32_t offset;
+    return &mem_page_item(m, addr, &offset)->read_ptr[offset];
 }
 
 uint8_t* mem_writeptr(mem_t* m, uint16_t addr) {
     CHIPS_ASSERT(m);
-    return (uint8_t*)&(m->page_table[addr >> MEM_PAGE_SHIFT].write_ptr[addr & MEM_PAGE_MASK]);
+    uint32_t offset;
+    uint8_t* write_ptr = mem_page_item(m, addr, &offset)->write_ptr;
+#ifdef MEM_COPY_ON_WRITE
+    if (!write_ptr) {
+        return mem_copy_on_write(m, addr);
+    }
+#endif
+    return &write_ptr[offset];
 }
 
 void mem_write_range(mem_t* m, uint16_t addr, const uint8_t* src, uint32_t num_bytes) {
@@ -336,10 +902,175 @@ void mem_write_range(mem_t* m, uint16_t addr, const uint8_t* src, uint32_t num_b
     }
 }
 
+void mem_set_page_flags(mem_t* m, uint16_t addr, uint32_t size, uint8_t flags) {
+    CHIPS_ASSERT(m && (size <= MEM_ADDR_RANGE));
+    if (size == 0) {
+        return;
+    }
+    const size_t first = addr >> MEM_PAGE_SHIFT;
+    const size_t num = (((addr & MEM_PAGE_MASK) + size - 1) >> MEM_PAGE_SHIFT) + 1;
+    for (size_t i = 0; (i < num) && (i < MEM_NUM_PAGES); i++) {
+        m->page_flags[(first + i) & (MEM_NUM_PAGES - 1)] |= flags;
+    }
+}
+
+void mem_clear_page_flags(mem_t* m, uint8_t flags) {
+    CHIPS_ASSERT(m);
+    for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
+        m->page_flags[page_index] &= ~flags;
+    }
+}
+
+#ifdef MEM_TRACK_WRITES
+bool mem_collect_written(mem_t* m, mem_written_func_t func, void* user_data) {
+    CHIPS_ASSERT(m && func);
+    for (int i = 0; i < m->num_written_log; i++) {
+        func(m->written_log[i], user_data);
+    }
+    for (size_t page_index = 0; page_index < MEM_NUM_PAGES; page_index++) {
+        if (m->written[page_index >> 5] & (1U << (page_index & 31))) {
+            uint8_t* read_ptr;
+            uint8_t* write_ptr;
+            _mem_visible_page(m, page_index, &read_ptr, &write_ptr);
+            func(write_ptr, user_data);
+        }
+    }
+    const bool complete = !m->written_lost;
+    mem_clear_written(m);
+    return complete;
+}
+
+void mem_clear_written(mem_t* m) {
+    CHIPS_ASSERT(m);
+    memset(m->written, 0, sizeof(m->written));
+    m->num_written_log = 0;
+    m->written_lost = false;
+}
+#endif
+
+#ifdef MEM_COPY_ON_WRITE
+// Copy a piece of shared host memory which hasn't been copied yet and update the page items mapping it
+static void _mem_copy_shared(mem_t* m, mem_shared_t* shared, uint32_t shared_page) {
+    const size_t offset = shared_page * MEM_LAYER_PAGE_SIZE;
+    memcpy(shared->ptr + offset, shared->src + offset, MEM_LAYER_PAGE_SIZE);
+    shared->pending[shared_page >> 5] &= ~(1U << (shared_page & 31));
+    // Other CPU-visible pages may map the same host memory
+    _mem_update_all(m);
+}
+
+void mem_share(mem_t* m, uint8_t* ptr, const uint8_t* src, uint32_t size) {
+    CHIPS_ASSERT(m && ptr && src && (m->num_shared < MEM_MAX_SHARED));
+    CHIPS_ASSERT(((size & MEM_LAYER_PAGE_MASK) == 0) && (size <= MEM_ADDR_RANGE));
+    mem_shared_t* shared = &m->shared[m->num_shared++];
+    shared->ptr = ptr;
+    shared->src = src;
+    shared->size = size;
+    memset(shared->pending, 0, sizeof(shared->pending));
+    for (uint32_t i = 0; i < (size >> MEM_LAYER_PAGE_SHIFT); i++) {
+        shared->pending[i >> 5] |= 1U << (i & 31);
+    }
+    _mem_update_all(m);
+}
+
+void mem_unshare(mem_t* m) {
+    CHIPS_ASSERT(m);
+    if (m->num_shared == 0) {
+        return;
+    }
+    for (int i = 0; i < m->num_shared; i++) {
+        mem_shared_t* shared = &m->shared[i];
+        for (uint32_t page = 0; page < (shared->size >> MEM_LAYER_PAGE_SHIFT); page++) {
+            if (_mem_shared_pending(shared, page)) {
+                const size_t offset = page * MEM_LAYER_PAGE_SIZE;
+                memcpy(shared->ptr + offset, shared->src + offset, MEM_LAYER_PAGE_SIZE);
+            }
+        }
+    }
+    memset(m->shared, 0, sizeof(m->shared));
+    m->num_shared = 0;
+    _mem_update_all(m);
+}
+
+uint8_t* mem_copy_on_write(mem_t* m, uint16_t addr) {
+    CHIPS_ASSERT(m);
+    // The layers hold the host pointers of this instance
+    uint8_t* read_ptr = 0;
+    uint8_t* write_ptr = 0;
+    for (size_t layer_index = 0; layer_index < MEM_NUM_LAYERS; layer_index++) {
+        if ((m->layer_mask & (1U << layer_index)) &&
+            _mem_layer_page(m, layer_index, addr >> MEM_PAGE_SHIFT, &read_ptr, &write_ptr)) {
+            break;
+        }
+    }
+    mem_shared_t* shared = 0;
+    uint32_t shared_page = 0;
+    if (!_mem_find_shared(m, write_ptr, &shared, &shared_page)) {
+        CHIPS_ASSERT(false);
+        return _mem_junk_page;
+    }
+    CHIPS_ASSERT(_mem_shared_pending(shared, shared_page));
+    _mem_copy_shared(m, shared, shared_page);
+    return write_ptr + (addr & MEM_PAGE_MASK);
+}
+#else
+void mem_unshare(mem_t* m) {
+    // Nothing is ever shared
+    (void)m;
+}
+#endif
+
+static void _mem_relocate_ptr(uint8_t** ptr, uintptr_t old_base, size_t size, uint8_t* new_base) {
+    const uintptr_t offset = (uintptr_t)*ptr - old_base;
+    if (offset < size) {
+        *ptr = new_base + offset;
+    }
+}
+
+void mem_relocate(mem_t* m, const void* old_base, size_t size, void* new_base) {
+    CHIPS_ASSERT(m && old_base && new_base);
+    const uintptr_t old = (uintptr_t)old_base;
+    for (size_t page = 0; page < _MEM_NUM_TABLE_PAGES; page++) {
+        _mem_relocate_ptr(&m->page_table[page].read_ptr, old, size, new_base);
+        _mem_relocate_ptr(&m->page_table[page].write_ptr, old, size, new_base);
+    }
+#ifndef MEM_FLAT_PAGE_TABLE
+    for (size_t fine = 0; fine < MEM_MAX_SPLIT; fine++) {
+        for (size_t page = 0; page < MEM_NUM_SPLIT_PAGES; page++) {
+            _mem_relocate_ptr(&m->fine_pages[fine][page].read_ptr, old, size, new_base);
+            _mem_relocate_ptr(&m->fine_pages[fine][page].write_ptr, old, size, new_base);
+        }
+    }
+#endif
+    for (size_t layer = 0; layer < MEM_NUM_LAYERS; layer++) {
+        for (size_t page = 0; page < MEM_NUM_LAYER_PAGES; page++) {
+            _mem_relocate_ptr(&m->layers[layer][page].read_ptr, old, size, new_base);
+            _mem_relocate_ptr(&m->layers[layer][page].write_ptr, old, size, new_base);
+        }
+    }
+    for (size_t split = 0; split < MEM_MAX_SPLIT; split++) {
+        for (size_t page = 0; page < MEM_NUM_SPLIT_PAGES; page++) {
+            _mem_relocate_ptr(&m->split_pages[split][page].read_ptr, old, size, new_base);
+            _mem_relocate_ptr(&m->split_pages[split][page].write_ptr, old, size, new_base);
+        }
+    }
+#ifdef MEM_TRACK_WRITES
+    for (int i = 0; i < m->num_written_log; i++) {
+        _mem_relocate_ptr(&m->written_log[i], old, size, new_base);
+    }
+#endif
+#ifdef MEM_COPY_ON_WRITE
+    for (int i = 0; i < m->num_shared; i++) {
+        _mem_relocate_ptr(&m->shared[i].ptr, old, size, new_base);
+    }
+#endif
+}
+
 uint8_t mem_layer_rd(mem_t* mem, size_t layer, uint16_t addr) {
     CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
-    if (mem->layers[layer][addr >> MEM_PAGE_SHIFT].read_ptr) {
-        return mem->layers[layer][addr >> MEM_PAGE_SHIFT].read_ptr[addr & MEM_PAGE_MASK];
+    uint8_t* read_ptr;
+    uint8_t* write_ptr;
+    if (_mem_layer_page(mem, layer, addr >> MEM_PAGE_SHIFT, &read_ptr, &write_ptr)) {
+        return *mem_shared_ptr(mem, &read_ptr[addr & MEM_PAGE_MASK]);
     } else {
         return 0xFF;
     }
@@ -347,8 +1078,18 @@ uint8_t mem_layer_rd(mem_t* mem, size_t layer, uint16_t addr) {
 
 void mem_layer_wr(mem_t* mem, size_t layer, uint16_t addr, uint8_t data) {
     CHIPS_ASSERT(layer < MEM_NUM_LAYERS);
-    if (mem->layers[layer][addr >> MEM_PAGE_SHIFT].write_ptr) {
-        mem->layers[layer][addr >> MEM_PAGE_SHIFT].write_ptr[addr & MEM_PAGE_MASK] = data;
+    uint8_t* read_ptr;
+    uint8_t* write_ptr;
+    if (_mem_layer_page(mem, layer, addr >> MEM_PAGE_SHIFT, &read_ptr, &write_ptr)) {
+#ifdef MEM_COPY_ON_WRITE
+        // The host page may be behind the CPU-visible mapping, copy only the shared piece written to
+        mem_shared_t* shared;
+        uint32_t shared_page;
+        if (_mem_find_shared(mem, write_ptr, &shared, &shared_page) && _mem_shared_pending(shared, shared_page)) {
+            _mem_copy_shared(mem, shared, shared_page);
+        }
+#endif
+        write_ptr[addr & MEM_PAGE_MASK] = data;
     }
 }
 
@@ -365,8 +1106,8 @@ static void mem_ptr_to_offset(uint8_t** ptr_ptr, uint8_t* base) {
     } else if (ptr == _mem_junk_page) {
         *ptr_ptr = (uint8_t*)(intptr_t)MEM_SPECIAL_OFFSET_JUNK_PAGE;
     } else {
-        CHIPS_ASSERT(base <= *ptr_ptr);
-        *ptr_ptr = (uint8_t*)(*ptr_ptr - base);
+        // ROMs may live outside the system struct, so the offset can be negative
+        *ptr_ptr = (uint8_t*)((intptr_t)ptr - (intptr_t)base);
     }
 }
 
@@ -383,37 +1124,76 @@ static void mem_offset_to_ptr(uint8_t** ptr_ptr, uint8_t* base) {
             *ptr_ptr = _mem_junk_page;
             break;
         default:
-            *ptr_ptr = (base + offset);
+            *ptr_ptr = (uint8_t*)((intptr_t)base + offset);
             break;
     }
 }
 
 void mem_snapshot_onsave(mem_t* snapshot, void* base) {
     uint8_t* base8 = (uint8_t*)base;
-    for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
+#ifdef MEM_TRACK_WRITES
+    // Written pages are not part of a snapshot, report all memory as written after loading
+    memset(snapshot->written, 0, sizeof(snapshot->written));
+    memset(snapshot->written_log, 0, sizeof(snapshot->written_log));
+    snapshot->num_written_log = 0;
+    snapshot->written_lost = true;
+#endif
+#ifdef MEM_COPY_ON_WRITE
+    // Shared memory is not part of a snapshot (call mem_unshare() before taking one)
+    CHIPS_ASSERT(snapshot->num_shared == 0);
+#endif
+    for (size_t page = 0; page < _MEM_NUM_TABLE_PAGES; page++) {
         mem_ptr_to_offset(&snapshot->page_table[page].read_ptr, base8);
         mem_ptr_to_offset(&snapshot->page_table[page].write_ptr, base8);
     }
+#ifndef MEM_FLAT_PAGE_TABLE
+    for (size_t fine = 0; fine < MEM_MAX_SPLIT; fine++) {
+        for (size_t page = 0; page < MEM_NUM_SPLIT_PAGES; page++) {
+            mem_ptr_to_offset(&snapshot->fine_pages[fine][page].read_ptr, base8);
+            mem_ptr_to_offset(&snapshot->fine_pages[fine][page].write_ptr, base8);
+        }
+    }
+#endif
     for (size_t layer = 0; layer < MEM_NUM_LAYERS; layer++) {
-        for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
+        for (size_t page = 0; page < MEM_NUM_LAYER_PAGES; page++) {
             mem_ptr_to_offset(&snapshot->layers[layer][page].read_ptr, base8);
             mem_ptr_to_offset(&snapshot->layers[layer][page].write_ptr, base8);
         }
     }
+    for (size_t split = 0; split < MEM_MAX_SPLIT; split++) {
+        for (size_t page = 0; page < MEM_NUM_SPLIT_PAGES; page++) {
+            mem_ptr_to_offset(&snapshot->split_pages[split][page].read_ptr, base8);
+            mem_ptr_to_offset(&snapshot->split_pages[split][page].write_ptr, base8);
+        }
+    }
 }
 
 void mem_snapshot_onload(mem_t* snapshot, void* base) {
     uint8_t* base8 = (uint8_t*)base;
-    for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
+    for (size_t page = 0; page < _MEM_NUM_TABLE_PAGES; page++) {
         mem_offset_to_ptr(&snapshot->page_table[page].read_ptr, base8);
         mem_offset_to_ptr(&snapshot->page_table[page].write_ptr, base8);
     }
+#ifndef MEM_FLAT_PAGE_TABLE
+    for (size_t fine = 0; fine < MEM_MAX_SPLIT; fine++) {
+        for (size_t page = 0; page < MEM_NUM_SPLIT_PAGES; page++) {
+            mem_offset_to_ptr(&snapshot->fine_pages[fine][page].read_ptr, base8);
+            mem_offset_to_ptr(&snapshot->fine_pages[fine][page].write_ptr, base8);
+        }
+    }
+#endif
     for (size_t layer = 0; layer < MEM_NUM_LAYERS; layer++) {
-        for (size_t page = 0; page < MEM_NUM_PAGES; page++) {
+        for (size_t page = 0; page < MEM_NUM_LAYER_PAGES; page++) {
             mem_offset_to_ptr(&snapshot->layers[layer][page].read_ptr, base8);
             mem_offset_to_ptr(&snapshot->layers[layer][page].write_ptr, base8);
         }
     }
+    for (size_t split = 0; split < MEM_MAX_SPLIT; split++) {
+        for (size_t page = 0; page < MEM_NUM_SPLIT_PAGES; page++) {
+            mem_offset_to_ptr(&snapshot->split_pages[split][page].read_ptr, base8);
+            mem_offset_to_ptr(&snapshot->split_pages[split][page].write_ptr, base8);
+        }
+    }
 }
 
 #endif  // CHIPS_IMPL
@@ -181,6 +181,64 @@
 // ~~~
 //     Set and get 6502 registers and flags.
 //
+// ## Instruction Trace
+//
+// Define MOS6502CPU_TRACE before including this file to record the last
+// MOS6502CPU_TRACE_SIZE executed instructions (default: 256, must be a power
+// of 2) in a ring buffer inside mos6502cpu_t. Each entry holds the opcode
+// address, the opcode, the A/X/Y/S/P registers and the CPU tick stamp at the
+// time the opcode was fetched. Recording happens only on SYNC and costs a
+// handful of stores per instruction. When MOS6502CPU_TRACE is not defined,
+// the trace code is compiled out completely.
+//
+// ~~~C
+// int mos6502cpu_trace_get(const mos6502cpu_t* c, mos6502cpu_trace_item_t* items, int num)
+// ~~~
+//     Copy the last 'num' recorded instructions into 'items', oldest first.
+//     Returns the number of copied items (less than 'num' if fewer
+//     instructions have been executed).
+//
+// ~~~C
+// void mos6502cpu_trace_dump(const mos6502cpu_t* c, int num)
+// ~~~
+//     Print the last 'num' recorded instructions to stdout, for instance
+//     after a guest crash was detected.
+//
+// ## Guest Code Profiler
+//
+// Define MOS6502CPU_PROFILE before including this file to compile in an
+// exact per-PC cycle profiler. The profiler state lives in a separate
+// (large) mos6502cpu_profile_t structure which is attached to the CPU
+// through mos6502cpu_t.profile, profiling is inactive while this pointer
+// is null. For each executed tick, the cycle counter of the currently
+// executing instruction is incremented. The counters are kept per bank,
+// bank_map[] maps each 4 KB region of the CPU address space to a bank index
+// (up to MOS6502CPU_PROFILE_MAX_BANKS, default: 8) and must be kept up to
+// date by the system emulation when it switches memory banks. Additionally
+// all JSR and RTS instructions are recorded as call/return edges.
+//
+// ~~~C
+// void mos6502cpu_profile_reset(mos6502cpu_profile_t* p)
+// ~~~
+//     Clear all cycle counters and edges (the bank map is preserved).
+//
+// ~~~C
+// void mos6502cpu_profile_report(const mos6502cpu_profile_t* p, const mos6502cpu_profile_symbol_t* symbols, int num_symbols, int num_entries)
+// ~~~
+//     Print the 'num_entries' hottest routines, addresses and call edges
+//     to stdout. Addresses are annotated with the closest preceding symbol
+//     in the same bank. The symbol table must be sorted by bank and address.
+//
+// ## State Files
+//
+// ~~~C
+// void mos6502cpu_save_state(const mos6502cpu_t* c, chips_state_writer_t* w)
+// bool mos6502cpu_load_state(mos6502cpu_t* c, chips_state_reader_t* r)
+// ~~~
+//     Write the registers, flags and pins as a MOS6502CPU_STATE_ID chunk of
+//     a portable state file, and read them back from such a chunk. Include
+//     chips/chips_common.h before this file to use them.
+//
 //
 // ## zlib/libpng license
 //
@@ -215,10 +273,16 @@ extern "C" {
 #define MOS6502CPU_TICK(c)           mos6502cpu_tick(c)
 #define MOS6502CPU_GET_ADDR(c)       ((c)->addr)
 #define MOS6502CPU_GET_DATA(c)       ((c)->data)
+#define MOS6502CPU_GET_SYNC(c)       ((c)->sync)
 #define MOS6502CPU_SET_DATA(c, d)    ((c)->data = d)
 #define MOS6502CPU_SET_IRQ(c, state) ((c)->irq = state)
 #define MOS6510CPU_SET_PORT(c, p)    ((c)->port = p)
 #define MOS6510CPU_CHECK_IO(c)       (((c)->addr & 0xFFFEULL) == 0)
+#define MOS6502CPU_SAVE_STATE(c, w)  mos6502cpu_save_state(c, w)
+#define MOS6502CPU_LOAD_STATE(c, r)  mos6502cpu_load_state(c, r)
+
+// State file chunk id
+#define MOS6502CPU_STATE_ID CHIPS_STATE_ID('C', 'P', 'U', ' ')
 
 // IO port callback prototypes (mos6510cpu)
 typedef void (*mos6510cpu_out_t)(uint8_t data, void* user_data);
@@ -234,6 +298,71 @@ typedef struct {
     uint8_t mos6510cpu_io_floating;      // Unconnected IO port pins
 } mos6502cpu_desc_t;
 
+#ifdef MOS6502CPU_TRACE
+#ifndef MOS6502CPU_TRACE_SIZE
+#define MOS6502CPU_TRACE_SIZE (256)
+#endif
+
+// Instruction trace item, recorded at the start of each instruction
+typedef struct {
+    uint32_t tick;    // CPU tick stamp
+    uint16_t pc;      // Address of the opcode
+    uint8_t opcode;   // Opcode byte
+    uint8_t a, x, y;  // Registers before the instruction executes
+    uint8_t s, p;     // Stack pointer and status register
+} mos6502cpu_trace_item_t;
+
+// Instruction trace ring buffer
+typedef struct {
+    uint32_t tick;  // Running CPU tick counter
+    uint32_t head;  // Total number of recorded instructions
+    mos6502cpu_trace_item_t items[MOS6502CPU_TRACE_SIZE];
+} mos6502cpu_trace_t;
+#endif
+
+#ifdef MOS6502CPU_PROFILE
+#ifndef MOS6502CPU_PROFILE_MAX_BANKS
+#define MOS6502CPU_PROFILE_MAX_BANKS (8)
+#endif
+#ifndef MOS6502CPU_PROFILE_MAX_EDGES
+#define MOS6502CPU_PROFILE_MAX_EDGES (4096)
+#endif
+
+#define MOS6502CPU_PROFILE_EDGE_CALL   (1)  // JSR
+#define MOS6502CPU_PROFILE_EDGE_RETURN (2)  // RTS
+
+// Call or return edge
+typedef struct {
+    uint16_t from;   // Address of the JSR/RTS instruction
+    uint16_t to;     // Address of the next executed instruction
+    uint8_t bank;     // Bank of the JSR/RTS instruction
+    uint8_t to_bank;  // Bank of the next executed instruction
+    uint8_t type;     // MOS6502CPU_PROFILE_EDGE_CALL or MOS6502CPU_PROFILE_EDGE_RETURN
+    uint32_t count;   // Number of times the edge was taken
+} mos6502cpu_profile_edge_t;
+
+// Symbol for annotating profiler reports
+typedef struct {
+    uint8_t bank;
+    uint16_t addr;
+    const char* name;
+} mos6502cpu_profile_symbol_t;
+
+// Profiler state, attach to mos6502cpu_t.profile to enable profiling
+typedef struct {
+    uint8_t bank_map[16];  // Bank index for each 4 KB region, set by the system emulation
+    uint32_t* cur;         // Cycle counter of the currently executing instruction
+    uint32_t dummy;        // Target of cur before the first instruction
+    uint16_t last_pc;
+    uint8_t last_bank;
+    uint8_t last_opcode;
+    uint32_t num_edges;
+    uint32_t dropped_edges;  // Number of edges which didn't fit into edges[]
+    mos6502cpu_profile_edge_t edges[MOS6502CPU_PROFILE_MAX_EDGES];
+    uint32_t cycles[MOS6502CPU_PROFILE_MAX_BANKS][1 << 16];
+} mos6502cpu_profile_t;
+#endif
+
 // CPU internal state
 typedef struct {
     uint16_t IR;         // Internal instruction register
@@ -285,6 +414,12 @@ typedef struct {
 
     bool nmi_triggered;
 
+#ifdef MOS6502CPU_TRACE
+    mos6502cpu_trace_t trace;
+#endif
+#ifdef MOS6502CPU_PROFILE
+    mos6502cpu_profile_t* profile;  // Optional profiler state, null if not profiling
+#endif
 } mos6502cpu_t;
 
 // Initialize a new mos6502cpu instance
@@ -297,6 +432,23 @@ void mos6510cpu_iorq(mos6502cpu_t* c);
 void mos6502cpu_snapshot_onsave(mos6502cpu_t* snapshot);
 // Fixup mos6502cpu_t snapshot after loading
 void mos6502cpu_snapshot_onload(mos6502cpu_t* snapshot, mos6502cpu_t* c);
+// Write the CPU state chunk to a state file
+void mos6502cpu_save_state(const mos6502cpu_t* c, chips_state_writer_t* w);
+// Read the current state file chunk (MOS6502CPU_STATE_ID), returns false if it's invalid
+bool mos6502cpu_load_state(mos6502cpu_t* c, chips_state_reader_t* r);
+#ifdef MOS6502CPU_TRACE
+// Copy the last num traced instructions into items (oldest first), returns number of items copied
+int mos6502cpu_trace_get(const mos6502cpu_t* c, mos6502cpu_trace_item_t* items, int num);
+// Print the last num traced instructions to stdout
+void mos6502cpu_trace_dump(const mos6502cpu_t* c, int num);
+#endif
+#ifdef MOS6502CPU_PROFILE
+// Clear profiler counters and edges
+void mos6502cpu_profile_reset(mos6502cpu_profile_t* p);
+// Print profiler report to stdout, symbols must be sorted by bank and address
+void mos6502cpu_profile_report(const mos6502cpu_profile_t* p, const mos6502cpu_profile_symbol_t* symbols,
+                               int num_symbols, int num_entries);
+#endif
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -309,6 +461,9 @@ void mos6502cpu_snapshot_onload(mos6502cpu_t* snapshot, mos6502cpu_t* c);
 #include <assert.h>
 #define CHIPS_ASSERT(c) assert(c)
 #endif
+#if defined(MOS6502CPU_TRACE) || defined(MOS6502CPU_PROFILE)
+#include <stdio.h>
+#endif
 
 // Set 16-bit address
 #define _SA(a) (c->addr = a)
@@ -591,6 +746,9 @@ void mos6502cpu_snapshot_onsave(mos6502cpu_t* snapshot) {
     snapshot->in_cb = 0;
     snapshot->out_cb = 0;
     snapshot->user_data = 0;
+#ifdef MOS6502CPU_PROFILE
+    snapshot->profile = 0;
+#endif
 }
 
 void mos6502cpu_snapshot_onload(mos6502cpu_t* snapshot, mos6502cpu_t* c) {
@@ -598,14 +756,292 @@ void mos6502cpu_snapshot_onload(mos6502cpu_t* snapshot, mos6502cpu_t* c) {
     snapshot->in_cb = c->in_cb;
     snapshot->out_cb = c->out_cb;
     snapshot->user_data = c->user_data;
+#ifdef MOS6502CPU_PROFILE
+    snapshot->profile = c->profile;
+#endif
+}
+
+void mos6502cpu_save_state(const mos6502cpu_t* c, chips_state_writer_t* w) {
+    CHIPS_ASSERT(c && w);
+    chips_state_begin_chunk(w, MOS6502CPU_STATE_ID, 1);
+    chips_state_put16(w, c->IR);
+    chips_state_put16(w, c->PC);
+    chips_state_put16(w, c->AD);
+    chips_state_put8(w, c->A);
+    chips_state_put8(w, c->X);
+    chips_state_put8(w, c->Y);
+    chips_state_put8(w, c->S);
+    chips_state_put16(w, c->irq_pip);
+    chips_state_put16(w, c->nmi_pip);
+    chips_state_put8(w, c->bcd_enabled);
+    chips_state_put8(w, c->io_ddr);
+    chips_state_put8(w, c->io_inp);
+    chips_state_put8(w, c->io_out);
+    chips_state_put8(w, c->io_pins);
+    chips_state_put8(w, c->io_drive);
+    const bool flags[] = {c->cf, c->zf, c->iflag, c->df, c->bf, c->xf, c->vf, c->nf, c->brk_irq, c->brk_nmi,
+                          c->brk_reset, c->rw, c->sync, c->irq, c->nmi, c->rdy, c->res, c->nmi_triggered};
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        chips_state_put_bool(w, flags[i]);
+    }
+    chips_state_put16(w, c->addr);
+    chips_state_put8(w, c->data);
+    chips_state_put8(w, c->port);
+    chips_state_end_chunk(w);
+}
+
+bool mos6502cpu_load_state(mos6502cpu_t* c, chips_state_reader_t* r) {
+    CHIPS_ASSERT(c && r && (r->chunk_id == MOS6502CPU_STATE_ID));
+    c->IR = chips_state_get16(r);
+    c->PC = chips_state_get16(r);
+    c->AD = chips_state_get16(r);
+    c->A = chips_state_get8(r);
+    c->X = chips_state_get8(r);
+    c->Y = chips_state_get8(r);
+    c->S = chips_state_get8(r);
+    c->irq_pip = chips_state_get16(r);
+    c->nmi_pip = chips_state_get16(r);
+    c->bcd_enabled = chips_state_get8(r);
+    c->io_ddr = chips_state_get8(r);
+    c->io_inp = chips_state_get8(r);
+    c->io_out = chips_state_get8(r);
+    c->io_pins = chips_state_get8(r);
+    c->io_drive = chips_state_get8(r);
+    bool* flags[] = {&c->cf, &c->zf, &c->iflag, &c->df, &c->bf, &c->xf, &c->vf, &c->nf, &c->brk_irq, &c->brk_nmi,
+                     &c->brk_reset, &c->rw, &c->sync, &c->irq, &c->nmi, &c->rdy, &c->res, &c->nmi_triggered};
+    for (size_t i = 0; i < sizeof(flags) / sizeof(flags[0]); i++) {
+        *flags[i] = chips_state_get_bool(r);
+    }
+    c->addr = chips_state_get16(r);
+    c->data = chips_state_get8(r);
+    c->port = chips_state_get8(r);
+    return r->ok;
+}
+
+#ifdef MOS6502CPU_TRACE
+int mos6502cpu_trace_get(const mos6502cpu_t* c, mos6502cpu_trace_item_t* items, int num) {
+    CHIPS_ASSERT(c && items && (num >= 0));
+    CHIPS_ASSERT((MOS6502CPU_TRACE_SIZE & (MOS6502CPU_TRACE_SIZE - 1)) == 0);
+    uint32_t avail = c->trace.head < MOS6502CPU_TRACE_SIZE ? c->trace.head : MOS6502CPU_TRACE_SIZE;
+    if ((uint32_t)num > avail) {
+        num = (int)avail;
+    }
+    uint32_t pos = c->trace.head - (uint32_t)num;
+    for (int i = 0; i < num; i++, pos++) {
+        items[i] = c->trace.items[pos & (MOS6502CPU_TRACE_SIZE - 1)];
+    }
+    return num;
+}
+
+void mos6502cpu_trace_dump(const mos6502cpu_t* c, int num) {
+    CHIPS_ASSERT(c && (num >= 0));
+    mos6502cpu_trace_item_t items[MOS6502CPU_TRACE_SIZE];
+    num = mos6502cpu_trace_get(c, items, num < MOS6502CPU_TRACE_SIZE ? num : MOS6502CPU_TRACE_SIZE);
+    printf("    TICK   PC OP  A  X  Y  S NV-BDIZC\n");
+    for (int i = 0; i < num; i++) {
+        const mos6502cpu_trace_item_t* item = &items[i];
+        char flags[9];
+        for (int b = 0; b < 8; b++) {
+            flags[b] = (item->p & (0x80 >> b)) ? "NV-BDIZC"[b] : '.';
+        }
+        flags[8] = 0;
+        printf("%08X %04X %02X %02X %02X %02X %02X %s\n", (unsigned)item->tick, item->pc, item->opcode, item->a,
+               item->x, item->y, item->s, flags);
+    }
+}
+#endif
+
+#ifdef MOS6502CPU_PROFILE
+void mos6502cpu_profile_reset(mos6502cpu_profile_t* p) {
+    CHIPS_ASSERT(p);
+    CHIPS_ASSERT((MOS6502CPU_PROFILE_MAX_EDGES & (MOS6502CPU_PROFILE_MAX_EDGES - 1)) == 0);
+    uint8_t bank_map[16];
+    memcpy(bank_map, p->bank_map, sizeof(bank_map));
+    memset(p, 0, sizeof(mos6502cpu_profile_t));
+    memcpy(p->bank_map, bank_map, sizeof(bank_map));
+    p->cur = &p->dummy;
+}
+
+static void _mos6502cpu_profile_edge(mos6502cpu_profile_t* p, uint16_t to, uint8_t to_bank, uint8_t type) {
+    uint32_t hash = ((uint32_t)p->last_pc * 0x9E3779B1u) ^ ((uint32_t)to * 0x85EBCA6Bu) ^ (p->last_bank << 1) ^ type;
+    for (uint32_t i = 0; i < MOS6502CPU_PROFILE_MAX_EDGES; i++) {
+        mos6502cpu_profile_edge_t* e = &p->edges[(hash + i) & (MOS6502CPU_PROFILE_MAX_EDGES - 1)];
+        if (e->count == 0) {
+            e->from = p->last_pc;
+            e->to = to;
+            e->bank = p->last_bank;
+            e->to_bank = to_bank;
+            e->type = type;
+            e->count = 1;
+            p->num_edges++;
+            return;
+        }
+        if ((e->from == p->last_pc) && (e->to == to) && (e->bank == p->last_bank) && (e->to_bank == to_bank) &&
+            (e->type == type)) {
+            e->count++;
+            return;
+        }
+    }
+    p->dropped_edges++;
+}
+
+static void _mos6502cpu_profile_sync(mos6502cpu_profile_t* p, uint16_t pc, uint8_t opcode) {
+    uint8_t bank = p->bank_map[pc >> 12];
+    CHIPS_ASSERT(bank < MOS6502CPU_PROFILE_MAX_BANKS);
+    if (p->last_opcode == 0x20) {
+        _mos6502cpu_profile_edge(p, pc, bank, MOS6502CPU_PROFILE_EDGE_CALL);
+    } else if (p->last_opcode == 0x60) {
+        _mos6502cpu_profile_edge(p, pc, bank, MOS6502CPU_PROFILE_EDGE_RETURN);
+    }
+    p->cur = &p->cycles[bank][pc];
+    p->last_pc = pc;
+    p->last_bank = bank;
+    p->last_opcode = opcode;
+}
+
+static const char* _mos6502cpu_profile_symbol(const mos6502cpu_profile_symbol_t* symbols, int num_symbols,
+                                              uint8_t bank, uint16_t addr, uint16_t* offset) {
+    // Binary search for the last symbol <= bank:addr
+    int lo = 0, hi = num_symbols - 1, found = -1;
+    uint32_t key = ((uint32_t)bank << 16) | addr;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        uint32_t k = ((uint32_t)symbols[mid].bank << 16) | symbols[mid].addr;
+        if (k <= key) {
+            found = mid;
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if ((found < 0) || (symbols[found].bank != bank)) {
+        return 0;
+    }
+    *offset = addr - symbols[found].addr;
+    return symbols[found].name;
+}
+
+static void _mos6502cpu_profile_print_addr(const mos6502cpu_profile_symbol_t* symbols, int num_symbols, uint8_t bank,
+                                           uint16_t addr) {
+    uint16_t offset = 0;
+    const char* name = _mos6502cpu_profile_symbol(symbols, num_symbols, bank, addr, &offset);
+    if (name) {
+        if (offset) {
+            printf("%X:%04X %s+%u", bank, addr, name, offset);
+        } else {
+            printf("%X:%04X %s", bank, addr, name);
+        }
+    } else {
+        printf("%X:%04X", bank, addr);
+    }
+}
+
+// Insert key/value into a descending top list of size num, returns new list size
+static int _mos6502cpu_profile_top_insert(uint32_t* vals, uint32_t* keys, int size, int num, uint32_t val,
+                                          uint32_t key) {
+    if ((size == num) && (val <= vals[size - 1])) {
+        return size;
+    }
+    int i = (size < num) ? size++ : size - 1;
+    while ((i > 0) && (vals[i - 1] < val)) {
+        vals[i] = vals[i - 1];
+        keys[i] = keys[i - 1];
+        i--;
+    }
+    vals[i] = val;
+    keys[i] = key;
+    return size;
 }
 
+void mos6502cpu_profile_report(const mos6502cpu_profile_t* p, const mos6502cpu_profile_symbol_t* symbols,
+                               int num_symbols, int num_entries) {
+    CHIPS_ASSERT(p && (num_entries > 0) && (num_entries <= 256));
+    CHIPS_ASSERT((num_symbols == 0) || symbols);
+    uint32_t vals[256];
+    uint32_t keys[256];
+    int size;
+
+    uint64_t total = 0;
+    for (int bank = 0; bank < MOS6502CPU_PROFILE_MAX_BANKS; bank++) {
+        for (int addr = 0; addr < (1 << 16); addr++) {
+            total += p->cycles[bank][addr];
+        }
+    }
+    printf("mos6502cpu profile: %llu cycles, %u edges (%u dropped)\n", (unsigned long long)total,
+           (unsigned)p->num_edges, (unsigned)p->dropped_edges);
+    if (total == 0) {
+        return;
+    }
+
+    // Hottest routines (cycles accumulated from a symbol up to the next symbol)
+    size = 0;
+    for (int i = 0; i < num_symbols; i++) {
+        uint32_t end = ((i + 1) < num_symbols && (symbols[i + 1].bank == symbols[i].bank)) ? symbols[i + 1].addr
+                                                                                            : (1 << 16);
+        uint32_t sum = 0;
+        for (uint32_t addr = symbols[i].addr; addr < end; addr++) {
+            sum += p->cycles[symbols[i].bank][addr];
+        }
+        if (sum > 0) {
+            size = _mos6502cpu_profile_top_insert(vals, keys, size, num_entries, sum, (uint32_t)i);
+        }
+    }
+    if (size > 0) {
+        printf("\n  cycles      %%  routine\n");
+        for (int i = 0; i < size; i++) {
+            const mos6502cpu_profile_symbol_t* sym = &symbols[keys[i]];
+            printf("%8u %6.2f  %X:%04X %s\n", (unsigned)vals[i], 100.0 * vals[i] / total, sym->bank, sym->addr,
+                   sym->name);
+        }
+    }
+
+    // Hottest instructions
+    size = 0;
+    for (int bank = 0; bank < MOS6502CPU_PROFILE_MAX_BANKS; bank++) {
+        for (int addr = 0; addr < (1 << 16); addr++) {
+            if (p->cycles[bank][addr] > 0) {
+                size = _mos6502cpu_profile_top_insert(vals, keys, size, num_entries, p->cycles[bank][addr],
+                                                      ((uint32_t)bank << 16) | addr);
+            }
+        }
+    }
+    printf("\n  cycles      %%  address\n");
+    for (int i = 0; i < size; i++) {
+        printf("%8u %6.2f  ", (unsigned)vals[i], 100.0 * vals[i] / total);
+        _mos6502cpu_profile_print_addr(symbols, num_symbols, keys[i] >> 16, keys[i] & 0xFFFF);
+        printf("\n");
+    }
+
+    // Most frequent call and return edges
+    size = 0;
+    for (int i = 0; i < MOS6502CPU_PROFILE_MAX_EDGES; i++) {
+        if (p->edges[i].count > 0) {
+            size = _mos6502cpu_profile_top_insert(vals, keys, size, num_entries, p->edges[i].count, (uint32_t)i);
+        }
+    }
+    if (size > 0) {
+        printf("\n   count  edge\n");
+        for (int i = 0; i < size; i++) {
+            const mos6502cpu_profile_edge_t* e = &p->edges[keys[i]];
+            printf("%8u  %s ", (unsigned)e->count, (e->type == MOS6502CPU_PROFILE_EDGE_CALL) ? "JSR" : "RTS");
+            _mos6502cpu_profile_print_addr(symbols, num_symbols, e->bank, e->from);
+            printf(" -> ");
+            _mos6502cpu_profile_print_addr(symbols, num_symbols, e->to_bank, e->to);
+            printf("\n");
+        }
+    }
+}
+#endif
+
 #if defined(_MSC_VER)
 #pragma warning(push)
 #pragma warning(disable : 4244)  // Conversion from 'uint16_t' to 'uint8_t', possible loss of data
 #endif
 
 void mos6502cpu_tick(mos6502cpu_t* c) {
+#ifdef MOS6502CPU_TRACE
+    c->trace.tick++;
+#endif
     if (c->sync || c->irq || c->nmi || c->rdy || c->res) {
         // Interrupt detection also works in RDY phases, but only NMI is "sticky"
 
@@ -625,6 +1061,17 @@ void mos6502cpu_tick(mos6502cpu_t* c) {
             return;
         }
         if (c->sync) {
+#ifdef MOS6502CPU_TRACE
+            mos6502cpu_trace_item_t* item = &c->trace.items[c->trace.head++ & (MOS6502CPU_TRACE_SIZE - 1)];
+            item->tick = c->trace.tick;
+            item->pc = c->PC;
+            item->opcode = _GD();
+            item->a = c->A;
+            item->x = c->X;
+            item->y = c->Y;
+            item->s = c->S;
+            item->p = _get_flags(c);
+#endif
             // Load new instruction into 'instruction register' and restart tick counter
             c->IR = _GD() << 3;
             c->sync = false;
@@ -653,6 +1100,12 @@ void mos6502cpu_tick(mos6502cpu_t* c) {
             c->irq_pip &= 0x3FF;
             c->nmi_pip &= 0x3FF;
 
+#ifdef MOS6502CPU_PROFILE
+            if (c->profile) {
+                _mos6502cpu_profile_sync(c->profile, c->PC, (c->brk_irq || c->brk_nmi || c->brk_reset) ? 0x00 : _GD());
+            }
+#endif
+
             // if interrupt or reset was requested, force a BRK instruction
             if (c->brk_irq || c->brk_nmi || c->brk_reset) {
                 c->IR = 0;
@@ -663,6 +1116,11 @@ void mos6502cpu_tick(mos6502cpu_t* c) {
             }
         }
     }
+#ifdef MOS6502CPU_PROFILE
+    if (c->profile) {
+        (*c->profile->cur)++;
+    }
+#endif
     // Reads are default, writes are special
     _RD();
     switch (c->IR++) {
@@ -27,6 +27,9 @@ extern "C" {
 #define MOS6522VIA_REG_IER    (14)  // Interrupt enable register
 #define MOS6522VIA_REG_RA_NOH (15)  // Input / output A without handshake
 
+// State file chunk id
+#define MOS6522VIA_STATE_ID CHIPS_STATE_ID('V', 'I', 'A', ' ')
+
 // PCR test macros (MAME naming)
 #define MOS6522VIA_PCR_CA1_LOW_TO_HIGH(c)  (c->pcr & 0x01)
 #define MOS6522VIA_PCR_CA1_HIGH_TO_LOW(c)  (!(c->pcr & 0x01))
@@ -126,6 +129,9 @@ typedef struct {
     uint8_t acr;  // Auxilary control register
     uint8_t pcr;  // Peripheral control register
     bool pb6_triggered;
+    // Lazy evaluation
+    uint32_t cycle;  // Cycle stamp of the next tick not yet performed
+    bool irq;        // IRQ output after the last tick
 } mos6522via_t;
 
 // Initialize a new 6522 instance
@@ -134,6 +140,13 @@ void mos6522via_init(mos6522via_t* c);
 void mos6522via_reset(mos6522via_t* c);
 // Tick the mos6522via
 bool mos6522via_tick(mos6522via_t* c, uint8_t cycles);
+// Lazy evaluation: perform all ticks of 'cycles' cycles before cycle stamp 'cycle', return IRQ output.
+// Same result as calling mos6522via_tick() for each tick, but stretches where only
+// the timers count down are skipped arithmetically.
+bool mos6522via_update(mos6522via_t* c, uint32_t cycle, uint8_t cycles);
+// Lazy evaluation: cycle stamp of the next tick which may change the IRQ output (or any
+// state other than the timer counters), assuming no register access or input change
+uint32_t mos6522via_next_irq_cycle(const mos6522via_t* c, uint8_t cycles);
 
 uint8_t mos6522via_read(mos6522via_t* c, uint8_t addr);
 
@@ -162,6 +175,10 @@ void mos6522via_set_cb1(mos6522via_t* c, bool state);
 bool mos6522via_get_cb2(mos6522via_t* c);
 
 void mos6522via_set_cb2(mos6522via_t* c, bool state);
+// Write the VIA state chunk to a state file (requires chips/chips_common.h)
+void mos6522via_save_state(const mos6522via_t* c, chips_state_writer_t* w);
+// Read the current state file chunk (MOS6522VIA_STATE_ID), returns false if it's invalid
+bool mos6522via_load_state(mos6522via_t* c, chips_state_reader_t* r);
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -344,6 +361,7 @@ static void _mos6522via_tick_t2(mos6522via_t* c, uint8_t cycles) {
         // Count falling edge of PB6
         if (c->pb6_triggered) {
             t->counter--;
+            c->pb6_triggered = false;
         }
     } else if (_MOS6522VIA_PIP_TEST(t->pip, MOS6522VIA_PIP_TIMER_COUNT, 0)) {
         t->counter -= cycles;
@@ -399,6 +417,9 @@ static void _mos6522via_update_cab(mos6522via_t* c) {
     if (c->pb.c2_triggered && MOS6522VIA_PCR_CB2_INPUT(c)) {
         _mos6522via_set_intr(c, MOS6522VIA_IRQ_CB2);
     }
+    // Edges are only seen by one tick
+    c->pa.c1_triggered = c->pa.c2_triggered = false;
+    c->pb.c1_triggered = c->pb.c2_triggered = false;
 }
 
 static bool _mos6522via_update_irq(mos6522via_t* c) {
@@ -421,9 +442,73 @@ bool mos6522via_tick(mos6522via_t* c, uint8_t cycles) {
     _mos6522via_tick_t2(c, cycles);
     bool irq = _mos6522via_update_irq(c);
     _mos6522via_tick_pipeline(c);
+    c->irq = irq;
+    c->cycle += cycles;
     return irq;
 }
 
+// Number of upcoming ticks in which nothing but the timer counters change
+static uint32_t _mos6522via_quiet_ticks(const mos6522via_t* c, uint8_t cycles) {
+    if (c->pa.c1_triggered || c->pa.c2_triggered || c->pb.c1_triggered || c->pb.c2_triggered || c->pb6_triggered) {
+        return 0;
+    }
+    // Counter pipelines must be settled (counting, no pending reload)
+    const bool t2_count_pb6 = MOS6522VIA_ACR_T2_COUNT_PB6(c);
+    if ((c->t1.pip != 0x0003) || c->t1.t_out || c->t2.t_out || (!t2_count_pb6 && (c->t2.pip != 0x0003))) {
+        return 0;
+    }
+    // Interrupt pipeline must be settled too
+    if (c->intr.ifr & c->intr.ier) {
+        if ((c->intr.pip != 0x0001) || !(c->intr.ifr & MOS6522VIA_IRQ_ANY)) {
+            return 0;
+        }
+    } else if (c->intr.pip != 0) {
+        return 0;
+    }
+    // ...and the IRQ output must already reflect the main interrupt bit
+    if (c->irq != (0 != (c->intr.ifr & (1 << 7)))) {
+        return 0;
+    }
+    // Ticks until the next timer underflow
+    uint32_t n = (c->t1.counter > 0) ? ((uint32_t)c->t1.counter / cycles) : 0;
+    if (!t2_count_pb6) {
+        const uint32_t n2 = (c->t2.counter > 0) ? ((uint32_t)c->t2.counter / cycles) : 0;
+        n = (n2 < n) ? n2 : n;
+    }
+    return n;
+}
+
+bool mos6522via_update(mos6522via_t* c, uint32_t cycle, uint8_t cycles) {
+    CHIPS_ASSERT(c && (cycles > 0));
+    if ((int32_t)(cycle - c->cycle) <= 0) {
+        return c->irq;
+    }
+    uint32_t num_ticks = (cycle - c->cycle + cycles - 1) / cycles;
+    while (num_ticks > 0) {
+        uint32_t n = _mos6522via_quiet_ticks(c, cycles);
+        if (n > 0) {
+            if (n > num_ticks) {
+                n = num_ticks;
+            }
+            c->t1.counter -= (int32_t)(n * cycles);
+            if (!MOS6522VIA_ACR_T2_COUNT_PB6(c)) {
+                c->t2.counter -= (int32_t)(n * cycles);
+            }
+            c->cycle += n * cycles;
+            num_ticks -= n;
+        } else {
+            mos6522via_tick(c, cycles);
+            num_ticks--;
+        }
+    }
+    return c->irq;
+}
+
+uint32_t mos6522via_next_irq_cycle(const mos6522via_t* c, uint8_t cycles) {
+    CHIPS_ASSERT(c && (cycles > 0));
+    return c->cycle + _mos6522via_quiet_ticks(c, cycles) * cycles;
+}
+
 // Read a register
 uint8_t mos6522via_read(mos6522via_t* c, uint8_t reg) {
     uint8_t data = 0;
@@ -680,4 +765,79 @@ void mos6522via_set_cb2(mos6522via_t* c, bool state) {
     c->pb.c2_in = state;
 }
 
+static void _mos6522via_save_port(const mos6522via_port_t* p, chips_state_writer_t* w) {
+    chips_state_put8(w, p->inpr);
+    chips_state_put8(w, p->outr);
+    chips_state_put8(w, p->ddr);
+    chips_state_put_bool(w, p->c1_in);
+    chips_state_put_bool(w, p->c1_out);
+    chips_state_put_bool(w, p->c1_triggered);
+    chips_state_put_bool(w, p->c2_in);
+    chips_state_put_bool(w, p->c2_out);
+    chips_state_put_bool(w, p->c2_triggered);
+}
+
+static void _mos6522via_load_port(mos6522via_port_t* p, chips_state_reader_t* r) {
+    p->inpr = chips_state_get8(r);
+    p->outr = chips_state_get8(r);
+    p->ddr = chips_state_get8(r);
+    p->c1_in = chips_state_get_bool(r);
+    p->c1_out = chips_state_get_bool(r);
+    p->c1_triggered = chips_state_get_bool(r);
+    p->c2_in = chips_state_get_bool(r);
+    p->c2_out = chips_state_get_bool(r);
+    p->c2_triggered = chips_state_get_bool(r);
+}
+
+static void _mos6522via_save_timer(const mos6522via_timer_t* t, chips_state_writer_t* w) {
+    chips_state_put16(w, t->latch);
+    chips_state_put32(w, (uint32_t)t->counter);
+    chips_state_put_bool(w, t->t_bit);
+    chips_state_put_bool(w, t->t_out);
+    chips_state_put16(w, t->pip);
+}
+
+static void _mos6522via_load_timer(mos6522via_timer_t* t, chips_state_reader_t* r) {
+    t->latch = chips_state_get16(r);
+    t->counter = (int32_t)chips_state_get32(r);
+    t->t_bit = chips_state_get_bool(r);
+    t->t_out = chips_state_get_bool(r);
+    t->pip = chips_state_get16(r);
+}
+
+void mos6522via_save_state(const mos6522via_t* c, chips_state_writer_t* w) {
+    CHIPS_ASSERT(c && w);
+    chips_state_begin_chunk(w, MOS6522VIA_STATE_ID, 1);
+    _mos6522via_save_port(&c->pa, w);
+    _mos6522via_save_port(&c->pb, w);
+    _mos6522via_save_timer(&c->t1, w);
+    _mos6522via_save_timer(&c->t2, w);
+    chips_state_put8(w, c->intr.ier);
+    chips_state_put8(w, c->intr.ifr);
+    chips_state_put16(w, c->intr.pip);
+    chips_state_put8(w, c->acr);
+    chips_state_put8(w, c->pcr);
+    chips_state_put_bool(w, c->pb6_triggered);
+    chips_state_put32(w, c->cycle);
+    chips_state_put_bool(w, c->irq);
+    chips_state_end_chunk(w);
+}
+
+bool mos6522via_load_state(mos6522via_t* c, chips_state_reader_t* r) {
+    CHIPS_ASSERT(c && r && (r->chunk_id == MOS6522VIA_STATE_ID));
+    _mos6522via_load_port(&c->pa, r);
+    _mos6522via_load_port(&c->pb, r);
+    _mos6522via_load_timer(&c->t1, r);
+    _mos6522via_load_timer(&c->t2, r);
+    c->intr.ier = chips_state_get8(r);
+    c->intr.ifr = chips_state_get8(r);
+    c->intr.pip = chips_state_get16(r);
+    c->acr = chips_state_get8(r);
+    c->pcr = chips_state_get8(r);
+    c->pb6_triggered = chips_state_get_bool(r);
+    c->cycle = chips_state_get32(r);
+    c->irq = chips_state_get_bool(r);
+    return r->ok;
+}
+
 #endif  // CHIPS_IMPL
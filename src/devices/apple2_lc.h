@@ -12,6 +12,14 @@ extern "C" {
 #define APPLE2_LC_READ_ENABLED  (1)
 #define APPLE2_LC_WRITE_ENABLED (2)
 
+// Memory layers, the RAM layer covers the ROM while reading from the language card is enabled
+#define APPLE2_LC_RAM_LAYER  (0)
+#define APPLE2_LC_BASE_LAYER (1)  // ROM and the main RAM of the system
+
+// State file chunk ids
+#define APPLE2_LC_STATE_ID     CHIPS_STATE_ID('L', 'C', ' ', ' ')
+#define APPLE2_LC_STATE_RAM_ID CHIPS_STATE_ID('L', 'C', 'R', 'M')
+
 // Config parameters for apple2_lc_init()
 typedef struct {
     mem_t* sys_mem;
@@ -30,6 +38,8 @@ typedef struct {
     uint16_t current_bank;
     uint8_t state;
     bool prewrite;
+
+    uint8_t ram_map_key, rom_map_key;  // Bank and write enable of the mapped layers (0: stale)
 } apple2_lc_t;
 
 // Apple II language card controller interface
@@ -51,6 +61,12 @@ void apple2_lc_snapshot_onsave(apple2_lc_t* snapshot);
 // Fix up the language card snapshot after loading
 void apple2_lc_snapshot_onload(apple2_lc_t* snapshot, apple2_lc_t* dev);
 
+// Write the language card state chunks to a state file (requires chips/chips_common.h)
+void apple2_lc_save_state(const apple2_lc_t* dev, chips_state_writer_t* w);
+
+// Read the current state file chunk (APPLE2_LC_STATE_*), returns false if it's invalid
+bool apple2_lc_load_state(apple2_lc_t* dev, chips_state_reader_t* r);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -63,6 +79,40 @@ void apple2_lc_snapshot_onload(apple2_lc_t* snapshot, apple2_lc_t* dev);
 #define CHIPS_ASSERT(c) assert(c)
 #endif
 
+static void _apple2_lc_update_memorymap(apple2_lc_t* dev) {
+    // Only the visible layer is remapped, the hidden one is brought up to date when it is enabled or disabled
+    uint8_t* bank_ptr = dev->ram + dev->current_bank;
+    const bool write_enabled = (dev->state & APPLE2_LC_WRITE_ENABLED) != 0;
+    const uint8_t key = 0x10 | (dev->current_bank ? 0x01 : 0) | (write_enabled ? 0x02 : 0);
+    if (dev->state & APPLE2_LC_READ_ENABLED) {
+        if (dev->ram_map_key != key) {
+            if (write_enabled) {
+                mem_map_ram(dev->sys_mem, APPLE2_LC_RAM_LAYER, 0xD000, 0x1000, bank_ptr);
+                mem_map_ram(dev->sys_mem, APPLE2_LC_RAM_LAYER, 0xE000, 0x2000, dev->ram + 0x2000);
+            } else {
+                mem_map_rom(dev->sys_mem, APPLE2_LC_RAM_LAYER, 0xD000, 0x1000, bank_ptr);
+                mem_map_rom(dev->sys_mem, APPLE2_LC_RAM_LAYER, 0xE000, 0x2000, dev->ram + 0x2000);
+            }
+            dev->ram_map_key = key;
+        }
+    } else {
+        // Without write enable the ROM mapping does not depend on the bank
+        const uint8_t rom_key = write_enabled ? key : 0x10;
+        if (dev->rom_map_key != rom_key) {
+            if (write_enabled) {
+                mem_map_rw(dev->sys_mem, APPLE2_LC_BASE_LAYER, 0xD000, 0x1000, dev->sys_rom, bank_ptr);
+                mem_map_rw(dev->sys_mem, APPLE2_LC_BASE_LAYER, 0xE000, 0x2000, dev->sys_rom + 0x1000,
+                           dev->ram + 0x2000);
+            } else {
+                mem_map_rom(dev->sys_mem, APPLE2_LC_BASE_LAYER, 0xD000, 0x3000, dev->sys_rom);
+            }
+            dev->rom_map_key = rom_key;
+        }
+    }
+    // Switching between the RAM and the ROM only enables or disables the RAM layer
+    mem_enable_layer(dev->sys_mem, APPLE2_LC_RAM_LAYER, (dev->state & APPLE2_LC_READ_ENABLED) != 0);
+}
+
 void apple2_lc_init(apple2_lc_t* dev, const apple2_lc_desc_t* desc) {
     CHIPS_ASSERT(dev && !dev->valid);
     memset(dev, 0, sizeof(apple2_lc_t));
@@ -73,8 +123,7 @@ void apple2_lc_init(apple2_lc_t* dev, const apple2_lc_desc_t* desc) {
     dev->state &= ~APPLE2_LC_READ_ENABLED;
     dev->state |= APPLE2_LC_WRITE_ENABLED;
     dev->prewrite = false;
-    mem_map_rw(dev->sys_mem, 0, 0xD000, 0x1000, dev->sys_rom, dev->ram + dev->current_bank);
-    mem_map_rw(dev->sys_mem, 0, 0xE000, 0x2000, dev->sys_rom + 0x1000, dev->ram + 0x2000);
+    _apple2_lc_update_memorymap(dev);
 }
 
 void apple2_lc_discard(apple2_lc_t* dev) {
@@ -121,26 +170,34 @@ void apple2_lc_control(apple2_lc_t* dev, uint8_t offset, bool rw) {
         dev->current_bank = 0;
     }
 
-    if (dev->state & APPLE2_LC_READ_ENABLED) {
-        if (dev->state & APPLE2_LC_WRITE_ENABLED) {
-            mem_map_ram(dev->sys_mem, 0, 0xD000, 0x1000, dev->ram + dev->current_bank);
-            mem_map_ram(dev->sys_mem, 0, 0xE000, 0x2000, dev->ram + 0x2000);
-        } else {
-            mem_map_rom(dev->sys_mem, 0, 0xD000, 0x1000, dev->ram + dev->current_bank);
-            mem_map_rom(dev->sys_mem, 0, 0xE000, 0x2000, dev->ram + 0x2000);
-        }
-    } else {
-        if (dev->state & APPLE2_LC_WRITE_ENABLED) {
-            mem_map_rw(dev->sys_mem, 0, 0xD000, 0x1000, dev->sys_rom, dev->ram + dev->current_bank);
-            mem_map_rw(dev->sys_mem, 0, 0xE000, 0x2000, dev->sys_rom + 0x1000, dev->ram + 0x2000);
-        } else {
-            mem_map_rom(dev->sys_mem, 0, 0xD000, 0x3000, dev->sys_rom);
-        }
-    }
+    _apple2_lc_update_memorymap(dev);
 }
 
 void apple2_lc_snapshot_onsave(apple2_lc_t* snapshot) { CHIPS_ASSERT(snapshot); }
 
 void apple2_lc_snapshot_onload(apple2_lc_t* snapshot, apple2_lc_t* dev) { CHIPS_ASSERT(snapshot && dev); }
 
+void apple2_lc_save_state(const apple2_lc_t* dev, chips_state_writer_t* w) {
+    CHIPS_ASSERT(dev && dev->valid && w);
+    chips_state_begin_chunk(w, APPLE2_LC_STATE_ID, 1);
+    chips_state_put16(w, dev->current_bank);
+    chips_state_put8(w, dev->state);
+    chips_state_put_bool(w, dev->prewrite);
+    chips_state_end_chunk(w);
+    chips_state_put_memory(w, APPLE2_LC_STATE_RAM_ID, dev->ram, sizeof(dev->ram), 0);
+}
+
+bool apple2_lc_load_state(apple2_lc_t* dev, chips_state_reader_t* r) {
+    CHIPS_ASSERT(dev && dev->valid && r);
+    if (r->chunk_id == APPLE2_LC_STATE_RAM_ID) {
+        return chips_state_get_memory(r, dev->ram, sizeof(dev->ram), 0);
+    }
+    dev->current_bank = chips_state_get16(r) ? 0x1000 : 0;
+    dev->state = chips_state_get8(r) & (APPLE2_LC_READ_ENABLED | APPLE2_LC_WRITE_ENABLED);
+    dev->prewrite = chips_state_get_bool(r);
+    dev->ram_map_key = dev->rom_map_key = 0;
+    _apple2_lc_update_memorymap(dev);
+    return r->ok;
+}
+
 #endif  // CHIPS_IMPL
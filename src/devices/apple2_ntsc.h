@@ -0,0 +1,191 @@
+#pragma once
+
+// apple2_ntsc.h
+//
+// NTSC composite video renderer for the Apple II and //e. Converts the 560
+// dot scanline signal to YIQ with a multi-tap filter, precomputed into a
+// lookup table indexed by subcarrier phase and a 12 dot window around each
+// output dot, so the per-dot cost is a single table read.
+//
+// Luma uses a 5 tap filter with a notch at the subcarrier frequency, chroma
+// is demodulated and smoothed with a 9 tap filter. The chroma gain and hue
+// are fitted to the system palette at init time, so solid colors match the
+// 16 color renderer.
+//
+// The lookup tables take 64 KB, so the renderer is only compiled into the
+// systems when APPLE2_NTSC is defined.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define APPLE2_NTSC_WIDTH       (560)  // Dots per scanline
+#define APPLE2_NTSC_WORDS       (40)   // 14 dot words per scanline
+#define APPLE2_NTSC_WINDOW_BITS (12)   // Dots contributing to one output dot
+
+// Build the lookup tables, 'palette' holds the 16 RGBA8 colors of the system (R in the low byte)
+void apple2_ntsc_init(const uint32_t* palette);
+// Render a color scanline from 40 words of 14 dots (LSB first), 'phase' is the subcarrier phase of the first dot
+void apple2_ntsc_render_signal(uint32_t* out, const uint16_t* words, int phase);
+// Render a scanline with the color killer on (text), dots are black or white
+void apple2_ntsc_render_mono(uint32_t* out, const uint16_t* words);
+// Render a color scanline from a packed 4bpp framebuffer row (lores), each color becomes its dot pattern
+void apple2_ntsc_render_colors(uint32_t* out, const uint8_t* fb_row);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+// Window bit k holds the dot at x + k - _APPLE2_NTSC_CENTER
+#define _APPLE2_NTSC_CENTER (6)
+
+static uint32_t _apple2_ntsc_lut[4][1 << APPLE2_NTSC_WINDOW_BITS];
+static uint32_t _apple2_ntsc_white;
+static uint32_t _apple2_ntsc_black;
+
+// Luma filter, zero response at the subcarrier frequency
+static const float _apple2_ntsc_luma_taps[APPLE2_NTSC_WINDOW_BITS] = {0, 0, 0, 0, 1, 2, 2, 2, 1, 0, 0, 0};
+// Chroma low pass filter, zero response at the subcarrier frequency and twice that (no ripple on dot patterns)
+static const float _apple2_ntsc_chroma_taps[APPLE2_NTSC_WINDOW_BITS] = {0, 0, 1, 4, 8, 12, 14, 12, 8, 4, 1, 0};
+
+// Filter a window of dots, 'phase' is the subcarrier phase of the center dot
+static void _apple2_ntsc_filter(uint32_t window, int phase, float* y, float* c_re, float* c_im) {
+    static const float cos4[4] = {1, 0, -1, 0};
+    static const float sin4[4] = {0, 1, 0, -1};
+    float luma = 0, luma_sum = 0, re = 0, im = 0, chroma_sum = 0;
+    for (int k = 0; k < APPLE2_NTSC_WINDOW_BITS; k++) {
+        const float bit = (window >> k) & 1;
+        const int p = (phase + k - _APPLE2_NTSC_CENTER) & 3;
+        luma += _apple2_ntsc_luma_taps[k] * bit;
+        luma_sum += _apple2_ntsc_luma_taps[k];
+        re += _apple2_ntsc_chroma_taps[k] * bit * cos4[p];
+        im += _apple2_ntsc_chroma_taps[k] * bit * sin4[p];
+        chroma_sum += _apple2_ntsc_chroma_taps[k];
+    }
+    *y = luma / luma_sum;
+    *c_re = re / chroma_sum;
+    *c_im = im / chroma_sum;
+}
+
+static uint8_t _apple2_ntsc_clamp(float v) { return (v <= 0.0f) ? 0 : ((v >= 1.0f) ? 255 : (uint8_t)(v * 255.0f + 0.5f)); }
+
+void apple2_ntsc_init(const uint32_t* palette) {
+    CHIPS_ASSERT(palette);
+    // Fit luma gain and the complex chroma gain (saturation and hue) to the palette
+    float yy = 0, ys = 0, cc = 0, a_re = 0, a_im = 0;
+    for (int color = 0; color < 16; color++) {
+        const float r = (palette[color] & 0xFF) / 255.0f;
+        const float g = ((palette[color] >> 8) & 0xFF) / 255.0f;
+        const float b = ((palette[color] >> 16) & 0xFF) / 255.0f;
+        const float pal_y = 0.299f * r + 0.587f * g + 0.114f * b;
+        const float pal_i = 0.596f * r - 0.274f * g - 0.322f * b;
+        const float pal_q = 0.211f * r - 0.523f * g + 0.312f * b;
+
+        // Dot x of a solid color carries bit (x & 3) of the color
+        uint32_t window = 0;
+        for (int k = 0; k < APPLE2_NTSC_WINDOW_BITS; k++) {
+            window |= ((color >> ((k - _APPLE2_NTSC_CENTER) & 3)) & 1) << k;
+        }
+        float y, c_re, c_im;
+        _apple2_ntsc_filter(window, 0, &y, &c_re, &c_im);
+        yy += y * pal_y;
+        ys += y * y;
+        // a += conj(c) * (i + jq)
+        a_re += c_re * pal_i + c_im * pal_q;
+        a_im += c_re * pal_q - c_im * pal_i;
+        cc += c_re * c_re + c_im * c_im;
+    }
+    const float luma_gain = (ys > 0) ? yy / ys : 1.0f;
+    a_re /= cc;
+    a_im /= cc;
+
+    for (int phase = 0; phase < 4; phase++) {
+        for (uint32_t window = 0; window < (1 << APPLE2_NTSC_WINDOW_BITS); window++) {
+            float y, c_re, c_im;
+            _apple2_ntsc_filter(window, phase, &y, &c_re, &c_im);
+            y *= luma_gain;
+            const float i = a_re * c_re - a_im * c_im;
+            const float q = a_re * c_im + a_im * c_re;
+            const uint8_t r = _apple2_ntsc_clamp(y + 0.956f * i + 0.619f * q);
+            const uint8_t g = _apple2_ntsc_clamp(y - 0.272f * i - 0.647f * q);
+            const uint8_t b = _apple2_ntsc_clamp(y - 1.106f * i + 1.703f * q);
+            _apple2_ntsc_lut[phase][window] = 0xFF000000 | ((uint32_t)b << 16) | ((uint32_t)g << 8) | r;
+        }
+    }
+    _apple2_ntsc_black = palette[0];
+    _apple2_ntsc_white = palette[15];
+}
+
+void apple2_ntsc_render_signal(uint32_t* out, const uint16_t* words, int phase) {
+    // Dots before the first and after the last word are black
+    uint64_t w = (uint64_t)words[0] << _APPLE2_NTSC_CENTER;
+    int avail = 14 + _APPLE2_NTSC_CENTER;
+    int next = 1;
+    for (int x = 0; x < APPLE2_NTSC_WIDTH; x++) {
+        if (avail < APPLE2_NTSC_WINDOW_BITS) {
+            if (next < APPLE2_NTSC_WORDS) {
+                w |= (uint64_t)words[next] << avail;
+            }
+            next++;
+            avail += 14;
+        }
+        out[x] = _apple2_ntsc_lut[(x + phase) & 3][w & ((1 << APPLE2_NTSC_WINDOW_BITS) - 1)];
+        w >>= 1;
+        avail--;
+    }
+}
+
+void apple2_ntsc_render_mono(uint32_t* out, const uint16_t* words) {
+    for (int col = 0; col < APPLE2_NTSC_WORDS; col++) {
+        uint16_t w = words[col];
+        for (int b = 0; b < 14; b++) {
+            *out++ = (w & 1) ? _apple2_ntsc_white : _apple2_ntsc_black;
+            w >>= 1;
+        }
+    }
+}
+
+void apple2_ntsc_render_colors(uint32_t* out, const uint8_t* fb_row) {
+    uint16_t words[APPLE2_NTSC_WORDS];
+    for (int col = 0; col < APPLE2_NTSC_WORDS; col++) {
+        uint16_t w = 0;
+        for (int b = 0; b < 14; b++) {
+            const int x = col * 14 + b;
+            const uint8_t pixels = fb_row[x >> 1];
+            const uint8_t color = (x & 1) ? (pixels & 0x0F) : (pixels >> 4);
+            w |= ((color >> (x & 3)) & 1) << b;
+        }
+        words[col] = w;
+    }
+    apple2_ntsc_render_signal(out, words, 0);
+}
+
+#endif  // CHIPS_IMPL
@@ -54,6 +54,10 @@ extern "C" {
 
 #define DISK2_FDC_MAX_DRIVES 1
 
+// State file chunk ids
+#define DISK2_FDC_STATE_ID       CHIPS_STATE_ID('F', 'D', 'C', ' ')
+#define DISK2_FDC_STATE_TRACK_ID CHIPS_STATE_ID('F', 'D', 'T', 'R')  // Track written since the disk was inserted
+
 // Oric floppy disk controller state
 typedef struct {
     bool valid;
@@ -86,6 +90,17 @@ void disk2_fdc_snapshot_onsave(disk2_fdc_t* snapshot);
 // Fix up the floppy disk controller snapshot after loading
 void disk2_fdc_snapshot_onload(disk2_fdc_t* snapshot, disk2_fdc_t* sys);
 
+// Write the controller and drive state chunks to a state file (requires chips/chips_common.h),
+// disk images are stored as the tracks written since the disk was inserted
+void disk2_fdc_save_state(const disk2_fdc_t* sys, chips_state_writer_t* w);
+
+// Read the current state file chunk (DISK2_FDC_STATE_*), returns false if it's invalid, written tracks are
+// applied to the inserted disk images
+bool disk2_fdc_load_state(disk2_fdc_t* sys, chips_state_reader_t* r);
+
+// Check the current state file chunk like disk2_fdc_load_state() without changing the controller or the disk images
+bool disk2_fdc_check_state(const disk2_fdc_t* sys, chips_state_reader_t* r);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -149,6 +164,96 @@ void disk2_fdc_snapshot_onsave(disk2_fdc_t* snapshot) { CHIPS_ASSERT(snapshot);
 
 void disk2_fdc_snapshot_onload(disk2_fdc_t* snapshot, disk2_fdc_t* sys) { CHIPS_ASSERT(snapshot && sys); }
 
+void disk2_fdc_save_state(const disk2_fdc_t* sys, chips_state_writer_t* w) {
+    CHIPS_ASSERT(sys && sys->valid && w);
+    chips_state_begin_chunk(w, DISK2_FDC_STATE_ID, 1);
+    chips_state_put8(w, sys->selected_drive);
+    chips_state_put8(w, DISK2_FDC_MAX_DRIVES);
+    for (int i = 0; i < DISK2_FDC_MAX_DRIVES; i++) {
+        const disk2_fdd_t* fdd = &sys->fdd[i];
+        chips_state_put8(w, fdd->motor_state);
+        chips_state_put32(w, fdd->motor_timer_ticks);
+        chips_state_put8(w, fdd->half_track);
+        chips_state_put16(w, fdd->offset);
+        chips_state_put_bool(w, fdd->image_dirty);
+        chips_state_put_bool(w, fdd->write_protected);
+        chips_state_put8(w, fdd->control_bits);
+        chips_state_put8(w, fdd->write_ready);
+    }
+    chips_state_end_chunk(w);
+    for (int i = 0; i < DISK2_FDC_MAX_DRIVES; i++) {
+        const disk2_fdd_t* fdd = &sys->fdd[i];
+        if (!fdd->nib_image_loaded) {
+            continue;
+        }
+        for (int track = 0; track < DISK2_FDD_TRACKS_PER_DISK; track++) {
+            if (fdd->dirty_tracks & (1ULL << track)) {
+                chips_state_begin_chunk(w, DISK2_FDC_STATE_TRACK_ID, 1);
+                chips_state_put8(w, (uint8_t)i);
+                chips_state_put8(w, (uint8_t)track);
+                chips_state_put_rle(w, fdd->nib_image + track * DISK2_FDD_BYTES_PER_NIB_TRACK,
+                                    DISK2_FDD_BYTES_PER_NIB_TRACK);
+                chips_state_end_chunk(w);
+            }
+        }
+    }
+}
+
+bool disk2_fdc_load_state(disk2_fdc_t* sys, chips_state_reader_t* r) {
+    CHIPS_ASSERT(sys && sys->valid && r);
+    if (r->chunk_id == DISK2_FDC_STATE_TRACK_ID) {
+        const uint8_t drive = chips_state_get8(r);
+        const uint8_t track = chips_state_get8(r);
+        if ((drive >= DISK2_FDC_MAX_DRIVES) || (track >= DISK2_FDD_TRACKS_PER_DISK)) {
+            return false;
+        }
+        disk2_fdd_t* fdd = &sys->fdd[drive];
+        if (!fdd->nib_image_loaded ||
+            !chips_state_get_rle(r, fdd->nib_image + track * DISK2_FDD_BYTES_PER_NIB_TRACK,
+                                 DISK2_FDD_BYTES_PER_NIB_TRACK)) {
+            return false;
+        }
+        fdd->dirty_tracks |= 1ULL << track;
+        return true;
+    }
+    const uint8_t selected_drive = chips_state_get8(r);
+    const uint8_t num_drives = chips_state_get8(r);
+    if ((selected_drive >= DISK2_FDC_MAX_DRIVES) || (num_drives > DISK2_FDC_MAX_DRIVES)) {
+        return false;
+    }
+    sys->selected_drive = selected_drive;
+    for (int i = 0; i < num_drives; i++) {
+        disk2_fdd_t* fdd = &sys->fdd[i];
+        fdd->motor_state = chips_state_get8(r);
+        fdd->motor_timer_ticks = chips_state_get32(r);
+        fdd->half_track = chips_state_get8(r);
+        fdd->offset = chips_state_get16(r);
+        fdd->image_dirty = chips_state_get_bool(r);
+        fdd->write_protected = chips_state_get_bool(r);
+        fdd->control_bits = chips_state_get8(r);
+        fdd->write_ready = chips_state_get8(r);
+        if ((fdd->half_track >= 2 * DISK2_FDD_TRACKS_PER_DISK) || (fdd->offset >= DISK2_FDD_BYTES_PER_NIB_TRACK)) {
+            return false;
+        }
+        // Tracks written before saving follow in their own chunks
+        fdd->dirty_tracks = 0;
+    }
+    return r->ok;
+}
+
+bool disk2_fdc_check_state(const disk2_fdc_t* sys, chips_state_reader_t* r) {
+    CHIPS_ASSERT(sys && sys->valid && r);
+    if (r->chunk_id == DISK2_FDC_STATE_TRACK_ID) {
+        static uint8_t track_buf[DISK2_FDD_BYTES_PER_NIB_TRACK];
+        const uint8_t drive = chips_state_get8(r);
+        const uint8_t track = chips_state_get8(r);
+        return (drive < DISK2_FDC_MAX_DRIVES) && (track < DISK2_FDD_TRACKS_PER_DISK) &&
+               sys->fdd[drive].nib_image_loaded && chips_state_get_rle(r, track_buf, DISK2_FDD_BYTES_PER_NIB_TRACK);
+    }
+    disk2_fdc_t tmp = *sys;
+    return disk2_fdc_load_state(&tmp, r);
+}
+
 static void _disk2_fdc_process_soft_switches(disk2_fdc_t* sys, uint8_t addr) {
     disk2_fdd_t* fdd = &sys->fdd[sys->selected_drive];
 
@@ -29,6 +29,7 @@ typedef struct {
     uint8_t half_track;
     uint16_t offset;
     bool image_dirty;
+    uint64_t dirty_tracks;  // Tracks written since the disk was inserted (one bit per track)
     bool write_protected;
     bool nib_image_loaded;
     uint8_t control_bits;
@@ -119,6 +120,7 @@ bool disk2_fdd_insert_disk(disk2_fdd_t* sys, uint8_t* nib_image) {
     sys->nib_image_offset = 0;
     sys->nib_image = nib_image;
     sys->nib_image_loaded = true;
+    sys->dirty_tracks = 0;
     return true;
 }
 
@@ -126,6 +128,7 @@ void disk2_fdd_remove_disk(disk2_fdd_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     sys->nib_image_loaded = false;
     sys->image_dirty = false;
+    sys->dirty_tracks = 0;
 }
 
 bool disk2_fdd_is_disk_inserted(disk2_fdd_t* sys) {
@@ -190,6 +193,7 @@ void disk2_fdd_write_byte(disk2_fdd_t* sys, uint8_t byte) {
         _disk2_fdd_update_offset(sys);
         *(sys->nib_image + (sys->half_track / 2) * DISK2_FDD_BYTES_PER_NIB_TRACK + sys->offset) = byte;
         sys->image_dirty = true;
+        sys->dirty_tracks |= 1ULL << (sys->half_track / 2);
         sys->write_ready = 0;
     }
 }
@@ -17,6 +17,9 @@ extern "C" {
 #define ORIC_TD_PORT_PLAY   (1 << 3)
 #define ORIC_TD_PORT_RECORD (1 << 4)
 
+// State file chunk id
+#define ORIC_TD_STATE_ID CHIPS_STATE_ID('T', 'A', 'P', 'E')
+
 // Oric tape drive state
 typedef struct {
     uint8_t port;
@@ -68,6 +71,12 @@ void oric_td_snapshot_onsave(oric_td_t* snapshot);
 // Fix up the tape drive snapshot after loading
 void oric_td_snapshot_onload(oric_td_t* snapshot, oric_td_t* sys);
 
+// Write the tape position chunk to a state file (include chips/chips_common.h first)
+void oric_td_save_state(const oric_td_t* sys, chips_state_writer_t* w);
+
+// Read the tape position chunk, the same tape must be inserted
+bool oric_td_load_state(oric_td_t* sys, chips_state_reader_t* r);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -172,4 +181,26 @@ void oric_td_snapshot_onload(oric_td_t* snapshot, oric_td_t* sys) {
     snapshot->port = sys->port;
 }
 
+void oric_td_save_state(const oric_td_t* sys, chips_state_writer_t* w) {
+    CHIPS_ASSERT(sys && sys->valid && w);
+    chips_state_begin_chunk(w, ORIC_TD_STATE_ID, 1);
+    chips_state_put8(w, sys->port);
+    chips_state_put32(w, sys->pos);
+    chips_state_put8(w, (uint8_t)sys->bit_pos);
+    chips_state_end_chunk(w);
+}
+
+bool oric_td_load_state(oric_td_t* sys, chips_state_reader_t* r) {
+    CHIPS_ASSERT(sys && sys->valid && r && (r->chunk_id == ORIC_TD_STATE_ID));
+    sys->port = chips_state_get8(r);
+    const uint32_t pos = chips_state_get32(r);
+    const uint8_t bit_pos = chips_state_get8(r);
+    if (!r->ok || (pos > sys->size) || (bit_pos > 7)) {
+        return false;
+    }
+    sys->pos = pos;
+    sys->bit_pos = bit_pos;
+    return true;
+}
+
 #endif  // CHIPS_IMPL
@@ -30,6 +30,9 @@ extern "C" {
 #define PRODOS_CMD_WRITE  (0x02)
 #define PRODOS_CMD_FORMAT (0x04)
 
+// State file chunk id
+#define PRODOS_HDC_STATE_ID CHIPS_STATE_ID('H', 'D', 'C', ' ')
+
 // ProDOS hard disk controller state
 typedef struct {
     bool valid;
@@ -58,6 +61,12 @@ void prodos_hdc_snapshot_onsave(prodos_hdc_t* snapshot);
 // Fix up the hard disk controller snapshot after loading
 void prodos_hdc_snapshot_onload(prodos_hdc_t* snapshot, prodos_hdc_t* sys);
 
+// Write the controller registers to a state file (include chips/chips_common.h first)
+void prodos_hdc_save_state(const prodos_hdc_t* sys, chips_state_writer_t* w);
+
+// Read the controller registers from a state file chunk
+bool prodos_hdc_load_state(prodos_hdc_t* sys, chips_state_reader_t* r);
+
 #ifdef __cplusplus
 }  // extern "C"
 #endif
@@ -134,4 +143,17 @@ void prodos_hdc_snapshot_onsave(prodos_hdc_t* snapshot) { CHIPS_ASSERT(snapshot)
 
 void prodos_hdc_snapshot_onload(prodos_hdc_t* snapshot, prodos_hdc_t* sys) { CHIPS_ASSERT(snapshot && sys); }
 
+void prodos_hdc_save_state(const prodos_hdc_t* sys, chips_state_writer_t* w) {
+    CHIPS_ASSERT(sys && sys->valid && w);
+    chips_state_begin_chunk(w, PRODOS_HDC_STATE_ID, 1);
+    chips_state_put_bytes(w, sys->return_code, sizeof(sys->return_code));
+    chips_state_end_chunk(w);
+}
+
+bool prodos_hdc_load_state(prodos_hdc_t* sys, chips_state_reader_t* r) {
+    CHIPS_ASSERT(sys && sys->valid && r && (r->chunk_id == PRODOS_HDC_STATE_ID));
+    chips_state_get_bytes(r, sys->return_code, sizeof(sys->return_code));
+    return r->ok;
+}
+
 #endif  // CHIPS_IMPL
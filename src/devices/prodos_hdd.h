@@ -145,16 +145,15 @@ uint8_t prodos_hdd_read_block(prodos_hdd_t* sys, uint16_t buffer, uint32_t block
     }
 
     if (sys->image_type == PRODOS_HDD_IMAGE_TYPE_MSC) {
-        // USB flash drive
-        uint8_t* buf = mem_writeptr(mem, buffer);
-        if (fseek(sys->file, block * PRODOS_HDD_BYTES_PER_BLOCK, SEEK_SET) != 0) {
-            printf("Error reading from file\r\n");
-            return PRODOS_HDD_ERR_IO;
-        }
-        if (fread(buf, 1, PRODOS_HDD_BYTES_PER_BLOCK, sys->file) != PRODOS_HDD_BYTES_PER_BLOCK) {
+        // USB flash drive, the buffer may span host pages which are not contiguous or shared (see mem_share()).
+        // Positional reads leave the file position alone, so forks sharing the file can read from other threads.
+        uint8_t buf[PRODOS_HDD_BYTES_PER_BLOCK];
+        const off_t pos = (off_t)block * PRODOS_HDD_BYTES_PER_BLOCK;
+        if (pread(fileno(sys->file), buf, PRODOS_HDD_BYTES_PER_BLOCK, pos) != PRODOS_HDD_BYTES_PER_BLOCK) {
             printf("Error reading from file\r\n");
             return PRODOS_HDD_ERR_IO;
         }
+        mem_write_range(mem, buffer, buf, PRODOS_HDD_BYTES_PER_BLOCK);
     } else {
         // Internal flash
         mem_write_range(mem, buffer, sys->po_image + block * PRODOS_HDD_BYTES_PER_BLOCK, PRODOS_HDD_BYTES_PER_BLOCK);
@@ -174,16 +173,16 @@ uint8_t prodos_hdd_write_block(prodos_hdd_t* sys, uint16_t buffer, uint32_t bloc
     }
 
     if (sys->image_type == PRODOS_HDD_IMAGE_TYPE_MSC) {
-        // USB flash drive
-        if (fseek(sys->file, block * PRODOS_HDD_BYTES_PER_BLOCK, SEEK_SET) != 0) {
-            printf("Error writing to file\r\n");
-            return PRODOS_HDD_ERR_IO;
+        // USB flash drive, the buffer is gathered like in prodos_hdd_read_block() and written without stdio buffering
+        uint8_t buf[PRODOS_HDD_BYTES_PER_BLOCK];
+        for (int i = 0; i < PRODOS_HDD_BYTES_PER_BLOCK; i++) {
+            buf[i] = mem_rd(mem, (uint16_t)(buffer + i));
         }
-        if (fwrite(mem_readptr(mem, buffer), 1, PRODOS_HDD_BYTES_PER_BLOCK, sys->file) != PRODOS_HDD_BYTES_PER_BLOCK) {
+        const off_t pos = (off_t)block * PRODOS_HDD_BYTES_PER_BLOCK;
+        if (pwrite(fileno(sys->file), buf, PRODOS_HDD_BYTES_PER_BLOCK, pos) != PRODOS_HDD_BYTES_PER_BLOCK) {
             printf("Error writing to file\r\n");
             return PRODOS_HDD_ERR_IO;
         }
-        fflush(sys->file);
     }
 
     return PRODOS_HDD_ERR_OK;
@@ -71,14 +71,26 @@ extern "C" {
 #endif
 
 // Bump snapshot version when apple2_t memory layout changes
-#define APPLE2_SNAPSHOT_VERSION (1)
+#define APPLE2_SNAPSHOT_VERSION (15)
+
+// State file system and chunk ids
+#define APPLE2_STATE_ID     CHIPS_STATE_ID('A', 'P', '2', ' ')
+#define APPLE2_STATE_RAM_ID CHIPS_STATE_ID('R', 'A', 'M', ' ')
+#define APPLE2_STATE_SYS_ID CHIPS_STATE_ID('S', 'Y', 'S', ' ')
 
 #define APPLE2_FREQUENCY (1021800)
 
+// Number of system ticks between beeper sample flushes (must be 2^N)
+#define APPLE2_AUDIO_BLOCK_TICKS (1024)
+
 #define APPLE2_SCREEN_WIDTH     560  // (280 * 2)
 #define APPLE2_SCREEN_HEIGHT    192  // (192)
 #define APPLE2_FRAMEBUFFER_SIZE ((APPLE2_SCREEN_WIDTH / 2) * APPLE2_SCREEN_HEIGHT)
 
+// Video timing (used for beam racing)
+#define APPLE2_TICKS_PER_SCANLINE  (65)
+#define APPLE2_SCANLINES_PER_FRAME (262)
+
 #define PALETTE_BITS 4
 #define PALETTE_SIZE (1 << PALETTE_BITS)
 
@@ -103,13 +115,84 @@ static uint32_t __not_in_flash() apple2_palette[PALETTE_SIZE] = {
 };
 // clang-format on
 
+#ifdef MOS6502CPU_PROFILE
+// Profiler bank indices (see mos6502cpu_profile_t.bank_map)
+#define APPLE2_PROFILE_BANK_RAM (0)  // Main RAM and language card RAM
+#define APPLE2_PROFILE_BANK_ROM (1)  // Motherboard and slot ROMs
+#define APPLE2_PROFILE_BANK_LC1 (2)  // Language card RAM bank 1 at $D000-$DFFF
+
+// Well-known DOS 3.3 and Monitor ROM entry points for profiler reports
+// clang-format off
+static const mos6502cpu_profile_symbol_t apple2_profile_symbols[] = {
+    { APPLE2_PROFILE_BANK_RAM, 0xB800, "DOS.PRENIB16" },
+    { APPLE2_PROFILE_BANK_RAM, 0xB82A, "DOS.WRITE16" },
+    { APPLE2_PROFILE_BANK_RAM, 0xB8C2, "DOS.POSTNB16" },
+    { APPLE2_PROFILE_BANK_RAM, 0xB8DC, "DOS.READ16" },
+    { APPLE2_PROFILE_BANK_RAM, 0xB944, "DOS.RDADR16" },
+    { APPLE2_PROFILE_BANK_RAM, 0xB9A0, "DOS.SEEKABS" },
+    { APPLE2_PROFILE_BANK_RAM, 0xBD00, "DOS.RWTS" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF800, "PLOT" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF819, "HLINE" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF828, "VLINE" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF832, "CLRSCR" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF836, "CLRTOP" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF847, "GBASCALC" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF864, "SETCOL" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF871, "SCRN" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF940, "PRNTYX" },
+    { APPLE2_PROFILE_BANK_ROM, 0xF948, "PRBLNK" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFA62, "RESET" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFB1E, "PREAD" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFB2F, "INIT" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFB39, "SETTXT" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFB40, "SETGR" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFBC1, "BASCALC" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFBDD, "BELL1" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFC22, "VTAB" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFC42, "CLREOP" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFC58, "HOME" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFC62, "CR" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFC66, "LF" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFC70, "SCROLL" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFC9C, "CLREOL" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFCA8, "WAIT" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFD0C, "RDKEY" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFD1B, "KEYIN" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFD35, "RDCHAR" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFD6A, "GETLN" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFD8E, "CROUT" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFDDA, "PRBYTE" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFDE3, "PRHEX" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFDED, "COUT" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFDF0, "COUT1" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFE2C, "MOVE" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFE80, "SETINV" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFE84, "SETNORM" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFE89, "SETKBD" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFE93, "SETVID" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFF2D, "PRERR" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFF3A, "BELL" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFF3F, "RESTORE" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFF4A, "SAVE" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFF59, "OLDRST" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFF65, "MON" },
+    { APPLE2_PROFILE_BANK_ROM, 0xFF69, "MONZ" },
+};
+// clang-format on
+#endif
+
 // Config parameters for apple2_init()
 typedef struct {
     bool fdc_enabled;         // Set to true to enable floppy disk controller emulation
     bool hdc_enabled;         // Set to true to enable hard disk controller emulation
     bool hdc_internal_flash;  // Set to true to use internal flash
+    bool beam_racing;         // Set to true to render each scanline as the beam passes it
     chips_debug_t debug;      // Optional debugging hook
     chips_audio_desc_t audio;
+    chips_scanline_callback_t scanline_callback;  // Optional, called after each scanline in beam racing mode
+#ifdef APPLE2_NTSC
+    chips_range_t ntsc_framebuffer;  // Optional RGBA output (APPLE2_SCREEN_WIDTH x APPLE2_SCREEN_HEIGHT), enables NTSC mode
+#endif
     struct {
         chips_range_t rom;
         chips_range_t character_rom;
@@ -127,7 +210,7 @@ typedef struct {
     bool valid;
     chips_debug_t debug;
 
-    chips_audio_callback_t audio_callback;
+    chips_audio_t audio;
 
     uint8_t ram[0xC000];
     uint8_t *rom;
@@ -150,7 +233,19 @@ typedef struct {
     bool hires_page1_dirty;
     bool hires_page2_dirty;
 
+    char text_screen[24][81];  // Decoded text page, see apple2_text_screen()
+    uint8_t text_screen_key;   // PAGE2 of the decoded text page (0: text page written since)
+
     uint8_t fb[APPLE2_FRAMEBUFFER_SIZE];
+    chips_dirty_rows_t dirty_rows;  // Framebuffer rows rendered since last cleared by the frontend
+#ifdef APPLE2_NTSC
+    uint32_t *ntsc_fb;  // Optional NTSC RGBA output, rendered together with fb
+#endif
+
+    bool beam_racing;
+    chips_scanline_callback_t scanline_callback;
+    uint8_t video_hpos;   // Beam position: tick within the scanline
+    uint16_t video_vpos;  // Beam position: scanline within the frame
 
     disk2_fdc_t fdc;  // Disk II floppy disk controller
 
@@ -172,6 +267,9 @@ typedef struct {
     bool butn1;
     bool butn2;
 
+    chips_idle_t idle;     // Guest idle loop detector
+    MOS6502CPU_T idle_cpu;  // CPU state at the last pass through the idle loop head
+
     uint32_t system_ticks;
 } apple2_t;
 
@@ -187,13 +285,39 @@ void apple2_reset(apple2_t *sys);
 void apple2_tick(apple2_t *sys);
 
 // Tick Apple2 instance for a given number of microseconds, return number of executed ticks
+// (stops early when a breakpoint in debug.breakpoints is hit, see stop_reason)
 uint32_t apple2_exec(apple2_t *sys, uint32_t micro_seconds);
+// Tick Apple2 instance for a given number of ticks without the debug hooks, tight loops which only poll
+// the keyboard are fast-forwarded (see chips_idle_t), returns number of fast-forwarded ticks
+uint32_t apple2_run_ticks(apple2_t *sys, uint32_t num_ticks);
+// Run until a condition is met or 'max_ticks' ticks have been executed, returns true if the condition was met.
+// Runs like apple2_run_ticks(): breakpoints and the debug callback are ignored. The text screen of CHIPS_UNTIL_TEXT
+// is checked every CHIPS_UNTIL_TEXT_TICKS ticks, CHIPS_UNTIL_IDLE stops at a read of $C000 without a key.
+bool apple2_run_until(apple2_t *sys, const chips_until_t *cond, uint32_t max_ticks);
 // Take a snapshot, patches pointers to zero or offsets, returns snapshot version
 uint32_t apple2_save_snapshot(apple2_t *sys, apple2_t *dst);
 // Load a snapshot, returns false if snapshot version doesn't match
 bool apple2_load_snapshot(apple2_t *sys, uint32_t version, apple2_t *src);
-
+// Write a portable state file through the 'write' callback, 'buffer' holds a chunk while it is written (at least
+// CHIPS_STATE_MAX_CHUNK_SIZE bytes), returns false on write error
+bool apple2_save_state(apple2_t *sys, chips_range_t buffer, chips_state_write_t write, void *user_data);
+// Load a state file into an instance initialized with the same config, returns false if the file is invalid
+bool apple2_load_state(apple2_t *sys, const void *data, size_t size);
+
+// Render the screen from video memory (does nothing in beam racing mode),
+// rendered rows are added to sys->dirty_rows
 void apple2_screen_update(apple2_t *sys);
+// Decode the displayed text page into 24 lines of 40 ASCII characters (inverse and flashing ones read as normal),
+// the result is cached until a text page is written or the displayed page changes
+void apple2_text_screen(apple2_t *sys, char out[24][81]);
+// Call after video memory was written without the CPU (e.g. with mem_write_range()), the screen is rendered and
+// the text page decoded again
+void apple2_video_mem_dirty(apple2_t *sys);
+
+#ifdef MOS6502CPU_PROFILE
+// Attach a guest code profiler (or null to detach), resets the profiler counters
+void apple2_profile_attach(apple2_t *sys, mos6502cpu_profile_t *profile);
+#endif
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -208,6 +332,10 @@ void apple2_screen_update(apple2_t *sys);
 #endif
 
 static void _apple2_init_memorymap(apple2_t *sys);
+static void _apple2_render_scanline(apple2_t *sys, uint16_t row);
+#ifdef MOS6502CPU_PROFILE
+static void _apple2_profile_update_banks(apple2_t *sys);
+#endif
 
 // clang-format off
 static uint8_t __not_in_flash() _apple2_artifact_color_lut[1<<7] = {
@@ -263,7 +391,7 @@ void apple2_init(apple2_t *sys, const apple2_desc_t *desc) {
     memset(sys, 0, sizeof(apple2_t));
     sys->valid = true;
     sys->debug = desc->debug;
-    sys->audio_callback = desc->audio.callback;
+    chips_audio_init(&sys->audio, &desc->audio);
 
     CHIPS_ASSERT(desc->roms.rom.ptr && (desc->roms.rom.size == 0x3000));
     CHIPS_ASSERT(desc->roms.character_rom.ptr && (desc->roms.character_rom.size == 0x800));
@@ -289,6 +417,17 @@ void apple2_init(apple2_t *sys, const apple2_desc_t *desc) {
 
     sys->flash_timer_ticks = APPLE2_FREQUENCY / 2;
 
+    sys->beam_racing = desc->beam_racing;
+    sys->scanline_callback = desc->scanline_callback;
+
+#ifdef APPLE2_NTSC
+    if (desc->ntsc_framebuffer.ptr) {
+        CHIPS_ASSERT(desc->ntsc_framebuffer.size >= APPLE2_SCREEN_WIDTH * APPLE2_SCREEN_HEIGHT * sizeof(uint32_t));
+        sys->ntsc_fb = (uint32_t *)desc->ntsc_framebuffer.ptr;
+        apple2_ntsc_init(apple2_palette);
+    }
+#endif
+
     sys->kbd_last_key = 0x0D | 0x80;
 
     sys->paddl0 = 0x80;
@@ -344,6 +483,12 @@ void apple2_reset(apple2_t *sys) {
     MOS6502CPU_RESET(&sys->cpu);
 }
 
+void apple2_video_mem_dirty(apple2_t *sys) {
+    sys->text_page1_dirty = sys->text_page2_dirty = true;
+    sys->hires_page1_dirty = sys->hires_page2_dirty = true;
+    sys->text_screen_key = 0;
+}
+
 static void _apple2_mem_c000_c0ff_rw(apple2_t *sys, uint16_t addr, bool rw) {
     switch (addr & 0xFF) {
         case 0x00:
@@ -359,7 +504,7 @@ static void _apple2_mem_c000_c0ff_rw(apple2_t *sys, uint16_t addr, bool rw) {
             break;
 
         case 0x30:
-            beeper_toggle(&sys->beeper);
+            beeper_toggle(&sys->beeper, sys->system_ticks);
             break;
 
         case 0x50:
@@ -461,6 +606,9 @@ static void _apple2_mem_c000_c0ff_rw(apple2_t *sys, uint16_t addr, bool rw) {
             } else if ((addr >= 0xC080) && (addr <= 0xC08F)) {
                 // Apple II 16K Language Card
                 apple2_lc_control(&sys->lc, addr & 0xF, rw);
+#ifdef MOS6502CPU_PROFILE
+                _apple2_profile_update_banks(sys);
+#endif
                 if (rw) {
                     MOS6502CPU_SET_DATA(&sys->cpu, 0xFF);
                 }
@@ -488,6 +636,8 @@ static void _apple2_mem_c000_c0ff_rw(apple2_t *sys, uint16_t addr, bool rw) {
                     } else {
                         // Memory write
                         prodos_hdc_write_byte(&sys->hdc, addr & 0xF, MOS6502CPU_GET_DATA(&sys->cpu), &sys->mem);
+                        // Block reads write to memory directly
+                        apple2_video_mem_dirty(sys);
                     }
                 } else {
                     if (rw) {
@@ -525,8 +675,10 @@ static void _apple2_mem_rw(apple2_t *sys, uint16_t addr, bool rw) {
             mem_wr(&sys->mem, addr, MOS6502CPU_GET_DATA(&sys->cpu));
             if (addr >= 0x400 && addr <= 0x7FF) {
                 sys->text_page1_dirty = true;
+                sys->text_screen_key = 0;
             } else if (addr >= 0x800 && addr <= 0xBFF) {
                 sys->text_page2_dirty = true;
+                sys->text_screen_key = 0;
             } else if (addr >= 0x2000 && addr <= 0x3FFF) {
                 sys->hires_page1_dirty = true;
             } else if (addr >= 0x4000 && addr <= 0x5FFF) {
@@ -536,6 +688,41 @@ static void _apple2_mem_rw(apple2_t *sys, uint16_t addr, bool rw) {
     }
 }
 
+static void _apple2_audio_flush(apple2_t *sys) {
+    beeper_sample_t samples[BEEPER_ACCUM_LEN];
+    const int num_samples = beeper_flush(&sys->beeper, sys->system_ticks, samples, BEEPER_ACCUM_LEN);
+    for (int i = 0; i < num_samples; i++) {
+        chips_audio_push(&sys->audio, beeper_sample_s16(samples[i]));
+    }
+}
+
+static void _apple2_flash_toggle(apple2_t *sys) {
+    sys->flash = !sys->flash;
+    sys->flash_timer_ticks = APPLE2_FREQUENCY / 2;
+    if (!sys->page2) {
+        sys->text_page1_dirty = true;
+    } else {
+        sys->text_page2_dirty = true;
+    }
+}
+
+// Beam racing: render each visible scanline as soon as the beam has passed it
+static void _apple2_beam_tick(apple2_t *sys) {
+    if (++sys->video_hpos < APPLE2_TICKS_PER_SCANLINE) {
+        return;
+    }
+    sys->video_hpos = 0;
+    if (sys->video_vpos < APPLE2_SCREEN_HEIGHT) {
+        _apple2_render_scanline(sys, sys->video_vpos);
+        if (sys->scanline_callback.func) {
+            sys->scanline_callback.func(sys->video_vpos, sys->scanline_callback.user_data);
+        }
+    }
+    if (++sys->video_vpos == APPLE2_SCANLINES_PER_FRAME) {
+        sys->video_vpos = 0;
+    }
+}
+
 void apple2_tick(apple2_t *sys) {
     if (sys->paddl0_ticks_left > 0) {
         sys->paddl0_ticks_left--;
@@ -554,12 +741,9 @@ void apple2_tick(apple2_t *sys) {
 
     _apple2_mem_rw(sys, sys->cpu.addr, sys->cpu.rw);
 
-    // Update beeper
-    if (beeper_tick(&sys->beeper)) {
-        if (sys->audio_callback.func) {
-            // New sample is ready
-            sys->audio_callback.func((uint8_t)(sys->beeper.sample * 255.0f), sys->audio_callback.user_data);
-        }
+    // Generate beeper samples once per audio block
+    if ((sys->system_ticks & (APPLE2_AUDIO_BLOCK_TICKS - 1)) == 0) {
+        _apple2_audio_flush(sys);
     }
 
     // Tick FDC
@@ -570,39 +754,292 @@ void apple2_tick(apple2_t *sys) {
     if (sys->flash_timer_ticks > 0) {
         sys->flash_timer_ticks--;
         if (sys->flash_timer_ticks == 0) {
-            sys->flash = !sys->flash;
-            sys->flash_timer_ticks = APPLE2_FREQUENCY / 2;
-            if (!sys->page2) {
-                sys->text_page1_dirty = true;
+            _apple2_flash_toggle(sys);
+        }
+    }
+
+    if (sys->beam_racing) {
+        _apple2_beam_tick(sys);
+    }
+
+    sys->system_ticks++;
+}
+
+// True for I/O with side effects and for inputs which may change during apple2_run_ticks(),
+// the keyboard and the buttons only change between calls
+static bool _apple2_idle_io(uint16_t addr, bool rw) {
+    if ((addr < 0xC000) || (addr > 0xC0FF)) {
+        return false;
+    }
+    return !rw || ((addr != 0xC000) && ((addr < 0xC061) || (addr > 0xC063)));
+}
+
+// Advance all but the CPU by 'num_ticks' ticks, in steps from one FDC tick or audio block to the next
+static void _apple2_idle_skip(apple2_t *sys, uint32_t num_ticks) {
+    sys->paddl0_ticks_left = (sys->paddl0_ticks_left > num_ticks) ? (sys->paddl0_ticks_left - num_ticks) : 0;
+    sys->paddl1_ticks_left = (sys->paddl1_ticks_left > num_ticks) ? (sys->paddl1_ticks_left - num_ticks) : 0;
+    sys->paddl2_ticks_left = (sys->paddl2_ticks_left > num_ticks) ? (sys->paddl2_ticks_left - num_ticks) : 0;
+    sys->paddl3_ticks_left = (sys->paddl3_ticks_left > num_ticks) ? (sys->paddl3_ticks_left - num_ticks) : 0;
+    while (num_ticks > 0) {
+        // The first tick of a step does what apple2_tick() does (APPLE2_AUDIO_BLOCK_TICKS is a multiple of 128)
+        if ((sys->system_ticks & (APPLE2_AUDIO_BLOCK_TICKS - 1)) == 0) {
+            _apple2_audio_flush(sys);
+        }
+        if (sys->fdc.valid && (sys->system_ticks & 127) == 0) {
+            disk2_fdc_tick(&sys->fdc);
+        }
+        uint32_t step = 128 - (sys->system_ticks & 127);
+        if (step > num_ticks) {
+            step = num_ticks;
+        }
+        if (sys->flash_timer_ticks > 0) {
+            if (sys->flash_timer_ticks <= step) {
+                // The step ends with the flash toggle
+                step = sys->flash_timer_ticks;
+                _apple2_flash_toggle(sys);
             } else {
-                sys->text_page2_dirty = true;
+                sys->flash_timer_ticks -= step;
             }
         }
+        sys->system_ticks += step;
+        num_ticks -= step;
     }
+}
 
-    sys->system_ticks++;
+// Test of the run-until conditions which are met by a CPU access
+static inline bool _apple2_until_tick(apple2_t *sys, const chips_until_t *cond) {
+    switch (cond->type) {
+        case CHIPS_UNTIL_PC:
+            return MOS6502CPU_GET_SYNC(&sys->cpu) && (sys->cpu.addr == cond->addr);
+        case CHIPS_UNTIL_MEM:
+            // Test at instruction boundaries, this also catches memory written by DMA
+            return MOS6502CPU_GET_SYNC(&sys->cpu) && ((mem_rd(&sys->mem, cond->addr) & cond->mask) == cond->value);
+        case CHIPS_UNTIL_IDLE:
+            return sys->cpu.rw && (sys->cpu.addr == 0xC000) && !(sys->kbd_last_key & 0x80);
+        default:
+            return false;
+    }
+}
+
+// apple2_run_ticks() which also stops after the tick meeting 'cond' (if not null), returns true if it was met,
+// the number of ticks run and fast-forwarded are added to 'ticks_run' and 'skipped_ticks'
+static bool _apple2_run(apple2_t *sys, uint32_t num_ticks, const chips_until_t *cond, uint32_t *ticks_run,
+                        uint32_t *skipped_ticks) {
+    chips_idle_t *idle = &sys->idle;
+    // Scanline callbacks, traced instructions and profiler cycles can't be fast-forwarded
+    bool idle_enabled = !sys->beam_racing;
+#ifdef MOS6502CPU_TRACE
+    idle_enabled = false;
+#endif
+#ifdef MOS6502CPU_PROFILE
+    idle_enabled = idle_enabled && !sys->cpu.profile;
+#endif
+    bool met = false;
+    uint32_t ticks = 0;
+    if (!idle_enabled) {
+        while (!met && (ticks < num_ticks)) {
+            apple2_tick(sys);
+            ticks++;
+            met = cond && _apple2_until_tick(sys, cond);
+        }
+        *ticks_run += ticks;
+        return met;
+    }
+    // Inputs may have changed since the last call, only iterations seen completely count
+    chips_idle_reset(idle);
+    while (!met && (ticks < num_ticks)) {
+        apple2_tick(sys);
+        ticks++;
+        if (cond && _apple2_until_tick(sys, cond)) {
+            met = true;
+        } else if (MOS6502CPU_GET_SYNC(&sys->cpu)) {
+            if (chips_idle_fetch(idle, sys->cpu.addr, sys->system_ticks)) {
+                if ((idle->num_repeats > 1) && (memcmp(&sys->idle_cpu, &sys->cpu, sizeof(sys->cpu)) == 0)) {
+                    // The loop is a fixed point, skip the iterations which fit in before the end
+                    uint32_t n = chips_idle_iterations(idle, num_ticks - ticks);
+                    if (cond) {
+                        n = chips_idle_until_iterations(idle, cond, n);
+                    }
+                    for (int i = 0; i < idle->num_last_writes; i++) {
+                        if (idle->counters & (1U << i)) {
+                            mem_wr(&sys->mem, (uint16_t)(idle->last_writes[i] >> 8), chips_idle_counter(idle, i, n));
+                        }
+                    }
+                    _apple2_idle_skip(sys, n * idle->period);
+                    ticks += n * idle->period;
+                    *skipped_ticks += n * idle->period;
+                }
+                memcpy(&sys->idle_cpu, &sys->cpu, sizeof(sys->cpu));
+            }
+        } else if (idle->tracking) {
+            chips_idle_access(idle, sys->cpu.addr, sys->cpu.rw, MOS6502CPU_GET_DATA(&sys->cpu),
+                              _apple2_idle_io(sys->cpu.addr, sys->cpu.rw));
+        }
+    }
+    *ticks_run += ticks;
+    return met;
+}
+
+uint32_t apple2_run_ticks(apple2_t *sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    uint32_t ticks = 0;
+    uint32_t skipped_ticks = 0;
+    _apple2_run(sys, num_ticks, 0, &ticks, &skipped_ticks);
+    return skipped_ticks;
+}
+
+static void _apple2_update_watch_flags(apple2_t *sys) {
+    const chips_breakpoints_t *bp = sys->debug.breakpoints;
+    mem_clear_page_flags(&sys->mem, MEM_PAGE_FLAG_WATCH_READ | MEM_PAGE_FLAG_WATCH_WRITE);
+    for (int i = 0; i < bp->num_watchpoints; i++) {
+        const chips_watchpoint_t *wp = &bp->watchpoints[i];
+        const uint8_t flags = ((wp->flags & CHIPS_WATCH_READ) ? MEM_PAGE_FLAG_WATCH_READ : 0) |
+                              ((wp->flags & CHIPS_WATCH_WRITE) ? MEM_PAGE_FLAG_WATCH_WRITE : 0);
+        mem_set_page_flags(&sys->mem, wp->addr, wp->size, flags);
+    }
+}
+
+// Check breakpoints and watchpoints after a tick, returns true if execution must stop
+static bool _apple2_check_breakpoints(apple2_t *sys) {
+    chips_breakpoints_t *bp = sys->debug.breakpoints;
+    const uint16_t addr = sys->cpu.addr;
+    if (MOS6502CPU_GET_SYNC(&sys->cpu) && chips_breakpoint_test(bp, addr)) {
+        bp->stop_reason = CHIPS_STOP_BREAKPOINT;
+        bp->stop_addr = addr;
+        return true;
+    }
+    if (mem_page_flags(&sys->mem, addr) & (sys->cpu.rw ? MEM_PAGE_FLAG_WATCH_READ : MEM_PAGE_FLAG_WATCH_WRITE)) {
+        const int reason = chips_watchpoint_test(bp, addr, sys->cpu.rw);
+        if (reason != CHIPS_STOP_NONE) {
+            bp->stop_reason = reason;
+            bp->stop_addr = addr;
+            return true;
+        }
+    }
+    return false;
 }
 
 uint32_t apple2_exec(apple2_t *sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
     uint32_t num_ticks = clk_us_to_ticks(APPLE2_FREQUENCY, micro_seconds);
+    uint32_t ticks;
+    if (sys->debug.breakpoints) {
+        sys->debug.breakpoints->stop_reason = CHIPS_STOP_NONE;
+        _apple2_update_watch_flags(sys);
+    }
     if (0 == sys->debug.callback.func) {
-        // run without debug callback
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-            apple2_tick(sys);
+        if (0 == sys->debug.breakpoints) {
+            // run without debug hooks
+            apple2_run_ticks(sys, num_ticks);
+            ticks = num_ticks;
+        } else {
+            // run with native breakpoints
+            for (ticks = 0; ticks < num_ticks;) {
+                apple2_tick(sys);
+                ticks++;
+                if (_apple2_check_breakpoints(sys)) {
+                    break;
+                }
+            }
         }
     } else {
         // run with debug callback
-        for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
+        for (ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped);) {
             apple2_tick(sys);
+            ticks++;
             sys->debug.callback.func(sys->debug.callback.user_data, 0);
+            if (sys->debug.breakpoints && _apple2_check_breakpoints(sys)) {
+                break;
+            }
         }
     }
     // kbd_update(&sys->kbd, micro_seconds);
+    _apple2_audio_flush(sys);
+    chips_audio_flush(&sys->audio);
     apple2_screen_update(sys);
 
     // printf("executed %d ticks\n", num_ticks);
-    return num_ticks;
+    return ticks;
+}
+
+// ASCII character of a text screen code, the character ROM has 64 characters (inverse, flashing, normal)
+static char _apple2_text_ascii(uint8_t code) {
+    code &= 0x3F;
+    return (char)((code < 0x20) ? (code + 0x40) : code);
+}
+
+// Decode the displayed text page into sys->text_screen, unless it is still up to date
+static void _apple2_text_screen_update(apple2_t *sys) {
+    const uint8_t key = 0x10 | (sys->page2 ? 0x01 : 0);
+    if (sys->text_screen_key == key) {
+        return;
+    }
+    const uint16_t start_address = sys->page2 ? 0x0800 : 0x0400;
+    for (int row = 0; row < 24; row++) {
+        const uint8_t *vram_row =
+            mem_shared_ptr(&sys->mem, &sys->ram[start_address + (((row & 0x07) << 7) | ((row & 0x18) * 5))]);
+        char *line = sys->text_screen[row];
+        for (int col = 0; col < 40; col++) {
+            line[col] = _apple2_text_ascii(vram_row[col]);
+        }
+        line[40] = 0;
+    }
+    sys->text_screen_key = key;
+}
+
+void apple2_text_screen(apple2_t *sys, char out[24][81]) {
+    CHIPS_ASSERT(sys && sys->valid && out);
+    _apple2_text_screen_update(sys);
+    memcpy(out, sys->text_screen, sizeof(sys->text_screen));
+}
+
+// True if a line of the displayed text page contains 'text'
+static bool _apple2_text_contains(apple2_t *sys, const char *text) {
+    _apple2_text_screen_update(sys);
+    for (int row = 0; row < 24; row++) {
+        if (strstr(sys->text_screen[row], text)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool apple2_run_until(apple2_t *sys, const chips_until_t *cond, uint32_t max_ticks) {
+    CHIPS_ASSERT(sys && sys->valid && cond);
+    bool met = false;
+    uint32_t ticks = 0;
+    uint32_t skipped_ticks = 0;
+    switch (cond->type) {
+        case CHIPS_UNTIL_PC:
+        case CHIPS_UNTIL_IDLE:
+            met = _apple2_run(sys, max_ticks, cond, &ticks, &skipped_ticks);
+            break;
+
+        case CHIPS_UNTIL_MEM:
+            met = (mem_rd(&sys->mem, cond->addr) & cond->mask) == cond->value;
+            if (!met) {
+                met = _apple2_run(sys, max_ticks, cond, &ticks, &skipped_ticks);
+            }
+            break;
+
+        case CHIPS_UNTIL_TEXT:
+            met = _apple2_text_contains(sys, cond->text);
+            while (!met && (ticks < max_ticks)) {
+                const uint32_t num_ticks =
+                    (max_ticks - ticks < CHIPS_UNTIL_TEXT_TICKS) ? (max_ticks - ticks) : CHIPS_UNTIL_TEXT_TICKS;
+                _apple2_run(sys, num_ticks, 0, &ticks, &skipped_ticks);
+                met = _apple2_text_contains(sys, cond->text);
+            }
+            break;
+
+        default:
+            CHIPS_ASSERT(false);
+            break;
+    }
+    _apple2_audio_flush(sys);
+    chips_audio_flush(&sys->audio);
+    apple2_screen_update(sys);
+    return met;
 }
 
 static void _apple2_init_memorymap(apple2_t *sys) {
@@ -611,20 +1048,52 @@ static void _apple2_init_memorymap(apple2_t *sys) {
         sys->ram[addr] = 0;
         sys->ram[addr + 1] = 0xFF;
     }
-    mem_map_ram(&sys->mem, 0, 0x0000, 0xC000, sys->ram);
+    mem_map_ram(&sys->mem, APPLE2_LC_BASE_LAYER, 0x0000, 0xC000, sys->ram);
 }
 
 uint32_t apple2_save_snapshot(apple2_t *sys, apple2_t *dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
-    chips_audio_callback_snapshot_onsave(&dst->audio_callback);
+    chips_audio_snapshot_onsave(&dst->audio);
+    chips_scanline_callback_snapshot_onsave(&dst->scanline_callback);
+#ifdef APPLE2_NTSC
+    dst->ntsc_fb = 0;
+#endif
     // m6502_snapshot_onsave(&dst->cpu);
     disk2_fdc_snapshot_onsave(&dst->fdc);
     mem_snapshot_onsave(&dst->mem, sys);
     return APPLE2_SNAPSHOT_VERSION;
 }
 
+#ifdef MOS6502CPU_PROFILE
+static void _apple2_profile_update_banks(apple2_t *sys) {
+    mos6502cpu_profile_t *p = sys->cpu.profile;
+    if (!p) {
+        return;
+    }
+    for (int i = 0x0; i <= 0xB; i++) {
+        p->bank_map[i] = APPLE2_PROFILE_BANK_RAM;
+    }
+    p->bank_map[0xC] = APPLE2_PROFILE_BANK_ROM;
+    if (sys->lc.state & APPLE2_LC_READ_ENABLED) {
+        p->bank_map[0xD] = (sys->lc.current_bank == 0) ? APPLE2_PROFILE_BANK_LC1 : APPLE2_PROFILE_BANK_RAM;
+        p->bank_map[0xE] = p->bank_map[0xF] = APPLE2_PROFILE_BANK_RAM;
+    } else {
+        p->bank_map[0xD] = p->bank_map[0xE] = p->bank_map[0xF] = APPLE2_PROFILE_BANK_ROM;
+    }
+}
+
+void apple2_profile_attach(apple2_t *sys, mos6502cpu_profile_t *profile) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->cpu.profile = profile;
+    if (profile) {
+        mos6502cpu_profile_reset(profile);
+        _apple2_profile_update_banks(sys);
+    }
+}
+#endif
+
 bool apple2_load_snapshot(apple2_t *sys, uint32_t version, apple2_t *src) {
     CHIPS_ASSERT(sys && src);
     if (version != APPLE2_SNAPSHOT_VERSION) {
@@ -633,14 +1102,159 @@ bool apple2_load_snapshot(apple2_t *sys, uint32_t version, apple2_t *src) {
     static apple2_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
-    chips_audio_callback_snapshot_onload(&im.audio_callback, &sys->audio_callback);
+    chips_audio_snapshot_onload(&im.audio, &sys->audio);
+    chips_scanline_callback_snapshot_onload(&im.scanline_callback, &sys->scanline_callback);
+#ifdef APPLE2_NTSC
+    im.ntsc_fb = sys->ntsc_fb;
+#endif
     // m6502_snapshot_onload(&im.cpu, &sys->cpu);
     disk2_fdc_snapshot_onload(&im.fdc, &sys->fdc);
     mem_snapshot_onload(&im.mem, sys);
+#ifdef MOS6502CPU_PROFILE
+    im.cpu.profile = sys->cpu.profile;
+#endif
     *sys = im;
+    // The framebuffer was replaced, all rows differ from what the frontend has seen
+    chips_dirty_rows_set_all(&sys->dirty_rows);
+    // The NTSC output is not part of the snapshot
+    apple2_video_mem_dirty(sys);
+#ifdef MOS6502CPU_PROFILE
+    _apple2_profile_update_banks(sys);
+#endif
     return true;
 }
 
+bool apple2_save_state(apple2_t *sys, chips_range_t buffer, chips_state_write_t write, void *user_data) {
+    CHIPS_ASSERT(sys && sys->valid && write);
+    chips_state_writer_t w;
+    chips_state_writer_init(&w, APPLE2_STATE_ID, buffer, write, user_data);
+    MOS6502CPU_SAVE_STATE(&sys->cpu, &w);
+    chips_state_put_memory(&w, APPLE2_STATE_RAM_ID, sys->ram, sizeof(sys->ram), 0xFF00);
+    apple2_lc_save_state(&sys->lc, &w);
+
+    chips_state_begin_chunk(&w, APPLE2_STATE_SYS_ID, 1);
+    chips_state_put_bool(&w, sys->text);
+    chips_state_put_bool(&w, sys->mixed);
+    chips_state_put_bool(&w, sys->page2);
+    chips_state_put_bool(&w, sys->hires);
+    chips_state_put_bool(&w, sys->flash);
+    chips_state_put32(&w, sys->flash_timer_ticks);
+    chips_state_put8(&w, sys->kbd_last_key);
+    chips_state_put8(&w, sys->paddl0);
+    chips_state_put8(&w, sys->paddl1);
+    chips_state_put8(&w, sys->paddl2);
+    chips_state_put8(&w, sys->paddl3);
+    chips_state_put16(&w, sys->paddl0_ticks_left);
+    chips_state_put16(&w, sys->paddl1_ticks_left);
+    chips_state_put16(&w, sys->paddl2_ticks_left);
+    chips_state_put16(&w, sys->paddl3_ticks_left);
+    chips_state_put_bool(&w, sys->butn0);
+    chips_state_put_bool(&w, sys->butn1);
+    chips_state_put_bool(&w, sys->butn2);
+    chips_state_put32(&w, sys->system_ticks);
+    chips_state_put8(&w, sys->video_hpos);
+    chips_state_put16(&w, sys->video_vpos);
+    chips_state_end_chunk(&w);
+
+    beeper_save_state(&sys->beeper, &w);
+    if (sys->fdc.valid) {
+        disk2_fdc_save_state(&sys->fdc, &w);
+    }
+    if (sys->hdc.valid) {
+        prodos_hdc_save_state(&sys->hdc, &w);
+    }
+    return chips_state_writer_finish(&w);
+}
+
+// Read the state file chunks into 'sys', in check mode the disk images are not written
+static bool _apple2_load_chunks(apple2_t *sys, chips_state_reader_t *r, bool check) {
+    // Memory blocks missing from the file hold the power-on pattern
+    chips_state_fill_memory(sys->ram, sizeof(sys->ram), 0xFF00);
+    chips_state_fill_memory(sys->lc.ram, sizeof(sys->lc.ram), 0);
+    bool ok = true;
+    while (ok && chips_state_next_chunk(r)) {
+        switch (r->chunk_id) {
+            case MOS6502CPU_STATE_ID:
+                ok = MOS6502CPU_LOAD_STATE(&sys->cpu, r);
+                break;
+            case APPLE2_STATE_RAM_ID:
+                ok = chips_state_get_memory(r, sys->ram, sizeof(sys->ram), 0xFF00);
+                break;
+            case APPLE2_LC_STATE_ID:
+            case APPLE2_LC_STATE_RAM_ID:
+                ok = apple2_lc_load_state(&sys->lc, r);
+                break;
+            case APPLE2_STATE_SYS_ID:
+                sys->text = chips_state_get_bool(r);
+                sys->mixed = chips_state_get_bool(r);
+                sys->page2 = chips_state_get_bool(r);
+                sys->hires = chips_state_get_bool(r);
+                sys->flash = chips_state_get_bool(r);
+                sys->flash_timer_ticks = chips_state_get32(r);
+                sys->kbd_last_key = chips_state_get8(r);
+                sys->paddl0 = chips_state_get8(r);
+                sys->paddl1 = chips_state_get8(r);
+                sys->paddl2 = chips_state_get8(r);
+                sys->paddl3 = chips_state_get8(r);
+                sys->paddl0_ticks_left = chips_state_get16(r);
+                sys->paddl1_ticks_left = chips_state_get16(r);
+                sys->paddl2_ticks_left = chips_state_get16(r);
+                sys->paddl3_ticks_left = chips_state_get16(r);
+                sys->butn0 = chips_state_get_bool(r);
+                sys->butn1 = chips_state_get_bool(r);
+                sys->butn2 = chips_state_get_bool(r);
+                sys->system_ticks = chips_state_get32(r);
+                sys->video_hpos = chips_state_get8(r) % APPLE2_TICKS_PER_SCANLINE;
+                sys->video_vpos = chips_state_get16(r) % APPLE2_SCANLINES_PER_FRAME;
+                ok = r->ok;
+                break;
+            case BEEPER_STATE_ID:
+                ok = beeper_load_state(&sys->beeper, r);
+                break;
+            case DISK2_FDC_STATE_ID:
+            case DISK2_FDC_STATE_TRACK_ID:
+                // Chunks of devices this instance does not have are skipped
+                if (sys->fdc.valid) {
+                    ok = check ? disk2_fdc_check_state(&sys->fdc, r) : disk2_fdc_load_state(&sys->fdc, r);
+                }
+                break;
+            case PRODOS_HDC_STATE_ID:
+                if (sys->hdc.valid) {
+                    ok = prodos_hdc_load_state(&sys->hdc, r);
+                }
+                break;
+            default:
+                // Chunk written by a newer version
+                break;
+        }
+    }
+    return ok;
+}
+
+bool apple2_load_state(apple2_t *sys, const void *data, size_t size) {
+    CHIPS_ASSERT(sys && sys->valid && data);
+    chips_state_reader_t r;
+    if (!chips_state_reader_init(&r, data, size, APPLE2_STATE_ID)) {
+        return false;
+    }
+    // Load into a scratch copy first, so an invalid chunk leaves the machine unchanged
+    static apple2_t im;
+    im = *sys;
+    im.lc.sys_mem = &im.mem;
+    chips_state_reader_t check = r;
+    if (!_apple2_load_chunks(&im, &check, true)) {
+        return false;
+    }
+    const bool ok = _apple2_load_chunks(sys, &r, false);
+    CHIPS_ASSERT(ok);
+    // The framebuffer is not stored, render it from video memory again
+    apple2_video_mem_dirty(sys);
+#ifdef MOS6502CPU_PROFILE
+    _apple2_profile_update_banks(sys);
+#endif
+    return ok;
+}
+
 static void _apple2_render_line_monochrome(uint8_t *out, uint16_t *in, int start_col, int stop_col) {
     uint32_t w = in[start_col];
 
@@ -698,6 +1312,90 @@ static uint8_t _apple2_get_text_character(apple2_t *sys, uint8_t code, uint16_t
 
 static uint8_t *_apple2_get_fb_addr(apple2_t *sys, uint16_t row) { return &sys->fb[row * (APPLE2_SCREEN_WIDTH / 2)]; }
 
+// NTSC output of a rendered row, does nothing unless built with APPLE2_NTSC and an NTSC framebuffer is set
+typedef enum {
+    _APPLE2_NTSC_COLORS,
+    _APPLE2_NTSC_MONO,
+    _APPLE2_NTSC_SIGNAL,
+    _APPLE2_NTSC_COPY
+} _apple2_ntsc_source_t;
+
+static void _apple2_ntsc_row(apple2_t *sys, uint16_t row, _apple2_ntsc_source_t source, const uint16_t *words) {
+#ifdef APPLE2_NTSC
+    if (!sys->ntsc_fb) {
+        return;
+    }
+    uint32_t *out = &sys->ntsc_fb[row * APPLE2_SCREEN_WIDTH];
+    switch (source) {
+        case _APPLE2_NTSC_COLORS: apple2_ntsc_render_colors(out, _apple2_get_fb_addr(sys, row)); break;
+        case _APPLE2_NTSC_MONO: apple2_ntsc_render_mono(out, words); break;
+        case _APPLE2_NTSC_SIGNAL: apple2_ntsc_render_signal(out, words, 0); break;
+        case _APPLE2_NTSC_COPY: memcpy(out, out - APPLE2_SCREEN_WIDTH, APPLE2_SCREEN_WIDTH * sizeof(uint32_t)); break;
+    }
+#else
+    (void)sys;
+    (void)row;
+    (void)source;
+    (void)words;
+#endif
+}
+
+static void _apple2_lores_row(apple2_t *sys, uint16_t start_address, uint16_t row) {
+    uint16_t address = start_address + ((((row / 8) & 0x07) << 7) | (((row / 8) & 0x18) * 5));
+    uint8_t *vram_row = &sys->ram[address];
+
+#define NIBBLE(byte) (((byte) >> (row & 4)) & 0x0F)
+    uint8_t *p = _apple2_get_fb_addr(sys, row);
+
+    for (int col = 0; col < 40; col++) {
+        uint8_t c = NIBBLE(vram_row[col]);
+        for (int b = 0; b < 7; b++) {
+            *p = c << 4;
+            *p++ |= c;
+        }
+    }
+#undef NIBBLE
+    _apple2_ntsc_row(sys, row, _APPLE2_NTSC_COLORS, 0);
+    chips_dirty_rows_set(&sys->dirty_rows, row);
+}
+
+static void _apple2_text_row(apple2_t *sys, uint16_t start_address, uint16_t row) {
+    uint16_t address = start_address + ((((row / 8) & 0x07) << 7) | (((row / 8) & 0x18) * 5));
+    uint8_t *vram_row = &sys->ram[address];
+
+    uint16_t words[40];
+
+    for (int col = 0; col < 40; col++) {
+        words[col] = _apple2_double_7_bits(_apple2_get_text_character(sys, vram_row[col], row & 7));
+    }
+
+    _apple2_render_line_monochrome(_apple2_get_fb_addr(sys, row), words, 0, 40);
+    _apple2_ntsc_row(sys, row, _APPLE2_NTSC_MONO, words);
+    chips_dirty_rows_set(&sys->dirty_rows, row);
+}
+
+static void _apple2_hgr_row(apple2_t *sys, uint16_t start_address, uint16_t row) {
+    uint32_t address = start_address + (((row / 8) & 0x07) << 7) + (((row / 8) & 0x18) * 5) + ((row & 7) << 10);
+    uint8_t *vram_row = &sys->ram[address];
+
+    uint16_t words[40];
+
+    uint16_t last_output_bit = 0;
+
+    for (int col = 0; col < 40; col++) {
+        uint16_t w = _apple2_double_7_bits(vram_row[col] & 0x7F);
+        if (vram_row[col] & 0x80) {
+            w = (w << 1 | last_output_bit) & 0x3FFF;
+        };
+        words[col] = w;
+        last_output_bit = w >> 13;
+    }
+
+    _apple2_render_line_color(_apple2_get_fb_addr(sys, row), words, 0, 40);
+    _apple2_ntsc_row(sys, row, _APPLE2_NTSC_SIGNAL, words);
+    chips_dirty_rows_set(&sys->dirty_rows, row);
+}
+
 static void _apple2_lores_update(apple2_t *sys, uint16_t begin_row, uint16_t end_row) {
     if ((!sys->page2 && !sys->text_page1_dirty) || (sys->page2 && !sys->text_page2_dirty)) {
         return;
@@ -709,23 +1407,12 @@ static void _apple2_lores_update(apple2_t *sys, uint16_t begin_row, uint16_t end
     uint16_t stop_row = ((end_row / 8) + 1) * 8;
 
     for (int row = start_row; row < stop_row; row += 4) {
-        uint16_t address = start_address + ((((row / 8) & 0x07) << 7) | (((row / 8) & 0x18) * 5));
-        uint8_t *vram_row = &sys->ram[address];
-
-#define NIBBLE(byte) (((byte) >> (row & 4)) & 0x0F)
-        uint8_t *p = _apple2_get_fb_addr(sys, row);
-
-        for (int col = 0; col < 40; col++) {
-            uint8_t c = NIBBLE(vram_row[col]);
-            for (int b = 0; b < 7; b++) {
-                *p = c << 4;
-                *p++ |= c;
-            }
-        }
-#undef NIBBLE
+        _apple2_lores_row(sys, start_address, row);
 
         for (int y = 1; y < 4; y++) {
             memcpy(_apple2_get_fb_addr(sys, row + y), _apple2_get_fb_addr(sys, row), 40 * 7);
+            _apple2_ntsc_row(sys, row + y, _APPLE2_NTSC_COPY, 0);
+            chips_dirty_rows_set(&sys->dirty_rows, row + y);
         }
     }
 
@@ -747,16 +1434,7 @@ static void _apple2_text_update(apple2_t *sys, uint16_t begin_row, uint16_t end_
     uint16_t stop_row = ((end_row / 8) + 1) * 8;
 
     for (int row = start_row; row < stop_row; row++) {
-        uint16_t address = start_address + ((((row / 8) & 0x07) << 7) | (((row / 8) & 0x18) * 5));
-        uint8_t *vram_row = &sys->ram[address];
-
-        uint16_t words[40];
-
-        for (int col = 0; col < 40; col++) {
-            words[col] = _apple2_double_7_bits(_apple2_get_text_character(sys, vram_row[col], row & 7));
-        }
-
-        _apple2_render_line_monochrome(_apple2_get_fb_addr(sys, row), words, 0, 40);
+        _apple2_text_row(sys, start_address, row);
     }
 
     if (!sys->page2) {
@@ -774,23 +1452,7 @@ static void _apple2_hgr_update(apple2_t *sys, uint16_t begin_row, uint16_t end_r
     uint16_t start_address = sys->page2 ? 0x4000 : 0x2000;
 
     for (int row = begin_row; row <= end_row; row++) {
-        uint32_t address = start_address + (((row / 8) & 0x07) << 7) + (((row / 8) & 0x18) * 5) + ((row & 7) << 10);
-        uint8_t *vram_row = &sys->ram[address];
-
-        uint16_t words[40];
-
-        uint16_t last_output_bit = 0;
-
-        for (int col = 0; col < 40; col++) {
-            uint16_t w = _apple2_double_7_bits(vram_row[col] & 0x7F);
-            if (vram_row[col] & 0x80) {
-                w = (w << 1 | last_output_bit) & 0x3FFF;
-            };
-            words[col] = w;
-            last_output_bit = w >> 13;
-        }
-
-        _apple2_render_line_color(_apple2_get_fb_addr(sys, row), words, 0, 40);
+        _apple2_hgr_row(sys, start_address, row);
     }
 
     if (!sys->page2) {
@@ -800,7 +1462,23 @@ static void _apple2_hgr_update(apple2_t *sys, uint16_t begin_row, uint16_t end_r
     }
 }
 
+// Render a single scanline with the current soft switch state (beam racing)
+static void _apple2_render_scanline(apple2_t *sys, uint16_t row) {
+    if (sys->text || (sys->mixed && (row >= 160))) {
+        _apple2_text_row(sys, sys->page2 ? 0x0800 : 0x0400, row);
+    } else if (sys->hires) {
+        _apple2_hgr_row(sys, sys->page2 ? 0x4000 : 0x2000, row);
+    } else {
+        _apple2_lores_row(sys, sys->page2 ? 0x0800 : 0x0400, row);
+    }
+}
+
 void apple2_screen_update(apple2_t *sys) {
+    if (sys->beam_racing) {
+        // Scanlines are rendered as the beam passes them
+        return;
+    }
+
     uint16_t text_start_row = 0;
 
     if (!sys->text) {
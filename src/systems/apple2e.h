@@ -71,14 +71,34 @@ extern "C" {
 #endif
 
 // Bump snapshot version when apple2e_t memory layout changes
-#define APPLE2E_SNAPSHOT_VERSION (1)
+#define APPLE2E_SNAPSHOT_VERSION (16)
+
+// State file system and chunk ids
+#define APPLE2E_STATE_ID     CHIPS_STATE_ID('A', 'P', '2', 'E')
+#define APPLE2E_STATE_RAM_ID CHIPS_STATE_ID('R', 'A', 'M', ' ')
+#define APPLE2E_STATE_AUX_ID CHIPS_STATE_ID('A', 'U', 'X', ' ')
+#define APPLE2E_STATE_SYS_ID CHIPS_STATE_ID('S', 'Y', 'S', ' ')
 
 #define APPLE2E_FREQUENCY (1021800)
 
+// Number of system ticks between beeper sample flushes (must be 2^N)
+#define APPLE2E_AUDIO_BLOCK_TICKS (1024)
+
 #define APPLE2E_SCREEN_WIDTH     560  // (280 * 2)
 #define APPLE2E_SCREEN_HEIGHT    192  // (192)
 #define APPLE2E_FRAMEBUFFER_SIZE ((APPLE2E_SCREEN_WIDTH / 2) * APPLE2E_SCREEN_HEIGHT)
 
+// Video timing (used for beam racing)
+#define APPLE2E_TICKS_PER_SCANLINE (65)
+
+#ifndef APPLE2E_LC_CACHE_SIZE
+// Number of cached language card memory maps
+#define APPLE2E_LC_CACHE_SIZE (4)
+#endif
+// Pages of the banked regions: RAMRD/RAMWRT/ALTZP/80STORE at $0000-$BFFF, the language card at $D000-$FFFF
+#define APPLE2E_MAIN_PAGES (0xC000 >> MEM_PAGE_SHIFT)
+#define APPLE2E_LC_PAGES   (0x3000 >> MEM_PAGE_SHIFT)
+
 #define PALETTE_BITS 4
 #define PALETTE_SIZE (1 << PALETTE_BITS)
 
@@ -103,13 +123,86 @@ static const uint32_t apple2e_palette[PALETTE_SIZE] = {
 };
 // clang-format on
 
+#ifdef MOS6502CPU_PROFILE
+// Profiler bank indices (see mos6502cpu_profile_t.bank_map)
+#define APPLE2E_PROFILE_BANK_MAIN     (0)  // Main RAM and main language card RAM
+#define APPLE2E_PROFILE_BANK_AUX      (1)  // Auxiliary RAM and auxiliary language card RAM
+#define APPLE2E_PROFILE_BANK_ROM      (2)  // Internal and slot ROMs
+#define APPLE2E_PROFILE_BANK_MAIN_LC1 (3)  // Main language card RAM bank 1 at $D000-$DFFF
+#define APPLE2E_PROFILE_BANK_AUX_LC1  (4)  // Auxiliary language card RAM bank 1 at $D000-$DFFF
+
+// Well-known DOS 3.3 and Monitor ROM entry points for profiler reports
+// clang-format off
+static const mos6502cpu_profile_symbol_t apple2e_profile_symbols[] = {
+    { APPLE2E_PROFILE_BANK_MAIN, 0xB800, "DOS.PRENIB16" },
+    { APPLE2E_PROFILE_BANK_MAIN, 0xB82A, "DOS.WRITE16" },
+    { APPLE2E_PROFILE_BANK_MAIN, 0xB8C2, "DOS.POSTNB16" },
+    { APPLE2E_PROFILE_BANK_MAIN, 0xB8DC, "DOS.READ16" },
+    { APPLE2E_PROFILE_BANK_MAIN, 0xB944, "DOS.RDADR16" },
+    { APPLE2E_PROFILE_BANK_MAIN, 0xB9A0, "DOS.SEEKABS" },
+    { APPLE2E_PROFILE_BANK_MAIN, 0xBD00, "DOS.RWTS" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF800, "PLOT" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF819, "HLINE" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF828, "VLINE" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF832, "CLRSCR" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF836, "CLRTOP" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF847, "GBASCALC" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF864, "SETCOL" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF871, "SCRN" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF940, "PRNTYX" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xF948, "PRBLNK" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFA62, "RESET" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFB1E, "PREAD" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFB2F, "INIT" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFB39, "SETTXT" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFB40, "SETGR" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFBC1, "BASCALC" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFBDD, "BELL1" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFC22, "VTAB" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFC42, "CLREOP" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFC58, "HOME" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFC62, "CR" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFC66, "LF" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFC70, "SCROLL" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFC9C, "CLREOL" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFCA8, "WAIT" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFD0C, "RDKEY" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFD1B, "KEYIN" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFD35, "RDCHAR" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFD6A, "GETLN" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFD8E, "CROUT" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFDDA, "PRBYTE" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFDE3, "PRHEX" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFDED, "COUT" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFDF0, "COUT1" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFE2C, "MOVE" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFE80, "SETINV" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFE84, "SETNORM" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFE89, "SETKBD" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFE93, "SETVID" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFF2D, "PRERR" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFF3A, "BELL" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFF3F, "RESTORE" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFF4A, "SAVE" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFF59, "OLDRST" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFF65, "MON" },
+    { APPLE2E_PROFILE_BANK_ROM, 0xFF69, "MONZ" },
+};
+// clang-format on
+#endif
+
 // Config parameters for apple2e_init()
 typedef struct {
     bool fdc_enabled;         // Set to true to enable floppy disk controller emulation
     bool hdc_enabled;         // Set to true to enable hard disk controller emulation
     bool hdc_internal_flash;  // Set to true to use internal flash
+    bool beam_racing;         // Set to true to render each scanline as the beam passes it
     chips_debug_t debug;      // Optional debugging hook
     chips_audio_desc_t audio;
+    chips_scanline_callback_t scanline_callback;  // Optional, called after each scanline in beam racing mode
+#ifdef APPLE2_NTSC
+    chips_range_t ntsc_framebuffer;  // Optional RGBA output (APPLE2E_SCREEN_WIDTH x APPLE2E_SCREEN_HEIGHT), enables NTSC mode
+#endif
     struct {
         chips_range_t rom;
         chips_range_t character_rom;
@@ -119,16 +212,26 @@ typedef struct {
     } roms;
 } apple2e_desc_t;
 
+// Precomputed memory maps of the banked regions, a bank switch copies their page items with mem_map_pages()
+// instead of rebuilding them (they point into the system, see _apple2e_mem_maps_init())
+typedef struct {
+    mem_page_t main[4][APPLE2E_MAIN_PAGES];  // Bit 0 of the bank selects aux RAM for reads, bit 1 for writes
+    mem_page_t lc[APPLE2E_LC_CACHE_SIZE][APPLE2E_LC_PAGES];
+    uint8_t lc_keys[APPLE2E_LC_CACHE_SIZE];  // Language card state of each entry (0: unused)
+    uint8_t lc_next;                         // Entry replaced next
+} apple2e_mem_maps_t;
+
 // Apple //e emulator state
 typedef struct {
     MOS6502CPU_T cpu;
     beeper_t beeper;
     kbd_t kbd;
     mem_t mem;
+    apple2e_mem_maps_t mem_maps;
     bool valid;
     chips_debug_t debug;
 
-    chips_audio_callback_t audio_callback;
+    chips_audio_t audio;
 
     uint8_t ram[0x10000];
     uint8_t aux_ram[0x10000];
@@ -165,7 +268,18 @@ typedef struct {
     bool hires_page1_dirty;
     bool hires_page2_dirty;
 
+    char text_screen[24][81];  // Decoded text page, see apple2e_text_screen()
+    uint8_t text_screen_key;   // Display switches of the decoded text page (0: text page written since)
+
     uint8_t fb[APPLE2E_FRAMEBUFFER_SIZE];
+    chips_dirty_rows_t dirty_rows;  // Framebuffer rows rendered since last cleared by the frontend
+#ifdef APPLE2_NTSC
+    uint32_t *ntsc_fb;  // Optional NTSC RGBA output, rendered together with fb
+#endif
+
+    bool beam_racing;
+    chips_scanline_callback_t scanline_callback;
+    uint8_t video_row;  // Next scanline to be rendered in beam racing mode
 
     disk2_fdc_t fdc;  // Disk II floppy disk controller
 
@@ -189,6 +303,9 @@ typedef struct {
     bool butn1;
     bool butn2;
 
+    chips_idle_t idle;     // Guest idle loop detector
+    MOS6502CPU_T idle_cpu;  // CPU state at the last pass through the idle loop head
+
     uint32_t system_ticks;
     uint16_t vbl_ticks;
 } apple2e_t;
@@ -205,13 +322,46 @@ void apple2e_reset(apple2e_t *sys);
 void apple2e_tick(apple2e_t *sys);
 
 // Tick Apple2e instance for a given number of microseconds, return number of executed ticks
+// (stops early when a breakpoint in debug.breakpoints is hit, see stop_reason)
 uint32_t apple2e_exec(apple2e_t *sys, uint32_t micro_seconds);
+// Tick Apple2e instance for a given number of ticks without the debug hooks, tight loops which only poll
+// the keyboard or the VBL flag are fast-forwarded (see chips_idle_t), returns number of fast-forwarded ticks
+uint32_t apple2e_run_ticks(apple2e_t *sys, uint32_t num_ticks);
+// Run until a condition is met or 'max_ticks' ticks have been executed, returns true if the condition was met.
+// Runs like apple2e_run_ticks(): breakpoints and the debug callback are ignored. The text screen of CHIPS_UNTIL_TEXT
+// is checked every CHIPS_UNTIL_TEXT_TICKS ticks, CHIPS_UNTIL_IDLE stops at a read of $C000 without a key.
+bool apple2e_run_until(apple2e_t *sys, const chips_until_t *cond, uint32_t max_ticks);
 // Take snapshot, patches pointers to zero or offsets, returns snapshot version
 uint32_t apple2e_save_snapshot(apple2e_t *sys, apple2e_t *dst);
 // Load snapshot, returns false if snapshot version doesn't match
 bool apple2e_load_snapshot(apple2e_t *sys, uint32_t version, apple2e_t *src);
+// Write a portable state file through the 'write' callback, 'buffer' holds a chunk while it is written (at least
+// CHIPS_STATE_MAX_CHUNK_SIZE bytes), returns false on write error
+bool apple2e_save_state(apple2e_t *sys, chips_range_t buffer, chips_state_write_t write, void *user_data);
+// Load a state file into an instance initialized with the same config, returns false if the file is invalid
+bool apple2e_load_state(apple2e_t *sys, const void *data, size_t size);
+// Fork an instance: 'fork' continues from the current state of 'sys' and reads the RAM of 'sys' until it writes to
+// it (copy-on-write). 'sys' must not run or be discarded while it has forks. Forks produce no audio, have no
+// callbacks and their disk drives are write protected, so forks of the same instance can run on different threads.
+// Needs mem.h compiled with MEM_COPY_ON_WRITE.
+#ifdef MEM_COPY_ON_WRITE
+void apple2e_fork(apple2e_t *sys, apple2e_t *fork);
+#endif
 
+// Render the screen from video memory (does nothing in beam racing mode),
+// rendered rows are added to sys->dirty_rows
 void apple2e_screen_update(apple2e_t *sys);
+// Decode the displayed text page into 24 lines of 40 or 80 ASCII characters (inverse and flashing ones read as
+// normal, MouseText as '@' to '_'), the result is cached until a text page is written or the display switches change
+void apple2e_text_screen(apple2e_t *sys, char out[24][81]);
+// Call after video memory was written without the CPU (e.g. with mem_write_range()), the screen is rendered and
+// the text page decoded again
+void apple2e_video_mem_dirty(apple2e_t *sys);
+
+#ifdef MOS6502CPU_PROFILE
+// Attach a guest code profiler (or null to detach), resets the profiler counters
+void apple2e_profile_attach(apple2e_t *sys, mos6502cpu_profile_t *profile);
+#endif
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -226,6 +376,10 @@ void apple2e_screen_update(apple2e_t *sys);
 #endif
 
 static void _apple2e_init_memorymap(apple2e_t *sys);
+static void _apple2e_render_scanline(apple2e_t *sys, uint16_t row);
+#ifdef MOS6502CPU_PROFILE
+static void _apple2e_profile_update_banks(apple2e_t *sys);
+#endif
 
 // clang-format off
 static uint8_t __not_in_flash() _apple2e_artifact_color_lut[1<<7] = {
@@ -275,7 +429,7 @@ void apple2e_init(apple2e_t *sys, const apple2e_desc_t *desc) {
     memset(sys, 0, sizeof(apple2e_t));
     sys->valid = true;
     sys->debug = desc->debug;
-    sys->audio_callback = desc->audio.callback;
+    chips_audio_init(&sys->audio, &desc->audio);
 
     CHIPS_ASSERT(desc->roms.rom.ptr && (desc->roms.rom.size == 0x4000));
     CHIPS_ASSERT(desc->roms.character_rom.ptr && (desc->roms.character_rom.size == 0x1000));
@@ -300,6 +454,17 @@ void apple2e_init(apple2e_t *sys, const apple2e_desc_t *desc) {
 
     sys->flash_timer_ticks = APPLE2E_FREQUENCY / 2;
 
+    sys->beam_racing = desc->beam_racing;
+    sys->scanline_callback = desc->scanline_callback;
+
+#ifdef APPLE2_NTSC
+    if (desc->ntsc_framebuffer.ptr) {
+        CHIPS_ASSERT(desc->ntsc_framebuffer.size >= APPLE2E_SCREEN_WIDTH * APPLE2E_SCREEN_HEIGHT * sizeof(uint32_t));
+        sys->ntsc_fb = (uint32_t *)desc->ntsc_framebuffer.ptr;
+        apple2_ntsc_init(apple2e_palette);
+    }
+#endif
+
     sys->ioudis = true;
 
     sys->kbd_last_key = 0x0D | 0x80;
@@ -355,17 +520,25 @@ void apple2e_reset(apple2e_t *sys) {
     MOS6502CPU_RESET(&sys->cpu);
 }
 
-typedef struct {
-    uint8_t *read_ptr;
-    uint8_t *write_ptr;
-} mem_bank_t;
+// Build the main and aux RAM maps and forget the cached language card maps
+static void _apple2e_mem_maps_init(apple2e_t *sys) {
+    apple2e_mem_maps_t *maps = &sys->mem_maps;
+    for (int bank = 0; bank < 4; bank++) {
+        uint8_t *read_ptr = (bank & 1) ? sys->aux_ram : sys->ram;
+        uint8_t *write_ptr = (bank & 2) ? sys->aux_ram : sys->ram;
+        for (int page = 0; page < APPLE2E_MAIN_PAGES; page++) {
+            maps->main[bank][page].read_ptr = read_ptr + page * MEM_PAGE_SIZE;
+            maps->main[bank][page].write_ptr = write_ptr + page * MEM_PAGE_SIZE;
+        }
+    }
+    memset(maps->lc_keys, 0, sizeof(maps->lc_keys));
+    maps->lc_next = 0;
+}
 
-static mem_bank_t mem_bank_0000[2];
-static mem_bank_t mem_bank_0200[4];
-static mem_bank_t mem_bank_0400[4];
-static mem_bank_t mem_bank_0800[4];
-static mem_bank_t mem_bank_2000[4];
-static mem_bank_t mem_bank_4000[4];
+// Map main or aux RAM at 'addr', bit 0 of 'bank' selects aux RAM for reads, bit 1 for writes
+static void _apple2e_map_bank(apple2e_t *sys, uint16_t addr, uint32_t size, int bank) {
+    mem_map_pages(&sys->mem, 0, addr, size, &sys->mem_maps.main[bank][addr >> MEM_PAGE_SHIFT]);
+}
 
 static void _apple2e_text_bank_update(apple2e_t *sys) {
     int ramwr = (sys->ramrd ? 1 : 0) | (sys->ramwrt ? 2 : 0);
@@ -373,7 +546,7 @@ static void _apple2e_text_bank_update(apple2e_t *sys) {
     if (sys->_80store) {
         bank = sys->page2 ? 3 : 0;
     }
-    mem_map_rw(&sys->mem, 0, 0x0400, 0x400, mem_bank_0400[bank].read_ptr, mem_bank_0400[bank].write_ptr);
+    _apple2e_map_bank(sys, 0x0400, 0x400, bank);
 }
 
 static void _apple2e_hires_bank_update(apple2e_t *sys) {
@@ -382,28 +555,31 @@ static void _apple2e_hires_bank_update(apple2e_t *sys) {
     if ((sys->_80store) && (sys->hires)) {
         bank = sys->page2 ? 3 : 0;
     }
-    mem_map_rw(&sys->mem, 0, 0x2000, 0x2000, mem_bank_2000[bank].read_ptr, mem_bank_2000[bank].write_ptr);
+    _apple2e_map_bank(sys, 0x2000, 0x2000, bank);
 }
 
 static void _apple2e_aux_bank_update(apple2e_t *sys) {
     int ramwr = (sys->ramrd ? 1 : 0) | (sys->ramwrt ? 2 : 0);
 
-    mem_map_rw(&sys->mem, 0, 0x0200, 0x200, mem_bank_0200[ramwr].read_ptr, mem_bank_0200[ramwr].write_ptr);
+    _apple2e_map_bank(sys, 0x0200, 0x200, ramwr);
 
     if (!sys->_80store) {
         _apple2e_text_bank_update(sys);
     }
 
-    mem_map_rw(&sys->mem, 0, 0x0800, 0x1800, mem_bank_0800[ramwr].read_ptr, mem_bank_0800[ramwr].write_ptr);
+    _apple2e_map_bank(sys, 0x0800, 0x1800, ramwr);
 
     if (!((sys->_80store) && (sys->hires))) {
         _apple2e_hires_bank_update(sys);
     }
 
-    mem_map_rw(&sys->mem, 0, 0x4000, 0x8000, mem_bank_4000[ramwr].read_ptr, mem_bank_4000[ramwr].write_ptr);
+    _apple2e_map_bank(sys, 0x4000, 0x8000, ramwr);
+#ifdef MOS6502CPU_PROFILE
+    _apple2e_profile_update_banks(sys);
+#endif
 }
 
-static void _apple2e_lc_bank_update(apple2e_t *sys) {
+static void _apple2e_lc_map(apple2e_t *sys) {
     uint8_t *ram_ptr = sys->altzp ? sys->aux_ram : sys->ram;
     uint16_t bank_offset = 0xC000 + (sys->lcbnk2 ? 0x1000 : 0x0000);
 
@@ -425,8 +601,33 @@ static void _apple2e_lc_bank_update(apple2e_t *sys) {
     }
 }
 
+static void _apple2e_lc_bank_update(apple2e_t *sys) {
+    apple2e_mem_maps_t *maps = &sys->mem_maps;
+    const uint8_t key = 0x10 | (sys->altzp ? 0x01 : 0) | (sys->lcram ? 0x02 : 0) | (sys->lcbnk2 ? 0x04 : 0) |
+                        (sys->write_enabled ? 0x08 : 0);
+    int entry = -1;
+    for (int i = 0; i < APPLE2E_LC_CACHE_SIZE; i++) {
+        if (maps->lc_keys[i] == key) {
+            entry = i;
+            break;
+        }
+    }
+    if (entry >= 0) {
+        mem_map_pages(&sys->mem, 0, 0xD000, 0x3000, maps->lc[entry]);
+    } else {
+        // Build the memory map and keep it for the next switch to this state
+        _apple2e_lc_map(sys);
+        maps->lc_keys[maps->lc_next] = key;
+        mem_copy_pages(&sys->mem, 0, 0xD000, 0x3000, maps->lc[maps->lc_next]);
+        maps->lc_next = (maps->lc_next + 1) % APPLE2E_LC_CACHE_SIZE;
+    }
+#ifdef MOS6502CPU_PROFILE
+    _apple2e_profile_update_banks(sys);
+#endif
+}
+
 static void _apple2e_altzp_update(apple2e_t *sys) {
-    mem_map_rw(&sys->mem, 0, 0x0000, 0x200, mem_bank_0000[sys->altzp].read_ptr, mem_bank_0000[sys->altzp].write_ptr);
+    _apple2e_map_bank(sys, 0x0000, 0x200, sys->altzp ? 3 : 0);
     _apple2e_lc_bank_update(sys);
 }
 
@@ -631,6 +832,12 @@ static void _apple2e_mem_c010_c01f_r(apple2e_t *sys, uint16_t addr) {
     MOS6502CPU_SET_DATA(&sys->cpu, data);
 }
 
+void apple2e_video_mem_dirty(apple2e_t *sys) {
+    sys->text_page1_dirty = sys->text_page2_dirty = true;
+    sys->hires_page1_dirty = sys->hires_page2_dirty = true;
+    sys->text_screen_key = 0;
+}
+
 static void _apple2e_mem_c000_c0ff_rw(apple2e_t *sys, uint16_t addr, bool rw) {
     switch (addr & 0xFF) {
         case 0x10:
@@ -790,7 +997,7 @@ static void _apple2e_mem_c000_c0ff_rw(apple2e_t *sys, uint16_t addr, bool rw) {
                 }
             } else if ((addr >= 0xC030) && (addr <= 0xC03F)) {
                 // Speaker
-                beeper_toggle(&sys->beeper);
+                beeper_toggle(&sys->beeper, sys->system_ticks);
             } else if ((addr >= 0xC070) && (addr <= 0xC07F)) {
                 // Joystick
                 if (sys->paddl0_ticks_left == 0) {
@@ -828,6 +1035,8 @@ static void _apple2e_mem_c000_c0ff_rw(apple2e_t *sys, uint16_t addr, bool rw) {
                 } else {
                     // Memory write
                     prodos_hdc_write_byte(&sys->hdc, addr & 0xF, MOS6502CPU_GET_DATA(&sys->cpu), &sys->mem);
+                    // Block reads write to memory directly
+                    apple2e_video_mem_dirty(sys);
                 }
             }
             break;
@@ -872,8 +1081,10 @@ static void _apple2e_mem_rw(apple2e_t *sys, uint16_t addr, bool rw) {
             mem_wr(&sys->mem, addr, MOS6502CPU_GET_DATA(&sys->cpu));
             if (addr >= 0x400 && addr <= 0x7FF) {
                 sys->text_page1_dirty = true;
+                sys->text_screen_key = 0;
             } else if (addr >= 0x800 && addr <= 0xBFF) {
                 sys->text_page2_dirty = true;
+                sys->text_screen_key = 0;
             } else if (addr >= 0x2000 && addr <= 0x3FFF) {
                 sys->hires_page1_dirty = true;
             } else if (addr >= 0x4000 && addr <= 0x5FFF) {
@@ -883,6 +1094,40 @@ static void _apple2e_mem_rw(apple2e_t *sys, uint16_t addr, bool rw) {
     }
 }
 
+static void _apple2e_audio_flush(apple2e_t *sys) {
+    beeper_sample_t samples[BEEPER_ACCUM_LEN];
+    const int num_samples = beeper_flush(&sys->beeper, sys->system_ticks, samples, BEEPER_ACCUM_LEN);
+    for (int i = 0; i < num_samples; i++) {
+        chips_audio_push(&sys->audio, beeper_sample_s16(samples[i]));
+    }
+}
+
+static void _apple2e_flash_toggle(apple2e_t *sys) {
+    sys->flash = !sys->flash;
+    sys->flash_timer_ticks = APPLE2E_FREQUENCY / 2;
+    if (!sys->page2) {
+        sys->text_page1_dirty = true;
+    } else {
+        sys->text_page2_dirty = true;
+    }
+}
+
+// Beam racing: render each visible scanline as soon as the beam has passed it,
+// vbl_ticks is the beam position within the frame
+static void _apple2e_beam_tick(apple2e_t *sys) {
+    if (sys->vbl_ticks == 0) {
+        sys->video_row = 0;
+    }
+    if ((sys->video_row < APPLE2E_SCREEN_HEIGHT) &&
+        (sys->vbl_ticks == (sys->video_row + 1) * APPLE2E_TICKS_PER_SCANLINE - 1)) {
+        _apple2e_render_scanline(sys, sys->video_row);
+        if (sys->scanline_callback.func) {
+            sys->scanline_callback.func(sys->video_row, sys->scanline_callback.user_data);
+        }
+        sys->video_row++;
+    }
+}
+
 void apple2e_tick(apple2e_t *sys) {
     if (sys->vbl_ticks == 12480) {
         sys->vbl = true;
@@ -912,12 +1157,9 @@ void apple2e_tick(apple2e_t *sys) {
 
     _apple2e_mem_rw(sys, sys->cpu.addr, sys->cpu.rw);
 
-    // Update beeper
-    if (beeper_tick(&sys->beeper)) {
-        if (sys->audio_callback.func) {
-            // New sample is ready
-            sys->audio_callback.func((uint8_t)(sys->beeper.sample * 255.0f), sys->audio_callback.user_data);
-        }
+    // Generate beeper samples once per audio block
+    if ((sys->system_ticks & (APPLE2E_AUDIO_BLOCK_TICKS - 1)) == 0) {
+        _apple2e_audio_flush(sys);
     }
 
     // Tick FDC
@@ -928,44 +1170,365 @@ void apple2e_tick(apple2e_t *sys) {
     if (sys->flash_timer_ticks > 0) {
         sys->flash_timer_ticks--;
         if (sys->flash_timer_ticks == 0) {
-            sys->flash = !sys->flash;
-            sys->flash_timer_ticks = APPLE2E_FREQUENCY / 2;
-            if (!sys->page2) {
-                sys->text_page1_dirty = true;
+            _apple2e_flash_toggle(sys);
+        }
+    }
+
+    if (sys->beam_racing) {
+        _apple2e_beam_tick(sys);
+    }
+
+    sys->system_ticks++;
+}
+
+// True for I/O with side effects and for inputs which may change during apple2e_run_ticks(),
+// the keyboard and the buttons only change between calls, the VBL flag only at the frame
+// positions checked by apple2e_run_ticks()
+static bool _apple2e_idle_io(uint16_t addr, bool rw) {
+    if ((addr < 0xC000) || (addr > 0xC0FF)) {
+        return false;
+    }
+    if (!rw) {
+        return true;
+    }
+    return (addr == 0xC010) || ((addr > 0xC01F) && ((addr < 0xC061) || (addr > 0xC063)));
+}
+
+// Advance all but the CPU by 'num_ticks' ticks, in steps from one FDC tick or audio block to the next,
+// the caller makes sure that the VBL flag doesn't change
+static void _apple2e_idle_skip(apple2e_t *sys, uint32_t num_ticks) {
+    sys->vbl_ticks += num_ticks;
+    sys->paddl0_ticks_left = (sys->paddl0_ticks_left > num_ticks) ? (sys->paddl0_ticks_left - num_ticks) : 0;
+    sys->paddl1_ticks_left = (sys->paddl1_ticks_left > num_ticks) ? (sys->paddl1_ticks_left - num_ticks) : 0;
+    sys->paddl2_ticks_left = (sys->paddl2_ticks_left > num_ticks) ? (sys->paddl2_ticks_left - num_ticks) : 0;
+    sys->paddl3_ticks_left = (sys->paddl3_ticks_left > num_ticks) ? (sys->paddl3_ticks_left - num_ticks) : 0;
+    while (num_ticks > 0) {
+        // The first tick of a step does what apple2e_tick() does (APPLE2E_AUDIO_BLOCK_TICKS is a multiple of 128)
+        if ((sys->system_ticks & (APPLE2E_AUDIO_BLOCK_TICKS - 1)) == 0) {
+            _apple2e_audio_flush(sys);
+        }
+        if (sys->fdc.valid && (sys->system_ticks & 127) == 0) {
+            disk2_fdc_tick(&sys->fdc);
+        }
+        uint32_t step = 128 - (sys->system_ticks & 127);
+        if (step > num_ticks) {
+            step = num_ticks;
+        }
+        if (sys->flash_timer_ticks > 0) {
+            if (sys->flash_timer_ticks <= step) {
+                // The step ends with the flash toggle
+                step = sys->flash_timer_ticks;
+                _apple2e_flash_toggle(sys);
             } else {
-                sys->text_page2_dirty = true;
+                sys->flash_timer_ticks -= step;
             }
         }
+        sys->system_ticks += step;
+        num_ticks -= step;
     }
+}
 
-    sys->system_ticks++;
+// Test of the run-until conditions which are met by a CPU access
+static inline bool _apple2e_until_tick(apple2e_t *sys, const chips_until_t *cond) {
+    switch (cond->type) {
+        case CHIPS_UNTIL_PC:
+            return MOS6502CPU_GET_SYNC(&sys->cpu) && (sys->cpu.addr == cond->addr);
+        case CHIPS_UNTIL_MEM:
+            // Test at instruction boundaries, this also catches memory written by DMA
+            return MOS6502CPU_GET_SYNC(&sys->cpu) && ((mem_rd(&sys->mem, cond->addr) & cond->mask) == cond->value);
+        case CHIPS_UNTIL_IDLE:
+            return sys->cpu.rw && (sys->cpu.addr == 0xC000) && !(sys->kbd_last_key & 0x80);
+        default:
+            return false;
+    }
+}
+
+// apple2e_run_ticks() which also stops after the tick meeting 'cond' (if not null), returns true if it was met,
+// the number of ticks run and fast-forwarded are added to 'ticks_run' and 'skipped_ticks'
+static bool _apple2e_run(apple2e_t *sys, uint32_t num_ticks, const chips_until_t *cond, uint32_t *ticks_run,
+                         uint32_t *skipped_ticks) {
+    chips_idle_t *idle = &sys->idle;
+    // Scanline callbacks, traced instructions and profiler cycles can't be fast-forwarded
+    bool idle_enabled = !sys->beam_racing;
+#ifdef MOS6502CPU_TRACE
+    idle_enabled = false;
+#endif
+#ifdef MOS6502CPU_PROFILE
+    idle_enabled = idle_enabled && !sys->cpu.profile;
+#endif
+    bool met = false;
+    uint32_t ticks = 0;
+    if (!idle_enabled) {
+        while (!met && (ticks < num_ticks)) {
+            apple2e_tick(sys);
+            ticks++;
+            met = cond && _apple2e_until_tick(sys, cond);
+        }
+        *ticks_run += ticks;
+        return met;
+    }
+    // Inputs may have changed since the last call, only iterations seen completely count
+    chips_idle_reset(idle);
+    while (!met && (ticks < num_ticks)) {
+        apple2e_tick(sys);
+        ticks++;
+        if (cond && _apple2e_until_tick(sys, cond)) {
+            met = true;
+        } else if (MOS6502CPU_GET_SYNC(&sys->cpu)) {
+            if (chips_idle_fetch(idle, sys->cpu.addr, sys->system_ticks)) {
+                if ((idle->num_repeats > 1) && (memcmp(&sys->idle_cpu, &sys->cpu, sizeof(sys->cpu)) == 0)) {
+                    // The VBL flag must be the same during the last iteration and the skipped ones
+                    const uint32_t vbl = sys->vbl_ticks;
+                    const uint32_t vbl_age = (vbl > 12480) ? (vbl - 12481) : vbl;
+                    uint32_t max_ticks = (vbl <= 12480) ? (12480 - vbl) : (17030 - vbl);
+                    if (max_ticks > (num_ticks - ticks)) {
+                        max_ticks = num_ticks - ticks;
+                    }
+                    if (vbl_age > idle->period) {
+                        // The loop is a fixed point, skip the iterations which fit in before the end
+                        uint32_t n = chips_idle_iterations(idle, max_ticks);
+                        if (cond) {
+                            n = chips_idle_until_iterations(idle, cond, n);
+                        }
+                        for (int i = 0; i < idle->num_last_writes; i++) {
+                            if (idle->counters & (1U << i)) {
+                                const uint16_t addr = (uint16_t)(idle->last_writes[i] >> 8);
+                                mem_wr(&sys->mem, addr, chips_idle_counter(idle, i, n));
+                            }
+                        }
+                        _apple2e_idle_skip(sys, n * idle->period);
+                        ticks += n * idle->period;
+                        *skipped_ticks += n * idle->period;
+                    }
+                }
+                memcpy(&sys->idle_cpu, &sys->cpu, sizeof(sys->cpu));
+            }
+        } else if (idle->tracking) {
+            chips_idle_access(idle, sys->cpu.addr, sys->cpu.rw, MOS6502CPU_GET_DATA(&sys->cpu),
+                              _apple2e_idle_io(sys->cpu.addr, sys->cpu.rw));
+        }
+    }
+    *ticks_run += ticks;
+    return met;
+}
+
+uint32_t apple2e_run_ticks(apple2e_t *sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    uint32_t ticks = 0;
+    uint32_t skipped_ticks = 0;
+    _apple2e_run(sys, num_ticks, 0, &ticks, &skipped_ticks);
+    return skipped_ticks;
+}
+
+static void _apple2e_update_watch_flags(apple2e_t *sys) {
+    const chips_breakpoints_t *bp = sys->debug.breakpoints;
+    mem_clear_page_flags(&sys->mem, MEM_PAGE_FLAG_WATCH_READ | MEM_PAGE_FLAG_WATCH_WRITE);
+    for (int i = 0; i < bp->num_watchpoints; i++) {
+        const chips_watchpoint_t *wp = &bp->watchpoints[i];
+        const uint8_t flags = ((wp->flags & CHIPS_WATCH_READ) ? MEM_PAGE_FLAG_WATCH_READ : 0) |
+                              ((wp->flags & CHIPS_WATCH_WRITE) ? MEM_PAGE_FLAG_WATCH_WRITE : 0);
+        mem_set_page_flags(&sys->mem, wp->addr, wp->size, flags);
+    }
+}
+
+// Check breakpoints and watchpoints after a tick, returns true if execution must stop
+static bool _apple2e_check_breakpoints(apple2e_t *sys) {
+    chips_breakpoints_t *bp = sys->debug.breakpoints;
+    const uint16_t addr = sys->cpu.addr;
+    if (MOS6502CPU_GET_SYNC(&sys->cpu) && chips_breakpoint_test(bp, addr)) {
+        bp->stop_reason = CHIPS_STOP_BREAKPOINT;
+        bp->stop_addr = addr;
+        return true;
+    }
+    if (mem_page_flags(&sys->mem, addr) & (sys->cpu.rw ? MEM_PAGE_FLAG_WATCH_READ : MEM_PAGE_FLAG_WATCH_WRITE)) {
+        const int reason = chips_watchpoint_test(bp, addr, sys->cpu.rw);
+        if (reason != CHIPS_STOP_NONE) {
+            bp->stop_reason = reason;
+            bp->stop_addr = addr;
+            return true;
+        }
+    }
+    return false;
 }
 
 uint32_t apple2e_exec(apple2e_t *sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
     uint32_t num_ticks = clk_us_to_ticks(APPLE2E_FREQUENCY, micro_seconds);
     // uint32_t num_ticks = 50;
+    uint32_t ticks;
+    if (sys->debug.breakpoints) {
+        sys->debug.breakpoints->stop_reason = CHIPS_STOP_NONE;
+        _apple2e_update_watch_flags(sys);
+    }
     if (0 == sys->debug.callback.func) {
-        // run without debug callback
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-            apple2e_tick(sys);
+        if (0 == sys->debug.breakpoints) {
+            // run without debug hooks
+            apple2e_run_ticks(sys, num_ticks);
+            ticks = num_ticks;
+        } else {
+            // run with native breakpoints
+            for (ticks = 0; ticks < num_ticks;) {
+                apple2e_tick(sys);
+                ticks++;
+                if (_apple2e_check_breakpoints(sys)) {
+                    break;
+                }
+            }
         }
     } else {
         // run with debug callback
-        for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
+        for (ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped);) {
             apple2e_tick(sys);
+            ticks++;
             sys->debug.callback.func(sys->debug.callback.user_data, 0);
+            if (sys->debug.breakpoints && _apple2e_check_breakpoints(sys)) {
+                break;
+            }
         }
     }
     // kbd_update(&sys->kbd, micro_seconds);
+    _apple2e_audio_flush(sys);
+    chips_audio_flush(&sys->audio);
     apple2e_screen_update(sys);
 
     // printf("executed %d ticks\n", num_ticks);
-    return num_ticks;
+    return ticks;
+}
+
+// ASCII character of a text screen code
+static char _apple2e_text_ascii(apple2e_t *sys, uint8_t code) {
+    if (code >= 0xA0) {
+        // Normal symbols, uppercase and lowercase
+        return (char)(code & 0x7F);
+    }
+    if (sys->altcharset && (code >= 0x60) && (code <= 0x7F)) {
+        // Inverse lowercase
+        return (char)code;
+    }
+    code &= 0x3F;
+    return (char)((code < 0x20) ? (code + 0x40) : code);
 }
 
+// Decode the displayed text page into sys->text_screen, unless it is still up to date
+static void _apple2e_text_screen_update(apple2e_t *sys) {
+    const bool page2 = sys->page2 && !sys->_80store;
+    const uint8_t key = 0x10 | (page2 ? 0x01 : 0) | (sys->_80col ? 0x02 : 0) | (sys->altcharset ? 0x04 : 0);
+    if (sys->text_screen_key == key) {
+        return;
+    }
+    const uint16_t start_address = page2 ? 0x0800 : 0x0400;
+    for (int row = 0; row < 24; row++) {
+        const uint16_t address = start_address + (((row & 0x07) << 7) | ((row & 0x18) * 5));
+        const uint8_t *vram_row = mem_shared_ptr(&sys->mem, &sys->ram[address]);
+        const uint8_t *vaux_row = mem_shared_ptr(&sys->mem, &sys->aux_ram[address]);
+        char *line = sys->text_screen[row];
+        int n = 0;
+        for (int col = 0; col < 40; col++) {
+            if (sys->_80col) {
+                line[n++] = _apple2e_text_ascii(sys, vaux_row[col]);
+            }
+            line[n++] = _apple2e_text_ascii(sys, vram_row[col]);
+        }
+        line[n] = 0;
+    }
+    sys->text_screen_key = key;
+}
+
+void apple2e_text_screen(apple2e_t *sys, char out[24][81]) {
+    CHIPS_ASSERT(sys && sys->valid && out);
+    _apple2e_text_screen_update(sys);
+    memcpy(out, sys->text_screen, sizeof(sys->text_screen));
+}
+
+// True if a line of the displayed text page contains 'text'
+static bool _apple2e_text_contains(apple2e_t *sys, const char *text) {
+    _apple2e_text_screen_update(sys);
+    for (int row = 0; row < 24; row++) {
+        if (strstr(sys->text_screen[row], text)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool apple2e_run_until(apple2e_t *sys, const chips_until_t *cond, uint32_t max_ticks) {
+    CHIPS_ASSERT(sys && sys->valid && cond);
+    bool met = false;
+    uint32_t ticks = 0;
+    uint32_t skipped_ticks = 0;
+    switch (cond->type) {
+        case CHIPS_UNTIL_PC:
+        case CHIPS_UNTIL_IDLE:
+            met = _apple2e_run(sys, max_ticks, cond, &ticks, &skipped_ticks);
+            break;
+
+        case CHIPS_UNTIL_MEM:
+            met = (mem_rd(&sys->mem, cond->addr) & cond->mask) == cond->value;
+            if (!met) {
+                met = _apple2e_run(sys, max_ticks, cond, &ticks, &skipped_ticks);
+            }
+            break;
+
+        case CHIPS_UNTIL_TEXT:
+            met = _apple2e_text_contains(sys, cond->text);
+            while (!met && (ticks < max_ticks)) {
+                const uint32_t num_ticks =
+                    (max_ticks - ticks < CHIPS_UNTIL_TEXT_TICKS) ? (max_ticks - ticks) : CHIPS_UNTIL_TEXT_TICKS;
+                _apple2e_run(sys, num_ticks, 0, &ticks, &skipped_ticks);
+                met = _apple2e_text_contains(sys, cond->text);
+            }
+            break;
+
+        default:
+            CHIPS_ASSERT(false);
+            break;
+    }
+    _apple2e_audio_flush(sys);
+    chips_audio_flush(&sys->audio);
+    apple2e_screen_update(sys);
+    return met;
+}
+
+#ifdef MEM_COPY_ON_WRITE
+void apple2e_fork(apple2e_t *sys, apple2e_t *fork) {
+    CHIPS_ASSERT(sys && sys->valid && fork && (sys != fork));
+    // A fork of a fork gets its own copy of the shared memory first
+    mem_unshare(&sys->mem);
+    // Copy everything but the RAM and the framebuffer
+    memcpy(fork, sys, offsetof(apple2e_t, ram));
+    memcpy(&fork->rom, &sys->rom, offsetof(apple2e_t, fb) - offsetof(apple2e_t, rom));
+    memcpy(&fork->dirty_rows, &sys->dirty_rows, sizeof(apple2e_t) - offsetof(apple2e_t, dirty_rows));
+    mem_relocate(&fork->mem, sys, sizeof(apple2e_t), fork);
+    _apple2e_mem_maps_init(fork);
+#ifdef MEM_TRACK_WRITES
+    mem_clear_written(&fork->mem);
+#endif
+    mem_share(&fork->mem, fork->ram, sys->ram, sizeof(sys->ram));
+    mem_share(&fork->mem, fork->aux_ram, sys->aux_ram, sizeof(sys->aux_ram));
+    chips_debug_snapshot_onsave(&fork->debug);
+    chips_audio_snapshot_onsave(&fork->audio);
+    chips_scanline_callback_snapshot_onsave(&fork->scanline_callback);
+#ifdef APPLE2_NTSC
+    fork->ntsc_fb = 0;
+#endif
+#ifdef MOS6502CPU_PROFILE
+    fork->cpu.profile = 0;
+#endif
+    // The disk images are shared
+    for (int i = 0; i < DISK2_FDC_MAX_DRIVES; i++) {
+        fork->fdc.fdd[i].write_protected = true;
+    }
+    for (int i = 0; i < PRODOS_HDC_MAX_DRIVES; i++) {
+        fork->hdc.hdd[i].write_protected = true;
+    }
+    // The framebuffer is rendered from video memory again
+    apple2e_video_mem_dirty(fork);
+}
+#endif
+
 static void _apple2e_init_memorymap(apple2e_t *sys) {
     mem_init(&sys->mem);
+    _apple2e_mem_maps_init(sys);
     for (int addr = 0; addr < 0x10000; addr += 2) {
         sys->ram[addr] = 0;
         sys->ram[addr + 1] = 0xFF;
@@ -973,58 +1536,6 @@ static void _apple2e_init_memorymap(apple2e_t *sys) {
         sys->aux_ram[addr + 1] = 0xFF;
     }
 
-    memcpy(mem_bank_0000,
-           (mem_bank_t[]){
-               {sys->ram, sys->ram},
-               {sys->aux_ram, sys->aux_ram},
-           },
-           sizeof(mem_bank_0000));
-
-    memcpy(mem_bank_0200,
-           (mem_bank_t[]){
-               {sys->ram + 0x200, sys->ram + 0x200},
-               {sys->aux_ram + 0x200, sys->ram + 0x200},
-               {sys->ram + 0x200, sys->aux_ram + 0x200},
-               {sys->aux_ram + 0x200, sys->aux_ram + 0x200},
-           },
-           sizeof(mem_bank_0200));
-
-    memcpy(mem_bank_0400,
-           (mem_bank_t[]){
-               {sys->ram + 0x400, sys->ram + 0x400},
-               {sys->aux_ram + 0x400, sys->ram + 0x400},
-               {sys->ram + 0x400, sys->aux_ram + 0x400},
-               {sys->aux_ram + 0x400, sys->aux_ram + 0x400},
-           },
-           sizeof(mem_bank_0400));
-
-    memcpy(mem_bank_0800,
-           (mem_bank_t[]){
-               {sys->ram + 0x800, sys->ram + 0x800},
-               {sys->aux_ram + 0x800, sys->ram + 0x800},
-               {sys->ram + 0x800, sys->aux_ram + 0x800},
-               {sys->aux_ram + 0x800, sys->aux_ram + 0x800},
-           },
-           sizeof(mem_bank_0800));
-
-    memcpy(mem_bank_2000,
-           (mem_bank_t[]){
-               {sys->ram + 0x2000, sys->ram + 0x2000},
-               {sys->aux_ram + 0x2000, sys->ram + 0x2000},
-               {sys->ram + 0x2000, sys->aux_ram + 0x2000},
-               {sys->aux_ram + 0x2000, sys->aux_ram + 0x2000},
-           },
-           sizeof(mem_bank_2000));
-
-    memcpy(mem_bank_4000,
-           (mem_bank_t[]){
-               {sys->ram + 0x4000, sys->ram + 0x4000},
-               {sys->aux_ram + 0x4000, sys->ram + 0x4000},
-               {sys->ram + 0x4000, sys->aux_ram + 0x4000},
-               {sys->aux_ram + 0x4000, sys->aux_ram + 0x4000},
-           },
-           sizeof(mem_bank_4000));
-
     mem_map_ram(&sys->mem, 0, 0x0000, 0xC000, sys->ram);
     mem_map_rom(&sys->mem, 0, 0xC000, 0x1000, sys->rom);
     mem_map_rw(&sys->mem, 0, 0xD000, 0x1000, sys->rom + 0x1000, sys->ram + 0xD000);
@@ -1038,15 +1549,56 @@ static void _apple2e_init_memorymap(apple2e_t *sys) {
 
 uint32_t apple2e_save_snapshot(apple2e_t *sys, apple2e_t *dst) {
     CHIPS_ASSERT(sys && dst);
+    mem_unshare(&sys->mem);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
-    chips_audio_callback_snapshot_onsave(&dst->audio_callback);
+    chips_audio_snapshot_onsave(&dst->audio);
+    chips_scanline_callback_snapshot_onsave(&dst->scanline_callback);
+#ifdef APPLE2_NTSC
+    dst->ntsc_fb = 0;
+#endif
     // m6502_snapshot_onsave(&dst->cpu);
     disk2_fdc_snapshot_onsave(&dst->fdc);
     mem_snapshot_onsave(&dst->mem, sys);
+    // Rebuilt by apple2e_load_snapshot()
+    memset(&dst->mem_maps, 0, sizeof(dst->mem_maps));
     return APPLE2E_SNAPSHOT_VERSION;
 }
 
+#ifdef MOS6502CPU_PROFILE
+static void _apple2e_profile_update_banks(apple2e_t *sys) {
+    mos6502cpu_profile_t *p = sys->cpu.profile;
+    if (!p) {
+        return;
+    }
+    // Bank selection is tracked at 4 KB granularity, ALTZP and 80STORE
+    // remapping of $0000-$01FF and the display pages is ignored
+    for (int i = 0x0; i <= 0xB; i++) {
+        p->bank_map[i] = sys->ramrd ? APPLE2E_PROFILE_BANK_AUX : APPLE2E_PROFILE_BANK_MAIN;
+    }
+    p->bank_map[0xC] = APPLE2E_PROFILE_BANK_ROM;
+    if (sys->lcram) {
+        if (sys->lcbnk2) {
+            p->bank_map[0xD] = sys->altzp ? APPLE2E_PROFILE_BANK_AUX : APPLE2E_PROFILE_BANK_MAIN;
+        } else {
+            p->bank_map[0xD] = sys->altzp ? APPLE2E_PROFILE_BANK_AUX_LC1 : APPLE2E_PROFILE_BANK_MAIN_LC1;
+        }
+        p->bank_map[0xE] = p->bank_map[0xF] = sys->altzp ? APPLE2E_PROFILE_BANK_AUX : APPLE2E_PROFILE_BANK_MAIN;
+    } else {
+        p->bank_map[0xD] = p->bank_map[0xE] = p->bank_map[0xF] = APPLE2E_PROFILE_BANK_ROM;
+    }
+}
+
+void apple2e_profile_attach(apple2e_t *sys, mos6502cpu_profile_t *profile) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->cpu.profile = profile;
+    if (profile) {
+        mos6502cpu_profile_reset(profile);
+        _apple2e_profile_update_banks(sys);
+    }
+}
+#endif
+
 bool apple2e_load_snapshot(apple2e_t *sys, uint32_t version, apple2e_t *src) {
     CHIPS_ASSERT(sys && src);
     if (version != APPLE2E_SNAPSHOT_VERSION) {
@@ -1055,14 +1607,170 @@ bool apple2e_load_snapshot(apple2e_t *sys, uint32_t version, apple2e_t *src) {
     static apple2e_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
-    chips_audio_callback_snapshot_onload(&im.audio_callback, &sys->audio_callback);
+    chips_audio_snapshot_onload(&im.audio, &sys->audio);
+    chips_scanline_callback_snapshot_onload(&im.scanline_callback, &sys->scanline_callback);
+#ifdef APPLE2_NTSC
+    im.ntsc_fb = sys->ntsc_fb;
+#endif
     // m6502_snapshot_onload(&im.cpu, &sys->cpu);
     disk2_fdc_snapshot_onload(&im.fdc, &sys->fdc);
     mem_snapshot_onload(&im.mem, sys);
+#ifdef MOS6502CPU_PROFILE
+    im.cpu.profile = sys->cpu.profile;
+#endif
     *sys = im;
+    _apple2e_mem_maps_init(sys);
+    // The framebuffer was replaced, all rows differ from what the frontend has seen
+    chips_dirty_rows_set_all(&sys->dirty_rows);
+    // The NTSC output is not part of the snapshot
+    apple2e_video_mem_dirty(sys);
+#ifdef MOS6502CPU_PROFILE
+    _apple2e_profile_update_banks(sys);
+#endif
     return true;
 }
 
+bool apple2e_save_state(apple2e_t *sys, chips_range_t buffer, chips_state_write_t write, void *user_data) {
+    CHIPS_ASSERT(sys && sys->valid && write);
+    chips_state_writer_t w;
+    mem_unshare(&sys->mem);
+    chips_state_writer_init(&w, APPLE2E_STATE_ID, buffer, write, user_data);
+    MOS6502CPU_SAVE_STATE(&sys->cpu, &w);
+    chips_state_put_memory(&w, APPLE2E_STATE_RAM_ID, sys->ram, sizeof(sys->ram), 0xFF00);
+    chips_state_put_memory(&w, APPLE2E_STATE_AUX_ID, sys->aux_ram, sizeof(sys->aux_ram), 0xFF00);
+
+    chips_state_begin_chunk(&w, APPLE2E_STATE_SYS_ID, 1);
+    const bool switches[] = {sys->text, sys->mixed, sys->page2, sys->hires, sys->dhires, sys->flash, sys->_80col,
+        sys->altcharset, sys->_80store, sys->ramrd, sys->ramwrt, sys->altzp, sys->intcxrom, sys->slotc3rom, sys->lcram,
+        sys->lcbnk2, sys->prewrite, sys->write_enabled, sys->ioudis, sys->vbl};
+    for (size_t i = 0; i < CHIPS_ARRAY_SIZE(switches); i++) {
+        chips_state_put_bool(&w, switches[i]);
+    }
+    chips_state_put32(&w, sys->flash_timer_ticks);
+    chips_state_put8(&w, sys->kbd_last_key);
+    chips_state_put_bool(&w, sys->kbd_open_apple_pressed);
+    chips_state_put_bool(&w, sys->kbd_solid_apple_pressed);
+    chips_state_put8(&w, sys->paddl0);
+    chips_state_put8(&w, sys->paddl1);
+    chips_state_put8(&w, sys->paddl2);
+    chips_state_put8(&w, sys->paddl3);
+    chips_state_put16(&w, sys->paddl0_ticks_left);
+    chips_state_put16(&w, sys->paddl1_ticks_left);
+    chips_state_put16(&w, sys->paddl2_ticks_left);
+    chips_state_put16(&w, sys->paddl3_ticks_left);
+    chips_state_put_bool(&w, sys->butn0);
+    chips_state_put_bool(&w, sys->butn1);
+    chips_state_put_bool(&w, sys->butn2);
+    chips_state_put32(&w, sys->system_ticks);
+    chips_state_put16(&w, sys->vbl_ticks);
+    chips_state_put8(&w, sys->video_row);
+    chips_state_end_chunk(&w);
+
+    beeper_save_state(&sys->beeper, &w);
+    if (sys->fdc.valid) {
+        disk2_fdc_save_state(&sys->fdc, &w);
+    }
+    if (sys->hdc.valid) {
+        prodos_hdc_save_state(&sys->hdc, &w);
+    }
+    return chips_state_writer_finish(&w);
+}
+
+// Read the state file chunks into 'sys', in check mode the disk images are not written
+static bool _apple2e_load_chunks(apple2e_t *sys, chips_state_reader_t *r, bool check) {
+    // Memory blocks missing from the file hold the power-on pattern
+    chips_state_fill_memory(sys->ram, sizeof(sys->ram), 0xFF00);
+    chips_state_fill_memory(sys->aux_ram, sizeof(sys->aux_ram), 0xFF00);
+    bool ok = true;
+    while (ok && chips_state_next_chunk(r)) {
+        switch (r->chunk_id) {
+            case MOS6502CPU_STATE_ID:
+                ok = MOS6502CPU_LOAD_STATE(&sys->cpu, r);
+                break;
+            case APPLE2E_STATE_RAM_ID:
+                ok = chips_state_get_memory(r, sys->ram, sizeof(sys->ram), 0xFF00);
+                break;
+            case APPLE2E_STATE_AUX_ID:
+                ok = chips_state_get_memory(r, sys->aux_ram, sizeof(sys->aux_ram), 0xFF00);
+                break;
+            case APPLE2E_STATE_SYS_ID: {
+                bool *switches[] = {&sys->text, &sys->mixed, &sys->page2, &sys->hires, &sys->dhires, &sys->flash,
+                    &sys->_80col, &sys->altcharset, &sys->_80store, &sys->ramrd, &sys->ramwrt, &sys->altzp,
+                    &sys->intcxrom, &sys->slotc3rom, &sys->lcram, &sys->lcbnk2, &sys->prewrite, &sys->write_enabled,
+                    &sys->ioudis, &sys->vbl};
+                for (size_t i = 0; i < CHIPS_ARRAY_SIZE(switches); i++) {
+                    *switches[i] = chips_state_get_bool(r);
+                }
+                sys->flash_timer_ticks = chips_state_get32(r);
+                sys->kbd_last_key = chips_state_get8(r);
+                sys->kbd_open_apple_pressed = chips_state_get_bool(r);
+                sys->kbd_solid_apple_pressed = chips_state_get_bool(r);
+                sys->paddl0 = chips_state_get8(r);
+                sys->paddl1 = chips_state_get8(r);
+                sys->paddl2 = chips_state_get8(r);
+                sys->paddl3 = chips_state_get8(r);
+                sys->paddl0_ticks_left = chips_state_get16(r);
+                sys->paddl1_ticks_left = chips_state_get16(r);
+                sys->paddl2_ticks_left = chips_state_get16(r);
+                sys->paddl3_ticks_left = chips_state_get16(r);
+                sys->butn0 = chips_state_get_bool(r);
+                sys->butn1 = chips_state_get_bool(r);
+                sys->butn2 = chips_state_get_bool(r);
+                sys->system_ticks = chips_state_get32(r);
+                sys->vbl_ticks = chips_state_get16(r);
+                sys->video_row = chips_state_get8(r);
+                ok = r->ok;
+                break;
+            }
+            case BEEPER_STATE_ID:
+                ok = beeper_load_state(&sys->beeper, r);
+                break;
+            case DISK2_FDC_STATE_ID:
+            case DISK2_FDC_STATE_TRACK_ID:
+                // Chunks of devices this instance does not have are skipped
+                if (sys->fdc.valid) {
+                    ok = check ? disk2_fdc_check_state(&sys->fdc, r) : disk2_fdc_load_state(&sys->fdc, r);
+                }
+                break;
+            case PRODOS_HDC_STATE_ID:
+                if (sys->hdc.valid) {
+                    ok = prodos_hdc_load_state(&sys->hdc, r);
+                }
+                break;
+            default:
+                // Chunk written by a newer version
+                break;
+        }
+    }
+    return ok;
+}
+
+bool apple2e_load_state(apple2e_t *sys, const void *data, size_t size) {
+    CHIPS_ASSERT(sys && sys->valid && data);
+    chips_state_reader_t r;
+    if (!chips_state_reader_init(&r, data, size, APPLE2E_STATE_ID)) {
+        return false;
+    }
+    // Load into a scratch copy first, so an invalid chunk leaves the machine unchanged
+    static apple2e_t im;
+    im = *sys;
+    chips_state_reader_t check = r;
+    if (!_apple2e_load_chunks(&im, &check, true)) {
+        return false;
+    }
+    mem_unshare(&sys->mem);
+    const bool ok = _apple2e_load_chunks(sys, &r, false);
+    CHIPS_ASSERT(ok);
+    // Rebuild the memory map from the soft switches
+    _apple2e_altzp_update(sys);
+    _apple2e_aux_bank_update(sys);
+    _apple2e_text_bank_update(sys);
+    _apple2e_hires_bank_update(sys);
+    // The framebuffer is not stored, render it from video memory again
+    apple2e_video_mem_dirty(sys);
+    return ok;
+}
+
 static void _apple2e_render_line_monochrome(uint8_t *out, uint16_t *in, int start_col, int stop_col) {
     uint32_t w = in[start_col];
 
@@ -1128,53 +1836,151 @@ static uint8_t *_apple2e_get_fb_addr(apple2e_t *sys, uint16_t row) {
     return &sys->fb[row * (APPLE2E_SCREEN_WIDTH / 2)];
 }
 
-static void _apple2e_lores_update(apple2e_t *sys, uint16_t begin_row, uint16_t end_row) {
-    if ((!sys->page2 && !sys->text_page1_dirty) || (sys->page2 && !sys->text_page2_dirty)) {
+// NTSC output of a rendered row, does nothing unless built with APPLE2_NTSC and an NTSC framebuffer is set
+typedef enum {
+    _APPLE2E_NTSC_COLORS,
+    _APPLE2E_NTSC_MONO,
+    _APPLE2E_NTSC_SIGNAL,
+    _APPLE2E_NTSC_SIGNAL_80COL,
+    _APPLE2E_NTSC_COPY
+} _apple2e_ntsc_source_t;
+
+static void _apple2e_ntsc_row(apple2e_t *sys, uint16_t row, _apple2e_ntsc_source_t source, const uint16_t *words) {
+#ifdef APPLE2_NTSC
+    if (!sys->ntsc_fb) {
         return;
     }
+    uint32_t *out = &sys->ntsc_fb[row * APPLE2E_SCREEN_WIDTH];
+    switch (source) {
+        case _APPLE2E_NTSC_COLORS: apple2_ntsc_render_colors(out, _apple2e_get_fb_addr(sys, row)); break;
+        case _APPLE2E_NTSC_MONO: apple2_ntsc_render_mono(out, words); break;
+        case _APPLE2E_NTSC_SIGNAL: apple2_ntsc_render_signal(out, words, 0); break;
+        // 80 column dots are shifted by one dot against the subcarrier (see _apple2e_render_line_color)
+        case _APPLE2E_NTSC_SIGNAL_80COL: apple2_ntsc_render_signal(out, words, 1); break;
+        case _APPLE2E_NTSC_COPY: memcpy(out, out - APPLE2E_SCREEN_WIDTH, APPLE2E_SCREEN_WIDTH * sizeof(uint32_t)); break;
+    }
+#else
+    (void)sys;
+    (void)row;
+    (void)source;
+    (void)words;
+#endif
+}
 
+static void _apple2e_lores_row(apple2e_t *sys, uint16_t start_address, uint16_t row) {
     bool _double = sys->dhires && sys->_80col;
 
-    uint16_t start_address = sys->page2 && !sys->_80store ? 0x0800 : 0x0400;
-
-    uint16_t start_row = (begin_row / 8) * 8;
-    uint16_t stop_row = ((end_row / 8) + 1) * 8;
-
-    for (int row = start_row; row < stop_row; row += 4) {
-        uint16_t address = start_address + ((((row / 8) & 0x07) << 7) | (((row / 8) & 0x18) * 5));
-        uint8_t *vram_row = &sys->ram[address];
-        uint8_t *vaux_row = &sys->aux_ram[address];
+    uint16_t address = start_address + ((((row / 8) & 0x07) << 7) | (((row / 8) & 0x18) * 5));
+    const uint8_t *vram_row = mem_shared_ptr(&sys->mem, &sys->ram[address]);
+    const uint8_t *vaux_row = mem_shared_ptr(&sys->mem, &sys->aux_ram[address]);
 
 #define NIBBLE(byte) (((byte) >> (row & 4)) & 0x0F)
-        uint8_t *p = _apple2e_get_fb_addr(sys, row);
+    uint8_t *p = _apple2e_get_fb_addr(sys, row);
 
-        for (int col = 0; col < 40; col++) {
-            uint8_t c;
-            if (_double) {
-                c = _apple2e_rotl4(NIBBLE(vaux_row[col]), 1);
-                for (int b = 0; b < 3; b++) {
-                    *p = c << 4;
-                    *p++ |= c;
-                }
+    for (int col = 0; col < 40; col++) {
+        uint8_t c;
+        if (_double) {
+            c = _apple2e_rotl4(NIBBLE(vaux_row[col]), 1);
+            for (int b = 0; b < 3; b++) {
+                *p = c << 4;
+                *p++ |= c;
+            }
+            *p = c << 4;
+            c = NIBBLE(vram_row[col]);
+            *p++ |= c;
+            for (int b = 0; b < 3; b++) {
+                *p = c << 4;
+                *p++ |= c;
+            }
+        } else {
+            c = NIBBLE(vram_row[col]);
+            for (int b = 0; b < 7; b++) {
                 *p = c << 4;
-                c = NIBBLE(vram_row[col]);
                 *p++ |= c;
-                for (int b = 0; b < 3; b++) {
-                    *p = c << 4;
-                    *p++ |= c;
-                }
-            } else {
-                c = NIBBLE(vram_row[col]);
-                for (int b = 0; b < 7; b++) {
-                    *p = c << 4;
-                    *p++ |= c;
-                }
             }
         }
+    }
 #undef NIBBLE
+    _apple2e_ntsc_row(sys, row, _APPLE2E_NTSC_COLORS, 0);
+    chips_dirty_rows_set(&sys->dirty_rows, row);
+}
+
+static void _apple2e_text_row(apple2e_t *sys, uint16_t start_address, uint16_t row) {
+    uint16_t address = start_address + ((((row / 8) & 0x07) << 7) | (((row / 8) & 0x18) * 5));
+    const uint8_t *vram_row = mem_shared_ptr(&sys->mem, &sys->ram[address]);
+    const uint8_t *vaux_row = mem_shared_ptr(&sys->mem, &sys->aux_ram[address]);
+
+    uint16_t words[40];
+
+    for (int col = 0; col < 40; col++) {
+        if (sys->_80col) {
+            words[col] = _apple2e_get_text_character(sys, vaux_row[col], row & 7) +
+                         (_apple2e_get_text_character(sys, vram_row[col], row & 7) << 7);
+        } else {
+            words[col] = _apple2e_double_7_bits(_apple2e_get_text_character(sys, vram_row[col], row & 7));
+        }
+    }
+
+    _apple2e_render_line_monochrome(_apple2e_get_fb_addr(sys, row), words, 0, 40);
+    _apple2e_ntsc_row(sys, row, _APPLE2E_NTSC_MONO, words);
+    chips_dirty_rows_set(&sys->dirty_rows, row);
+}
+
+static void _apple2e_dhgr_row(apple2e_t *sys, uint16_t start_address, uint16_t row) {
+    uint32_t address = start_address + (((row / 8) & 0x07) << 7) + (((row / 8) & 0x18) * 5) + ((row & 7) << 10);
+    const uint8_t *vram_row = mem_shared_ptr(&sys->mem, &sys->ram[address]);
+    const uint8_t *vaux_row = mem_shared_ptr(&sys->mem, &sys->aux_ram[address]);
+
+    uint16_t words[40];
+
+    for (int col = 0; col < 40; col++) {
+        words[col] = ((vaux_row[col] & 0x7F) | ((vram_row[col] & 0x7F) << 7)) & 0x3FFF;
+    }
+
+    _apple2e_render_line_color(_apple2e_get_fb_addr(sys, row), words, 0, 40, true);
+    _apple2e_ntsc_row(sys, row, _APPLE2E_NTSC_SIGNAL_80COL, words);
+    chips_dirty_rows_set(&sys->dirty_rows, row);
+}
+
+static void _apple2e_hgr_row(apple2e_t *sys, uint16_t start_address, uint16_t row) {
+    uint32_t address = start_address + (((row / 8) & 0x07) << 7) + (((row / 8) & 0x18) * 5) + ((row & 7) << 10);
+    const uint8_t *vram_row = mem_shared_ptr(&sys->mem, &sys->ram[address]);
+
+    uint16_t words[40];
+
+    uint16_t last_output_bit = 0;
+
+    for (int col = 0; col < 40; col++) {
+        uint16_t w = _apple2e_double_7_bits(vram_row[col] & 0x7F);
+        if (vram_row[col] & 0x80) {
+            w = (w << 1 | last_output_bit) & 0x3FFF;
+        };
+        words[col] = w;
+        last_output_bit = w >> 13;
+    }
+
+    _apple2e_render_line_color(_apple2e_get_fb_addr(sys, row), words, 0, 40, false);
+    _apple2e_ntsc_row(sys, row, _APPLE2E_NTSC_SIGNAL, words);
+    chips_dirty_rows_set(&sys->dirty_rows, row);
+}
+
+static void _apple2e_lores_update(apple2e_t *sys, uint16_t begin_row, uint16_t end_row) {
+    if ((!sys->page2 && !sys->text_page1_dirty) || (sys->page2 && !sys->text_page2_dirty)) {
+        return;
+    }
+
+    uint16_t start_address = sys->page2 && !sys->_80store ? 0x0800 : 0x0400;
+
+    uint16_t start_row = (begin_row / 8) * 8;
+    uint16_t stop_row = ((end_row / 8) + 1) * 8;
+
+    for (int row = start_row; row < stop_row; row += 4) {
+        _apple2e_lores_row(sys, start_address, row);
 
         for (int y = 1; y < 4; y++) {
             memcpy(_apple2e_get_fb_addr(sys, row + y), _apple2e_get_fb_addr(sys, row), 40 * 7);
+            _apple2e_ntsc_row(sys, row + y, _APPLE2E_NTSC_COPY, 0);
+            chips_dirty_rows_set(&sys->dirty_rows, row + y);
         }
     }
 
@@ -1196,22 +2002,7 @@ static void _apple2e_text_update(apple2e_t *sys, uint16_t begin_row, uint16_t en
     uint16_t stop_row = ((end_row / 8) + 1) * 8;
 
     for (int row = start_row; row < stop_row; row++) {
-        uint16_t address = start_address + ((((row / 8) & 0x07) << 7) | (((row / 8) & 0x18) * 5));
-        uint8_t *vram_row = &sys->ram[address];
-        uint8_t *vaux_row = &sys->aux_ram[address];
-
-        uint16_t words[40];
-
-        for (int col = 0; col < 40; col++) {
-            if (sys->_80col) {
-                words[col] = _apple2e_get_text_character(sys, vaux_row[col], row & 7) +
-                             (_apple2e_get_text_character(sys, vram_row[col], row & 7) << 7);
-            } else {
-                words[col] = _apple2e_double_7_bits(_apple2e_get_text_character(sys, vram_row[col], row & 7));
-            }
-        }
-
-        _apple2e_render_line_monochrome(_apple2e_get_fb_addr(sys, row), words, 0, 40);
+        _apple2e_text_row(sys, start_address, row);
     }
 
     if (!sys->page2) {
@@ -1229,17 +2020,7 @@ static void _apple2e_dhgr_update(apple2e_t *sys, uint16_t begin_row, uint16_t en
     uint16_t start_address = sys->page2 && !sys->_80store ? 0x4000 : 0x2000;
 
     for (int row = begin_row; row <= end_row; row++) {
-        uint32_t address = start_address + (((row / 8) & 0x07) << 7) + (((row / 8) & 0x18) * 5) + ((row & 7) << 10);
-        uint8_t *vram_row = &sys->ram[address];
-        uint8_t *vaux_row = &sys->aux_ram[address];
-
-        uint16_t words[40];
-
-        for (int col = 0; col < 40; col++) {
-            words[col] = ((vaux_row[col] & 0x7F) | ((vram_row[col] & 0x7F) << 7)) & 0x3FFF;
-        }
-
-        _apple2e_render_line_color(_apple2e_get_fb_addr(sys, row), words, 0, 40, true);
+        _apple2e_dhgr_row(sys, start_address, row);
     }
 
     if (!sys->page2) {
@@ -1257,23 +2038,7 @@ static void _apple2e_hgr_update(apple2e_t *sys, uint16_t begin_row, uint16_t end
     uint16_t start_address = sys->page2 && !sys->_80store ? 0x4000 : 0x2000;
 
     for (int row = begin_row; row <= end_row; row++) {
-        uint32_t address = start_address + (((row / 8) & 0x07) << 7) + (((row / 8) & 0x18) * 5) + ((row & 7) << 10);
-        uint8_t *vram_row = &sys->ram[address];
-
-        uint16_t words[40];
-
-        uint16_t last_output_bit = 0;
-
-        for (int col = 0; col < 40; col++) {
-            uint16_t w = _apple2e_double_7_bits(vram_row[col] & 0x7F);
-            if (vram_row[col] & 0x80) {
-                w = (w << 1 | last_output_bit) & 0x3FFF;
-            };
-            words[col] = w;
-            last_output_bit = w >> 13;
-        }
-
-        _apple2e_render_line_color(_apple2e_get_fb_addr(sys, row), words, 0, 40, false);
+        _apple2e_hgr_row(sys, start_address, row);
     }
 
     if (!sys->page2) {
@@ -1283,7 +2048,28 @@ static void _apple2e_hgr_update(apple2e_t *sys, uint16_t begin_row, uint16_t end
     }
 }
 
+// Render a single scanline with the current soft switch state (beam racing)
+static void _apple2e_render_scanline(apple2e_t *sys, uint16_t row) {
+    const bool page2 = sys->page2 && !sys->_80store;
+    if (sys->text || (sys->mixed && (row >= 160))) {
+        _apple2e_text_row(sys, page2 ? 0x0800 : 0x0400, row);
+    } else if (sys->hires) {
+        if (sys->dhires && sys->_80col) {
+            _apple2e_dhgr_row(sys, page2 ? 0x4000 : 0x2000, row);
+        } else {
+            _apple2e_hgr_row(sys, page2 ? 0x4000 : 0x2000, row);
+        }
+    } else {
+        _apple2e_lores_row(sys, page2 ? 0x0800 : 0x0400, row);
+    }
+}
+
 void apple2e_screen_update(apple2e_t *sys) {
+    if (sys->beam_racing) {
+        // Scanlines are rendered as the beam passes them
+        return;
+    }
+
     uint16_t text_start_row = 0;
 
     if (!sys->text) {
@@ -68,14 +68,41 @@ extern "C" {
 #endif
 
 // Bump snapshot version when oric_t memory layout changes
-#define ORIC_SNAPSHOT_VERSION (1)
+#define ORIC_SNAPSHOT_VERSION (16)
 
 #define ORIC_FREQUENCY     (1000000)  // 1 MHz
+
+// State file system and chunk ids
+#define ORIC_STATE_ID         CHIPS_STATE_ID('O', 'R', 'I', 'C')
+#define ORIC_STATE_RAM_ID     CHIPS_STATE_ID('R', 'A', 'M', ' ')
+#define ORIC_STATE_OVERLAY_ID CHIPS_STATE_ID('O', 'V', 'R', 'L')
+#define ORIC_STATE_SYS_ID     CHIPS_STATE_ID('S', 'Y', 'S', ' ')
+
+// System ticks per VIA tick (must be 2^N)
+#define ORIC_VIA_TICKS (4)
+// System ticks per tape drive tick
+#define ORIC_TD_TICKS (52 * ORIC_VIA_TICKS)
+
+// System ticks per PSG output sample
+#define ORIC_PSG_SAMPLE_TICKS (46)
+// Number of system ticks between PSG sample flushes (must be 2^N)
+#define ORIC_AUDIO_BLOCK_TICKS (1024)
 #define ORIC_MAX_TAPE_SIZE (1 << 16)  // Max size of tape file in bytes
 
 #define ORIC_SCREEN_WIDTH     240  // (240)
 #define ORIC_SCREEN_HEIGHT    224  // (224)
 #define ORIC_FRAMEBUFFER_SIZE ((ORIC_SCREEN_WIDTH / 2) * ORIC_SCREEN_HEIGHT)
+#define ORIC_SCREEN_COLUMNS   40  // Character cells per line
+#define ORIC_HIRES_LINES      200
+#define ORIC_NUM_CHARSETS     4  // Text/HIRES mode x standard/alternate
+#define ORIC_TEXT_ROWS        28  // Text lines at $BB80 (3 lines at $BF68 in HIRES mode)
+
+// Keyboard buffer of the Atmos ROM, bit 7 is set while a key is pending
+#define ORIC_KEYBUF_ADDR (0x02DF)
+
+// Memory layers, the overlay RAM layer covers the BASIC ROM while it is enabled
+#define ORIC_OVERLAY_LAYER (0)
+#define ORIC_BASE_LAYER    (1)
 
 #define PALETTE_BITS 3
 #define PALETTE_SIZE (1 << PALETTE_BITS)
@@ -91,6 +118,13 @@ static const uint32_t oric_palette[PALETTE_SIZE] = {
     RGBA8(0xFF, 0xFF, 0xFF), /* white */
 };
 
+#ifdef MOS6502CPU_PROFILE
+// Profiler bank indices (see mos6502cpu_profile_t.bank_map)
+#define ORIC_PROFILE_BANK_RAM     (0)  // Main RAM
+#define ORIC_PROFILE_BANK_ROM     (1)  // BASIC ROM
+#define ORIC_PROFILE_BANK_OVERLAY (2)  // Overlay RAM at $C000-$FFFF
+#endif
+
 // Config parameters for oric_init()
 typedef struct {
     bool td_enabled;      // Set to true to enable tape drive emulation
@@ -113,7 +147,7 @@ typedef struct {
     bool valid;
     chips_debug_t debug;
 
-    chips_audio_callback_t audio_callback;
+    chips_audio_t audio;
 
     uint8_t ram[0xC000];
     uint8_t overlay_ram[0x4000];
@@ -126,6 +160,16 @@ typedef struct {
     uint8_t reserved[3];
     uint8_t fb[ORIC_FRAMEBUFFER_SIZE];
     bool screen_dirty;
+    chips_dirty_rows_t dirty_rows;  // Framebuffer rows rendered since last cleared by the frontend
+    // Incremental rendering state
+    uint8_t line_dirty_col[ORIC_SCREEN_HEIGHT];         // First column to re-render (ORIC_SCREEN_COLUMNS: clean)
+    uint8_t line_pattr[ORIC_SCREEN_HEIGHT];             // Video attributes at the start of each rendered line
+    uint8_t line_flags[ORIC_SCREEN_HEIGHT];             // Charsets used and blink state of each rendered line
+    uint32_t glyph_dirty[ORIC_NUM_CHARSETS][128 / 32];  // Redefined glyphs since last update
+    uint8_t glyph_dirty_sets;                           // Charsets with redefined glyphs
+
+    char text_screen[ORIC_TEXT_ROWS][ORIC_SCREEN_COLUMNS + 1];  // Decoded text screen, see oric_text_screen()
+    uint8_t text_screen_key;  // HIRES mode of the decoded text screen (0: text screen written since)
 
     uint16_t extension;
 
@@ -133,7 +177,12 @@ typedef struct {
 
     disk2_fdc_t fdc;  // Disk II floppy disk controller
 
+    chips_idle_t idle;     // Guest idle loop detector
+    MOS6502CPU_T idle_cpu;  // CPU state at the last pass through the idle loop head
+
     uint32_t system_ticks;
+    uint32_t via_sync_tick;  // Next system tick at which the VIA must be caught up
+    uint32_t td_tick;        // Next system tick at which the tape drive ticks
 
 } oric_t;
 
@@ -149,13 +198,41 @@ void oric_reset(oric_t* sys);
 void oric_tick(oric_t* sys);
 
 // Tick Oric instance for a given number of microseconds, return number of executed ticks
+// (stops early when a breakpoint in debug.breakpoints is hit, see stop_reason)
 uint32_t oric_exec(oric_t* sys, uint32_t micro_seconds);
+// Tick Oric instance for a given number of ticks without the debug hooks, tight loops which only poll RAM
+// (like the keyboard buffer filled by the VIA interrupt) are fast-forwarded up to the next VIA event
+// (see chips_idle_t), returns number of fast-forwarded ticks
+uint32_t oric_run_ticks(oric_t* sys, uint32_t num_ticks);
+// Run until a condition is met or 'max_ticks' ticks have been executed, returns true if the condition was met.
+// Runs like oric_run_ticks(): breakpoints and the debug callback are ignored. The text screen of CHIPS_UNTIL_TEXT
+// is checked every CHIPS_UNTIL_TEXT_TICKS ticks, CHIPS_UNTIL_IDLE stops when the ROM keyboard routine reads an
+// empty keyboard buffer (ORIC_KEYBUF_ADDR).
+bool oric_run_until(oric_t* sys, const chips_until_t* cond, uint32_t max_ticks);
 // Take a snapshot, patches pointers to zero or offsets, returns snapshot version
 uint32_t oric_save_snapshot(oric_t* sys, oric_t* dst);
 // Load a snapshot, returns false if snapshot version doesn't match
 bool oric_load_snapshot(oric_t* sys, uint32_t version, oric_t* src);
+// Write a portable state file through the 'write' callback, 'buffer' holds a chunk while it is written (at least
+// CHIPS_STATE_MAX_CHUNK_SIZE bytes), returns false on write error
+bool oric_save_state(oric_t* sys, chips_range_t buffer, chips_state_write_t write, void* user_data);
+// Load a state file into an instance initialized with the same config, returns false if the file is invalid
+bool oric_load_state(oric_t* sys, const void* data, size_t size);
 
+// Render changed screen lines, rendered rows are added to sys->dirty_rows
 void oric_screen_update(oric_t* sys);
+// Decode the text screen at $BB80 into lines of ASCII characters (serial attributes and alternate charset cells read
+// as spaces, inverse ones as normal), in HIRES mode only the last 3 lines at $BF68 are text and the others are
+// empty. The result is cached until the text screen is written or the HIRES mode changes.
+void oric_text_screen(oric_t* sys, char out[ORIC_TEXT_ROWS][ORIC_SCREEN_COLUMNS + 1]);
+// Call after video memory was written without the CPU (e.g. with mem_write_range()), all lines are rendered and
+// the text screen decoded again
+void oric_video_mem_dirty(oric_t* sys);
+
+#ifdef MOS6502CPU_PROFILE
+// Attach a guest code profiler (or null to detach), resets the profiler counters
+void oric_profile_attach(oric_t* sys, mos6502cpu_profile_t* profile);
+#endif
 
 #ifdef __cplusplus
 }  // extern "C"
@@ -172,6 +249,10 @@ void oric_screen_update(oric_t* sys);
 static void _oric_psg_out(int port_id, uint8_t data, void* user_data);
 static uint8_t _oric_psg_in(int port_id, void* user_data);
 static void _oric_init_memorymap(oric_t* sys);
+static void _oric_via_request_sync(oric_t* sys);
+#ifdef MOS6502CPU_PROFILE
+static void _oric_profile_update_banks(oric_t* sys);
+#endif
 static void _oric_init_key_map(oric_t* sys);
 
 #define PATTR_50HZ  (0x02)
@@ -180,6 +261,13 @@ static void _oric_init_key_map(oric_t* sys);
 #define LATTR_DSIZE (0x02)
 #define LATTR_BLINK (0x04)
 
+// Charset indices (bit index in line_flags)
+#define ORIC_CHARSET_TEXT_STD  (0)  // $B400
+#define ORIC_CHARSET_TEXT_ALT  (1)  // $B800
+#define ORIC_CHARSET_HIRES_STD (2)  // $9800
+#define ORIC_CHARSET_HIRES_ALT (3)  // $9C00
+#define ORIC_LINE_FLAG_BLINK   (1 << ORIC_NUM_CHARSETS)
+
 void oric_init(oric_t* sys, const oric_desc_t* desc) {
     CHIPS_ASSERT(sys && desc);
     if (desc->debug.callback.func) {
@@ -189,7 +277,7 @@ void oric_init(oric_t* sys, const oric_desc_t* desc) {
     memset(sys, 0, sizeof(oric_t));
     sys->valid = true;
     sys->debug = desc->debug;
-    sys->audio_callback = desc->audio.callback;
+    chips_audio_init(&sys->audio, &desc->audio);
 
     CHIPS_ASSERT(desc->roms.rom.ptr && (desc->roms.rom.size == 0x4000));
     CHIPS_ASSERT(desc->roms.boot_rom.ptr && (desc->roms.boot_rom.size == 0x200));
@@ -199,11 +287,13 @@ void oric_init(oric_t* sys, const oric_desc_t* desc) {
     MOS6502CPU_INIT(&sys->cpu, &(MOS6502CPU_DESC_T){0});
 
     mos6522via_init(&sys->via);
+    sys->td_tick = ORIC_TD_TICKS - ORIC_VIA_TICKS;
     ay38910psg_init(&sys->psg, &(ay38910psg_desc_t){.type = AY38910PSG_TYPE_8912,
                                                     .in_cb = _oric_psg_in,
                                                     .out_cb = _oric_psg_out,
                                                     .magnitude = CHIPS_DEFAULT(desc->audio.volume, 1.0f),
-                                                    .user_data = sys});
+                                                    .user_data = sys,
+                                                    .sample_ticks = ORIC_PSG_SAMPLE_TICKS});
 
     // setup memory map and keyboard matrix
     _oric_init_memorymap(sys);
@@ -247,6 +337,7 @@ void oric_nmi(oric_t* sys) {
 void oric_reset(oric_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     mos6522via_reset(&sys->via);
+    _oric_via_request_sync(sys);
     ay38910psg_reset(&sys->psg);
     if (sys->fdc.valid) {
         disk2_fdc_reset(&sys->fdc);
@@ -257,15 +348,60 @@ void oric_reset(oric_t* sys) {
     MOS6502CPU_RESET(&sys->cpu);
 }
 
+static void _oric_mark_glyph_dirty(oric_t* sys, int charset, uint16_t addr) {
+    const int glyph = (addr >> 3) & 0x7F;
+    sys->glyph_dirty[charset][glyph >> 5] |= 1u << (glyph & 31);
+    sys->glyph_dirty_sets |= 1 << charset;
+}
+
+static void _oric_mark_lines_dirty(oric_t* sys, int y, int num_lines, uint8_t col) {
+    for (int i = 0; i < num_lines; i++) {
+        if (col < sys->line_dirty_col[y + i]) {
+            sys->line_dirty_col[y + i] = col;
+        }
+    }
+}
+
+void oric_video_mem_dirty(oric_t* sys) {
+    _oric_mark_lines_dirty(sys, 0, ORIC_SCREEN_HEIGHT, 0);
+    sys->screen_dirty = true;
+    sys->text_screen_key = 0;
+}
+
+// Record which lines (from which column) or glyphs a write to video memory invalidates
+static void _oric_screen_write(oric_t* sys, uint16_t addr) {
+    sys->screen_dirty = true;
+    if (addr < 0xA000) {
+        _oric_mark_glyph_dirty(sys, (addr < 0x9C00) ? ORIC_CHARSET_HIRES_STD : ORIC_CHARSET_HIRES_ALT, addr);
+        return;
+    }
+    // Charsets, HIRES and text screen areas overlap
+    if ((addr >= 0xB400) && (addr < 0xBC00)) {
+        _oric_mark_glyph_dirty(sys, (addr < 0xB800) ? ORIC_CHARSET_TEXT_STD : ORIC_CHARSET_TEXT_ALT, addr);
+    }
+    if (addr < 0xA000 + ORIC_HIRES_LINES * ORIC_SCREEN_COLUMNS) {
+        const int offset = addr - 0xA000;
+        _oric_mark_lines_dirty(sys, offset / ORIC_SCREEN_COLUMNS, 1, offset % ORIC_SCREEN_COLUMNS);
+    }
+    if (addr >= 0xBB80) {
+        const int offset = addr - 0xBB80;
+        sys->text_screen_key = 0;
+        _oric_mark_lines_dirty(sys, (offset / ORIC_SCREEN_COLUMNS) * 8, 8, offset % ORIC_SCREEN_COLUMNS);
+    }
+}
+
 static void _oric_mem_rw(oric_t* sys, uint16_t addr, bool rw) {
     if ((addr >= 0x0300) && (addr <= 0x03FF)) {
         // Memory-mapped IO area
         if ((addr >= 0x0300) && (addr <= 0x030F)) {
+            // bring the VIA timers up to date, the VIA tick of this system tick comes after the access
+            mos6522via_update(&sys->via, sys->system_ticks, ORIC_VIA_TICKS);
             if (rw) {
                 MOS6502CPU_SET_DATA(&sys->cpu, mos6522via_read(&sys->via, addr & 0xF));
             } else {
                 mos6522via_write(&sys->via, addr & 0xF, MOS6502CPU_GET_DATA(&sys->cpu));
             }
+            _oric_via_request_sync(sys);
         } else if ((addr >= 0x0310) && (addr <= 0x031F)) {
             if (sys->fdc.valid) {
                 // Disk II FDC
@@ -291,28 +427,31 @@ static void _oric_mem_rw(oric_t* sys, uint16_t addr, bool rw) {
                     // Memory write
                     switch (addr) {
                         case 0x380:
-                            mem_map_rw(&sys->mem, 0, 0xC000, 0x4000, sys->rom, sys->overlay_ram);
+                            mem_enable_layer(&sys->mem, ORIC_OVERLAY_LAYER, false);
                             sys->extension = 0;
                             break;
 
                         case 0x381:
-                            mem_map_ram(&sys->mem, 0, 0xC000, 0x4000, sys->overlay_ram);
+                            mem_enable_layer(&sys->mem, ORIC_OVERLAY_LAYER, true);
                             sys->extension = 0;
                             break;
 
                         case 0x382:
-                            mem_map_rw(&sys->mem, 0, 0xC000, 0x4000, sys->rom, sys->overlay_ram);
+                            mem_enable_layer(&sys->mem, ORIC_OVERLAY_LAYER, false);
                             sys->extension = 0x100;
                             break;
 
                         case 0x383:
-                            mem_map_ram(&sys->mem, 0, 0xC000, 0x4000, sys->overlay_ram);
+                            mem_enable_layer(&sys->mem, ORIC_OVERLAY_LAYER, true);
                             sys->extension = 0x100;
                             break;
 
                         default:
                             break;
                     }
+#ifdef MOS6502CPU_PROFILE
+                    _oric_profile_update_banks(sys);
+#endif
                 }
             } else {
                 if (rw) {
@@ -330,7 +469,7 @@ static void _oric_mem_rw(oric_t* sys, uint16_t addr, bool rw) {
             mem_wr(&sys->mem, addr, MOS6502CPU_GET_DATA(&sys->cpu));
 
             if (addr >= 0x9800 && addr <= 0xBFDF) {
-                sys->screen_dirty = true;
+                _oric_screen_write(sys, addr);
             }
         }
     }
@@ -338,94 +477,227 @@ static void _oric_mem_rw(oric_t* sys, uint16_t addr, bool rw) {
 
 static uint8_t _last_motor_state = 0;
 
-void oric_tick(oric_t* sys) {
-    MOS6502CPU_TICK(&sys->cpu);
+// Generate PSG samples up to the current system tick
+static void _oric_audio_flush(oric_t* sys) {
+    int16_t samples[AY38910PSG_MAX_SAMPLES];
+    const int num_samples = ay38910psg_flush(&sys->psg, sys->system_ticks, samples, AY38910PSG_MAX_SAMPLES);
+    for (int i = 0; i < num_samples; i++) {
+        chips_audio_push(&sys->audio, samples[i]);
+    }
+}
 
-    _oric_mem_rw(sys, sys->cpu.addr, sys->cpu.rw);
+// Update the VIA <=> PSG, keyboard and tape wiring (same as done after each VIA tick)
+static void _oric_update_via_ports(oric_t* sys) {
+    // Update PSG state
+    if (mos6522via_get_cb2(&sys->via)) {
+        const uint8_t psg_data = mos6522via_get_pa(&sys->via);
+        if (mos6522via_get_ca2(&sys->via)) {
+            ay38910psg_latch_address(&sys->psg, psg_data);
+        } else {
+            // let the PSG catch up to (and including) this tick before the register changes
+            ay38910psg_update(&sys->psg, sys->system_ticks + 1);
+            ay38910psg_write(&sys->psg, psg_data);
+        }
+    }
 
-    // Tick PSG
-    if ((sys->system_ticks & 63) == 0) {
-        ay38910psg_tick_channels(&sys->psg);
+    if (!mos6522via_get_cb2(&sys->via)) {
+        mos6522via_set_pa(&sys->via, ay38910psg_read(&sys->psg));
     }
 
-    if ((sys->system_ticks & 127) == 0) {
-        ay38910psg_tick_envelope_generator(&sys->psg);
+    // PB0..PB2: select keyboard matrix line
+    uint8_t pb = mos6522via_get_pb(&sys->via);
+    uint8_t line = pb & 7;
+    if (line >= 0 && line <= 7) {
+        uint8_t line_mask = 1 << line;
+        if (kbd_scan_lines(&sys->kbd) == line_mask) {
+            mos6522via_set_pb(&sys->via, pb | (1 << 3));
+        } else {
+            mos6522via_set_pb(&sys->via, pb & ~(1 << 3));
+        }
     }
 
-    static uint8_t t1 = 0;
-    t1++;
-    if (t1 == 46) {
-        ay38910psg_tick_sample_generator(&sys->psg);
-        if (sys->audio_callback.func) {
-            // New sample is ready
-            sys->audio_callback.func((uint8_t)((uint8_t)(sys->psg.sample * 255.0f)), sys->audio_callback.user_data);
+    if (sys->td.valid) {
+        uint8_t motor_state = pb & 0x40;
+        if (motor_state != _last_motor_state) {
+            if (motor_state) {
+                sys->td.port |= ORIC_TD_PORT_MOTOR;
+                printf("oric: motor on\n");
+            } else {
+                sys->td.port &= ~ORIC_TD_PORT_MOTOR;
+                printf("oric: motor off\n");
+            }
+            _last_motor_state = motor_state;
         }
-        t1 = 0;
+
+        if ((int32_t)(sys->system_ticks - sys->td_tick) >= 0) {
+            oric_td_tick(&sys->td);
+            sys->td_tick = sys->system_ticks + ORIC_TD_TICKS;
+        }
+        if (sys->td.port & ORIC_TD_PORT_READ) {
+            mos6522via_set_cb1(&sys->via, true);
+        } else {
+            mos6522via_set_cb1(&sys->via, false);
+        }
+    }
+}
+
+// Perform the VIA ticks up to and including the current system tick, update the
+// port wiring and find the next system tick at which this must happen again
+static void _oric_via_sync(oric_t* sys) {
+    CHIPS_ASSERT((sys->system_ticks & (ORIC_VIA_TICKS - 1)) == 0);
+    MOS6502CPU_SET_IRQ(&sys->cpu, mos6522via_update(&sys->via, sys->system_ticks + 1, ORIC_VIA_TICKS));
+    _oric_update_via_ports(sys);
+    uint32_t next = mos6522via_next_irq_cycle(&sys->via, ORIC_VIA_TICKS);
+    if (mos6522via_get_cb2(&sys->via)) {
+        // PSG bus is in latch/write state, repeat every VIA tick
+        next = sys->system_ticks + ORIC_VIA_TICKS;
+    }
+    if (sys->td.valid && ((int32_t)(sys->td_tick - next) < 0)) {
+        next = sys->td_tick;
     }
+    sys->via_sync_tick = next;
+}
+
+// Request a VIA sync at the next VIA tick (after register access or external input changes)
+static void _oric_via_request_sync(oric_t* sys) {
+    const uint32_t next = (sys->system_ticks + ORIC_VIA_TICKS - 1) & ~(uint32_t)(ORIC_VIA_TICKS - 1);
+    if ((int32_t)(next - sys->via_sync_tick) < 0) {
+        sys->via_sync_tick = next;
+    }
+}
+
+void oric_tick(oric_t* sys) {
+    MOS6502CPU_TICK(&sys->cpu);
+
+    _oric_mem_rw(sys, sys->cpu.addr, sys->cpu.rw);
 
     // Tick FDC
     if (sys->fdc.valid && (sys->system_ticks & 127) == 0) {
         disk2_fdc_tick(&sys->fdc);
     }
 
-    // Tick VIA
-    if ((sys->system_ticks & 3) == 0) {
-        MOS6502CPU_SET_IRQ(&sys->cpu, mos6522via_tick(&sys->via, 4));
+    // Catch up the VIA when its IRQ output or port wiring may change
+    if ((int32_t)(sys->system_ticks - sys->via_sync_tick) >= 0) {
+        _oric_via_sync(sys);
+    }
 
-        // Update PSG state
-        if (mos6522via_get_cb2(&sys->via)) {
-            const uint8_t psg_data = mos6522via_get_pa(&sys->via);
-            if (mos6522via_get_ca2(&sys->via)) {
-                ay38910psg_latch_address(&sys->psg, psg_data);
-            } else {
-                ay38910psg_write(&sys->psg, psg_data);
-            }
-        }
+    sys->system_ticks++;
 
-        if (!mos6522via_get_cb2(&sys->via)) {
-            mos6522via_set_pa(&sys->via, ay38910psg_read(&sys->psg));
-        }
+    // Generate PSG samples once per audio block
+    if ((sys->system_ticks & (ORIC_AUDIO_BLOCK_TICKS - 1)) == 0) {
+        _oric_audio_flush(sys);
+    }
+}
 
-        // PB0..PB2: select keyboard matrix line
-        uint8_t pb = mos6522via_get_pb(&sys->via);
-        uint8_t line = pb & 7;
-        if (line >= 0 && line <= 7) {
-            uint8_t line_mask = 1 << line;
-            if (kbd_scan_lines(&sys->kbd) == line_mask) {
-                mos6522via_set_pb(&sys->via, pb | (1 << 3));
-            } else {
-                mos6522via_set_pb(&sys->via, pb & ~(1 << 3));
-            }
+// Advance all but the CPU by 'num_ticks' ticks, in steps from one FDC tick or audio block to the next,
+// the caller makes sure that no VIA sync is due
+static void _oric_idle_skip(oric_t* sys, uint32_t num_ticks) {
+    while (num_ticks > 0) {
+        // The first tick of a step does what oric_tick() does (ORIC_AUDIO_BLOCK_TICKS is a multiple of 128)
+        if (sys->fdc.valid && (sys->system_ticks & 127) == 0) {
+            disk2_fdc_tick(&sys->fdc);
+        }
+        uint32_t step = 128 - (sys->system_ticks & 127);
+        if (step > num_ticks) {
+            step = num_ticks;
+        }
+        sys->system_ticks += step;
+        num_ticks -= step;
+        if ((sys->system_ticks & (ORIC_AUDIO_BLOCK_TICKS - 1)) == 0) {
+            _oric_audio_flush(sys);
         }
+    }
+}
 
-        if (sys->td.valid) {
-            uint8_t motor_state = pb & 0x40;
-            if (motor_state != _last_motor_state) {
-                if (motor_state) {
-                    sys->td.port |= ORIC_TD_PORT_MOTOR;
-                    printf("oric: motor on\n");
-                } else {
-                    sys->td.port &= ~ORIC_TD_PORT_MOTOR;
-                    printf("oric: motor off\n");
-                }
-                _last_motor_state = motor_state;
-            }
+// Test of the run-until conditions which are met by a CPU access
+static inline bool _oric_until_tick(oric_t* sys, const chips_until_t* cond) {
+    switch (cond->type) {
+        case CHIPS_UNTIL_PC:
+            return MOS6502CPU_GET_SYNC(&sys->cpu) && (sys->cpu.addr == cond->addr);
+        case CHIPS_UNTIL_MEM:
+            // Test at instruction boundaries, this also catches memory written by DMA
+            return MOS6502CPU_GET_SYNC(&sys->cpu) && ((mem_rd(&sys->mem, cond->addr) & cond->mask) == cond->value);
+        case CHIPS_UNTIL_IDLE:
+            return sys->cpu.rw && (sys->cpu.addr == ORIC_KEYBUF_ADDR) && !(MOS6502CPU_GET_DATA(&sys->cpu) & 0x80);
+        default:
+            return false;
+    }
+}
 
-            static uint8_t t2 = 0;
-            t2++;
-            if (t2 == 52) {
-                oric_td_tick(&sys->td);
-                t2 = 0;
-            }
-            if (sys->td.port & ORIC_TD_PORT_READ) {
-                mos6522via_set_cb1(&sys->via, true);
-            } else {
-                mos6522via_set_cb1(&sys->via, false);
+// oric_run_ticks() which also stops after the tick meeting 'cond' (if not null), returns true if it was met,
+// the number of ticks run and fast-forwarded are added to 'ticks_run' and 'skipped_ticks'
+static bool _oric_run(oric_t* sys, uint32_t num_ticks, const chips_until_t* cond, uint32_t* ticks_run,
+                      uint32_t* skipped_ticks) {
+    chips_idle_t* idle = &sys->idle;
+    // keyboard or tape state may have been changed from outside
+    _oric_via_request_sync(sys);
+    // Traced instructions and profiler cycles can't be fast-forwarded
+    bool idle_enabled = true;
+#ifdef MOS6502CPU_TRACE
+    idle_enabled = false;
+#endif
+#ifdef MOS6502CPU_PROFILE
+    idle_enabled = idle_enabled && !sys->cpu.profile;
+#endif
+    bool met = false;
+    uint32_t ticks = 0;
+    if (!idle_enabled) {
+        while (!met && (ticks < num_ticks)) {
+            oric_tick(sys);
+            ticks++;
+            met = cond && _oric_until_tick(sys, cond);
+        }
+        *ticks_run += ticks;
+        return met;
+    }
+    // Inputs may have changed since the last call, only iterations seen completely count
+    chips_idle_reset(idle);
+    while (!met && (ticks < num_ticks)) {
+        oric_tick(sys);
+        ticks++;
+        if (cond && _oric_until_tick(sys, cond)) {
+            met = true;
+        } else if (MOS6502CPU_GET_SYNC(&sys->cpu)) {
+            if (chips_idle_fetch(idle, sys->cpu.addr, sys->system_ticks)) {
+                const int32_t via_ticks = (int32_t)(sys->via_sync_tick - sys->system_ticks);
+                if ((idle->num_repeats > 1) && (via_ticks > 0) &&
+                    (memcmp(&sys->idle_cpu, &sys->cpu, sizeof(sys->cpu)) == 0)) {
+                    // The loop is a fixed point, skip the iterations which fit in before the VIA sync or the end
+                    uint32_t max_ticks = num_ticks - ticks;
+                    if (max_ticks > (uint32_t)via_ticks) {
+                        max_ticks = (uint32_t)via_ticks;
+                    }
+                    uint32_t n = chips_idle_iterations(idle, max_ticks);
+                    if (cond) {
+                        n = chips_idle_until_iterations(idle, cond, n);
+                    }
+                    for (int i = 0; i < idle->num_last_writes; i++) {
+                        if (idle->counters & (1U << i)) {
+                            mem_wr(&sys->mem, (uint16_t)(idle->last_writes[i] >> 8), chips_idle_counter(idle, i, n));
+                        }
+                    }
+                    _oric_idle_skip(sys, n * idle->period);
+                    ticks += n * idle->period;
+                    *skipped_ticks += n * idle->period;
+                }
+                memcpy(&sys->idle_cpu, &sys->cpu, sizeof(sys->cpu));
             }
+        } else if (idle->tracking) {
+            // All of the I/O area has side effects or changing inputs
+            chips_idle_access(idle, sys->cpu.addr, sys->cpu.rw, MOS6502CPU_GET_DATA(&sys->cpu),
+                              (sys->cpu.addr >= 0x0300) && (sys->cpu.addr <= 0x03FF));
         }
     }
+    *ticks_run += ticks;
+    return met;
+}
 
-    sys->system_ticks++;
+uint32_t oric_run_ticks(oric_t* sys, uint32_t num_ticks) {
+    CHIPS_ASSERT(sys && sys->valid);
+    uint32_t ticks = 0;
+    uint32_t skipped_ticks = 0;
+    _oric_run(sys, num_ticks, 0, &ticks, &skipped_ticks);
+    return skipped_ticks;
 }
 
 // PSG OUT callback (nothing to do here)
@@ -446,125 +718,312 @@ static uint8_t _oric_psg_in(int port_id, void* user_data) {
     return 0xFF;
 }
 
+// Render line 'y' starting with video attributes 'pattr', return the video attributes at the end
+// of the line. Serial attributes are re-decoded from column 0, but only cells from column 'x0' onward
+// (or from the first cell using a redefined glyph) are drawn.
+static uint8_t _oric_render_line(oric_t* sys, int y, uint8_t pattr, int x0, bool blink_state) {
+    // Line attributes and current colors
+    uint8_t lattr = 0;
+    uint8_t fgcol = 7;
+    uint8_t bgcol = 0;
+    uint8_t flags = 0;
+
+    sys->line_pattr[y] = pattr;
+    sys->line_dirty_col[y] = ORIC_SCREEN_COLUMNS;
+
+    uint8_t* p = &sys->fb[y * (ORIC_SCREEN_WIDTH / 2)];
+
+    for (int x = 0; x < ORIC_SCREEN_COLUMNS; x++) {
+        // Lookup the byte and, if needed, the pattern data
+        uint8_t ch, pat;
+        if ((pattr & PATTR_HIRES) && y < ORIC_HIRES_LINES)
+            ch = pat = sys->ram[0xA000 + y * ORIC_SCREEN_COLUMNS + x];
+
+        else {
+            ch = sys->ram[0xBB80 + (y >> 3) * ORIC_SCREEN_COLUMNS + x];
+            int off = (lattr & LATTR_DSIZE ? y >> 1 : y) & 7;
+            int charset;
+            if (pattr & PATTR_HIRES)
+                charset = (lattr & LATTR_ALT) ? ORIC_CHARSET_HIRES_ALT : ORIC_CHARSET_HIRES_STD;
+            else
+                charset = (lattr & LATTR_ALT) ? ORIC_CHARSET_TEXT_ALT : ORIC_CHARSET_TEXT_STD;
+            static const uint16_t charset_base[ORIC_NUM_CHARSETS] = {0xB400, 0xB800, 0x9800, 0x9C00};
+            const int glyph = ch & 0x7F;
+            pat = sys->ram[charset_base[charset] + ((glyph << 3) | off)];
+            if (ch & 0x60) {
+                flags |= 1 << charset;
+                if ((x < x0) && (sys->glyph_dirty[charset][glyph >> 5] & (1u << (glyph & 31)))) {
+                    x0 = x;
+                }
+            }
+        }
+
+        // Handle state-chaging attributes
+        if (!(ch & 0x60)) {
+            pat = 0x00;
+            switch (ch & 0x18) {
+                case 0x00:
+                    fgcol = ch & 7;
+                    break;
+                case 0x08:
+                    lattr = ch & 7;
+                    break;
+                case 0x10:
+                    bgcol = ch & 7;
+                    break;
+                case 0x18:
+                    pattr = ch & 7;
+                    break;
+            }
+        }
+        if (lattr & LATTR_BLINK) {
+            flags |= ORIC_LINE_FLAG_BLINK;
+        }
+
+        // Cells before the change point are still up to date
+        if (x < x0) {
+            p += 3;
+            continue;
+        }
+
+        // Pick up the colors for the pattern
+        uint8_t c_fgcol = fgcol;
+        uint8_t c_bgcol = bgcol;
+
+        // inverse video
+        if (ch & 0x80) {
+            c_bgcol = c_bgcol ^ 0x07;
+            c_fgcol = c_fgcol ^ 0x07;
+        }
+        // blink
+        if ((lattr & LATTR_BLINK) && blink_state) c_fgcol = c_bgcol;
+
+        // Draw the pattern
+        uint8_t c;
+        c = pat & 0x20 ? c_fgcol : c_bgcol;
+        *p = c << 4;
+        c = pat & 0x10 ? c_fgcol : c_bgcol;
+        *p++ |= c;
+        c = pat & 0x08 ? c_fgcol : c_bgcol;
+        *p = c << 4;
+        c = pat & 0x04 ? c_fgcol : c_bgcol;
+        *p++ |= c;
+        c = pat & 0x02 ? c_fgcol : c_bgcol;
+        *p = c << 4;
+        c = pat & 0x01 ? c_fgcol : c_bgcol;
+        *p++ |= c;
+    }
+
+    sys->line_flags[y] = flags;
+    chips_dirty_rows_set(&sys->dirty_rows, y);
+    return pattr;
+}
+
 void oric_screen_update(oric_t* sys) {
     if (!sys->screen_dirty) {
         return;
     }
 
     bool blink_state = sys->blink_counter & 0x20;
+    // Blink state of the previous update
+    bool blink_changed = blink_state != (0 != (((sys->blink_counter - 1) & 0x3F) & 0x20));
     sys->blink_counter = (sys->blink_counter + 1) & 0x3F;
 
     uint8_t pattr = sys->pattr;
 
-    for (int y = 0; y < 224; y++) {
-        // Line attributes and current colors
-        uint8_t lattr = 0;
-        uint8_t fgcol = 7;
-        uint8_t bgcol = 0;
-
-        uint8_t* p = &sys->fb[y * (ORIC_SCREEN_WIDTH / 2)];
-
-        for (int x = 0; x < 40; x++) {
-            // Lookup the byte and, if needed, the pattern data
-            uint8_t ch, pat;
-            if ((pattr & PATTR_HIRES) && y < 200)
-                ch = pat = sys->ram[0xA000 + y * 40 + x];
-
-            else {
-                ch = sys->ram[0xBB80 + (y >> 3) * 40 + x];
-                int off = (lattr & LATTR_DSIZE ? y >> 1 : y) & 7;
-                const uint8_t* base;
-                if (pattr & PATTR_HIRES)
-                    if (lattr & LATTR_ALT)
-                        base = sys->ram + 0x9C00;
-                    else
-                        base = sys->ram + 0x9800;
-                else if (lattr & LATTR_ALT)
-                    base = sys->ram + 0xB800;
-                else
-                    base = sys->ram + 0xB400;
-                pat = base[((ch & 0x7F) << 3) | off];
-            }
-
-            // Handle state-chaging attributes
-            if (!(ch & 0x60)) {
-                pat = 0x00;
-                switch (ch & 0x18) {
-                    case 0x00:
-                        fgcol = ch & 7;
-                        break;
-                    case 0x08:
-                        lattr = ch & 7;
-                        break;
-                    case 0x10:
-                        bgcol = ch & 7;
-                        break;
-                    case 0x18:
-                        pattr = ch & 7;
-                        break;
-                }
-            }
-
-            // Pick up the colors for the pattern
-            uint8_t c_fgcol = fgcol;
-            uint8_t c_bgcol = bgcol;
-
-            // inverse video
-            if (ch & 0x80) {
-                c_bgcol = c_bgcol ^ 0x07;
-                c_fgcol = c_fgcol ^ 0x07;
-            }
-            // blink
-            if ((lattr & LATTR_BLINK) && blink_state) c_fgcol = c_bgcol;
-
-            // Draw the pattern
-            uint8_t c;
-            c = pat & 0x20 ? c_fgcol : c_bgcol;
-            *p = c << 4;
-            c = pat & 0x10 ? c_fgcol : c_bgcol;
-            *p++ |= c;
-            c = pat & 0x08 ? c_fgcol : c_bgcol;
-            *p = c << 4;
-            c = pat & 0x04 ? c_fgcol : c_bgcol;
-            *p++ |= c;
-            c = pat & 0x02 ? c_fgcol : c_bgcol;
-            *p = c << 4;
-            c = pat & 0x01 ? c_fgcol : c_bgcol;
-            *p++ |= c;
+    for (int y = 0; y < ORIC_SCREEN_HEIGHT; y++) {
+        int x0 = sys->line_dirty_col[y];
+        if ((pattr != sys->line_pattr[y]) || (blink_changed && (sys->line_flags[y] & ORIC_LINE_FLAG_BLINK))) {
+            x0 = 0;
+        }
+        if ((x0 >= ORIC_SCREEN_COLUMNS) && !(sys->line_flags[y] & sys->glyph_dirty_sets)) {
+            // Line is unchanged, and so are the video attributes at its end
+            pattr = (y < ORIC_SCREEN_HEIGHT - 1) ? sys->line_pattr[y + 1] : sys->pattr;
+            continue;
         }
+        pattr = _oric_render_line(sys, y, pattr, x0, blink_state);
     }
 
     sys->pattr = pattr;
 
+    memset(sys->glyph_dirty, 0, sizeof(sys->glyph_dirty));
+    sys->glyph_dirty_sets = 0;
     sys->screen_dirty = false;
 }
 
+static void _oric_update_watch_flags(oric_t* sys) {
+    const chips_breakpoints_t* bp = sys->debug.breakpoints;
+    mem_clear_page_flags(&sys->mem, MEM_PAGE_FLAG_WATCH_READ | MEM_PAGE_FLAG_WATCH_WRITE);
+    for (int i = 0; i < bp->num_watchpoints; i++) {
+        const chips_watchpoint_t* wp = &bp->watchpoints[i];
+        const uint8_t flags = ((wp->flags & CHIPS_WATCH_READ) ? MEM_PAGE_FLAG_WATCH_READ : 0) |
+                              ((wp->flags & CHIPS_WATCH_WRITE) ? MEM_PAGE_FLAG_WATCH_WRITE : 0);
+        mem_set_page_flags(&sys->mem, wp->addr, wp->size, flags);
+    }
+}
+
+// Check breakpoints and watchpoints after a tick, returns true if execution must stop
+static bool _oric_check_breakpoints(oric_t* sys) {
+    chips_breakpoints_t* bp = sys->debug.breakpoints;
+    const uint16_t addr = sys->cpu.addr;
+    if (MOS6502CPU_GET_SYNC(&sys->cpu) && chips_breakpoint_test(bp, addr)) {
+        bp->stop_reason = CHIPS_STOP_BREAKPOINT;
+        bp->stop_addr = addr;
+        return true;
+    }
+    if (mem_page_flags(&sys->mem, addr) & (sys->cpu.rw ? MEM_PAGE_FLAG_WATCH_READ : MEM_PAGE_FLAG_WATCH_WRITE)) {
+        const int reason = chips_watchpoint_test(bp, addr, sys->cpu.rw);
+        if (reason != CHIPS_STOP_NONE) {
+            bp->stop_reason = reason;
+            bp->stop_addr = addr;
+            return true;
+        }
+    }
+    return false;
+}
+
 uint32_t oric_exec(oric_t* sys, uint32_t micro_seconds) {
     CHIPS_ASSERT(sys && sys->valid);
     uint32_t num_ticks = clk_us_to_ticks(ORIC_FREQUENCY, micro_seconds);
+    uint32_t ticks;
+    // keyboard or tape state may have been changed from outside
+    _oric_via_request_sync(sys);
+    if (sys->debug.breakpoints) {
+        sys->debug.breakpoints->stop_reason = CHIPS_STOP_NONE;
+        _oric_update_watch_flags(sys);
+    }
     if (0 == sys->debug.callback.func) {
-        // run without debug callback
-        for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-            oric_tick(sys);
+        if (0 == sys->debug.breakpoints) {
+            // run without debug hooks
+            oric_run_ticks(sys, num_ticks);
+            ticks = num_ticks;
+        } else {
+            // run with native breakpoints
+            for (ticks = 0; ticks < num_ticks;) {
+                oric_tick(sys);
+                ticks++;
+                if (_oric_check_breakpoints(sys)) {
+                    break;
+                }
+            }
         }
     } else {
         // run with debug callback
-        for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped); ticks++) {
+        for (ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped);) {
             oric_tick(sys);
+            ticks++;
             sys->debug.callback.func(sys->debug.callback.user_data, 0);
+            if (sys->debug.breakpoints && _oric_check_breakpoints(sys)) {
+                break;
+            }
         }
     }
     kbd_update(&sys->kbd, micro_seconds);
+    _oric_audio_flush(sys);
+    chips_audio_flush(&sys->audio);
+    oric_screen_update(sys);
+    return ticks;
+}
+
+// Decode the text screen into sys->text_screen, unless it is still up to date
+static void _oric_text_screen_update(oric_t* sys) {
+    const bool hires = sys->pattr & PATTR_HIRES;
+    const uint8_t key = 0x10 | (hires ? 0x01 : 0);
+    if (sys->text_screen_key == key) {
+        return;
+    }
+    // The 3 text lines of HIRES mode at $BF68 are the last lines of the text screen
+    const int first_row = hires ? ORIC_TEXT_ROWS - 3 : 0;
+    for (int row = 0; row < ORIC_TEXT_ROWS; row++) {
+        char* line = sys->text_screen[row];
+        if (row < first_row) {
+            line[0] = 0;
+            continue;
+        }
+        const uint8_t* vram_row = &sys->ram[0xBB80 + row * ORIC_SCREEN_COLUMNS];
+        // Serial attributes start over on each line
+        uint8_t lattr = 0;
+        for (int col = 0; col < ORIC_SCREEN_COLUMNS; col++) {
+            const uint8_t ch = vram_row[col] & 0x7F;
+            if (ch < 0x20) {
+                if ((ch & 0x18) == 0x08) {
+                    lattr = ch & 7;
+                }
+                line[col] = ' ';
+            } else {
+                line[col] = (lattr & LATTR_ALT) ? ' ' : (char)ch;
+            }
+        }
+        line[ORIC_SCREEN_COLUMNS] = 0;
+    }
+    sys->text_screen_key = key;
+}
+
+void oric_text_screen(oric_t* sys, char out[ORIC_TEXT_ROWS][ORIC_SCREEN_COLUMNS + 1]) {
+    CHIPS_ASSERT(sys && sys->valid && out);
+    _oric_text_screen_update(sys);
+    memcpy(out, sys->text_screen, sizeof(sys->text_screen));
+}
+
+// True if a line of the text screen contains 'text'
+static bool _oric_text_contains(oric_t* sys, const char* text) {
+    _oric_text_screen_update(sys);
+    for (int row = 0; row < ORIC_TEXT_ROWS; row++) {
+        if (strstr(sys->text_screen[row], text)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool oric_run_until(oric_t* sys, const chips_until_t* cond, uint32_t max_ticks) {
+    CHIPS_ASSERT(sys && sys->valid && cond);
+    bool met = false;
+    uint32_t ticks = 0;
+    uint32_t skipped_ticks = 0;
+    switch (cond->type) {
+        case CHIPS_UNTIL_PC:
+        case CHIPS_UNTIL_IDLE:
+            met = _oric_run(sys, max_ticks, cond, &ticks, &skipped_ticks);
+            break;
+
+        case CHIPS_UNTIL_MEM:
+            met = (mem_rd(&sys->mem, cond->addr) & cond->mask) == cond->value;
+            if (!met) {
+                met = _oric_run(sys, max_ticks, cond, &ticks, &skipped_ticks);
+            }
+            break;
+
+        case CHIPS_UNTIL_TEXT:
+            met = _oric_text_contains(sys, cond->text);
+            while (!met && (ticks < max_ticks)) {
+                const uint32_t num_ticks =
+                    (max_ticks - ticks < CHIPS_UNTIL_TEXT_TICKS) ? (max_ticks - ticks) : CHIPS_UNTIL_TEXT_TICKS;
+                _oric_run(sys, num_ticks, 0, &ticks, &skipped_ticks);
+                met = _oric_text_contains(sys, cond->text);
+            }
+            break;
+
+        default:
+            CHIPS_ASSERT(false);
+            break;
+    }
+    kbd_update(&sys->kbd, (uint32_t)(((uint64_t)ticks * 1000000) / ORIC_FREQUENCY));
+    _oric_audio_flush(sys);
+    chips_audio_flush(&sys->audio);
     oric_screen_update(sys);
-    return num_ticks;
+    return met;
 }
 
 static void _oric_init_memorymap(oric_t* sys) {
     mem_init(&sys->mem);
     memset(sys->ram, 0, sizeof(sys->ram));
     memset(sys->overlay_ram, 0, sizeof(sys->overlay_ram));
-    mem_map_ram(&sys->mem, 0, 0x0000, 0xC000, sys->ram);
-    mem_map_rw(&sys->mem, 0, 0xC000, 0x4000, sys->rom, sys->overlay_ram);
+    mem_map_ram(&sys->mem, ORIC_BASE_LAYER, 0x0000, 0xC000, sys->ram);
+    // Writes to the ROM go to the overlay RAM
+    mem_map_rw(&sys->mem, ORIC_BASE_LAYER, 0xC000, 0x4000, sys->rom, sys->overlay_ram);
+    mem_enable_layer(&sys->mem, ORIC_OVERLAY_LAYER, false);
+    mem_map_ram(&sys->mem, ORIC_OVERLAY_LAYER, 0xC000, 0x4000, sys->overlay_ram);
 }
 
 static void _oric_init_key_map(oric_t* sys) {
@@ -635,7 +1094,7 @@ uint32_t oric_save_snapshot(oric_t* sys, oric_t* dst) {
     CHIPS_ASSERT(sys && dst);
     *dst = *sys;
     chips_debug_snapshot_onsave(&dst->debug);
-    chips_audio_callback_snapshot_onsave(&dst->audio_callback);
+    chips_audio_snapshot_onsave(&dst->audio);
     // m6502_snapshot_onsave(&dst->cpu);
     ay38910psg_snapshot_onsave(&dst->psg);
     oric_td_snapshot_onsave(&dst->td);
@@ -644,6 +1103,32 @@ uint32_t oric_save_snapshot(oric_t* sys, oric_t* dst) {
     return ORIC_SNAPSHOT_VERSION;
 }
 
+#ifdef MOS6502CPU_PROFILE
+static void _oric_profile_update_banks(oric_t* sys) {
+    mos6502cpu_profile_t* p = sys->cpu.profile;
+    if (!p) {
+        return;
+    }
+    bool overlay = mem_readptr(&sys->mem, 0xC000) == sys->overlay_ram;
+    for (int i = 0x0; i <= 0xF; i++) {
+        if (i < 0xC) {
+            p->bank_map[i] = ORIC_PROFILE_BANK_RAM;
+        } else {
+            p->bank_map[i] = overlay ? ORIC_PROFILE_BANK_OVERLAY : ORIC_PROFILE_BANK_ROM;
+        }
+    }
+}
+
+void oric_profile_attach(oric_t* sys, mos6502cpu_profile_t* profile) {
+    CHIPS_ASSERT(sys && sys->valid);
+    sys->cpu.profile = profile;
+    if (profile) {
+        mos6502cpu_profile_reset(profile);
+        _oric_profile_update_banks(sys);
+    }
+}
+#endif
+
 bool oric_load_snapshot(oric_t* sys, uint32_t version, oric_t* src) {
     CHIPS_ASSERT(sys && src);
     if (version != ORIC_SNAPSHOT_VERSION) {
@@ -652,14 +1137,131 @@ bool oric_load_snapshot(oric_t* sys, uint32_t version, oric_t* src) {
     static oric_t im;
     im = *src;
     chips_debug_snapshot_onload(&im.debug, &sys->debug);
-    chips_audio_callback_snapshot_onload(&im.audio_callback, &sys->audio_callback);
+    chips_audio_snapshot_onload(&im.audio, &sys->audio);
     // m6502_snapshot_onload(&im.cpu, &sys->cpu);
     ay38910psg_snapshot_onload(&im.psg, &sys->psg);
     oric_td_snapshot_onload(&im.td, &sys->td);
     disk2_fdc_snapshot_onload(&im.fdc, &sys->fdc);
     mem_snapshot_onload(&im.mem, sys);
+#ifdef MOS6502CPU_PROFILE
+    im.cpu.profile = sys->cpu.profile;
+#endif
     *sys = im;
+    // The framebuffer was replaced, all rows differ from what the frontend has seen
+    chips_dirty_rows_set_all(&sys->dirty_rows);
+    oric_video_mem_dirty(sys);
+#ifdef MOS6502CPU_PROFILE
+    _oric_profile_update_banks(sys);
+#endif
     return true;
 }
 
+bool oric_save_state(oric_t* sys, chips_range_t buffer, chips_state_write_t write, void* user_data) {
+    CHIPS_ASSERT(sys && sys->valid && write);
+    chips_state_writer_t w;
+    chips_state_writer_init(&w, ORIC_STATE_ID, buffer, write, user_data);
+    MOS6502CPU_SAVE_STATE(&sys->cpu, &w);
+    chips_state_put_memory(&w, ORIC_STATE_RAM_ID, sys->ram, sizeof(sys->ram), 0);
+    chips_state_put_memory(&w, ORIC_STATE_OVERLAY_ID, sys->overlay_ram, sizeof(sys->overlay_ram), 0);
+
+    chips_state_begin_chunk(&w, ORIC_STATE_SYS_ID, 1);
+    chips_state_put8(&w, (uint8_t)sys->blink_counter);
+    chips_state_put8(&w, sys->pattr);
+    chips_state_put16(&w, sys->extension);
+    chips_state_put_bool(&w, mem_readptr(&sys->mem, 0xC000) == sys->overlay_ram);
+    chips_state_put32(&w, sys->system_ticks);
+    chips_state_put32(&w, sys->via_sync_tick);
+    chips_state_put32(&w, sys->td_tick);
+    chips_state_end_chunk(&w);
+
+    mos6522via_save_state(&sys->via, &w);
+    ay38910psg_save_state(&sys->psg, &w);
+    if (sys->td.valid) {
+        oric_td_save_state(&sys->td, &w);
+    }
+    if (sys->fdc.valid) {
+        disk2_fdc_save_state(&sys->fdc, &w);
+    }
+    return chips_state_writer_finish(&w);
+}
+
+// Read the state file chunks into 'sys', in check mode the disk images are not written
+static bool _oric_load_chunks(oric_t* sys, chips_state_reader_t* r, bool check, bool* overlay) {
+    // Memory blocks missing from the file are zero
+    memset(sys->ram, 0, sizeof(sys->ram));
+    memset(sys->overlay_ram, 0, sizeof(sys->overlay_ram));
+    bool ok = true;
+    while (ok && chips_state_next_chunk(r)) {
+        switch (r->chunk_id) {
+            case MOS6502CPU_STATE_ID:
+                ok = MOS6502CPU_LOAD_STATE(&sys->cpu, r);
+                break;
+            case ORIC_STATE_RAM_ID:
+                ok = chips_state_get_memory(r, sys->ram, sizeof(sys->ram), 0);
+                break;
+            case ORIC_STATE_OVERLAY_ID:
+                ok = chips_state_get_memory(r, sys->overlay_ram, sizeof(sys->overlay_ram), 0);
+                break;
+            case ORIC_STATE_SYS_ID:
+                sys->blink_counter = chips_state_get8(r) & 0x3F;
+                sys->pattr = chips_state_get8(r);
+                sys->extension = chips_state_get16(r);
+                *overlay = chips_state_get_bool(r);
+                sys->system_ticks = chips_state_get32(r);
+                sys->via_sync_tick = chips_state_get32(r);
+                sys->td_tick = chips_state_get32(r);
+                ok = r->ok;
+                break;
+            case MOS6522VIA_STATE_ID:
+                ok = mos6522via_load_state(&sys->via, r);
+                break;
+            case AY38910PSG_STATE_ID:
+                ok = ay38910psg_load_state(&sys->psg, r);
+                break;
+            case ORIC_TD_STATE_ID:
+                // Chunks of devices this instance does not have are skipped
+                if (sys->td.valid) {
+                    ok = oric_td_load_state(&sys->td, r);
+                }
+                break;
+            case DISK2_FDC_STATE_ID:
+            case DISK2_FDC_STATE_TRACK_ID:
+                // Chunks of devices this instance does not have are skipped
+                if (sys->fdc.valid) {
+                    ok = check ? disk2_fdc_check_state(&sys->fdc, r) : disk2_fdc_load_state(&sys->fdc, r);
+                }
+                break;
+            default:
+                // Chunk written by a newer version
+                break;
+        }
+    }
+    return ok;
+}
+
+bool oric_load_state(oric_t* sys, const void* data, size_t size) {
+    CHIPS_ASSERT(sys && sys->valid && data);
+    chips_state_reader_t r;
+    if (!chips_state_reader_init(&r, data, size, ORIC_STATE_ID)) {
+        return false;
+    }
+    // Load into a scratch copy first, so an invalid chunk leaves the machine unchanged
+    static oric_t im;
+    im = *sys;
+    chips_state_reader_t check = r;
+    bool overlay = false;
+    if (!_oric_load_chunks(&im, &check, true, &overlay)) {
+        return false;
+    }
+    const bool ok = _oric_load_chunks(sys, &r, false, &overlay);
+    CHIPS_ASSERT(ok);
+    mem_enable_layer(&sys->mem, ORIC_OVERLAY_LAYER, overlay);
+    // The framebuffer is not stored, render all lines again
+    oric_video_mem_dirty(sys);
+#ifdef MOS6502CPU_PROFILE
+    _oric_profile_update_banks(sys);
+#endif
+    return ok;
+}
+
 #endif  // CHIPS_IMPL
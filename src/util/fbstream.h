@@ -0,0 +1,170 @@
+#pragma once
+
+// fbstream.h
+//
+// Framebuffer streaming: encodes the dirty rows of a packed 4bpp framebuffer
+// (two pixels per byte, as in the system fb arrays) into compact frame messages
+// for remote viewers, and applies such messages to a framebuffer copy.
+//
+// Frame message layout (all multi-byte values little endian):
+//
+//     uint32_t magic          FBSTREAM_MAGIC
+//     uint32_t frame          running frame number
+//     uint16_t bytes_per_row  packed bytes per framebuffer row
+//     uint16_t num_rows       framebuffer height
+//     uint16_t num_dirty      number of row records that follow
+//     row records:
+//         uint16_t row        framebuffer row index
+//         uint16_t size       size of the RLE data
+//         uint8_t data[size]  PackBits-style RLE of the packed row bytes
+//
+// RLE: a control byte c < 128 is followed by c + 1 literal bytes, a control
+// byte c >= 128 is followed by one byte which is repeated c - 125 times
+// (chips_rle_encode() in chips_common.h).
+//
+// Frames without dirty rows are still sent (header only), so viewers can
+// count frames.
+//
+// Include chips/chips_common.h before this header.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FBSTREAM_MAGIC            (0x42465252)  // "RRFB"
+#define FBSTREAM_HEADER_SIZE      (14)
+#define FBSTREAM_ROW_HEADER_SIZE  (4)
+// Worst case size of the RLE data of one row
+#define FBSTREAM_MAX_RLE_SIZE(bytes_per_row) CHIPS_RLE_MAX_SIZE(bytes_per_row)
+// Worst case size of a frame message
+#define FBSTREAM_MAX_FRAME_SIZE(bytes_per_row, num_rows) \
+    (FBSTREAM_HEADER_SIZE + (num_rows) * (FBSTREAM_ROW_HEADER_SIZE + FBSTREAM_MAX_RLE_SIZE(bytes_per_row)))
+
+// Framebuffer stream encoder state
+typedef struct {
+    int bytes_per_row;
+    int num_rows;
+    uint32_t frame;
+} fbstream_t;
+
+// Initialize a new encoder for a framebuffer of 'num_rows' rows of 'bytes_per_row' packed bytes
+void fbstream_init(fbstream_t* s, int bytes_per_row, int num_rows);
+// Encode the rows marked in 'dirty' into a frame message, returns message size (0 if 'max_size' is too small)
+size_t fbstream_encode(fbstream_t* s, const uint8_t* fb, const chips_dirty_rows_t* dirty, uint8_t* out,
+                       size_t max_size);
+// Apply a frame message to 'fb', returns number of bytes consumed (0 if the message is invalid or incomplete)
+size_t fbstream_decode(const uint8_t* msg, size_t size, uint8_t* fb, int bytes_per_row, int num_rows);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+static void _fbstream_put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void _fbstream_put32(uint8_t* p, uint32_t v) {
+    _fbstream_put16(p, (uint16_t)v);
+    _fbstream_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t _fbstream_get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t _fbstream_get32(const uint8_t* p) {
+    return _fbstream_get16(p) | ((uint32_t)_fbstream_get16(p + 2) << 16);
+}
+
+void fbstream_init(fbstream_t* s, int bytes_per_row, int num_rows) {
+    CHIPS_ASSERT(s && (bytes_per_row > 0) && (bytes_per_row <= 0xFFFF));
+    CHIPS_ASSERT((num_rows > 0) && (num_rows <= CHIPS_MAX_DIRTY_ROWS));
+    memset(s, 0, sizeof(*s));
+    s->bytes_per_row = bytes_per_row;
+    s->num_rows = num_rows;
+}
+
+size_t fbstream_encode(fbstream_t* s, const uint8_t* fb, const chips_dirty_rows_t* dirty, uint8_t* out,
+                       size_t max_size) {
+    CHIPS_ASSERT(s && fb && dirty && out);
+    if (max_size < FBSTREAM_HEADER_SIZE) {
+        return 0;
+    }
+    size_t pos = FBSTREAM_HEADER_SIZE;
+    uint16_t num_dirty = 0;
+    for (int row = 0; row < s->num_rows; row++) {
+        if (!chips_dirty_rows_test(dirty, row)) {
+            continue;
+        }
+        if (pos + FBSTREAM_ROW_HEADER_SIZE + FBSTREAM_MAX_RLE_SIZE(s->bytes_per_row) > max_size) {
+            return 0;
+        }
+        const int size =
+            chips_rle_encode(&fb[row * s->bytes_per_row], s->bytes_per_row, &out[pos + FBSTREAM_ROW_HEADER_SIZE]);
+        _fbstream_put16(&out[pos], (uint16_t)row);
+        _fbstream_put16(&out[pos + 2], (uint16_t)size);
+        pos += FBSTREAM_ROW_HEADER_SIZE + size;
+        num_dirty++;
+    }
+    _fbstream_put32(&out[0], FBSTREAM_MAGIC);
+    _fbstream_put32(&out[4], s->frame++);
+    _fbstream_put16(&out[8], (uint16_t)s->bytes_per_row);
+    _fbstream_put16(&out[10], (uint16_t)s->num_rows);
+    _fbstream_put16(&out[12], num_dirty);
+    return pos;
+}
+
+size_t fbstream_decode(const uint8_t* msg, size_t size, uint8_t* fb, int bytes_per_row, int num_rows) {
+    CHIPS_ASSERT(msg && fb);
+    if ((size < FBSTREAM_HEADER_SIZE) || (_fbstream_get32(&msg[0]) != FBSTREAM_MAGIC) ||
+        (_fbstream_get16(&msg[8]) != bytes_per_row) || (_fbstream_get16(&msg[10]) != num_rows)) {
+        return 0;
+    }
+    const int num_dirty = _fbstream_get16(&msg[12]);
+    size_t pos = FBSTREAM_HEADER_SIZE;
+    for (int i = 0; i < num_dirty; i++) {
+        if (pos + FBSTREAM_ROW_HEADER_SIZE > size) {
+            return 0;
+        }
+        const int row = _fbstream_get16(&msg[pos]);
+        const int rle_size = _fbstream_get16(&msg[pos + 2]);
+        pos += FBSTREAM_ROW_HEADER_SIZE;
+        if ((row >= num_rows) || (pos + rle_size > size) ||
+            !chips_rle_decode(&msg[pos], rle_size, &fb[row * bytes_per_row], bytes_per_row)) {
+            return 0;
+        }
+        pos += rle_size;
+    }
+    return pos;
+}
+
+#endif  // CHIPS_IMPL
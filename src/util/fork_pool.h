@@ -0,0 +1,190 @@
+#pragma once
+
+// fork_pool.h
+//
+// Thread pool for running many forks of a system in parallel (e.g. for
+// fuzzing or searching input sequences). The worker threads are started
+// once, fork_pool_run() hands them a batch of jobs and waits until all
+// of them are done.
+//
+// Usage with apple2e_fork() (one fork instance per thread):
+//
+//     static apple2e_t forks[FORK_POOL_MAX_THREADS];
+//
+//     static void job(int index, int thread, void* user_data) {
+//         apple2e_t* fork = &forks[thread];
+//         apple2e_fork((apple2e_t*)user_data, fork);
+//         fork->kbd_last_key = 0x80 | inputs[index];
+//         apple2e_exec(fork, 100000);
+//         results[index] = mem_rd(&fork->mem, 0x00FF);
+//     }
+//
+//     fork_pool_init(&pool, &(fork_pool_desc_t){.num_threads = 8});
+//     fork_pool_run(&pool, num_inputs, job, &parent);
+//
+// The parent must not run while fork_pool_run() is in progress. apple2e_fork()
+// needs mem.h compiled with MEM_COPY_ON_WRITE.
+//
+// Requires pthreads.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FORK_POOL_MAX_THREADS     (64)
+#define FORK_POOL_DEFAULT_THREADS (4)
+
+// Job callback, 'index' is the job number, 'thread' the worker number (0 .. num_threads - 1)
+typedef void (*fork_pool_func_t)(int index, int thread, void* user_data);
+
+// Setup parameters for fork_pool_init()
+typedef struct {
+    int num_threads;  // Number of worker threads (default: FORK_POOL_DEFAULT_THREADS)
+} fork_pool_desc_t;
+
+typedef struct fork_pool_t fork_pool_t;
+
+// Worker thread state
+typedef struct {
+    fork_pool_t* pool;
+    int index;
+    pthread_t thread;
+} fork_pool_worker_t;
+
+// Thread pool state
+struct fork_pool_t {
+    bool valid;
+    int num_threads;
+    fork_pool_worker_t workers[FORK_POOL_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t start;  // Signaled when a batch starts or the pool shuts down
+    pthread_cond_t done;   // Signaled when the last job of a batch is done
+    fork_pool_func_t func;
+    void* user_data;
+    uint32_t batch;  // Batch counter, wakes up the workers
+    int num_jobs;
+    int next_job;
+    int num_done;
+    bool quit;
+};
+
+// Start the worker threads
+void fork_pool_init(fork_pool_t* pool, const fork_pool_desc_t* desc);
+// Stop the worker threads
+void fork_pool_discard(fork_pool_t* pool);
+// Run 'num_jobs' jobs on the worker threads, returns when all are done
+void fork_pool_run(fork_pool_t* pool, int num_jobs, fork_pool_func_t func, void* user_data);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+static void* _fork_pool_worker(void* arg) {
+    fork_pool_worker_t* worker = (fork_pool_worker_t*)arg;
+    fork_pool_t* pool = worker->pool;
+    uint32_t batch = 0;
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->quit && (pool->batch == batch)) {
+            pthread_cond_wait(&pool->start, &pool->lock);
+        }
+        if (pool->quit) {
+            break;
+        }
+        batch = pool->batch;
+        while (pool->next_job < pool->num_jobs) {
+            const int index = pool->next_job++;
+            pthread_mutex_unlock(&pool->lock);
+            pool->func(index, worker->index, pool->user_data);
+            pthread_mutex_lock(&pool->lock);
+            if (++pool->num_done == pool->num_jobs) {
+                pthread_cond_signal(&pool->done);
+            }
+        }
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+void fork_pool_init(fork_pool_t* pool, const fork_pool_desc_t* desc) {
+    CHIPS_ASSERT(pool && desc);
+    memset(pool, 0, sizeof(*pool));
+    pool->num_threads = desc->num_threads ? desc->num_threads : FORK_POOL_DEFAULT_THREADS;
+    CHIPS_ASSERT((pool->num_threads > 0) && (pool->num_threads <= FORK_POOL_MAX_THREADS));
+    pthread_mutex_init(&pool->lock, 0);
+    pthread_cond_init(&pool->start, 0);
+    pthread_cond_init(&pool->done, 0);
+    for (int i = 0; i < pool->num_threads; i++) {
+        fork_pool_worker_t* worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->index = i;
+        pthread_create(&worker->thread, 0, _fork_pool_worker, worker);
+    }
+    pool->valid = true;
+}
+
+void fork_pool_discard(fork_pool_t* pool) {
+    CHIPS_ASSERT(pool && pool->valid);
+    pthread_mutex_lock(&pool->lock);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->start);
+    pthread_mutex_unlock(&pool->lock);
+    for (int i = 0; i < pool->num_threads; i++) {
+        pthread_join(pool->workers[i].thread, 0);
+    }
+    pthread_cond_destroy(&pool->done);
+    pthread_cond_destroy(&pool->start);
+    pthread_mutex_destroy(&pool->lock);
+    pool->valid = false;
+}
+
+void fork_pool_run(fork_pool_t* pool, int num_jobs, fork_pool_func_t func, void* user_data) {
+    CHIPS_ASSERT(pool && pool->valid && func && (num_jobs >= 0));
+    if (num_jobs == 0) {
+        return;
+    }
+    pthread_mutex_lock(&pool->lock);
+    pool->func = func;
+    pool->user_data = user_data;
+    pool->num_jobs = num_jobs;
+    pool->next_job = 0;
+    pool->num_done = 0;
+    pool->batch++;
+    pthread_cond_broadcast(&pool->start);
+    while (pool->num_done < pool->num_jobs) {
+        pthread_cond_wait(&pool->done, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+}
+
+#endif  // CHIPS_IMPL
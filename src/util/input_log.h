@@ -0,0 +1,307 @@
+#pragma once
+
+// input_log.h
+//
+// Deterministic input log: records the inputs a frontend applies to a
+// system (keys, paddles, buttons, reset, disk changes) keyed by the system
+// tick at which they were applied, together with the length of each
+// exec() call and RAM hash checkpoints. Replaying the log runs the same
+// ticks with the same inputs at the same ticks, so the run is bit-identical
+// on any host (e.g. for benchmark workloads), and the checkpoints verify it.
+//
+// Log layout (all multi-byte values little endian):
+//
+//     uint32_t magic          INPUT_LOG_MAGIC
+//     uint16_t version        INPUT_LOG_VERSION
+//     uint32_t system_id      system the log was recorded on (e.g. APPLE2_STATE_ID)
+//     records:
+//         uint32_t ticks      ticks since the previous record
+//         uint8_t type        INPUT_LOG_*
+//         uint16_t code       key code, paddle/button/image index
+//         uint32_t value      see below
+//
+// Record types:
+//
+//     INPUT_LOG_FRAME       exec() call with 'value' micro seconds, the record ticks are the ticks it executed
+//     INPUT_LOG_KEY_DOWN    key 'code' pressed (as passed to the system)
+//     INPUT_LOG_KEY_UP      key 'code' released
+//     INPUT_LOG_PADDLE      paddle 'code' set to 'value'
+//     INPUT_LOG_BUTTON      button 'code' pressed ('value' 1) or released (0)
+//     INPUT_LOG_RESET       system reset
+//     INPUT_LOG_NMI         NMI
+//     INPUT_LOG_INSERT      disk or tape image 'code' of the frontend inserted
+//     INPUT_LOG_CHECK       'value' is the input_log_hash() of the system RAM
+//
+// Inputs are applied between exec() calls, so all records but frames have
+// zero ticks. Replaying the exec() calls with the recorded lengths (instead
+// of the host frame time) puts every input at the exact recorded tick, and
+// also keeps frame based state such as the Oric keyboard release timing
+// identical.
+//
+// Replay driver usage:
+//
+//     input_log_replay_t replay = {.exec = exec, .input = apply_input, .hash = ram_hash, .user_data = sys};
+//     while (input_log_replay_frame(&player, &replay)) {
+//         ... present the frame ...
+//     }
+//     if (player.num_tick_errors || player.num_check_errors) ... the replay diverged ...
+//
+// Include chips/chips_common.h before this header.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define INPUT_LOG_MAGIC       (0x4C495252)  // "RRIL"
+#define INPUT_LOG_VERSION     (1)
+#define INPUT_LOG_HEADER_SIZE (10)
+#define INPUT_LOG_RECORD_SIZE (11)
+#define INPUT_LOG_HASH_INIT   (0x811C9DC5)  // FNV-1a offset basis, initial input_log_hash() value
+
+// Record types
+#define INPUT_LOG_FRAME    (1)
+#define INPUT_LOG_KEY_DOWN (2)
+#define INPUT_LOG_KEY_UP   (3)
+#define INPUT_LOG_PADDLE   (4)
+#define INPUT_LOG_BUTTON   (5)
+#define INPUT_LOG_RESET    (6)
+#define INPUT_LOG_NMI      (7)
+#define INPUT_LOG_INSERT   (8)
+#define INPUT_LOG_CHECK    (9)
+
+// A decoded log record
+typedef struct {
+    uint64_t ticks;  // Ticks since the start of the log at the end of the record
+    uint8_t type;
+    uint16_t code;
+    uint32_t value;
+} input_log_event_t;
+
+// Log writer state
+typedef struct {
+    bool valid;
+    uint64_t ticks;       // Ticks recorded so far
+    uint64_t prev_ticks;  // Ticks at the previous record
+    chips_state_write_t write;
+    void* user_data;
+    bool ok;  // False after a write error
+} input_log_t;
+
+// Player results of input_log_player_next()
+typedef enum {
+    INPUT_LOG_PLAYER_END = 0,  // End of the log
+    INPUT_LOG_PLAYER_ERROR,    // Log is truncated
+    INPUT_LOG_PLAYER_EVENT,    // player->event holds the next record
+} input_log_player_result_t;
+
+// Log player state
+typedef struct {
+    bool valid;
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    uint64_t ticks;
+    input_log_event_t event;
+    // Replay results of input_log_replay_frame()
+    uint64_t replay_ticks;      // Ticks executed by the replay
+    uint32_t num_frames;        // Frames replayed
+    uint32_t num_checks;        // Checkpoints compared
+    uint32_t num_tick_errors;   // Frames after which the executed ticks differ from the log
+    uint32_t num_check_errors;  // Checkpoints with a different RAM hash
+    bool truncated;             // Log ended in the middle of a record
+} input_log_player_t;
+
+// Replay driver callbacks
+typedef struct {
+    uint32_t (*exec)(uint32_t micro_seconds, void* user_data);        // Run the system, return executed ticks
+    void (*input)(const input_log_event_t* event, void* user_data);  // Apply an input record
+    uint32_t (*hash)(void* user_data);                                // input_log_hash() of the system RAM
+    void* user_data;
+} input_log_replay_t;
+
+// Initialize a log writer for a system and write the log header through 'write'
+void input_log_init(input_log_t* log, uint32_t system_id, chips_state_write_t write, void* user_data);
+// Record an exec() call of 'micro_seconds' which executed 'ticks' ticks
+void input_log_frame(input_log_t* log, uint32_t micro_seconds, uint32_t ticks);
+// Record an input applied before the next exec() call
+void input_log_input(input_log_t* log, uint8_t type, uint16_t code, uint32_t value);
+// Record a RAM hash checkpoint
+void input_log_check(input_log_t* log, uint32_t hash);
+
+// Initialize a player over a complete log in memory, returns false if the header is invalid or the log was
+// recorded on another system
+bool input_log_player_init(input_log_player_t* player, const void* data, size_t size, uint32_t system_id);
+// Decode the next record into player->event
+input_log_player_result_t input_log_player_next(input_log_player_t* player);
+// Apply the inputs and compare the checkpoints up to the next frame record and run that frame, returns false at
+// the end of the log
+bool input_log_replay_frame(input_log_player_t* player, const input_log_replay_t* replay);
+
+// FNV-1a hash of a memory range, chain several ranges by passing the previous result (start with INPUT_LOG_HASH_INIT)
+uint32_t input_log_hash(uint32_t hash, const void* data, size_t size);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+static void _input_log_put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void _input_log_put32(uint8_t* p, uint32_t v) {
+    _input_log_put16(p, (uint16_t)v);
+    _input_log_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t _input_log_get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t _input_log_get32(const uint8_t* p) {
+    return _input_log_get16(p) | ((uint32_t)_input_log_get16(p + 2) << 16);
+}
+
+void input_log_init(input_log_t* log, uint32_t system_id, chips_state_write_t write, void* user_data) {
+    CHIPS_ASSERT(log && write);
+    memset(log, 0, sizeof(*log));
+    log->valid = true;
+    log->write = write;
+    log->user_data = user_data;
+    uint8_t header[INPUT_LOG_HEADER_SIZE];
+    _input_log_put32(&header[0], INPUT_LOG_MAGIC);
+    _input_log_put16(&header[4], INPUT_LOG_VERSION);
+    _input_log_put32(&header[6], system_id);
+    log->ok = write(header, sizeof(header), user_data);
+}
+
+static void _input_log_record(input_log_t* log, uint8_t type, uint16_t code, uint32_t value) {
+    // exec() runs less than 2^32 ticks, so the delta always fits
+    uint8_t record[INPUT_LOG_RECORD_SIZE];
+    _input_log_put32(&record[0], (uint32_t)(log->ticks - log->prev_ticks));
+    record[4] = type;
+    _input_log_put16(&record[5], code);
+    _input_log_put32(&record[7], value);
+    log->prev_ticks = log->ticks;
+    if (log->ok) {
+        log->ok = log->write(record, sizeof(record), log->user_data);
+    }
+}
+
+void input_log_frame(input_log_t* log, uint32_t micro_seconds, uint32_t ticks) {
+    CHIPS_ASSERT(log && log->valid);
+    log->ticks += ticks;
+    _input_log_record(log, INPUT_LOG_FRAME, 0, micro_seconds);
+}
+
+void input_log_input(input_log_t* log, uint8_t type, uint16_t code, uint32_t value) {
+    CHIPS_ASSERT(log && log->valid && (type != INPUT_LOG_FRAME));
+    _input_log_record(log, type, code, value);
+}
+
+void input_log_check(input_log_t* log, uint32_t hash) {
+    CHIPS_ASSERT(log && log->valid);
+    _input_log_record(log, INPUT_LOG_CHECK, 0, hash);
+}
+
+bool input_log_player_init(input_log_player_t* player, const void* data, size_t size, uint32_t system_id) {
+    CHIPS_ASSERT(player && data);
+    memset(player, 0, sizeof(*player));
+    const uint8_t* p = (const uint8_t*)data;
+    if ((size < INPUT_LOG_HEADER_SIZE) || (_input_log_get32(&p[0]) != INPUT_LOG_MAGIC) ||
+        (_input_log_get16(&p[4]) != INPUT_LOG_VERSION) || (_input_log_get32(&p[6]) != system_id)) {
+        return false;
+    }
+    player->valid = true;
+    player->data = p;
+    player->size = size;
+    player->pos = INPUT_LOG_HEADER_SIZE;
+    return true;
+}
+
+input_log_player_result_t input_log_player_next(input_log_player_t* player) {
+    CHIPS_ASSERT(player && player->valid);
+    if (player->pos == player->size) {
+        return INPUT_LOG_PLAYER_END;
+    }
+    if (player->size - player->pos < INPUT_LOG_RECORD_SIZE) {
+        return INPUT_LOG_PLAYER_ERROR;
+    }
+    const uint8_t* p = &player->data[player->pos];
+    player->pos += INPUT_LOG_RECORD_SIZE;
+    player->ticks += _input_log_get32(&p[0]);
+    player->event.ticks = player->ticks;
+    player->event.type = p[4];
+    player->event.code = _input_log_get16(&p[5]);
+    player->event.value = _input_log_get32(&p[7]);
+    return INPUT_LOG_PLAYER_EVENT;
+}
+
+bool input_log_replay_frame(input_log_player_t* player, const input_log_replay_t* replay) {
+    CHIPS_ASSERT(player && player->valid && replay && replay->exec && replay->input && replay->hash);
+    input_log_player_result_t res;
+    while ((res = input_log_player_next(player)) == INPUT_LOG_PLAYER_EVENT) {
+        const input_log_event_t* ev = &player->event;
+        switch (ev->type) {
+            case INPUT_LOG_FRAME:
+                player->replay_ticks += replay->exec(ev->value, replay->user_data);
+                player->num_frames++;
+                if (player->replay_ticks != ev->ticks) {
+                    player->num_tick_errors++;
+                    // Compare the following frames against the log again
+                    player->replay_ticks = ev->ticks;
+                }
+                return true;
+            case INPUT_LOG_CHECK:
+                player->num_checks++;
+                if (replay->hash(replay->user_data) != ev->value) {
+                    player->num_check_errors++;
+                }
+                break;
+            default:
+                replay->input(ev, replay->user_data);
+                break;
+        }
+    }
+    player->truncated = (res == INPUT_LOG_PLAYER_ERROR);
+    return false;
+}
+
+uint32_t input_log_hash(uint32_t hash, const void* data, size_t size) {
+    CHIPS_ASSERT(data);
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ p[i]) * 0x01000193;
+    }
+    return hash;
+}
+
+#endif  // CHIPS_IMPL
@@ -0,0 +1,437 @@
+#pragma once
+
+// recorder.h
+//
+// Lossless session recording: captures the packed 4bpp framebuffer of a
+// system as XOR deltas against the previous frame, RLE-compressed with
+// chips_rle_encode(), interleaved with audio blocks and input events, and
+// plays such recordings back.
+//
+// Recording layout (all multi-byte values little endian):
+//
+//     uint32_t magic          RECORDER_MAGIC
+//     uint16_t version        RECORDER_VERSION
+//     uint16_t width          framebuffer width in pixels
+//     uint16_t height         framebuffer height in pixels
+//     uint32_t sample_rate    audio sample rate in Hz
+//     uint32_t palette[16]    palette of the 4bpp framebuffer
+//     chunks:
+//         uint8_t type        RECORDER_CHUNK_*
+//         uint32_t size       size of the payload
+//         uint8_t data[size]  payload
+//
+// Chunk payloads:
+//
+//     RECORDER_CHUNK_FRAME    RLE of (frame XOR previous frame), the frame before the first one is all zeros
+//     RECORDER_CHUNK_AUDIO    int16_t mono samples
+//     RECORDER_CHUNK_INPUT    uint8_t key down (1) or up (0), uint16_t key code
+//
+// Input events are recorded before the frame during which they were applied.
+//
+// recorder_frame() only compares the framebuffer rows marked as dirty by the
+// system, clean rows go into the XOR delta as zero runs without being read,
+// so a recording costs little more than the rows that actually changed.
+//
+// Include chips/chips_common.h before this header.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RECORDER_MAGIC        (0x43525252)  // "RRRC"
+#define RECORDER_VERSION      (1)
+#define RECORDER_HEADER_SIZE  (78)
+#define RECORDER_PALETTE_SIZE (16)
+
+#define RECORDER_MAX_FRAMEBUFFER_SIZE (64 * 1024)
+#define RECORDER_MAX_AUDIO_SAMPLES    (1024)  // Max number of samples in one audio chunk
+
+#define RECORDER_CHUNK_FRAME (1)
+#define RECORDER_CHUNK_AUDIO (2)
+#define RECORDER_CHUNK_INPUT (3)
+
+// Receives the recording as a sequence of byte blocks
+typedef struct {
+    void (*func)(const void* data, size_t size, void* user_data);
+    void* user_data;
+} recorder_write_callback_t;
+
+typedef struct {
+    int width;                 // Framebuffer width in pixels (two pixels per byte)
+    int height;                // Framebuffer height in pixels
+    const uint32_t* palette;   // RECORDER_PALETTE_SIZE palette entries
+    int sample_rate;           // Audio sample rate in Hz
+    recorder_write_callback_t write;
+} recorder_desc_t;
+
+typedef struct {
+    bool valid;
+    int fb_size;
+    int row_size;  // Bytes per framebuffer row
+    int height;
+    uint32_t num_frames;
+    recorder_write_callback_t write;
+    uint8_t prev_fb[RECORDER_MAX_FRAMEBUFFER_SIZE];
+    uint8_t delta[RECORDER_MAX_FRAMEBUFFER_SIZE];  // XOR of the dirty rows, clean rows are not written
+    uint8_t buf[5 + CHIPS_RLE_MAX_SIZE(RECORDER_MAX_FRAMEBUFFER_SIZE)];
+} recorder_t;
+
+// Player events returned by recorder_player_next()
+typedef enum {
+    RECORDER_EVENT_END = 0,  // End of the recording
+    RECORDER_EVENT_ERROR,    // Recording is truncated or invalid
+    RECORDER_EVENT_FRAME,    // player->fb holds the next frame
+    RECORDER_EVENT_AUDIO,    // player->samples holds player->num_samples samples
+    RECORDER_EVENT_INPUT,    // player->key_code was pressed (player->key_down) or released
+} recorder_event_t;
+
+typedef struct {
+    bool valid;
+    const uint8_t* data;
+    size_t size;
+    size_t pos;
+    int width;
+    int height;
+    int fb_size;
+    int sample_rate;
+    uint32_t palette[RECORDER_PALETTE_SIZE];
+    uint32_t num_frames;  // Number of frames decoded so far
+    uint8_t fb[RECORDER_MAX_FRAMEBUFFER_SIZE];
+    uint8_t delta[RECORDER_MAX_FRAMEBUFFER_SIZE];
+    int num_samples;
+    int16_t samples[RECORDER_MAX_AUDIO_SAMPLES];
+    int key_code;
+    bool key_down;
+} recorder_player_t;
+
+// Initialize a new recorder and write the recording header
+void recorder_init(recorder_t* rec, const recorder_desc_t* desc);
+// Record a frame from the packed 4bpp framebuffer, only the rows in 'dirty' are compared (NULL: all rows),
+// call before the system's dirty rows are cleared
+void recorder_frame(recorder_t* rec, const uint8_t* fb, const chips_dirty_rows_t* dirty);
+// Record a block of audio samples
+void recorder_audio(recorder_t* rec, const void* samples, int num_samples, chips_audio_format_t format);
+// Record a key event
+void recorder_input(recorder_t* rec, int key_code, bool key_down);
+
+// Initialize a player over a complete recording in memory, returns false if the header is invalid
+bool recorder_player_init(recorder_player_t* player, const void* data, size_t size);
+// Decode the next chunk
+recorder_event_t recorder_player_next(recorder_player_t* player);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+static void _recorder_put16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void _recorder_put32(uint8_t* p, uint32_t v) {
+    _recorder_put16(p, (uint16_t)v);
+    _recorder_put16(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint16_t _recorder_get16(const uint8_t* p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+
+static uint32_t _recorder_get32(const uint8_t* p) {
+    return _recorder_get16(p) | ((uint32_t)_recorder_get16(p + 2) << 16);
+}
+
+// Write a chunk whose payload is already in rec->buf after the 5 byte chunk header
+static void _recorder_write_chunk(recorder_t* rec, uint8_t type, int size) {
+    rec->buf[0] = type;
+    _recorder_put32(&rec->buf[1], (uint32_t)size);
+    rec->write.func(rec->buf, 5 + (size_t)size, rec->write.user_data);
+}
+
+void recorder_init(recorder_t* rec, const recorder_desc_t* desc) {
+    CHIPS_ASSERT(rec && desc && desc->palette && desc->write.func);
+    CHIPS_ASSERT((desc->width > 0) && ((desc->width & 1) == 0) && (desc->height > 0));
+    CHIPS_ASSERT((desc->width / 2) * desc->height <= RECORDER_MAX_FRAMEBUFFER_SIZE);
+    CHIPS_ASSERT(desc->height <= CHIPS_MAX_DIRTY_ROWS);
+    memset(rec, 0, sizeof(*rec));
+    rec->valid = true;
+    rec->fb_size = (desc->width / 2) * desc->height;
+    rec->row_size = desc->width / 2;
+    rec->height = desc->height;
+    rec->write = desc->write;
+
+    uint8_t* p = rec->buf;
+    _recorder_put32(&p[0], RECORDER_MAGIC);
+    _recorder_put16(&p[4], RECORDER_VERSION);
+    _recorder_put16(&p[6], (uint16_t)desc->width);
+    _recorder_put16(&p[8], (uint16_t)desc->height);
+    _recorder_put32(&p[10], (uint32_t)desc->sample_rate);
+    for (int i = 0; i < RECORDER_PALETTE_SIZE; i++) {
+        _recorder_put32(&p[14 + i * 4], desc->palette[i]);
+    }
+    rec->write.func(p, RECORDER_HEADER_SIZE, rec->write.user_data);
+}
+
+// Encoder for the chips_rle_encode() format which takes zero runs of any length, so clean rows are never scanned
+
+// Append 'n' bytes to the open literal ('*lit' is its count byte or null), starting new ones as needed
+static uint8_t* _recorder_rle_literal(uint8_t* dst, uint8_t** lit, const uint8_t* src, int n) {
+    while (n > 0) {
+        int k;
+        if (!*lit || (**lit == 127)) {
+            k = (n > 128) ? 128 : n;
+            *lit = dst++;
+            **lit = (uint8_t)(k - 1);
+        } else {
+            k = 127 - **lit;
+            k = (n > k) ? k : n;
+            **lit = (uint8_t)(**lit + k);
+        }
+        n -= k;
+        for (; k > 0; k--) {
+            *dst++ = *src++;
+        }
+    }
+    return dst;
+}
+
+// Write 'n' bytes of value 'b' as runs of up to 129 bytes, a rest of 1 or 2 bytes goes into the literal
+static uint8_t* _recorder_rle_run(uint8_t* dst, uint8_t** lit, uint8_t b, uint32_t n) {
+    while (n >= 3) {
+        const uint32_t run = (n > 129) ? 129 : n;
+        *dst++ = (uint8_t)(run + 125);
+        *dst++ = b;
+        *lit = 0;
+        n -= run;
+    }
+    const uint8_t rest[2] = {b, b};
+    return _recorder_rle_literal(dst, lit, rest, (int)n);
+}
+
+// Return the end of the zero run starting at d[i], unchanged areas are skipped a machine word at a time
+static int _recorder_zero_run(const uint8_t* d, int i, int len) {
+    while ((i < len) && (i & (int)(sizeof(uint64_t) - 1)) && (d[i] == 0)) {
+        i++;
+    }
+    for (; i + (int)sizeof(uint64_t) <= len; i += sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, &d[i], sizeof(uint64_t));
+        if (w != 0) {
+            break;
+        }
+    }
+    while ((i < len) && (d[i] == 0)) {
+        i++;
+    }
+    return i;
+}
+
+// XOR a dirty row into rec->delta and update the previous frame, a machine word at a time
+static void _recorder_delta_row(recorder_t* rec, const uint8_t* fb, int offset) {
+    const int num_words = rec->row_size / (int)sizeof(uint64_t);
+    for (int i = 0; i < num_words; i++) {
+        const int pos = offset + i * (int)sizeof(uint64_t);
+        uint64_t cur, prev;
+        memcpy(&cur, &fb[pos], sizeof(uint64_t));
+        memcpy(&prev, &rec->prev_fb[pos], sizeof(uint64_t));
+        const uint64_t delta = cur ^ prev;
+        memcpy(&rec->delta[pos], &delta, sizeof(uint64_t));
+        memcpy(&rec->prev_fb[pos], &cur, sizeof(uint64_t));
+    }
+    for (int pos = offset + num_words * (int)sizeof(uint64_t); pos < offset + rec->row_size; pos++) {
+        rec->delta[pos] = fb[pos] ^ rec->prev_fb[pos];
+        rec->prev_fb[pos] = fb[pos];
+    }
+}
+
+void recorder_frame(recorder_t* rec, const uint8_t* fb, const chips_dirty_rows_t* dirty) {
+    CHIPS_ASSERT(rec && rec->valid && fb);
+    uint8_t* dst = &rec->buf[5];
+    uint8_t* lit = 0;
+    uint32_t zeros = 0;  // Pending zero run, written when the next non-zero byte or the end of the frame is reached
+    for (int row = 0; row < rec->height; row++) {
+        // The first frame is compared completely, it starts the delta chain
+        if ((rec->num_frames > 0) && dirty && !chips_dirty_rows_test(dirty, row)) {
+            zeros += (uint32_t)rec->row_size;
+            continue;
+        }
+        const int offset = row * rec->row_size;
+        _recorder_delta_row(rec, fb, offset);
+        const uint8_t* d = &rec->delta[offset];
+        const int len = rec->row_size;
+        int i = 0;
+        while (i < len) {
+            const uint8_t b = d[i];
+            if (b == 0) {
+                const int end = _recorder_zero_run(d, i, len);
+                zeros += (uint32_t)(end - i);
+                i = end;
+                continue;
+            }
+            if (zeros > 0) {
+                dst = _recorder_rle_run(dst, &lit, 0, zeros);
+                zeros = 0;
+            }
+            if ((i + 2 < len) && (d[i + 1] == b) && (d[i + 2] == b)) {
+                int n = 3;
+                while ((i + n < len) && (d[i + n] == b)) {
+                    n++;
+                }
+                dst = _recorder_rle_run(dst, &lit, b, (uint32_t)n);
+                i += n;
+                continue;
+            }
+            // Literal up to the next run of 3 equal bytes, zero runs included
+            int end = i + 1;
+            while ((end < len) && !((end + 2 < len) && (d[end] == d[end + 1]) && (d[end] == d[end + 2]))) {
+                end++;
+            }
+            dst = _recorder_rle_literal(dst, &lit, &d[i], end - i);
+            i = end;
+        }
+    }
+    dst = _recorder_rle_run(dst, &lit, 0, zeros);
+    const int size = (int)(dst - &rec->buf[5]);
+    CHIPS_ASSERT(size <= CHIPS_RLE_MAX_SIZE(rec->fb_size));
+    _recorder_write_chunk(rec, RECORDER_CHUNK_FRAME, size);
+    rec->num_frames++;
+}
+
+static int16_t _recorder_sample_s16(const void* samples, int i, chips_audio_format_t format) {
+    switch (format) {
+        case CHIPS_AUDIO_FORMAT_U8:
+            return (int16_t)((((const uint8_t*)samples)[i] - 128) << 8);
+        case CHIPS_AUDIO_FORMAT_S16:
+            return ((const int16_t*)samples)[i];
+        case CHIPS_AUDIO_FORMAT_FLOAT:
+        default: {
+            float s = ((const float*)samples)[i];
+            s = (s > 1.0f) ? 1.0f : ((s < -1.0f) ? -1.0f : s);
+            return (int16_t)(s * 32767.0f);
+        }
+    }
+}
+
+void recorder_audio(recorder_t* rec, const void* samples, int num_samples, chips_audio_format_t format) {
+    CHIPS_ASSERT(rec && rec->valid && samples);
+    int pos = 0;
+    while (pos < num_samples) {
+        int n = num_samples - pos;
+        if (n > RECORDER_MAX_AUDIO_SAMPLES) {
+            n = RECORDER_MAX_AUDIO_SAMPLES;
+        }
+        for (int i = 0; i < n; i++) {
+            _recorder_put16(&rec->buf[5 + i * 2], (uint16_t)_recorder_sample_s16(samples, pos + i, format));
+        }
+        _recorder_write_chunk(rec, RECORDER_CHUNK_AUDIO, n * 2);
+        pos += n;
+    }
+}
+
+void recorder_input(recorder_t* rec, int key_code, bool key_down) {
+    CHIPS_ASSERT(rec && rec->valid);
+    rec->buf[5] = key_down ? 1 : 0;
+    _recorder_put16(&rec->buf[6], (uint16_t)key_code);
+    _recorder_write_chunk(rec, RECORDER_CHUNK_INPUT, 3);
+}
+
+bool recorder_player_init(recorder_player_t* player, const void* data, size_t size) {
+    CHIPS_ASSERT(player && data);
+    memset(player, 0, sizeof(*player));
+    const uint8_t* p = (const uint8_t*)data;
+    if ((size < RECORDER_HEADER_SIZE) || (_recorder_get32(&p[0]) != RECORDER_MAGIC) ||
+        (_recorder_get16(&p[4]) != RECORDER_VERSION)) {
+        return false;
+    }
+    player->width = _recorder_get16(&p[6]);
+    player->height = _recorder_get16(&p[8]);
+    player->fb_size = (player->width / 2) * player->height;
+    if ((player->fb_size == 0) || (player->fb_size > RECORDER_MAX_FRAMEBUFFER_SIZE)) {
+        return false;
+    }
+    player->sample_rate = (int)_recorder_get32(&p[10]);
+    for (int i = 0; i < RECORDER_PALETTE_SIZE; i++) {
+        player->palette[i] = _recorder_get32(&p[14 + i * 4]);
+    }
+    player->valid = true;
+    player->data = p;
+    player->size = size;
+    player->pos = RECORDER_HEADER_SIZE;
+    return true;
+}
+
+recorder_event_t recorder_player_next(recorder_player_t* player) {
+    CHIPS_ASSERT(player && player->valid);
+    if (player->pos == player->size) {
+        return RECORDER_EVENT_END;
+    }
+    if (player->pos + 5 > player->size) {
+        return RECORDER_EVENT_ERROR;
+    }
+    const uint8_t type = player->data[player->pos];
+    const uint32_t size = _recorder_get32(&player->data[player->pos + 1]);
+    const uint8_t* payload = &player->data[player->pos + 5];
+    if (size > player->size - player->pos - 5) {
+        return RECORDER_EVENT_ERROR;
+    }
+    player->pos += 5 + size;
+    switch (type) {
+        case RECORDER_CHUNK_FRAME:
+            if (!chips_rle_decode(payload, (int)size, player->delta, player->fb_size)) {
+                return RECORDER_EVENT_ERROR;
+            }
+            for (int i = 0; i < player->fb_size; i++) {
+                player->fb[i] ^= player->delta[i];
+            }
+            player->num_frames++;
+            return RECORDER_EVENT_FRAME;
+        case RECORDER_CHUNK_AUDIO:
+            if ((size & 1) || (size > RECORDER_MAX_AUDIO_SAMPLES * 2)) {
+                return RECORDER_EVENT_ERROR;
+            }
+            player->num_samples = (int)size / 2;
+            for (int i = 0; i < player->num_samples; i++) {
+                player->samples[i] = (int16_t)_recorder_get16(&payload[i * 2]);
+            }
+            return RECORDER_EVENT_AUDIO;
+        case RECORDER_CHUNK_INPUT:
+            if (size != 3) {
+                return RECORDER_EVENT_ERROR;
+            }
+            player->key_down = payload[0] != 0;
+            player->key_code = _recorder_get16(&payload[1]);
+            return RECORDER_EVENT_INPUT;
+        default:
+            return RECORDER_EVENT_ERROR;
+    }
+}
+
+#endif  // CHIPS_IMPL
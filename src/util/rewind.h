@@ -0,0 +1,370 @@
+#pragma once
+
+// rewind.h
+//
+// Rewind history: keeps a snapshot image (e.g. the result of
+// apple2_save_snapshot()) every few frames as an XOR delta against the
+// previous snapshot, RLE-compressed with chips_rle_encode(), in a ring
+// buffer. When the buffer is full the oldest snapshots are dropped.
+//
+// The image is compared in blocks of REWIND_BLOCK_SIZE bytes. Ranges of the
+// image registered with rewind_track() (the system RAM) are only compared
+// where they have been written, as reported by rewind_mark_written() or
+// rewind_mark_mem_written(), everything else is compared on every snapshot.
+// Only blocks which changed are stored.
+//
+// Usage (once per frame):
+//
+//     rewind_mark_mem_written(&rw, &sys.mem, &sys);
+//     if (rewind_frame(&rw)) {
+//         apple2_save_snapshot(&sys, &snapshot);
+//         rewind_push(&rw, &snapshot);
+//     }
+//
+// and to go back in time:
+//
+//     const apple2_t* im = rewind_step_back(&rw, num_frames);
+//     if (im) {
+//         apple2_load_snapshot(&sys, APPLE2_SNAPSHOT_VERSION, (apple2_t*)im);
+//         mem_clear_written(&sys.mem);
+//     }
+//
+// Memory outside the image (e.g. disk images) is not rewound.
+//
+// Include chips/chips_common.h and chips/mem.h before this header,
+// rewind_mark_mem_written() needs mem.h compiled with MEM_TRACK_WRITES.
+//
+// ## zlib/libpng license
+//
+// Copyright (c) 2025 Veselin Sladkov
+// This software is provided 'as-is', without any express or implied warranty.
+// In no event will the authors be held liable for any damages arising from the
+// use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+//     1. The origin of this software must not be misrepresented; you must not
+//     claim that you wrote the original software. If you use this software in a
+//     product, an acknowledgment in the product documentation would be
+//     appreciated but is not required.
+//     2. Altered source versions must be plainly marked as such, and must not
+//     be misrepresented as being the original software.
+//     3. This notice may not be removed or altered from any source
+//     distribution.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define REWIND_BLOCK_SIZE              (256)   // Image compare granularity in bytes
+#define REWIND_BLOCK_HEADER_SIZE       (4)     // uint16_t block index, uint16_t RLE size
+#define REWIND_MAX_SNAPSHOTS           (4096)  // Max number of snapshots in the history
+#define REWIND_DEFAULT_SNAPSHOT_FRAMES (6)
+
+// Setup parameters for rewind_init()
+typedef struct {
+    size_t image_size;         // Size of a snapshot image in bytes
+    uint32_t snapshot_frames;  // Frames between snapshots (default: REWIND_DEFAULT_SNAPSHOT_FRAMES)
+    chips_range_t buffer;      // Memory for the newest image and the delta history
+} rewind_desc_t;
+
+// A snapshot in the history, holds the delta to the previous snapshot (may wrap around the ring end)
+typedef struct {
+    uint32_t frame;  // Frame counter when the snapshot was taken
+    uint32_t offset;
+    uint32_t size;
+} rewind_entry_t;
+
+// Rewind history state
+typedef struct {
+    bool valid;
+    size_t image_size;
+    int num_blocks;
+    uint32_t snapshot_frames;
+    uint32_t frame;            // Frames counted by rewind_frame()
+    uint8_t* image;            // Newest snapshot image, base of the next delta
+    uint8_t* block_tracked;    // Per block: only compared when written
+    uint8_t* block_written;    // Per block: written since the last snapshot
+    uint8_t* scratch;          // Delta being encoded
+    uint8_t* ring;             // Delta history
+    size_t ring_size;
+    size_t ring_pos;           // Offset of the next delta in the ring
+    size_t ring_used;          // Bytes used by the deltas in the ring
+    bool all_written;          // Compare all blocks on the next snapshot
+    int first;                 // Index of the oldest entry
+    int num_entries;
+    rewind_entry_t entries[REWIND_MAX_SNAPSHOTS];
+} rewind_t;
+
+// Initialize the rewind history
+void rewind_init(rewind_t* rw, const rewind_desc_t* desc);
+// Register an image range which only changes where reported by rewind_mark_written()
+void rewind_track(rewind_t* rw, size_t offset, size_t size);
+// Report a written image range
+void rewind_mark_written(rewind_t* rw, size_t offset, size_t size);
+#ifdef MEM_TRACK_WRITES
+// Report the pages written through 'mem', 'base' is the system the image is a copy of
+void rewind_mark_mem_written(rewind_t* rw, mem_t* mem, const void* base);
+#endif
+// Count a frame, returns true if a snapshot should be pushed in this frame
+bool rewind_frame(rewind_t* rw);
+// Add a snapshot image to the history
+void rewind_push(rewind_t* rw, const void* image);
+// Go back to the newest snapshot at least 'num_frames' frames old (or the oldest one), drops newer snapshots,
+// returns the snapshot image or null if the history is empty
+const void* rewind_step_back(rewind_t* rw, uint32_t num_frames);
+// Drop the history (e.g. after loading a state), the next snapshot starts a new one
+void rewind_reset(rewind_t* rw);
+// Return the number of frames covered by the history
+uint32_t rewind_num_frames(const rewind_t* rw);
+// Return the number of bytes used by the delta history
+size_t rewind_history_size(const rewind_t* rw);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+#define _REWIND_MAX_DELTA_SIZE(num_blocks) \
+    ((size_t)(num_blocks) * (REWIND_BLOCK_HEADER_SIZE + CHIPS_RLE_MAX_SIZE(REWIND_BLOCK_SIZE)))
+
+static uint8_t* _rewind_alloc(uint8_t** ptr, size_t size) {
+    uint8_t* p = *ptr;
+    // Keep allocations 8-byte aligned, the image is cast to the system type
+    *ptr += (size + 7) & ~(size_t)7;
+    return p;
+}
+
+void rewind_init(rewind_t* rw, const rewind_desc_t* desc) {
+    CHIPS_ASSERT(rw && desc && (desc->image_size > 0) && desc->buffer.ptr);
+    CHIPS_ASSERT(((uintptr_t)desc->buffer.ptr & 7) == 0);
+    memset(rw, 0, sizeof(*rw));
+    rw->image_size = desc->image_size;
+    rw->num_blocks = (int)((desc->image_size + REWIND_BLOCK_SIZE - 1) / REWIND_BLOCK_SIZE);
+    CHIPS_ASSERT(rw->num_blocks <= 0xFFFF);
+    rw->snapshot_frames = CHIPS_DEFAULT(desc->snapshot_frames, REWIND_DEFAULT_SNAPSHOT_FRAMES);
+
+    uint8_t* ptr = (uint8_t*)desc->buffer.ptr;
+    rw->image = _rewind_alloc(&ptr, desc->image_size);
+    rw->block_tracked = _rewind_alloc(&ptr, rw->num_blocks);
+    rw->block_written = _rewind_alloc(&ptr, rw->num_blocks);
+    rw->scratch = _rewind_alloc(&ptr, _REWIND_MAX_DELTA_SIZE(rw->num_blocks));
+    const size_t used = ptr - (uint8_t*)desc->buffer.ptr;
+    // The history must at least hold one full delta
+    CHIPS_ASSERT(desc->buffer.size >= used + _REWIND_MAX_DELTA_SIZE(rw->num_blocks));
+    rw->ring = ptr;
+    rw->ring_size = desc->buffer.size - used;
+    memset(rw->block_tracked, 0, rw->num_blocks);
+    rw->valid = true;
+    rewind_reset(rw);
+}
+
+void rewind_track(rewind_t* rw, size_t offset, size_t size) {
+    CHIPS_ASSERT(rw && rw->valid && (offset + size <= rw->image_size));
+    // Blocks partially outside the range are always compared
+    const size_t first = (offset + REWIND_BLOCK_SIZE - 1) / REWIND_BLOCK_SIZE;
+    const size_t end = (offset + size) / REWIND_BLOCK_SIZE;
+    for (size_t i = first; i < end; i++) {
+        rw->block_tracked[i] = 1;
+    }
+}
+
+void rewind_mark_written(rewind_t* rw, size_t offset, size_t size) {
+    CHIPS_ASSERT(rw && rw->valid);
+    if ((size == 0) || (offset >= rw->image_size)) {
+        return;
+    }
+    size_t end = offset + size;
+    if (end > rw->image_size) {
+        end = rw->image_size;
+    }
+    for (size_t i = offset / REWIND_BLOCK_SIZE; i <= (end - 1) / REWIND_BLOCK_SIZE; i++) {
+        rw->block_written[i] = 1;
+    }
+}
+
+#ifdef MEM_TRACK_WRITES
+typedef struct {
+    rewind_t* rw;
+    const uint8_t* base;
+} _rewind_mem_ctx_t;
+
+static void _rewind_mem_written(uint8_t* ptr, void* user_data) {
+    _rewind_mem_ctx_t* ctx = (_rewind_mem_ctx_t*)user_data;
+    // Pages outside the system (ROM junk page, disk images) are not part of the image
+    if ((ptr >= ctx->base) && (ptr < ctx->base + ctx->rw->image_size)) {
+        rewind_mark_written(ctx->rw, (size_t)(ptr - ctx->base), MEM_PAGE_SIZE);
+    }
+}
+
+void rewind_mark_mem_written(rewind_t* rw, mem_t* mem, const void* base) {
+    CHIPS_ASSERT(rw && rw->valid && mem && base);
+    _rewind_mem_ctx_t ctx = {rw, (const uint8_t*)base};
+    if (!mem_collect_written(mem, _rewind_mem_written, &ctx)) {
+        rw->all_written = true;
+    }
+}
+#endif
+
+static rewind_entry_t* _rewind_entry(rewind_t* rw, int index) {
+    return &rw->entries[(rw->first + index) % REWIND_MAX_SNAPSHOTS];
+}
+
+bool rewind_frame(rewind_t* rw) {
+    CHIPS_ASSERT(rw && rw->valid);
+    rw->frame++;
+    return (rw->num_entries == 0) ||
+           ((rw->frame - _rewind_entry(rw, rw->num_entries - 1)->frame) >= rw->snapshot_frames);
+}
+
+// The delta of the oldest snapshot is never applied, its ring space is freed
+static void _rewind_drop_oldest(rewind_t* rw) {
+    rw->first = (rw->first + 1) % REWIND_MAX_SNAPSHOTS;
+    rw->num_entries--;
+    rewind_entry_t* oldest = _rewind_entry(rw, 0);
+    rw->ring_used -= oldest->size;
+    oldest->size = 0;
+}
+
+// Encode the changed blocks as XOR deltas into the scratch buffer and update the base image
+static size_t _rewind_encode(rewind_t* rw, const uint8_t* image) {
+    static uint8_t delta[REWIND_BLOCK_SIZE];
+    size_t pos = 0;
+    for (int block = 0; block < rw->num_blocks; block++) {
+        if (rw->block_tracked[block] && !rw->block_written[block] && !rw->all_written) {
+            continue;
+        }
+        const size_t offset = (size_t)block * REWIND_BLOCK_SIZE;
+        const size_t len = ((rw->image_size - offset) < REWIND_BLOCK_SIZE) ? (rw->image_size - offset)
+                                                                           : REWIND_BLOCK_SIZE;
+        if (memcmp(&rw->image[offset], &image[offset], len) == 0) {
+            continue;
+        }
+        for (size_t i = 0; i < len; i++) {
+            delta[i] = rw->image[offset + i] ^ image[offset + i];
+        }
+        memcpy(&rw->image[offset], &image[offset], len);
+        const int size = chips_rle_encode(delta, (int)len, &rw->scratch[pos + REWIND_BLOCK_HEADER_SIZE]);
+        rw->scratch[pos + 0] = (uint8_t)block;
+        rw->scratch[pos + 1] = (uint8_t)(block >> 8);
+        rw->scratch[pos + 2] = (uint8_t)size;
+        rw->scratch[pos + 3] = (uint8_t)(size >> 8);
+        pos += REWIND_BLOCK_HEADER_SIZE + size;
+    }
+    memset(rw->block_written, 0, rw->num_blocks);
+    rw->all_written = false;
+    return pos;
+}
+
+// XOR a delta into the base image
+static void _rewind_apply(rewind_t* rw, const rewind_entry_t* entry) {
+    static uint8_t delta[REWIND_BLOCK_SIZE];
+    const uint8_t* p = &rw->ring[entry->offset];
+    if (entry->offset + entry->size > rw->ring_size) {
+        // Delta wraps around the ring end
+        const size_t part = rw->ring_size - entry->offset;
+        memcpy(rw->scratch, p, part);
+        memcpy(rw->scratch + part, rw->ring, entry->size - part);
+        p = rw->scratch;
+    }
+    size_t pos = 0;
+    while (pos < entry->size) {
+        const int block = p[pos] | (p[pos + 1] << 8);
+        const int size = p[pos + 2] | (p[pos + 3] << 8);
+        pos += REWIND_BLOCK_HEADER_SIZE;
+        const size_t offset = (size_t)block * REWIND_BLOCK_SIZE;
+        const int len = ((rw->image_size - offset) < REWIND_BLOCK_SIZE) ? (int)(rw->image_size - offset)
+                                                                        : REWIND_BLOCK_SIZE;
+        const bool valid = chips_rle_decode(&p[pos], size, delta, len);
+        CHIPS_ASSERT(valid);
+        (void)valid;
+        for (int i = 0; i < len; i++) {
+            rw->image[offset + i] ^= delta[i];
+        }
+        pos += size;
+    }
+}
+
+void rewind_push(rewind_t* rw, const void* image) {
+    CHIPS_ASSERT(rw && rw->valid && image);
+    if (rw->num_entries == 0) {
+        // First snapshot, only initializes the base image
+        rw->all_written = true;
+        _rewind_encode(rw, (const uint8_t*)image);
+        rw->first = 0;
+        rw->num_entries = 1;
+        *_rewind_entry(rw, 0) = (rewind_entry_t){.frame = rw->frame, .offset = (uint32_t)rw->ring_pos, .size = 0};
+        return;
+    }
+    const size_t size = _rewind_encode(rw, (const uint8_t*)image);
+    while ((rw->num_entries > 1) && ((rw->ring_used + size > rw->ring_size) ||
+                                     (rw->num_entries == REWIND_MAX_SNAPSHOTS))) {
+        _rewind_drop_oldest(rw);
+    }
+    const size_t part = ((rw->ring_size - rw->ring_pos) < size) ? (rw->ring_size - rw->ring_pos) : size;
+    memcpy(&rw->ring[rw->ring_pos], rw->scratch, part);
+    memcpy(rw->ring, rw->scratch + part, size - part);
+    *_rewind_entry(rw, rw->num_entries) = (rewind_entry_t){.frame = rw->frame, .offset = (uint32_t)rw->ring_pos,
+                                                          .size = (uint32_t)size};
+    rw->num_entries++;
+    rw->ring_pos = (rw->ring_pos + size) % rw->ring_size;
+    rw->ring_used += size;
+}
+
+const void* rewind_step_back(rewind_t* rw, uint32_t num_frames) {
+    CHIPS_ASSERT(rw && rw->valid);
+    if (rw->num_entries == 0) {
+        return 0;
+    }
+    const uint32_t target = (num_frames < rw->frame) ? (rw->frame - num_frames) : 0;
+    while ((rw->num_entries > 1) && (_rewind_entry(rw, rw->num_entries - 1)->frame > target)) {
+        const rewind_entry_t* newest = _rewind_entry(rw, rw->num_entries - 1);
+        _rewind_apply(rw, newest);
+        rw->ring_pos = newest->offset;
+        rw->ring_used -= newest->size;
+        rw->num_entries--;
+    }
+    rw->frame = _rewind_entry(rw, rw->num_entries - 1)->frame;
+    // The caller loads the image, so it stays the base of the next delta
+    memset(rw->block_written, 0, rw->num_blocks);
+    rw->all_written = false;
+    return rw->image;
+}
+
+void rewind_reset(rewind_t* rw) {
+    CHIPS_ASSERT(rw && rw->valid);
+    rw->first = 0;
+    rw->num_entries = 0;
+    rw->ring_pos = 0;
+    rw->ring_used = 0;
+    rw->frame = 0;
+    memset(rw->image, 0, rw->image_size);
+    memset(rw->block_written, 0, rw->num_blocks);
+    rw->all_written = true;
+}
+
+uint32_t rewind_num_frames(const rewind_t* rw) {
+    CHIPS_ASSERT(rw && rw->valid);
+    if (rw->num_entries == 0) {
+        return 0;
+    }
+    return rw->frame - rw->entries[rw->first].frame;
+}
+
+size_t rewind_history_size(const rewind_t* rw) {
+    CHIPS_ASSERT(rw && rw->valid);
+    return rw->ring_used;
+}
+
+#endif  // CHIPS_IMPL
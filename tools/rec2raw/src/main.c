@@ -0,0 +1,181 @@
+// Export a session recording (src/util/recorder.h) to raw RGBA video and WAV audio
+//
+// Build from the repository root:
+//     cc -O2 -I src tools/rec2raw/src/main.c -o rec2raw
+//
+// The video file is a sequence of width * height RGBA frames, e.g. for ffmpeg:
+//     ffmpeg -f rawvideo -pix_fmt rgba -s 240x224 -r 60 -i video.rgba -i audio.wav out.mp4
+
+#define CHIPS_IMPL
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "chips/chips_common.h"
+#include "util/recorder.h"
+
+static recorder_player_t player;
+static uint8_t rgba_frame[RECORDER_MAX_FRAMEBUFFER_SIZE * 2 * 4];
+
+static void _put16(FILE* out, uint16_t v) {
+    fputc(v & 0xFF, out);
+    fputc(v >> 8, out);
+}
+
+static void _put32(FILE* out, uint32_t v) {
+    _put16(out, v & 0xFFFF);
+    _put16(out, v >> 16);
+}
+
+// Write the 44 byte WAV header for 'num_samples' mono 16-bit samples
+static void _write_wav_header(FILE* out, uint32_t sample_rate, uint32_t num_samples) {
+    fwrite("RIFF", 4, 1, out);
+    _put32(out, 36 + num_samples * 2);
+    fwrite("WAVEfmt ", 8, 1, out);
+    _put32(out, 16);
+    _put16(out, 1);  // PCM
+    _put16(out, 1);  // Mono
+    _put32(out, sample_rate);
+    _put32(out, sample_rate * 2);
+    _put16(out, 2);
+    _put16(out, 16);
+    fwrite("data", 4, 1, out);
+    _put32(out, num_samples * 2);
+}
+
+static void _write_rgba_frame(FILE* out) {
+    const int num_pixels = player.width * player.height;
+    for (int i = 0; i < num_pixels; i++) {
+        const uint8_t pixels = player.fb[i >> 1];
+        const uint32_t c = player.palette[(i & 1) ? (pixels & 0x0F) : (pixels >> 4)];
+        // Palette entries hold the bytes of one RGBA8 texel in little endian order
+        rgba_frame[i * 4 + 0] = (uint8_t)c;
+        rgba_frame[i * 4 + 1] = (uint8_t)(c >> 8);
+        rgba_frame[i * 4 + 2] = (uint8_t)(c >> 16);
+        rgba_frame[i * 4 + 3] = (uint8_t)(c >> 24);
+    }
+    fwrite(rgba_frame, num_pixels * 4, 1, out);
+}
+
+// Export recording to raw RGBA and/or WAV files
+static bool export_recording(const char* rec_file, const char* video_file, const char* audio_file) {
+    FILE* in = fopen(rec_file, "rb");
+    if (in == NULL) {
+        fprintf(stderr, "Failed to open file for reading: %s\n", rec_file);
+        return false;
+    }
+    fseek(in, 0, SEEK_END);
+    const long size = ftell(in);
+    fseek(in, 0, SEEK_SET);
+    uint8_t* data = malloc(size > 0 ? size : 1);
+    if ((size <= 0) || (fread(data, size, 1, in) != 1)) {
+        fprintf(stderr, "Failed to read file: %s\n", rec_file);
+        fclose(in);
+        free(data);
+        return false;
+    }
+    fclose(in);
+
+    if (!recorder_player_init(&player, data, size)) {
+        fprintf(stderr, "Invalid recording: %s\n", rec_file);
+        free(data);
+        return false;
+    }
+
+    FILE* video = NULL;
+    FILE* audio = NULL;
+    if (video_file && ((video = fopen(video_file, "wb")) == NULL)) {
+        fprintf(stderr, "Failed to open file for writing: %s\n", video_file);
+    }
+    if (audio_file && ((audio = fopen(audio_file, "wb")) == NULL)) {
+        fprintf(stderr, "Failed to open file for writing: %s\n", audio_file);
+    }
+    if (audio) {
+        // Patched with the final sample count below
+        _write_wav_header(audio, player.sample_rate, 0);
+    }
+
+    uint32_t num_samples = 0;
+    uint32_t num_inputs = 0;
+    recorder_event_t event;
+    while ((event = recorder_player_next(&player)) > RECORDER_EVENT_ERROR) {
+        switch (event) {
+            case RECORDER_EVENT_FRAME:
+                if (video) {
+                    _write_rgba_frame(video);
+                }
+                break;
+            case RECORDER_EVENT_AUDIO:
+                if (audio) {
+                    for (int i = 0; i < player.num_samples; i++) {
+                        _put16(audio, (uint16_t)player.samples[i]);
+                    }
+                }
+                num_samples += player.num_samples;
+                break;
+            case RECORDER_EVENT_INPUT:
+                num_inputs++;
+                break;
+            default:
+                break;
+        }
+    }
+    if (event == RECORDER_EVENT_ERROR) {
+        fprintf(stderr, "Recording is truncated or invalid, exported up to frame %u\n", player.num_frames);
+    }
+
+    if (video) {
+        fclose(video);
+    }
+    if (audio) {
+        fseek(audio, 0, SEEK_SET);
+        _write_wav_header(audio, player.sample_rate, num_samples);
+        fclose(audio);
+    }
+    free(data);
+
+    fprintf(stderr, "%dx%d, %u frames, %u samples at %d Hz, %u input events\n", player.width, player.height,
+            player.num_frames, num_samples, player.sample_rate, num_inputs);
+    return true;
+}
+
+static void print_usage(const char* argv0) {
+    fprintf(stderr,
+            "Usage: %s [-i recording_file] [-v RGBA_file] [-a WAV_file]\n"
+            "\t-h show this help\n",
+            argv0);
+    exit(1);
+}
+
+int main(int argc, char* const argv[]) {
+    char *infile = NULL, *videofile = NULL, *audiofile = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "i:v:a:h")) != -1) {
+        switch (opt) {
+            case 'i':
+                infile = strdup(optarg);
+                break;
+            case 'v':
+                videofile = strdup(optarg);
+                break;
+            case 'a':
+                audiofile = strdup(optarg);
+                break;
+            case 'h':
+            default:
+                print_usage(argv[0]);
+                break;
+        }
+    }
+
+    if (!infile) {
+        print_usage(argv[0]);
+    }
+
+    return export_recording(infile, videofile, audiofile) ? 0 : 1;
+}